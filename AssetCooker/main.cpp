@@ -0,0 +1,61 @@
+// Command line front end of the AssetCooker, run it after changing anything under Resource.
+//
+//   AssetCooker [--force] [--pack] [game directory]
+//
+// The game directory is the one holding Resource (the game's working directory), the cooked files
+// are written to its Cooked directory. --force cooks every asset again, --pack then packs the sources
+// and the cooked files into the asset archive the game mounts, which is all a shipped game needs.
+
+#include "../CS405-OpenGL-v0.5/AssetCooker.h"
+
+#include <iostream>
+#include <cstring>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+
+int main(int argc, char **argv)
+{
+	bool force = false, pack = false;
+	const char *directory = NULL;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--force") == 0)
+		{
+			force = true;
+		}
+		else if (std::strcmp(argv[i], "--pack") == 0)
+		{
+			pack = true;
+		}
+		else if (argv[i][0] == '-')
+		{
+			std::cout << "usage: AssetCooker [--force] [--pack] [game directory]" << std::endl;
+			return 2;
+		}
+		else
+		{
+			directory = argv[i];
+		}
+	}
+
+#ifdef _WIN32
+	if (directory != NULL && _chdir(directory) != 0)
+#else
+	if (directory != NULL && chdir(directory) != 0)
+#endif
+	{
+		std::cout << "AssetCooker: cannot enter " << directory << std::endl;
+		return 2;
+	}
+
+	AssetCooker cooker;
+	unsigned int failed = cooker.Run(force);
+	// an asset that failed to cook is read from its source
+	if (pack && !cooker.Pack(FILE_ARCHIVE))
+		return 1;
+	return failed == 0 ? 0 : 1;
+}
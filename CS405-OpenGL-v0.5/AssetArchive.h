@@ -0,0 +1,290 @@
+#ifndef ASSET_ARCHIVE_H
+#define ASSET_ARCHIVE_H
+
+#include <string>
+#include <vector>
+#include <set>
+#include <memory>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+
+#include "CookedAsset.h"
+#include "MappedFile.h"
+#include "LZ4Block.h"
+
+// The asset archive packs the files the game reads into one file, opened & mapped once at start up.
+// Layout: AssetArchiveHeader | entry data | names | AssetArchiveEntry per file.
+// The entries are sorted by the hash of their name, a lookup is a binary search (names tell collisions
+// apart). An entry is stored as it is, aligned so that a cooked file is read straight from the mapping
+// of the archive, or as one LZ4 block when that saves enough and the file is not meant to be mapped.
+
+const uint32_t ASSET_ARCHIVE_MAGIC = 0x4b415041; // "APAK"
+const uint32_t ASSET_ARCHIVE_VERSION = 1;
+// the cooked formats need 8, a cache line would gain nothing
+const size_t ASSET_ARCHIVE_ALIGNMENT = 16;
+// a file is compressed when that saves at least 1/8 of it
+const size_t ASSET_ARCHIVE_MIN_SAVING = 8;
+
+const uint32_t ASSET_ARCHIVE_ENTRY_LZ4 = 1;
+
+struct AssetArchiveHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t reserved;
+	uint64_t nameOffset;
+	uint64_t entryOffset;
+	uint64_t fileSize;
+};
+
+struct AssetArchiveEntry {
+	uint64_t hash;
+	uint64_t offset;
+	// in the archive, and once read
+	uint64_t storedSize;
+	uint64_t size;
+	// range of the name block
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint32_t flags;
+	uint32_t reserved;
+};
+
+class AssetArchive {
+public:
+	AssetArchive() { }
+
+	// Packs the files, each named by its path (see GetName). False when the archive can not be written,
+	// files that can not be read (or are empty) are left out.
+	static bool Write(const std::string &archivePath, const std::vector<std::string> &paths);
+
+	// The name of a path in the archive: slashes only, no "./" or "dir/.." parts.
+	static std::string GetName(const std::string &path);
+
+	// Maps the archive, false when it is missing or damaged.
+	bool Open(const std::string &archivePath);
+	void Close();
+	bool IsOpen() const { return (bool)_file; }
+	size_t GetEntryCount() const { return _file ? _GetHeader().entryCount : 0; }
+
+	// the entry of a name, null when the archive lacks it
+	const AssetArchiveEntry *Find(const std::string &name) const;
+	// The bytes of an entry: a view of the archive or, for a compressed one, a copy. Any thread.
+	std::shared_ptr<MappedFile> Read(const AssetArchiveEntry &entry) const;
+
+private:
+	std::shared_ptr<MappedFile> _file;
+
+	const AssetArchiveHeader &_GetHeader() const { return *(const AssetArchiveHeader*)_file->GetData(); }
+	const AssetArchiveEntry *_GetEntries() const { return (const AssetArchiveEntry*)(_file->GetData() + _GetHeader().entryOffset); }
+	static bool _Validate(const MappedFile &file);
+	// cooked files are mapped by whoever reads them, compressing them would force a copy
+	static bool _IsMapped(const std::string &name);
+	static uint64_t _Hash(const std::string &name) { return CookedAsset::Hash(CookedAsset::HASH_SEED, name.data(), name.size()); }
+	static size_t _AlignEntry(size_t offset) { return (offset + ASSET_ARCHIVE_ALIGNMENT - 1) & ~(ASSET_ARCHIVE_ALIGNMENT - 1); }
+};
+
+bool AssetArchive::Write(const std::string &archivePath, const std::vector<std::string> &paths)
+{
+	std::string temporary_path = CookedAsset::BeginWrite(archivePath);
+	std::ofstream file(temporary_path.c_str(), std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "AssetArchive: cannot write " << archivePath << std::endl;
+		return false;
+	}
+
+	AssetArchiveHeader header;
+	std::memset(&header, 0, sizeof(header));
+	file.write((const char*)&header, sizeof(header));
+	size_t written = sizeof(header);
+
+	const char padding[ASSET_ARCHIVE_ALIGNMENT] = {};
+	std::vector<AssetArchiveEntry> entries;
+	std::vector<std::string> names;
+	std::set<std::string> packed;
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		std::string name = GetName(paths[i]);
+		if (!packed.insert(name).second)
+			continue;
+		MappedFile source;
+		if (!source.Open(paths[i]))
+		{
+			std::cout << "AssetArchive: cannot read " << paths[i] << std::endl;
+			continue;
+		}
+
+		AssetArchiveEntry entry;
+		std::memset(&entry, 0, sizeof(entry));
+		entry.hash = _Hash(name);
+		entry.size = source.GetSize();
+
+		const unsigned char *data = source.GetData();
+		size_t stored_size = source.GetSize();
+		std::vector<unsigned char> compressed;
+		if (!_IsMapped(name))
+		{
+			compressed = LZ4Block::Compress(source.GetData(), source.GetSize());
+			if (compressed.size() <= source.GetSize() - source.GetSize() / ASSET_ARCHIVE_MIN_SAVING)
+			{
+				data = compressed.data();
+				stored_size = compressed.size();
+				entry.flags |= ASSET_ARCHIVE_ENTRY_LZ4;
+			}
+		}
+
+		entry.offset = _AlignEntry(written);
+		entry.storedSize = stored_size;
+		file.write(padding, (size_t)entry.offset - written);
+		file.write((const char*)data, stored_size);
+		written = (size_t)entry.offset + stored_size;
+
+		entries.push_back(entry);
+		names.push_back(name);
+	}
+
+	// names in the order of the entries
+	std::vector<size_t> order(entries.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&entries](size_t lhs, size_t rhs) { return entries[lhs].hash < entries[rhs].hash; });
+
+	std::string strings;
+	std::vector<AssetArchiveEntry> sorted(entries.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		sorted[i] = entries[order[i]];
+		sorted[i].nameOffset = (uint32_t)strings.size();
+		sorted[i].nameLength = (uint32_t)names[order[i]].size();
+		strings += names[order[i]];
+	}
+
+	header.magic = ASSET_ARCHIVE_MAGIC;
+	header.version = ASSET_ARCHIVE_VERSION;
+	header.entryCount = (uint32_t)sorted.size();
+	header.nameOffset = written;
+	header.entryOffset = CookedAsset::Align(written + strings.size());
+	header.fileSize = header.entryOffset + sorted.size() * sizeof(AssetArchiveEntry);
+	file.write(strings.data(), strings.size());
+	file.write(padding, (size_t)header.entryOffset - written - strings.size());
+	if (!sorted.empty())
+		file.write((const char*)sorted.data(), sorted.size() * sizeof(AssetArchiveEntry));
+	file.seekp(0);
+	file.write((const char*)&header, sizeof(header));
+	file.close();
+	return CookedAsset::Replace(temporary_path, archivePath, (bool)file);
+}
+
+std::string AssetArchive::GetName(const std::string &path)
+{
+	std::string normalized = CookedAsset::NormalizePath(path);
+	std::vector<std::string> parts;
+	size_t begin = 0;
+	while (begin <= normalized.size())
+	{
+		size_t end = normalized.find('/', begin);
+		if (end == std::string::npos)
+			end = normalized.size();
+		std::string part = normalized.substr(begin, end - begin);
+		if (part == ".." && !parts.empty() && parts.back() != "..")
+			parts.pop_back();
+		else if (!part.empty() && part != ".")
+			parts.push_back(part);
+		begin = end + 1;
+	}
+
+	// an absolute path stays absolute
+	std::string name = normalized.compare(0, 1, "/") == 0 ? "/" : "";
+	for (size_t i = 0; i < parts.size(); i++)
+		name += (i == 0 ? "" : "/") + parts[i];
+	return name;
+}
+
+bool AssetArchive::Open(const std::string &archivePath)
+{
+	Close();
+	std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+	if (!file->Open(archivePath) || !_Validate(*file))
+		return false;
+	_file = file;
+	return true;
+}
+
+void AssetArchive::Close()
+{
+	// entries still read keep the mapping alive
+	_file.reset();
+}
+
+const AssetArchiveEntry *AssetArchive::Find(const std::string &name) const
+{
+	if (!_file)
+		return nullptr;
+
+	uint64_t hash = _Hash(name);
+	const AssetArchiveEntry *begin = _GetEntries(), *end = begin + _GetHeader().entryCount;
+	const char *names = (const char*)_file->GetData() + _GetHeader().nameOffset;
+	const AssetArchiveEntry *entry = std::lower_bound(begin, end, hash,
+		[](const AssetArchiveEntry &lhs, uint64_t rhs) { return lhs.hash < rhs; });
+	for (; entry != end && entry->hash == hash; ++entry)
+	{
+		if (entry->nameLength == name.size() && std::memcmp(names + entry->nameOffset, name.data(), name.size()) == 0)
+			return entry;
+	}
+	return nullptr;
+}
+
+std::shared_ptr<MappedFile> AssetArchive::Read(const AssetArchiveEntry &entry) const
+{
+	std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+	if (!(entry.flags & ASSET_ARCHIVE_ENTRY_LZ4))
+		return file->OpenView(_file, (size_t)entry.offset, (size_t)entry.size) ? file : nullptr;
+
+	std::vector<unsigned char> bytes((size_t)entry.size);
+	if (!LZ4Block::Decompress(_file->GetData() + entry.offset, (size_t)entry.storedSize, bytes.data(), bytes.size()))
+	{
+		std::cout << "AssetArchive: damaged entry " << std::string((const char*)_file->GetData() + _GetHeader().nameOffset + entry.nameOffset, entry.nameLength) << std::endl;
+		return nullptr;
+	}
+	return file->Assign(bytes) ? file : nullptr;
+}
+
+bool AssetArchive::_Validate(const MappedFile &file)
+{
+	if (file.GetSize() < sizeof(AssetArchiveHeader))
+		return false;
+	const AssetArchiveHeader &header = *(const AssetArchiveHeader*)file.GetData();
+	if (header.magic != ASSET_ARCHIVE_MAGIC || header.version != ASSET_ARCHIVE_VERSION || header.fileSize != file.GetSize() ||
+		header.nameOffset > header.entryOffset || header.entryOffset % 8 != 0 ||
+		header.entryOffset + (uint64_t)header.entryCount * sizeof(AssetArchiveEntry) != header.fileSize)
+		return false;
+
+	// entries lie before the names, names inside their block
+	const AssetArchiveEntry *entries = (const AssetArchiveEntry*)(file.GetData() + header.entryOffset);
+	for (uint32_t i = 0; i < header.entryCount; i++)
+	{
+		const AssetArchiveEntry &entry = entries[i];
+		if (entry.offset > header.nameOffset || entry.storedSize > header.nameOffset - entry.offset ||
+			(uint64_t)entry.nameOffset + entry.nameLength > header.entryOffset - header.nameOffset ||
+			(i > 0 && entries[i - 1].hash > entry.hash))
+			return false;
+		if (!(entry.flags & ASSET_ARCHIVE_ENTRY_LZ4) && entry.storedSize != entry.size)
+			return false;
+		// Read allocates size bytes up front, a block can not grow beyond that
+		if ((entry.flags & ASSET_ARCHIVE_ENTRY_LZ4) && entry.size > LZ4Block::GetMaxSize(entry.storedSize))
+			return false;
+	}
+	return true;
+}
+
+bool AssetArchive::_IsMapped(const std::string &name)
+{
+	std::string cooked = GetName(DIRECTORY_COOKED) + "/";
+	return name.compare(0, cooked.size(), cooked) == 0;
+}
+
+#endif
@@ -0,0 +1,490 @@
+#ifndef ASSET_COOKER_H
+#define ASSET_COOKER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include "model.h"
+#include "CookedAsset.h"
+#include "CookedMesh.h"
+#include "CookedTexture.h"
+#include "ShaderBundle.h"
+#include "AssetArchive.h"
+#include "ThreadPool.h"
+#include "StringTable.h"
+
+// bump when the cooked output changes without a format version changing (tuning of the mesh pipeline, ...)
+const uint32_t ASSET_COOKER_VERSION = 2;
+
+// AssetCooker converts the sources under Resource into the cooked formats the game maps at load time:
+// models into CookedMesh files, images into CookedTexture files and all shader stages into one bundle.
+// Every asset is keyed by a content hash of its sources (a model includes its material libraries) and
+// of the cooker & format versions, so a run only cooks what changed. File hashes are cached in the
+// manifest by size & modification time, an untouched source is never read again.
+// Assets are cooked in parallel on the shared thread pool, nothing here needs a GL context.
+class AssetCooker {
+public:
+	AssetCooker() : _cooked(0), _restamped(0), _skipped(0), _failed(0) { }
+
+	// Cooks everything out of date, every asset when force is set. Returns the number of failures.
+	unsigned int Run(bool force);
+
+	// Packs what the game reads, the sources & the cooked files, into one archive. False when it can not be written.
+	bool Pack(const std::string &archivePath);
+
+private:
+	enum _AssetKind { _ASSET_MESH, _ASSET_TEXTURE, _ASSET_SHADERS };
+
+	struct _Asset {
+		_AssetKind kind;
+		// the first source is the one the cooked file is stamped with
+		std::vector<std::string> sources;
+		std::string output;
+		uint64_t hash;
+	};
+
+	// content hash of a source as of its size & modification time
+	struct _FileRecord {
+		uint64_t hash;
+		uint64_t size;
+		int64_t time;
+	};
+
+	std::map<std::string, _FileRecord> _files;
+	// content hash each output was cooked from
+	std::map<std::string, uint64_t> _outputs;
+	std::mutex _mutex;
+
+	std::atomic<unsigned int> _cooked;
+	std::atomic<unsigned int> _restamped;
+	std::atomic<unsigned int> _skipped;
+	std::atomic<unsigned int> _failed;
+
+	void _LoadManifest();
+	void _SaveManifest();
+
+	void _GatherAssets(std::vector<_Asset> &assets);
+	void _HashSources(std::vector<_Asset> &assets);
+	void _Cook(_Asset &asset, bool force);
+	bool _Build(const _Asset &asset);
+
+	static uint64_t _KindSeed(_AssetKind kind);
+	static void _ListFiles(const std::string &directory, std::vector<std::string> &files);
+	static std::string _Extension(const std::string &path);
+	static bool _IsModel(const std::string &extension);
+	static bool _IsImage(const std::string &extension);
+	static bool _IsShader(const std::string &extension);
+	// material libraries of the models
+	static bool _IsMaterial(const std::string &extension);
+	static bool _IsCooked(const std::string &extension);
+};
+
+unsigned int AssetCooker::Run(bool force)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	_LoadManifest();
+
+	std::vector<_Asset> assets;
+	_GatherAssets(assets);
+	_HashSources(assets);
+
+	// one asset per task, the mesh imports dominate and vary a lot in size
+	ThreadPool::Shared().ParallelFor(assets.size(), 1, [this, &assets, force](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			_Cook(assets[i], force);
+	});
+
+	_SaveManifest();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "AssetCooker: " << assets.size() << " assets, " << _cooked << " cooked, " << _restamped << " restamped, "
+		<< _skipped << " up to date, " << _failed << " failed in " << std::fixed << std::setprecision(2) << seconds << " s" << std::endl;
+	return _failed;
+}
+
+bool AssetCooker::Pack(const std::string &archivePath)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// authoring files & the archives the sources came in are left out
+	std::vector<std::string> files, packed;
+	_ListFiles(DIRECTORY_RESOURCE, files);
+	_ListFiles(DIRECTORY_COOKED, files);
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		std::string extension = _Extension(files[i]);
+		if (_IsModel(extension) || _IsImage(extension) || _IsShader(extension) || _IsMaterial(extension) || _IsCooked(extension))
+			packed.push_back(files[i]);
+	}
+
+	bool written = AssetArchive::Write(archivePath, packed);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "AssetCooker: " << (written ? "packed " : "failed to pack ") << packed.size() << " files into " << archivePath
+		<< " in " << std::fixed << std::setprecision(2) << seconds << " s" << std::endl;
+	return written;
+}
+
+void AssetCooker::_LoadManifest()
+{
+	std::ifstream file(FILE_COOKED_MANIFEST.c_str());
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream stream(line);
+		std::string kind;
+		uint64_t hash;
+		stream >> kind >> std::hex >> hash >> std::dec;
+		if (kind == "file")
+		{
+			_FileRecord record;
+			record.hash = hash;
+			std::string path;
+			stream >> record.size >> record.time;
+			stream.get();
+			std::getline(stream, path);
+			if (!path.empty())
+				_files[path] = record;
+		}
+		else if (kind == "asset")
+		{
+			std::string path;
+			stream.get();
+			std::getline(stream, path);
+			if (!path.empty())
+				_outputs[path] = hash;
+		}
+	}
+}
+
+void AssetCooker::_SaveManifest()
+{
+	CookedAsset::MakeDirectory();
+	std::ofstream file(FILE_COOKED_MANIFEST.c_str(), std::ios::trunc);
+	file << "# AssetCooker manifest: content hashes of the sources and of what each cooked file was built from" << std::endl;
+	file << std::setfill('0');
+	for (std::map<std::string, _FileRecord>::const_iterator it = _files.begin(); it != _files.end(); ++it)
+	{
+		file << "file " << std::hex << std::setw(16) << it->second.hash << std::dec
+			<< " " << it->second.size << " " << it->second.time << " " << it->first << "\n";
+	}
+	for (std::map<std::string, uint64_t>::const_iterator it = _outputs.begin(); it != _outputs.end(); ++it)
+	{
+		file << "asset " << std::hex << std::setw(16) << it->second << std::dec << " " << it->first << "\n";
+	}
+}
+
+void AssetCooker::_GatherAssets(std::vector<_Asset> &assets)
+{
+	std::vector<std::string> files;
+	_ListFiles(DIRECTORY_OBJECTS, files);
+	_ListFiles(DIRECTORY_TEXTURES, files);
+
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		std::string extension = _Extension(files[i]);
+		_Asset asset;
+		asset.hash = 0;
+		asset.sources.push_back(files[i]);
+		if (_IsModel(extension))
+		{
+			asset.kind = _ASSET_MESH;
+			asset.output = CookedMesh::GetPath(files[i]);
+			std::vector<std::string> libraries = CookedMesh::GetLibraries(files[i]);
+			asset.sources.insert(asset.sources.end(), libraries.begin(), libraries.end());
+		}
+		else if (_IsImage(extension))
+		{
+			asset.kind = _ASSET_TEXTURE;
+			asset.output = CookedTexture::GetPath(files[i]);
+		}
+		else
+		{
+			continue;
+		}
+		assets.push_back(asset);
+	}
+
+	std::vector<std::string> shader_files, shaders;
+	_ListFiles(DIRECTORY_SHADERS, shader_files);
+	for (size_t i = 0; i < shader_files.size(); i++)
+	{
+		if (_IsShader(_Extension(shader_files[i])))
+			shaders.push_back(shader_files[i]);
+	}
+	if (!shaders.empty())
+	{
+		_Asset bundle;
+		bundle.kind = _ASSET_SHADERS;
+		bundle.sources = shaders;
+		bundle.output = FILE_COOKED_SHADERS;
+		bundle.hash = 0;
+		assets.push_back(bundle);
+	}
+}
+
+void AssetCooker::_HashSources(std::vector<_Asset> &assets)
+{
+	// every source once, even when several assets share it
+	std::vector<std::string> paths;
+	for (size_t a = 0; a < assets.size(); a++)
+		paths.insert(paths.end(), assets[a].sources.begin(), assets[a].sources.end());
+	std::sort(paths.begin(), paths.end());
+	paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+	std::vector<_FileRecord> records(paths.size());
+	ThreadPool::Shared().ParallelFor(paths.size(), 4, [this, &paths, &records](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			_FileRecord &record = records[i];
+			if (!CookedAsset::GetSourceStamp(paths[i], record.size, record.time))
+			{
+				// a missing dependency still gives a hash, it changes once the file shows up
+				record.hash = 0;
+				continue;
+			}
+
+			std::map<std::string, _FileRecord>::const_iterator known = _files.find(paths[i]);
+			if (known != _files.end() && known->second.size == record.size && known->second.time == record.time)
+			{
+				record.hash = known->second.hash;
+				continue;
+			}
+			record.hash = CookedAsset::HASH_SEED;
+			CookedAsset::HashFile(paths[i], record.hash);
+		}
+	});
+
+	_files.clear();
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		if (records[i].hash != 0)
+			_files[paths[i]] = records[i];
+	}
+
+	for (size_t a = 0; a < assets.size(); a++)
+	{
+		_Asset &asset = assets[a];
+		asset.hash = _KindSeed(asset.kind);
+		for (size_t s = 0; s < asset.sources.size(); s++)
+		{
+			std::map<std::string, _FileRecord>::const_iterator record = _files.find(asset.sources[s]);
+			uint64_t file_hash = record != _files.end() ? record->second.hash : 0;
+			std::string path = CookedAsset::NormalizePath(asset.sources[s]);
+			asset.hash = CookedAsset::Hash(asset.hash, path.data(), path.size());
+			asset.hash = CookedAsset::Hash(asset.hash, &file_hash, sizeof(file_hash));
+		}
+	}
+}
+
+void AssetCooker::_Cook(_Asset &asset, bool force)
+{
+	bool cooked_before;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		std::map<std::string, uint64_t>::const_iterator output = _outputs.find(asset.output);
+		cooked_before = output != _outputs.end() && output->second == asset.hash;
+	}
+
+	std::ifstream existing(asset.output.c_str(), std::ios::binary);
+	CookedStamp stamp;
+	bool exists = (bool)existing.read((char*)&stamp, sizeof(stamp));
+	existing.close();
+
+	if (!force && cooked_before && exists)
+	{
+		// same content, but a touched source (or texture of a model) would make the game reject the file
+		bool current;
+		if (asset.kind == _ASSET_SHADERS)
+			current = ShaderBundle::IsCurrent(asset.output);
+		else if (asset.kind == _ASSET_MESH)
+			current = CookedMesh::Open(asset.output, asset.sources[0]) != nullptr;
+		else
+			current = CookedAsset::IsCurrent(stamp, asset.sources[0]);
+		if (current)
+		{
+			_skipped++;
+			return;
+		}
+		// the bundle stamps every stage, it is simply written again
+		bool restamped = asset.kind == _ASSET_MESH ? CookedMesh::Restamp(asset.output, asset.sources[0])
+			: asset.kind != _ASSET_SHADERS && CookedAsset::Restamp(asset.output, asset.sources[0]);
+		if (restamped)
+		{
+			_restamped++;
+			return;
+		}
+	}
+
+	bool built = _Build(asset);
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (built)
+	{
+		_outputs[asset.output] = asset.hash;
+		_cooked++;
+		std::cout << "AssetCooker: " << asset.sources[0] << (asset.sources.size() > 1 && asset.kind == _ASSET_SHADERS ? " ..." : "")
+			<< " -> " << asset.output << std::endl;
+	}
+	else
+	{
+		// retried on the next run
+		_outputs.erase(asset.output);
+		_failed++;
+		std::cout << "AssetCooker: failed to cook " << asset.sources[0] << std::endl;
+	}
+}
+
+bool AssetCooker::_Build(const _Asset &asset)
+{
+	switch (asset.kind)
+	{
+	case _ASSET_MESH:
+	{
+		ModelSource source;
+		if (!Model::Import(asset.sources[0], source))
+			return false;
+		return CookedMesh::Write(asset.output, asset.sources[0], source);
+	}
+	case _ASSET_TEXTURE:
+		return CookedTexture::Write(asset.output, asset.sources[0]);
+	case _ASSET_SHADERS:
+		return ShaderBundle::Write(asset.output, asset.sources);
+	}
+	return false;
+}
+
+uint64_t AssetCooker::_KindSeed(_AssetKind kind)
+{
+	uint32_t versions[4] = { ASSET_COOKER_VERSION, (uint32_t)kind, 0, 0 };
+	if (kind == _ASSET_MESH)
+	{
+		versions[2] = COOKED_MESH_VERSION;
+		versions[3] = (uint32_t)sizeof(PackedVertex);
+	}
+	else if (kind == _ASSET_TEXTURE)
+	{
+		versions[2] = COOKED_TEXTURE_VERSION;
+		versions[3] = BLOCK_COMPRESSOR_VERSION;
+	}
+	else
+	{
+		versions[2] = SHADER_BUNDLE_VERSION;
+	}
+	uint64_t hash = CookedAsset::Hash(CookedAsset::HASH_SEED, versions, sizeof(versions));
+	if (kind == _ASSET_MESH)
+		hash = CookedAsset::Hash(hash, LOD_INDEX_RATIOS, sizeof(LOD_INDEX_RATIOS));
+	else if (kind == _ASSET_TEXTURE)
+	{
+		uint32_t filter = (uint32_t)COOKED_TEXTURE_MIP_FILTER;
+		hash = CookedAsset::Hash(hash, &filter, sizeof(filter));
+		hash = CookedAsset::Hash(hash, &COOKED_TEXTURE_ALPHA_CUTOFF, sizeof(COOKED_TEXTURE_ALPHA_CUTOFF));
+	}
+	return hash;
+}
+
+void AssetCooker::_ListFiles(const std::string &directory, std::vector<std::string> &files)
+{
+	std::vector<std::string> names;
+	std::vector<std::string> directories;
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA((directory + "/*").c_str(), &data);
+	if (find == INVALID_HANDLE_VALUE)
+		return;
+	do
+	{
+		std::string name = data.cFileName;
+		if (name == "." || name == "..")
+			continue;
+		if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			directories.push_back(directory + "/" + name);
+		else
+			names.push_back(directory + "/" + name);
+	} while (FindNextFileA(find, &data));
+	FindClose(find);
+#else
+	DIR *dir = opendir(directory.c_str());
+	if (dir == NULL)
+		return;
+	while (dirent *entry = readdir(dir))
+	{
+		std::string name = entry->d_name;
+		if (name == "." || name == "..")
+			continue;
+		std::string path = directory + "/" + name;
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0)
+			continue;
+		if (S_ISDIR(info.st_mode))
+			directories.push_back(path);
+		else
+			names.push_back(path);
+	}
+	closedir(dir);
+#endif
+
+	// sorted, so the manifest & the order of the bundle do not depend on the file system
+	std::sort(names.begin(), names.end());
+	std::sort(directories.begin(), directories.end());
+	files.insert(files.end(), names.begin(), names.end());
+	for (size_t i = 0; i < directories.size(); i++)
+		_ListFiles(directories[i], files);
+}
+
+std::string AssetCooker::_Extension(const std::string &path)
+{
+	size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos || path.find('/', dot) != std::string::npos)
+		return "";
+	std::string extension = path.substr(dot);
+	for (size_t i = 0; i < extension.size(); i++)
+		extension[i] = (char)std::tolower((unsigned char)extension[i]);
+	return extension;
+}
+
+bool AssetCooker::_IsModel(const std::string &extension)
+{
+	return extension == ".obj" || extension == ".fbx" || extension == ".dae" || extension == ".3ds";
+}
+
+bool AssetCooker::_IsImage(const std::string &extension)
+{
+	return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp";
+}
+
+bool AssetCooker::_IsShader(const std::string &extension)
+{
+	return extension == ".vs" || extension == ".fs" || extension == ".gs";
+}
+
+bool AssetCooker::_IsMaterial(const std::string &extension)
+{
+	return extension == ".mtl";
+}
+
+bool AssetCooker::_IsCooked(const std::string &extension)
+{
+	return extension == ".mesh" || extension == ".tex" || extension == ".bundle";
+}
+
+#endif
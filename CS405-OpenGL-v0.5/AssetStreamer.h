@@ -0,0 +1,462 @@
+#ifndef ASSET_STREAMER_H
+#define ASSET_STREAMER_H
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <iostream>
+#include <cfloat>
+
+#include "GameObject.h"
+#include "ModelLoader.h"
+#include "TexturePacker.h"
+#include "CookedAsset.h"
+#include "values.h"
+
+// AssetStreamer keeps the full models of the objects resident only while they fit a memory budget.
+// Every object starts out with a proxy of its model (the coarsest level, untextured) that is always
+// there. The full models of the paths the objects use are loaded on demand, the most wanted first:
+// the nearest to the player, objects the camera saw in the last frame counting as much nearer.
+// A load reads the model on the workers (ModelLoader), uploads it and has the workers read its textures
+// (TexturePacker::Prepare), packs them and only then the objects switch from the proxy to it. When the budget is used up the least recently
+// visible models that are less wanted than the next load are evicted, their objects switch back.
+// A changed file is read again in the background, a resident model is swapped once the new one is packed.
+class AssetStreamer {
+public:
+	// A new proxy of the model the handle reads, for one object, the first one of a path registers it.
+	static Model *CreateProxy(const ModelHandle &handle);
+
+	// Streams the full model for the object, its model has to come from CreateProxy with the same handle.
+	static void Add(GameObject *object, const ModelHandle &handle);
+
+	// Once per frame on the GL thread, after culling: finishes loads, starts the most wanted ones and
+	// evicts what does not fit. focus is where the player is.
+	static void Update(const glm::vec3 &focus, const std::vector<GameObject*> &visibleObjects);
+
+	// Reads the model of a changed file again, or every model next to a changed material library (.mtl).
+	// Returns how many models use it.
+	static unsigned int Reload(const std::string &path);
+
+	static size_t GetResidentBytes() { return _residentBytes; }
+
+	static void PrintStats();
+
+	// Unloads every full model, the objects go back to their proxies.
+	static void Clear();
+
+private:
+	AssetStreamer() { }
+
+	enum _State {
+		_UNLOADED,
+		// read by the workers
+		_IMPORTING,
+		// uploaded, its textures are read on the workers
+		_PACKING,
+		_RESIDENT,
+		// the file could not be read (the proxy is empty) or its textures not packed
+		_FAILED
+	};
+
+	struct _Asset {
+		std::string path;
+		_State state;
+		// what the objects draw while the full model is not resident
+		Model *proxy;
+		Model *full;
+		ModelHandle import;
+		TexturePackHandle pack;
+		// the file changed: its new import, then the full model replacing the resident one and its textures
+		ModelHandle reload;
+		Model *replacement;
+		TexturePackHandle replacementPack;
+		std::vector<GameObject*> objects;
+		// of the full model, 0 until it was resident once
+		size_t bytes;
+		// distance of the most wanted object this frame, FLT_MAX when none is drawn
+		float priority;
+		unsigned long long lastVisible;
+	};
+
+	static std::vector<_Asset> _assets;
+	static std::map<std::string, size_t> _assetIndices;
+	static std::unordered_map<GameObject*, size_t> _objectAssets;
+	static unsigned long long _frame;
+	static size_t _residentBytes;
+
+	/*  Statistics  */
+	static size_t _loadCount;
+	static size_t _evictCount;
+
+	static void _UpdatePriorities(const glm::vec3 &focus, const std::vector<GameObject*> &visibleObjects);
+	static void _Progress(_Asset &asset);
+	static void _ProgressReload(_Asset &asset);
+	static void _StartLoads();
+	// evicts less wanted models until bytes more fit, false (and nothing evicted) when they can not
+	static bool _MakeRoom(size_t bytes, size_t wanted);
+	static void _Evict(_Asset &asset);
+	static void _SetMeshes(_Asset &asset, const Model &model);
+	// gives back the geometry & textures of a model and deletes it
+	static void _Free(Model *model);
+	static size_t _GeometryBytes(const Model &model);
+};
+
+// Instantiate static variables
+std::vector<AssetStreamer::_Asset> AssetStreamer::_assets;
+std::map<std::string, size_t> AssetStreamer::_assetIndices;
+std::unordered_map<GameObject*, size_t> AssetStreamer::_objectAssets;
+unsigned long long AssetStreamer::_frame = 0;
+size_t AssetStreamer::_residentBytes = 0;
+size_t AssetStreamer::_loadCount = 0;
+size_t AssetStreamer::_evictCount = 0;
+
+Model *AssetStreamer::CreateProxy(const ModelHandle &handle)
+{
+	const ModelImport &import = *handle.get();
+	std::string key = CookedAsset::NormalizePath(import.path);
+	std::map<std::string, size_t>::const_iterator known = _assetIndices.find(key);
+	if (known == _assetIndices.end())
+	{
+		_Asset asset;
+		asset.path = import.path;
+		asset.state = import.loaded ? _UNLOADED : _FAILED;
+		asset.proxy = new Model(import, true);
+		asset.full = nullptr;
+		asset.replacement = nullptr;
+		asset.bytes = 0;
+		asset.priority = FLT_MAX;
+		asset.lastVisible = 0;
+		// packed once, every copy shares the untextured material, there is nothing to read
+		TexturePacker::Pack(std::vector<Model*>(1, asset.proxy));
+
+		known = _assetIndices.insert(std::make_pair(key, _assets.size())).first;
+		_assets.push_back(asset);
+	}
+	return new Model(*_assets[known->second].proxy);
+}
+
+void AssetStreamer::Add(GameObject *object, const ModelHandle &handle)
+{
+	size_t index = _assetIndices.at(CookedAsset::NormalizePath(handle.get()->path));
+	_assets[index].objects.push_back(object);
+	_objectAssets[object] = index;
+	if (_assets[index].state == _RESIDENT)
+		object->model->meshes = _assets[index].full->meshes;
+}
+
+void AssetStreamer::Update(const glm::vec3 &focus, const std::vector<GameObject*> &visibleObjects)
+{
+	_frame++;
+	_UpdatePriorities(focus, visibleObjects);
+	for (size_t i = 0; i < _assets.size(); i++)
+		_Progress(_assets[i]);
+	_StartLoads();
+}
+
+unsigned int AssetStreamer::Reload(const std::string &path)
+{
+	std::string name = AssetArchive::GetName(path);
+	std::string extension = name.substr(std::min(name.find_last_of('.'), name.size()));
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	bool library = extension == ".mtl";
+	std::string directory = name.substr(0, name.find_last_of('/') + 1);
+
+	unsigned int reloaded = 0;
+	for (size_t i = 0; i < _assets.size(); i++)
+	{
+		_Asset &asset = _assets[i];
+		std::string asset_name = AssetArchive::GetName(asset.path);
+		if (library ? asset_name.compare(0, directory.size(), directory) != 0 || asset_name.find('/', directory.size()) != std::string::npos : asset_name != name)
+			continue;
+		// a load in flight may have read the old file, the new import is applied after it
+		ModelLoader::Forget(asset.path);
+		asset.reload = ModelLoader::Load(asset.path);
+		reloaded++;
+	}
+	return reloaded;
+}
+
+void AssetStreamer::PrintStats()
+{
+	size_t resident = 0, loading = 0;
+	for (size_t i = 0; i < _assets.size(); i++)
+	{
+		resident += _assets[i].state == _RESIDENT;
+		loading += _assets[i].state == _IMPORTING || _assets[i].state == _PACKING;
+	}
+	std::cout << "Asset Streamer: " << resident << " of " << _assets.size() << " models resident, " << loading << " loading, "
+		<< _residentBytes / 1024 << " of " << STREAMING_BUDGET / 1024 << " KB, " << _loadCount << " loads, " << _evictCount << " evictions" << std::endl;
+}
+
+void AssetStreamer::Clear()
+{
+	for (size_t i = 0; i < _assets.size(); i++)
+	{
+		// an import still reading is waited for, the FileSystem goes away after this
+		if (_assets[i].import.valid())
+			_assets[i].import.wait();
+		if (_assets[i].reload.valid())
+			_assets[i].reload.wait();
+		if (_assets[i].pack.valid())
+			_assets[i].pack.wait();
+		if (_assets[i].replacementPack.valid())
+			_assets[i].replacementPack.wait();
+		if (_assets[i].full != nullptr)
+			_Evict(_assets[i]);
+		delete _assets[i].proxy;
+	}
+	_assets.clear();
+	_assetIndices.clear();
+	_objectAssets.clear();
+	_residentBytes = 0;
+}
+
+void AssetStreamer::_UpdatePriorities(const glm::vec3 &focus, const std::vector<GameObject*> &visibleObjects)
+{
+	std::unordered_set<GameObject*> visible(visibleObjects.begin(), visibleObjects.end());
+	for (size_t i = 0; i < _assets.size(); i++)
+	{
+		_Asset &asset = _assets[i];
+		asset.priority = FLT_MAX;
+		for (size_t o = 0; o < asset.objects.size(); o++)
+		{
+			GameObject *object = asset.objects[o];
+			if (!object->ShouldRender())
+				continue;
+
+			float distance = glm::distance(focus, object->GetPosition());
+			if (visible.count(object) != 0)
+				asset.lastVisible = _frame;
+			else
+				distance *= STREAMING_HIDDEN_DISTANCE_SCALE;
+			asset.priority = std::min(asset.priority, distance);
+		}
+	}
+}
+
+void AssetStreamer::_Progress(_Asset &asset)
+{
+	_ProgressReload(asset);
+
+	if (asset.state == _IMPORTING && ModelLoader::IsReady(asset.import))
+	{
+		const ModelImport &import = *asset.import.get();
+		if (import.loaded)
+		{
+			asset.full = new Model(import);
+			asset.pack = TexturePacker::Prepare(std::vector<Model*>(1, asset.full));
+			asset.state = _PACKING;
+		}
+		else
+		{
+			asset.state = _FAILED;
+		}
+		// the import is only needed for the upload, a later load reads the file again
+		asset.import = ModelHandle();
+		ModelLoader::Forget(asset.path);
+	}
+
+	if (asset.state == _PACKING)
+	{
+		if (!TexturePacker::IsReady(asset.pack))
+			return;
+
+		bool packed = TexturePacker::Pack(std::vector<Model*>(1, asset.full), asset.pack);
+		asset.pack = TexturePackHandle();
+		if (!packed)
+		{
+			std::cout << "AssetStreamer: " << asset.path << " keeps its proxy" << std::endl;
+			_Free(asset.full);
+			asset.full = nullptr;
+			asset.state = _FAILED;
+			return;
+		}
+		asset.bytes = _GeometryBytes(*asset.full) + TexturePacker::GetTextureBytes(*asset.full);
+		_residentBytes += asset.bytes;
+		asset.state = _RESIDENT;
+		_SetMeshes(asset, *asset.full);
+		_loadCount++;
+
+		// a model larger than expected pushes out less wanted ones, if that is not enough it goes again
+		// and is loaded once enough of the others are gone
+		if (_residentBytes > STREAMING_BUDGET)
+		{
+			_residentBytes -= asset.bytes;
+			bool fits = _MakeRoom(asset.bytes, (size_t)(&asset - _assets.data()));
+			_residentBytes += asset.bytes;
+			if (!fits)
+				_Evict(asset);
+		}
+	}
+}
+
+// A reload is applied once the load or replacement in flight is packed, the workers reading for it are never
+// abandoned. The proxy is replaced right away, a resident model keeps being drawn until its replacement is packed.
+void AssetStreamer::_ProgressReload(_Asset &asset)
+{
+	if (asset.reload.valid() && ModelLoader::IsReady(asset.reload) && asset.state != _IMPORTING && asset.state != _PACKING
+		&& asset.replacement == nullptr)
+	{
+		const ModelImport &import = *asset.reload.get();
+		if (!import.loaded)
+		{
+			std::cout << "AssetStreamer: " << asset.path << " could not be read again, keeping the old model" << std::endl;
+		}
+		else
+		{
+			// the proxy has no textures, packing it reads nothing
+			Model *proxy = asset.proxy;
+			asset.proxy = new Model(import, true);
+			TexturePacker::Pack(std::vector<Model*>(1, asset.proxy));
+			if (asset.state != _RESIDENT)
+				_SetMeshes(asset, *asset.proxy);
+			_Free(proxy);
+
+			if (asset.state == _FAILED)
+			{
+				asset.state = _UNLOADED;
+			}
+			else if (asset.state == _RESIDENT)
+			{
+				asset.replacement = new Model(import);
+				asset.replacementPack = TexturePacker::Prepare(std::vector<Model*>(1, asset.replacement));
+			}
+		}
+		asset.reload = ModelHandle();
+		ModelLoader::Forget(asset.path);
+	}
+
+	if (asset.replacement != nullptr && TexturePacker::IsReady(asset.replacementPack))
+	{
+		bool packed = TexturePacker::Pack(std::vector<Model*>(1, asset.replacement), asset.replacementPack);
+		asset.replacementPack = TexturePackHandle();
+		if (!packed)
+		{
+			std::cout << "AssetStreamer: " << asset.path << " keeps the old model" << std::endl;
+			_Free(asset.replacement);
+			asset.replacement = nullptr;
+			return;
+		}
+
+		// the budget is not checked, the next loads make up for a model that grew
+		Model *full = asset.full;
+		asset.full = asset.replacement;
+		asset.replacement = nullptr;
+		_SetMeshes(asset, *asset.full);
+		_Free(full);
+
+		_residentBytes -= asset.bytes;
+		asset.bytes = _GeometryBytes(*asset.full) + TexturePacker::GetTextureBytes(*asset.full);
+		_residentBytes += asset.bytes;
+	}
+}
+
+void AssetStreamer::_StartLoads()
+{
+	std::vector<size_t> wanted;
+	unsigned int loading = 0;
+	for (size_t i = 0; i < _assets.size(); i++)
+	{
+		if (_assets[i].state == _IMPORTING || _assets[i].state == _PACKING)
+			loading++;
+		else if (_assets[i].state == _UNLOADED && _assets[i].priority != FLT_MAX)
+			wanted.push_back(i);
+	}
+	std::sort(wanted.begin(), wanted.end(), [](size_t lhs, size_t rhs) { return _assets[lhs].priority < _assets[rhs].priority; });
+
+	for (size_t i = 0; i < wanted.size() && loading < STREAMING_MAX_LOADS; i++)
+	{
+		_Asset &asset = _assets[wanted[i]];
+		// a model not loaded before is expected to fit, its size is only known once it is. One that does not fit
+		// leaves room for a smaller, less wanted one.
+		if (!_MakeRoom(asset.bytes, wanted[i]))
+			continue;
+		asset.import = ModelLoader::Load(asset.path);
+		asset.state = _IMPORTING;
+		loading++;
+	}
+}
+
+bool AssetStreamer::_MakeRoom(size_t bytes, size_t wanted)
+{
+	if (_residentBytes + bytes <= STREAMING_BUDGET)
+		return true;
+
+	// resident, not seen this frame, not waiting for a replacement and less wanted: the longest unseen go first
+	std::vector<size_t> candidates;
+	size_t evictable = 0;
+	for (size_t i = 0; i < _assets.size(); i++)
+	{
+		const _Asset &asset = _assets[i];
+		if (i != wanted && asset.state == _RESIDENT && asset.replacement == nullptr && asset.lastVisible != _frame
+			&& asset.priority > _assets[wanted].priority)
+		{
+			candidates.push_back(i);
+			evictable += asset.bytes;
+		}
+	}
+	if (_residentBytes - evictable + bytes > STREAMING_BUDGET)
+		return false;
+
+	std::sort(candidates.begin(), candidates.end(), [](size_t lhs, size_t rhs) {
+		if (_assets[lhs].lastVisible != _assets[rhs].lastVisible)
+			return _assets[lhs].lastVisible < _assets[rhs].lastVisible;
+		return _assets[lhs].priority > _assets[rhs].priority;
+	});
+	for (size_t i = 0; i < candidates.size() && _residentBytes + bytes > STREAMING_BUDGET; i++)
+		_Evict(_assets[candidates[i]]);
+	return true;
+}
+
+void AssetStreamer::_Evict(_Asset &asset)
+{
+	_SetMeshes(asset, *asset.proxy);
+
+	_Free(asset.full);
+	asset.full = nullptr;
+	if (asset.replacement != nullptr)
+		_Free(asset.replacement);
+	asset.replacement = nullptr;
+
+	if (asset.state == _RESIDENT)
+	{
+		_residentBytes -= asset.bytes;
+		_evictCount++;
+	}
+	asset.state = _UNLOADED;
+}
+
+void AssetStreamer::_SetMeshes(_Asset &asset, const Model &model)
+{
+	for (size_t i = 0; i < asset.objects.size(); i++)
+		asset.objects[i]->model->meshes = model.meshes;
+}
+
+void AssetStreamer::_Free(Model *model)
+{
+	// packed layers nothing else samples are deleted
+	TexturePacker::Release(*model);
+	for (size_t i = 0; i < model->meshes.size(); i++)
+		MeshPool::Free(model->meshes[i].allocation);
+	delete model;
+}
+
+// both streams of the mesh pool
+size_t AssetStreamer::_GeometryBytes(const Model &model)
+{
+	size_t bytes = 0;
+	for (size_t i = 0; i < model.meshes.size(); i++)
+	{
+		const GeometryAllocation &allocation = model.meshes[i].allocation;
+		bytes += allocation.vertexCount * (sizeof(PackedVertex) + sizeof(PackedPosition));
+		bytes += allocation.indexCount * IndexTypeSize(allocation.indexType);
+	}
+	return bytes;
+}
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef ASSIMP_FILE_SYSTEM_H
+#define ASSIMP_FILE_SYSTEM_H
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+
+#include <memory>
+#include <algorithm>
+#include <cstring>
+
+#include "FileSystem.h"
+#include "MappedFile.h"
+
+// AssimpFileStream reads a file of the FileSystem for assimp, from memory, writing is not supported.
+class AssimpFileStream : public Assimp::IOStream {
+public:
+	AssimpFileStream(const std::shared_ptr<MappedFile> &file) : _file(file), _position(0) { }
+
+	size_t Read(void *buffer, size_t size, size_t count) override;
+	size_t Write(const void *buffer, size_t size, size_t count) override { return 0; }
+	aiReturn Seek(size_t offset, aiOrigin origin) override;
+	size_t Tell() const override { return _position; }
+	size_t FileSize() const override { return _file->GetSize(); }
+	void Flush() override { }
+
+private:
+	std::shared_ptr<MappedFile> _file;
+	size_t _position;
+};
+
+// AssimpFileSystem lets an importer read a model, and the files it refers to (material libraries),
+// through the FileSystem. An importer owns the one it is given.
+class AssimpFileSystem : public Assimp::IOSystem {
+public:
+	bool Exists(const char *path) const override { return FileSystem::Exists(path); }
+	char getOsSeparator() const override { return '/'; }
+	Assimp::IOStream *Open(const char *path, const char *mode = "rb") override;
+	void Close(Assimp::IOStream *stream) override { delete stream; }
+};
+
+size_t AssimpFileStream::Read(void *buffer, size_t size, size_t count)
+{
+	if (size == 0)
+		return 0;
+	// whole elements only, like fread
+	count = std::min(count, (_file->GetSize() - _position) / size);
+	std::memcpy(buffer, _file->GetData() + _position, size * count);
+	_position += size * count;
+	return count;
+}
+
+aiReturn AssimpFileStream::Seek(size_t offset, aiOrigin origin)
+{
+	size_t base = origin == aiOrigin_SET ? 0 : origin == aiOrigin_CUR ? _position : _file->GetSize();
+	if (offset > _file->GetSize() - base)
+		return aiReturn_FAILURE;
+	_position = base + offset;
+	return aiReturn_SUCCESS;
+}
+
+Assimp::IOStream *AssimpFileSystem::Open(const char *path, const char *mode)
+{
+	if (std::strchr(mode, 'w') != nullptr || std::strchr(mode, 'a') != nullptr)
+		return nullptr;
+	std::shared_ptr<MappedFile> file = FileSystem::Open(path);
+	return file ? new AssimpFileStream(file) : nullptr;
+}
+
+#endif
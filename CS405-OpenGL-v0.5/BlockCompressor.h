@@ -0,0 +1,452 @@
+#ifndef BLOCK_COMPRESSOR_H
+#define BLOCK_COMPRESSOR_H
+
+#include "Include/glad/glad.h"
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cmath>
+
+#include "ThreadPool.h"
+
+// EXT_texture_compression_s3tc is not part of the core profile glad covers, RGTC (BC4 & BC5) is
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// raised whenever the encoder produces different blocks, so cooked textures are encoded again
+const uint32_t BLOCK_COMPRESSOR_VERSION = 1;
+
+// BlockCompressor encodes images on the CPU into the block formats GPUs sample directly, every 4x4 texels
+// become one block of 8 bytes (BC1, BC4) or 16 bytes (BC3, BC5), a fourth to an eighth of RGBA8.
+// Colors are fit along their principal axis and refined once by least squares, single channels
+// (alpha, red, the x & y of normal maps) use their range.
+// Images are read like the GL samples them: missing green & blue are 0, missing alpha is 255.
+// Decompress turns blocks back into texels, for the texture packer's gutters around already compressed images.
+class BlockCompressor {
+public:
+	// BC1 for opaque images, BC3 when any texel is translucent, BC4 for one channel and BC5 for two
+	// channels and normal maps (only x & y are kept, z follows from them)
+	static GLenum ChooseFormat(const unsigned char *pixels, int width, int height, int components, bool normalMap);
+
+	// Encodes an image of 1 to 4 components, block rows in parallel on the shared thread pool.
+	static std::vector<unsigned char> Compress(const unsigned char *pixels, int width, int height, int components, GLenum format);
+
+	// Decodes the blocks of an image back into RGBA, like the GL samples them.
+	static std::vector<unsigned char> Decompress(const unsigned char *blocks, int width, int height, GLenum format);
+
+	static bool IsBlockFormat(GLenum format);
+
+	// true for the formats that need EXT_texture_compression_s3tc, RGTC is core since 3.0
+	static bool NeedsS3TC(GLenum format) { return format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; }
+
+	// bytes of an image in the format, formats that are not block compressed count as RGBA8
+	static size_t GetSize(GLenum format, int width, int height);
+
+private:
+	BlockCompressor() { }
+
+	// block rows handed to one worker at a time
+	static const size_t _ROWS_PER_TASK = 8;
+
+	// 4x4 RGBA texels, edges of images that are no multiple of 4 are repeated
+	static void _FetchBlock(const unsigned char *pixels, int width, int height, int components, int blockX, int blockY, unsigned char block[64]);
+	// BC1 color part, always in the four color mode
+	static void _EncodeColor(const unsigned char block[64], unsigned char *out);
+	// BC4 block of one channel of the texels
+	static void _EncodeChannel(const unsigned char block[64], int channel, unsigned char *out);
+	// BC1 color part, the three color mode only where the format has no alpha of its own
+	static void _DecodeColor(const unsigned char *in, bool fourColors, unsigned char block[64]);
+	static void _DecodeChannel(const unsigned char *in, int channel, unsigned char block[64]);
+
+	static uint16_t _Pack565(const float color[3]);
+	static void _Unpack565(uint16_t packed, int color[3]);
+	// indices of the texels into the four colors of the endpoints, returns the squared error
+	static int _MatchColors(const unsigned char block[64], uint16_t color0, uint16_t color1, uint32_t &indices);
+};
+
+GLenum BlockCompressor::ChooseFormat(const unsigned char *pixels, int width, int height, int components, bool normalMap)
+{
+	if (components == 1)
+		return GL_COMPRESSED_RED_RGTC1;
+	if (components == 2 || normalMap)
+		return GL_COMPRESSED_RG_RGTC2;
+	if (components == 4)
+	{
+		size_t count = (size_t)width * height;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (pixels[i * 4 + 3] != 255)
+				return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		}
+	}
+	return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+}
+
+std::vector<unsigned char> BlockCompressor::Compress(const unsigned char *pixels, int width, int height, int components, GLenum format)
+{
+	int blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+	size_t block_size = GetSize(format, 4, 4);
+	std::vector<unsigned char> blocks((size_t)blocks_x * blocks_y * block_size);
+
+	ThreadPool::Shared().ParallelFor((size_t)blocks_y, _ROWS_PER_TASK, [&](size_t begin, size_t end) {
+		unsigned char block[64];
+		for (size_t y = begin; y < end; y++)
+		{
+			for (int x = 0; x < blocks_x; x++)
+			{
+				unsigned char *out = &blocks[((size_t)y * blocks_x + x) * block_size];
+				_FetchBlock(pixels, width, height, components, x, (int)y, block);
+				switch (format)
+				{
+				case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+					_EncodeColor(block, out);
+					break;
+				case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+					_EncodeChannel(block, 3, out);
+					_EncodeColor(block, out + 8);
+					break;
+				case GL_COMPRESSED_RED_RGTC1:
+					_EncodeChannel(block, 0, out);
+					break;
+				case GL_COMPRESSED_RG_RGTC2:
+					_EncodeChannel(block, 0, out);
+					_EncodeChannel(block, 1, out + 8);
+					break;
+				}
+			}
+		}
+	});
+	return blocks;
+}
+
+std::vector<unsigned char> BlockCompressor::Decompress(const unsigned char *blocks, int width, int height, GLenum format)
+{
+	int blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+	size_t block_size = GetSize(format, 4, 4);
+	std::vector<unsigned char> pixels((size_t)width * height * 4);
+
+	unsigned char block[64];
+	for (int y = 0; y < blocks_y; y++)
+	{
+		for (int x = 0; x < blocks_x; x++)
+		{
+			const unsigned char *in = &blocks[((size_t)y * blocks_x + x) * block_size];
+			for (int i = 0; i < 16; i++)
+			{
+				block[i * 4 + 1] = block[i * 4 + 2] = 0;
+				block[i * 4 + 3] = 255;
+			}
+			switch (format)
+			{
+			case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+				_DecodeColor(in, false, block);
+				break;
+			case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+				_DecodeChannel(in, 3, block);
+				_DecodeColor(in + 8, true, block);
+				break;
+			case GL_COMPRESSED_RED_RGTC1:
+				_DecodeChannel(in, 0, block);
+				break;
+			case GL_COMPRESSED_RG_RGTC2:
+				_DecodeChannel(in, 0, block);
+				_DecodeChannel(in + 8, 1, block);
+				break;
+			}
+
+			// the texels of a partial block past the edge are dropped
+			for (int row = 0; row < 4 && y * 4 + row < height; row++)
+			{
+				for (int column = 0; column < 4 && x * 4 + column < width; column++)
+					std::memcpy(&pixels[((size_t)(y * 4 + row) * width + x * 4 + column) * 4], &block[(row * 4 + column) * 4], 4);
+			}
+		}
+	}
+	return pixels;
+}
+
+bool BlockCompressor::IsBlockFormat(GLenum format)
+{
+	return format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ||
+		format == GL_COMPRESSED_RED_RGTC1 || format == GL_COMPRESSED_RG_RGTC2;
+}
+
+size_t BlockCompressor::GetSize(GLenum format, int width, int height)
+{
+	size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+	switch (format)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RED_RGTC1:
+		return blocks * 8;
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_RG_RGTC2:
+		return blocks * 16;
+	}
+	return (size_t)width * height * 4;
+}
+
+void BlockCompressor::_FetchBlock(const unsigned char *pixels, int width, int height, int components, int blockX, int blockY, unsigned char block[64])
+{
+	for (int y = 0; y < 4; y++)
+	{
+		int row = std::min(blockY * 4 + y, height - 1);
+		for (int x = 0; x < 4; x++)
+		{
+			int column = std::min(blockX * 4 + x, width - 1);
+			const unsigned char *source = &pixels[((size_t)row * width + column) * components];
+			unsigned char *texel = &block[(y * 4 + x) * 4];
+			texel[0] = source[0];
+			texel[1] = components > 1 ? source[1] : 0;
+			texel[2] = components > 2 ? source[2] : 0;
+			texel[3] = components > 3 ? source[3] : 255;
+		}
+	}
+}
+
+void BlockCompressor::_EncodeColor(const unsigned char block[64], unsigned char *out)
+{
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 3; c++)
+			mean[c] += block[i * 4 + c];
+	}
+	for (int c = 0; c < 3; c++)
+		mean[c] /= 16.0f;
+
+	// covariance of the colors, its largest eigenvector by power iteration is the axis they spread along
+	float covariance[6] = {};
+	for (int i = 0; i < 16; i++)
+	{
+		float r = block[i * 4] - mean[0], g = block[i * 4 + 1] - mean[1], b = block[i * 4 + 2] - mean[2];
+		covariance[0] += r * r; covariance[1] += r * g; covariance[2] += r * b;
+		covariance[3] += g * g; covariance[4] += g * b; covariance[5] += b * b;
+	}
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 4; iteration++)
+	{
+		float next[3] = {
+			covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+			covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+			covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]
+		};
+		float largest = std::max(std::fabs(next[0]), std::max(std::fabs(next[1]), std::fabs(next[2])));
+		if (largest < 1e-6f)
+			break;
+		for (int c = 0; c < 3; c++)
+			axis[c] = next[c] / largest;
+	}
+
+	// the extremes along the axis, pulled in a little since the ends are rarely hit exactly
+	float low = 1e30f, high = -1e30f;
+	for (int i = 0; i < 16; i++)
+	{
+		float t = (block[i * 4] - mean[0]) * axis[0] + (block[i * 4 + 1] - mean[1]) * axis[1] + (block[i * 4 + 2] - mean[2]) * axis[2];
+		low = std::min(low, t);
+		high = std::max(high, t);
+	}
+	float length = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+	float inset = (high - low) / 16.0f;
+	float end0[3], end1[3];
+	for (int c = 0; c < 3; c++)
+	{
+		end0[c] = mean[c] + axis[c] * (high - inset) / length;
+		end1[c] = mean[c] + axis[c] * (low + inset) / length;
+	}
+
+	uint16_t color0 = _Pack565(end0), color1 = _Pack565(end1);
+	uint32_t indices = 0;
+	int error = _MatchColors(block, color0, color1, indices);
+
+	// least squares endpoints for those indices, kept when they fit better
+	static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[3] = {}, bx[3] = {};
+	for (int i = 0; i < 16; i++)
+	{
+		float a = weights[(indices >> (i * 2)) & 3], b = 1.0f - a;
+		aa += a * a; ab += a * b; bb += b * b;
+		for (int c = 0; c < 3; c++)
+		{
+			ax[c] += a * block[i * 4 + c];
+			bx[c] += b * block[i * 4 + c];
+		}
+	}
+	float determinant = aa * bb - ab * ab;
+	if (std::fabs(determinant) > 1e-6f)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			end0[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+			end1[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+		}
+		uint16_t refined0 = _Pack565(end0), refined1 = _Pack565(end1);
+		uint32_t refined_indices = 0;
+		int refined_error = _MatchColors(block, refined0, refined1, refined_indices);
+		if (refined_error < error)
+		{
+			color0 = refined0;
+			color1 = refined1;
+			indices = refined_indices;
+		}
+	}
+
+	// color0 > color1 selects the four color mode, swapping the endpoints swaps index 0 & 1 and 2 & 3
+	if (color0 < color1)
+	{
+		std::swap(color0, color1);
+		indices ^= 0x55555555;
+	}
+	else if (color0 == color1)
+	{
+		indices = 0;
+	}
+
+	out[0] = (unsigned char)(color0 & 0xff);
+	out[1] = (unsigned char)(color0 >> 8);
+	out[2] = (unsigned char)(color1 & 0xff);
+	out[3] = (unsigned char)(color1 >> 8);
+	for (int i = 0; i < 4; i++)
+		out[4 + i] = (unsigned char)((indices >> (i * 8)) & 0xff);
+}
+
+void BlockCompressor::_EncodeChannel(const unsigned char block[64], int channel, unsigned char *out)
+{
+	int low = 255, high = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		low = std::min(low, (int)block[i * 4 + channel]);
+		high = std::max(high, (int)block[i * 4 + channel]);
+	}
+
+	// high > low selects eight values: the endpoints (index 0 & 1) and six steps between them (2 to 7)
+	int values[8] = { high, low };
+	for (int i = 1; i < 7; i++)
+		values[i + 1] = ((7 - i) * high + i * low + 3) / 7;
+
+	uint64_t indices = 0;
+	if (high != low)
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			int value = block[i * 4 + channel];
+			int best = 0;
+			for (int v = 1; v < 8; v++)
+			{
+				if (std::abs(values[v] - value) < std::abs(values[best] - value))
+					best = v;
+			}
+			indices |= (uint64_t)best << (i * 3);
+		}
+	}
+
+	out[0] = (unsigned char)high;
+	out[1] = (unsigned char)low;
+	for (int i = 0; i < 6; i++)
+		out[2 + i] = (unsigned char)((indices >> (i * 8)) & 0xff);
+}
+
+void BlockCompressor::_DecodeColor(const unsigned char *in, bool fourColors, unsigned char block[64])
+{
+	uint16_t color0 = (uint16_t)(in[0] | (in[1] << 8)), color1 = (uint16_t)(in[2] | (in[3] << 8));
+	int palette[4][3];
+	_Unpack565(color0, palette[0]);
+	_Unpack565(color1, palette[1]);
+	bool four = fourColors || color0 > color1;
+	for (int c = 0; c < 3; c++)
+	{
+		palette[2][c] = four ? (2 * palette[0][c] + palette[1][c]) / 3 : (palette[0][c] + palette[1][c]) / 2;
+		palette[3][c] = four ? (palette[0][c] + 2 * palette[1][c]) / 3 : 0;
+	}
+
+	uint32_t indices = (uint32_t)in[4] | ((uint32_t)in[5] << 8) | ((uint32_t)in[6] << 16) | ((uint32_t)in[7] << 24);
+	for (int i = 0; i < 16; i++)
+	{
+		const int *color = palette[(indices >> (i * 2)) & 3];
+		for (int c = 0; c < 3; c++)
+			block[i * 4 + c] = (unsigned char)color[c];
+	}
+}
+
+void BlockCompressor::_DecodeChannel(const unsigned char *in, int channel, unsigned char block[64])
+{
+	int high = in[0], low = in[1];
+	int values[8] = { high, low };
+	if (high > low)
+	{
+		for (int i = 1; i < 7; i++)
+			values[i + 1] = ((7 - i) * high + i * low) / 7;
+	}
+	else
+	{
+		// the endpoints and four values between them, then 0 & 255
+		for (int i = 1; i < 5; i++)
+			values[i + 1] = ((5 - i) * high + i * low) / 5;
+		values[6] = 0;
+		values[7] = 255;
+	}
+
+	uint64_t indices = 0;
+	for (int i = 0; i < 6; i++)
+		indices |= (uint64_t)in[2 + i] << (i * 8);
+	for (int i = 0; i < 16; i++)
+		block[i * 4 + channel] = (unsigned char)values[(indices >> (i * 3)) & 7];
+}
+
+uint16_t BlockCompressor::_Pack565(const float color[3])
+{
+	int r = (int)(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+	int g = (int)(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+	int b = (int)(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+void BlockCompressor::_Unpack565(uint16_t packed, int color[3])
+{
+	int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+int BlockCompressor::_MatchColors(const unsigned char block[64], uint16_t color0, uint16_t color1, uint32_t &indices)
+{
+	int palette[4][3];
+	_Unpack565(color0, palette[0]);
+	_Unpack565(color1, palette[1]);
+	for (int c = 0; c < 3; c++)
+	{
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+
+	int error = 0;
+	indices = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		int best = 0, best_distance = 1 << 30;
+		for (int p = 0; p < 4; p++)
+		{
+			int r = block[i * 4] - palette[p][0], g = block[i * 4 + 1] - palette[p][1], b = block[i * 4 + 2] - palette[p][2];
+			int distance = r * r + g * g + b * b;
+			if (distance < best_distance)
+			{
+				best = p;
+				best_distance = distance;
+			}
+		}
+		indices |= (uint32_t)best << (i * 2);
+		error += best_distance;
+	}
+	return error;
+}
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef COOKED_ASSET_H
+#define COOKED_ASSET_H
+
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include "StringTable.h"
+
+// First bytes of every cooked file, the stamp ties it to the source it was cooked from.
+struct CookedStamp {
+	uint32_t magic;
+	uint32_t version;
+	// size & modification time of the source
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	// the whole cooked file, a truncated copy never validates
+	uint64_t fileSize;
+};
+
+// CookedAsset holds what the cooked formats (CookedMesh, CookedTexture, ShaderBundle) share:
+// where a cooked file lives, how it is matched to its source and how it replaces an older one.
+class CookedAsset {
+public:
+	// the same source always maps to the same cooked file, however the path is spelled
+	static std::string NormalizePath(const std::string &path);
+	static std::string GetPath(const std::string &sourcePath, const std::string &extension);
+
+	// false (and zeros) when the source does not exist
+	static bool GetSourceStamp(const std::string &sourcePath, uint64_t &size, int64_t &time);
+	static void SetStamp(CookedStamp &stamp, uint32_t magic, uint32_t version, const std::string &sourcePath);
+
+	// A cooked file is current while its source is unchanged, without the source it is all there is.
+	static bool IsCurrent(const CookedStamp &stamp, const std::string &sourcePath);
+
+	// Writes the stamp of the source as it is now into a cooked file, for a source touched but not changed.
+	static bool Restamp(const std::string &cookedPath, const std::string &sourcePath);
+
+	static void MakeDirectory();
+	// Creates the cooked directory and returns the path to write a new file to before Replace.
+	static std::string BeginWrite(const std::string &cookedPath);
+	// Moves the finished file over the old one, a mapping of the old file never sees a partial one.
+	static bool Replace(const std::string &temporaryPath, const std::string &cookedPath, bool written);
+
+	static size_t Align(size_t offset) { return (offset + 7) & ~(size_t)7; }
+
+	// FNV-1a over the bytes of a file, continuing from hash; false when it can not be read
+	static bool HashFile(const std::string &path, uint64_t &hash);
+	static uint64_t Hash(uint64_t hash, const void *data, size_t size);
+	static const uint64_t HASH_SEED = 14695981039346656037ULL;
+
+private:
+	CookedAsset() { }
+};
+
+std::string CookedAsset::NormalizePath(const std::string &path)
+{
+	std::string result = path;
+	for (size_t i = 0; i < result.size(); i++)
+	{
+		if (result[i] == '\\')
+			result[i] = '/';
+	}
+	while (result.compare(0, 2, "./") == 0)
+		result.erase(0, 2);
+	return result;
+}
+
+std::string CookedAsset::GetPath(const std::string &sourcePath, const std::string &extension)
+{
+	// one flat directory, the source path becomes the file name
+	std::string name = NormalizePath(sourcePath);
+	for (size_t i = 0; i < name.size(); i++)
+	{
+		if (name[i] == '/' || name[i] == ':')
+			name[i] = '_';
+	}
+	return DIRECTORY_COOKED + "/" + name + extension;
+}
+
+bool CookedAsset::GetSourceStamp(const std::string &sourcePath, uint64_t &size, int64_t &time)
+{
+	struct stat info;
+	if (stat(sourcePath.c_str(), &info) != 0)
+	{
+		size = 0;
+		time = 0;
+		return false;
+	}
+	size = (uint64_t)info.st_size;
+	time = (int64_t)info.st_mtime;
+	return true;
+}
+
+void CookedAsset::SetStamp(CookedStamp &stamp, uint32_t magic, uint32_t version, const std::string &sourcePath)
+{
+	stamp.magic = magic;
+	stamp.version = version;
+	GetSourceStamp(sourcePath, stamp.sourceSize, stamp.sourceTime);
+	stamp.fileSize = 0;
+}
+
+bool CookedAsset::IsCurrent(const CookedStamp &stamp, const std::string &sourcePath)
+{
+	uint64_t size;
+	int64_t time;
+	if (!GetSourceStamp(sourcePath, size, time))
+		return true;
+	return size == stamp.sourceSize && time == stamp.sourceTime;
+}
+
+bool CookedAsset::Restamp(const std::string &cookedPath, const std::string &sourcePath)
+{
+	std::fstream file(cookedPath.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+	CookedStamp stamp;
+	if (!file.read((char*)&stamp, sizeof(stamp)))
+		return false;
+	GetSourceStamp(sourcePath, stamp.sourceSize, stamp.sourceTime);
+	file.seekp(0);
+	file.write((const char*)&stamp, sizeof(stamp));
+	return (bool)file;
+}
+
+void CookedAsset::MakeDirectory()
+{
+#ifdef _WIN32
+	_mkdir(DIRECTORY_COOKED.c_str());
+#else
+	mkdir(DIRECTORY_COOKED.c_str(), 0755);
+#endif
+}
+
+std::string CookedAsset::BeginWrite(const std::string &cookedPath)
+{
+	MakeDirectory();
+	return cookedPath + ".tmp";
+}
+
+bool CookedAsset::Replace(const std::string &temporaryPath, const std::string &cookedPath, bool written)
+{
+	if (!written)
+	{
+		std::remove(temporaryPath.c_str());
+		return false;
+	}
+	std::remove(cookedPath.c_str());
+	return std::rename(temporaryPath.c_str(), cookedPath.c_str()) == 0;
+}
+
+bool CookedAsset::HashFile(const std::string &path, uint64_t &hash)
+{
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file)
+		return false;
+	char buffer[64 * 1024];
+	while (file)
+	{
+		file.read(buffer, sizeof(buffer));
+		hash = Hash(hash, buffer, (size_t)file.gcount());
+	}
+	return true;
+}
+
+uint64_t CookedAsset::Hash(uint64_t hash, const void *data, size_t size)
+{
+	const unsigned char *bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+#endif
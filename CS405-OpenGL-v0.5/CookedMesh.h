@@ -0,0 +1,437 @@
+#ifndef COOKED_MESH_H
+#define COOKED_MESH_H
+
+#include "Include/glad/glad.h"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <cctype>
+
+#include "CookedAsset.h"
+#include "MappedFile.h"
+#include "FileSystem.h"
+#include "mesh.h"
+#include "values.h"
+#include "StringTable.h"
+
+// A cooked model file holds the packed vertices and final indices (every level of detail, already
+// optimized) of all meshes of a model, so loading it is a mapping and one upload per mesh.
+// Layout, native byte order, every part 8 byte aligned:
+//   CookedMeshHeader | CookedMeshEntry per mesh | CookedTextureReference per texture | CookedMeshDependency per dependency
+//   | strings | vertex & index blobs
+// A file is only used while its version, vertex size and the stamps of its source and dependencies (material
+// libraries & textures) match, anything else re-imports.
+// The AssetCooker writes these ahead of time, a model without one is imported and cooked on first load.
+
+const uint32_t COOKED_MESH_MAGIC = 0x48534d43; // "CMSH"
+const uint32_t COOKED_MESH_VERSION = 3;
+
+struct CookedMeshHeader {
+	CookedStamp stamp;
+	uint32_t vertexSize;
+	uint32_t maxLods;
+	uint32_t meshCount;
+	uint32_t textureCount;
+	uint64_t stringOffset;
+	uint64_t stringSize;
+	// ModelSource::initialMin & initialMax
+	float initialMin[3];
+	float initialMax[3];
+	uint32_t dependencyCount;
+};
+
+struct CookedMeshEntry {
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t indexType;
+	uint32_t lodCount;
+	uint32_t lodOffsets[MAX_MESH_LODS];
+	uint32_t lodCounts[MAX_MESH_LODS];
+	float lodErrors[MAX_MESH_LODS];
+	float boundsMin[3];
+	float boundsMax[3];
+	uint32_t firstTexture;
+	uint32_t textureCount;
+};
+
+// type & path of a texture, as ranges of the string block
+struct CookedTextureReference {
+	uint32_t typeOffset;
+	uint32_t typeLength;
+	uint32_t pathOffset;
+	uint32_t pathLength;
+};
+
+// a file the model was cooked from besides its source, its path is a range of the string block
+struct CookedMeshDependency {
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	uint32_t pathOffset;
+	uint32_t pathLength;
+};
+
+// CookedMesh writes and opens cooked model files, Model turns an opened file into meshes.
+class CookedMesh {
+public:
+	// where the cooked file of a source model is kept
+	static std::string GetPath(const std::string &sourcePath);
+
+	// Packs the source like Mesh does and writes it, false when the file can not be written.
+	static bool Write(const std::string &cookedPath, const std::string &sourcePath, const ModelSource &source);
+
+	// Maps the cooked file, null when it is missing, damaged or older than its source or a dependency.
+	static std::shared_ptr<MappedFile> Open(const std::string &cookedPath, const std::string &sourcePath);
+
+	// the material libraries a model source names, read from the file without importing it
+	static std::vector<std::string> GetLibraries(const std::string &sourcePath);
+
+	// Writes the stamps of the source & dependencies as they are now, for files touched but not changed.
+	static bool Restamp(const std::string &cookedPath, const std::string &sourcePath);
+
+	/*  Views into an opened file  */
+	static const CookedMeshHeader &GetHeader(const MappedFile &file) { return *(const CookedMeshHeader*)file.GetData(); }
+	static const CookedMeshEntry &GetEntry(const MappedFile &file, size_t mesh);
+	static const CookedTextureReference &GetTexture(const MappedFile &file, size_t texture);
+	static const CookedMeshDependency &GetDependency(const MappedFile &file, size_t dependency);
+	static std::string GetString(const MappedFile &file, uint32_t offset, uint32_t length);
+
+private:
+	CookedMesh() { }
+
+	static bool _Validate(const MappedFile &file);
+	static bool _IsCurrent(const MappedFile &file, const std::string &sourcePath);
+	static size_t _DependencyOffset(const CookedMeshHeader &header);
+	template <typename T>
+	static bool _IndicesBelow(const unsigned char *data, uint32_t count, uint32_t vertexCount);
+};
+
+std::string CookedMesh::GetPath(const std::string &sourcePath)
+{
+	return CookedAsset::GetPath(sourcePath, ".mesh");
+}
+
+bool CookedMesh::Write(const std::string &cookedPath, const std::string &sourcePath, const ModelSource &source)
+{
+	CookedMeshHeader header;
+	std::memset(&header, 0, sizeof(header));
+	CookedAsset::SetStamp(header.stamp, COOKED_MESH_MAGIC, COOKED_MESH_VERSION, sourcePath);
+	header.vertexSize = sizeof(PackedVertex);
+	header.maxLods = MAX_MESH_LODS;
+	header.meshCount = (uint32_t)source.meshes.size();
+	for (int i = 0; i < 3; i++)
+	{
+		header.initialMin[i] = source.initialMin[i];
+		header.initialMax[i] = source.initialMax[i];
+	}
+
+	std::vector<CookedMeshEntry> entries(source.meshes.size());
+	std::vector<CookedTextureReference> textures;
+	std::string strings;
+	for (size_t m = 0; m < source.meshes.size(); m++)
+	{
+		const MeshSource &mesh = source.meshes[m];
+		CookedMeshEntry &entry = entries[m];
+		std::memset(&entry, 0, sizeof(entry));
+		entry.firstTexture = (uint32_t)textures.size();
+		entry.textureCount = (uint32_t)mesh.textures.size();
+		for (size_t t = 0; t < mesh.textures.size(); t++)
+		{
+			CookedTextureReference reference;
+			reference.typeOffset = (uint32_t)strings.size();
+			reference.typeLength = (uint32_t)mesh.textures[t].type.size();
+			strings += mesh.textures[t].type;
+			reference.pathOffset = (uint32_t)strings.size();
+			reference.pathLength = (uint32_t)mesh.textures[t].path.size();
+			strings += mesh.textures[t].path;
+			textures.push_back(reference);
+		}
+	}
+	header.textureCount = (uint32_t)textures.size();
+
+	// the material libraries, then every texture once
+	std::vector<std::string> dependency_paths = GetLibraries(sourcePath);
+	for (size_t t = 0; t < textures.size(); t++)
+	{
+		std::string path = strings.substr(textures[t].pathOffset, textures[t].pathLength);
+		if (std::find(dependency_paths.begin(), dependency_paths.end(), path) == dependency_paths.end())
+			dependency_paths.push_back(path);
+	}
+	std::vector<CookedMeshDependency> dependencies(dependency_paths.size());
+	for (size_t d = 0; d < dependency_paths.size(); d++)
+	{
+		CookedAsset::GetSourceStamp(dependency_paths[d], dependencies[d].sourceSize, dependencies[d].sourceTime);
+		dependencies[d].pathOffset = (uint32_t)strings.size();
+		dependencies[d].pathLength = (uint32_t)dependency_paths[d].size();
+		strings += dependency_paths[d];
+	}
+	header.dependencyCount = (uint32_t)dependencies.size();
+
+	size_t offset = CookedAsset::Align(_DependencyOffset(header) + dependencies.size() * sizeof(CookedMeshDependency));
+	header.stringOffset = offset;
+	header.stringSize = strings.size();
+	offset = CookedAsset::Align(offset + strings.size());
+
+	// pack every mesh, the blobs follow in mesh order
+	std::vector<std::vector<PackedVertex> > packed(source.meshes.size());
+	std::vector<std::vector<GLushort> > short_indices(source.meshes.size());
+	for (size_t m = 0; m < source.meshes.size(); m++)
+	{
+		const MeshSource &mesh = source.meshes[m];
+		CookedMeshEntry &entry = entries[m];
+
+		glm::vec3 bounds_min, bounds_max;
+		Mesh::CalculateBounds(mesh.vertices, bounds_min, bounds_max);
+		packed[m] = Mesh::PackVertices(mesh.vertices, bounds_min, bounds_max);
+		for (int i = 0; i < 3; i++)
+		{
+			entry.boundsMin[i] = bounds_min[i];
+			entry.boundsMax[i] = bounds_max[i];
+		}
+
+		entry.indexType = Mesh::IndexTypeFor(mesh.vertices.size());
+		if (entry.indexType == GL_UNSIGNED_SHORT)
+			short_indices[m].assign(mesh.indices.begin(), mesh.indices.end());
+
+		entry.lodCount = (uint32_t)std::min(mesh.lods.size(), (size_t)MAX_MESH_LODS);
+		for (uint32_t l = 0; l < entry.lodCount; l++)
+		{
+			entry.lodOffsets[l] = mesh.lods[l].indexOffset;
+			entry.lodCounts[l] = mesh.lods[l].indexCount;
+			entry.lodErrors[l] = mesh.lods[l].error;
+		}
+
+		entry.vertexCount = (uint32_t)mesh.vertices.size();
+		entry.vertexOffset = offset;
+		offset = CookedAsset::Align(offset + packed[m].size() * sizeof(PackedVertex));
+		entry.indexCount = (uint32_t)mesh.indices.size();
+		entry.indexOffset = offset;
+		offset = CookedAsset::Align(offset + mesh.indices.size() * IndexTypeSize(entry.indexType));
+	}
+	header.stamp.fileSize = offset;
+
+	std::string temporary_path = CookedAsset::BeginWrite(cookedPath);
+	std::ofstream file(temporary_path.c_str(), std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "CookedMesh: cannot write " << cookedPath << std::endl;
+		return false;
+	}
+
+	const char padding[8] = {};
+	size_t written = 0;
+	auto write = [&file, &written, &padding](const void *data, size_t size, size_t at) {
+		file.write(padding, at - written);
+		file.write((const char*)data, size);
+		written = at + size;
+	};
+	write(&header, sizeof(header), 0);
+	if (!entries.empty())
+		write(entries.data(), entries.size() * sizeof(CookedMeshEntry), written);
+	if (!textures.empty())
+		write(textures.data(), textures.size() * sizeof(CookedTextureReference), written);
+	if (!dependencies.empty())
+		write(dependencies.data(), dependencies.size() * sizeof(CookedMeshDependency), written);
+	write(strings.data(), strings.size(), (size_t)header.stringOffset);
+	for (size_t m = 0; m < source.meshes.size(); m++)
+	{
+		write(packed[m].data(), packed[m].size() * sizeof(PackedVertex), (size_t)entries[m].vertexOffset);
+		if (entries[m].indexType == GL_UNSIGNED_SHORT)
+			write(short_indices[m].data(), short_indices[m].size() * sizeof(GLushort), (size_t)entries[m].indexOffset);
+		else
+			write(source.meshes[m].indices.data(), source.meshes[m].indices.size() * sizeof(GLuint), (size_t)entries[m].indexOffset);
+	}
+	file.write(padding, (size_t)header.stamp.fileSize - written);
+	file.close();
+	return CookedAsset::Replace(temporary_path, cookedPath, (bool)file);
+}
+
+std::shared_ptr<MappedFile> CookedMesh::Open(const std::string &cookedPath, const std::string &sourcePath)
+{
+	std::shared_ptr<MappedFile> file = FileSystem::Open(cookedPath);
+	if (!file || !_Validate(*file) || !_IsCurrent(*file, sourcePath))
+		return nullptr;
+	return file;
+}
+
+std::vector<std::string> CookedMesh::GetLibraries(const std::string &sourcePath)
+{
+	std::vector<std::string> libraries;
+	std::string extension = sourcePath.substr(std::min(sourcePath.find_last_of('.'), sourcePath.size()));
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	if (extension != ".obj")
+		return libraries;
+	std::string directory = sourcePath.substr(0, sourcePath.find_last_of('/'));
+
+	// the libraries come before the first vertex
+	std::ifstream file(sourcePath.c_str());
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.compare(0, 2, "v ") == 0)
+			break;
+		if (line.compare(0, 7, "mtllib ") != 0)
+			continue;
+		std::string name = line.substr(7);
+		while (!name.empty() && std::isspace((unsigned char)name[name.size() - 1]))
+			name.erase(name.size() - 1);
+		if (!name.empty())
+			libraries.push_back(directory + "/" + name);
+	}
+	return libraries;
+}
+
+bool CookedMesh::Restamp(const std::string &cookedPath, const std::string &sourcePath)
+{
+	std::fstream file(cookedPath.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+	CookedMeshHeader header;
+	if (!file.read((char*)&header, sizeof(header)) || header.stamp.magic != COOKED_MESH_MAGIC || header.stamp.version != COOKED_MESH_VERSION)
+		return false;
+	std::vector<CookedMeshDependency> dependencies(header.dependencyCount);
+	std::string strings((size_t)header.stringSize, '\0');
+	file.seekg(_DependencyOffset(header));
+	if (!dependencies.empty())
+		file.read((char*)dependencies.data(), dependencies.size() * sizeof(CookedMeshDependency));
+	file.seekg((std::streamoff)header.stringOffset);
+	if (!strings.empty())
+		file.read(&strings[0], strings.size());
+	if (!file)
+		return false;
+
+	CookedAsset::GetSourceStamp(sourcePath, header.stamp.sourceSize, header.stamp.sourceTime);
+	for (size_t d = 0; d < dependencies.size(); d++)
+	{
+		if ((uint64_t)dependencies[d].pathOffset + dependencies[d].pathLength > strings.size())
+			return false;
+		CookedAsset::GetSourceStamp(strings.substr(dependencies[d].pathOffset, dependencies[d].pathLength),
+			dependencies[d].sourceSize, dependencies[d].sourceTime);
+	}
+	file.seekp(0);
+	file.write((const char*)&header, sizeof(header));
+	file.seekp(_DependencyOffset(header));
+	if (!dependencies.empty())
+		file.write((const char*)dependencies.data(), dependencies.size() * sizeof(CookedMeshDependency));
+	return (bool)file;
+}
+
+const CookedMeshEntry &CookedMesh::GetEntry(const MappedFile &file, size_t mesh)
+{
+	const CookedMeshEntry *entries = (const CookedMeshEntry*)(file.GetData() + sizeof(CookedMeshHeader));
+	return entries[mesh];
+}
+
+const CookedTextureReference &CookedMesh::GetTexture(const MappedFile &file, size_t texture)
+{
+	const CookedTextureReference *textures = (const CookedTextureReference*)(file.GetData() + sizeof(CookedMeshHeader)
+		+ GetHeader(file).meshCount * sizeof(CookedMeshEntry));
+	return textures[texture];
+}
+
+const CookedMeshDependency &CookedMesh::GetDependency(const MappedFile &file, size_t dependency)
+{
+	const CookedMeshDependency *dependencies = (const CookedMeshDependency*)(file.GetData() + _DependencyOffset(GetHeader(file)));
+	return dependencies[dependency];
+}
+
+std::string CookedMesh::GetString(const MappedFile &file, uint32_t offset, uint32_t length)
+{
+	return std::string((const char*)file.GetData() + GetHeader(file).stringOffset + offset, length);
+}
+
+// every offset & count is checked once, the views above trust the file afterwards
+bool CookedMesh::_Validate(const MappedFile &file)
+{
+	if (file.GetSize() < sizeof(CookedMeshHeader))
+		return false;
+	const CookedMeshHeader &header = GetHeader(file);
+	if (header.stamp.magic != COOKED_MESH_MAGIC || header.stamp.version != COOKED_MESH_VERSION || header.vertexSize != sizeof(PackedVertex) ||
+		header.maxLods != MAX_MESH_LODS || header.stamp.fileSize != file.GetSize())
+		return false;
+
+	uint64_t tables = sizeof(CookedMeshHeader) + (uint64_t)header.meshCount * sizeof(CookedMeshEntry)
+		+ (uint64_t)header.textureCount * sizeof(CookedTextureReference) + (uint64_t)header.dependencyCount * sizeof(CookedMeshDependency);
+	if (tables > header.stringOffset || header.stringOffset + header.stringSize > header.stamp.fileSize)
+		return false;
+
+	for (uint32_t m = 0; m < header.meshCount; m++)
+	{
+		const CookedMeshEntry &entry = GetEntry(file, m);
+		uint64_t index_size = entry.indexType == GL_UNSIGNED_SHORT ? 2 : (entry.indexType == GL_UNSIGNED_INT ? 4 : 0);
+		if (index_size == 0 || entry.lodCount == 0 || entry.lodCount > MAX_MESH_LODS ||
+			entry.vertexOffset + (uint64_t)entry.vertexCount * sizeof(PackedVertex) > header.stamp.fileSize ||
+			entry.indexOffset + (uint64_t)entry.indexCount * index_size > header.stamp.fileSize ||
+			(uint64_t)entry.firstTexture + entry.textureCount > header.textureCount)
+			return false;
+		for (uint32_t l = 0; l < entry.lodCount; l++)
+		{
+			if ((uint64_t)entry.lodOffsets[l] + entry.lodCounts[l] > entry.indexCount)
+				return false;
+		}
+		// an index past the vertices would have the GPU and the CPU side readers read outside the blob
+		const unsigned char *indices = file.GetData() + entry.indexOffset;
+		if (entry.indexType == GL_UNSIGNED_SHORT ? !_IndicesBelow<GLushort>(indices, entry.indexCount, entry.vertexCount)
+			: !_IndicesBelow<GLuint>(indices, entry.indexCount, entry.vertexCount))
+			return false;
+	}
+	for (uint32_t t = 0; t < header.textureCount; t++)
+	{
+		const CookedTextureReference &reference = GetTexture(file, t);
+		if ((uint64_t)reference.typeOffset + reference.typeLength > header.stringSize ||
+			(uint64_t)reference.pathOffset + reference.pathLength > header.stringSize)
+			return false;
+	}
+	for (uint32_t d = 0; d < header.dependencyCount; d++)
+	{
+		const CookedMeshDependency &dependency = GetDependency(file, d);
+		if ((uint64_t)dependency.pathOffset + dependency.pathLength > header.stringSize)
+			return false;
+	}
+	return true;
+}
+
+// the source and every dependency unchanged, a file missing beside the cooked one (an archive) counts as unchanged
+bool CookedMesh::_IsCurrent(const MappedFile &file, const std::string &sourcePath)
+{
+	const CookedMeshHeader &header = GetHeader(file);
+	if (!CookedAsset::IsCurrent(header.stamp, sourcePath))
+		return false;
+	for (uint32_t d = 0; d < header.dependencyCount; d++)
+	{
+		const CookedMeshDependency &dependency = GetDependency(file, d);
+		uint64_t size;
+		int64_t time;
+		if (CookedAsset::GetSourceStamp(GetString(file, dependency.pathOffset, dependency.pathLength), size, time) &&
+			(size != dependency.sourceSize || time != dependency.sourceTime))
+			return false;
+	}
+	return true;
+}
+
+size_t CookedMesh::_DependencyOffset(const CookedMeshHeader &header)
+{
+	return sizeof(CookedMeshHeader) + header.meshCount * sizeof(CookedMeshEntry) + header.textureCount * sizeof(CookedTextureReference);
+}
+
+template <typename T>
+bool CookedMesh::_IndicesBelow(const unsigned char *data, uint32_t count, uint32_t vertexCount)
+{
+	// the blobs are aligned for their index type
+	const T *indices = (const T*)data;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (indices[i] >= vertexCount)
+			return false;
+	}
+	return true;
+}
+
+#endif
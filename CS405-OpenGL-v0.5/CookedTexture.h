@@ -0,0 +1,175 @@
+#ifndef COOKED_TEXTURE_H
+#define COOKED_TEXTURE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <cctype>
+
+#include "stb_image.h"
+
+#include "CookedAsset.h"
+#include "MappedFile.h"
+#include "FileSystem.h"
+#include "BlockCompressor.h"
+#include "MipGenerator.h"
+
+// A cooked texture holds an image with its whole mip chain, so loading it is a mapping and one upload
+// per level instead of a decode and glGenerateMipmap. The levels are built by MipGenerator: color is
+// filtered in linear space and alpha tested images keep their coverage. They are block compressed (BlockCompressor),
+// a format of 0 means tightly packed pixels (upload with GL_UNPACK_ALIGNMENT 1).
+// Layout, native byte order: CookedTextureHeader | level 0 | level 1 | ... every level 8 byte aligned.
+
+const uint32_t COOKED_TEXTURE_MAGIC = 0x58455443; // "CTEX"
+const uint32_t COOKED_TEXTURE_VERSION = 2;
+
+// enough levels for a 32768 texel edge
+const unsigned int COOKED_TEXTURE_MAX_LEVELS = 16;
+
+const MipFilter COOKED_TEXTURE_MIP_FILTER = MIP_FILTER_KAISER;
+// alpha at which the images with an alpha channel are taken to be cut out
+const float COOKED_TEXTURE_ALPHA_CUTOFF = 0.5f;
+
+struct CookedTextureLevel {
+	uint64_t offset;
+	uint64_t size;
+	uint32_t width;
+	uint32_t height;
+};
+
+struct CookedTextureHeader {
+	CookedStamp stamp;
+	uint32_t components;
+	// GL internal format of the blocks, 0 for pixels
+	uint32_t format;
+	uint32_t levelCount;
+	CookedTextureLevel levels[COOKED_TEXTURE_MAX_LEVELS];
+};
+
+// CookedTexture writes and opens cooked textures, TextureLoader uploads them.
+class CookedTexture {
+public:
+	static std::string GetPath(const std::string &sourcePath) { return CookedAsset::GetPath(sourcePath, ".tex"); }
+
+	// Decodes the source, builds the mip chain, compresses it and writes it, false when the source can not be decoded.
+	static bool Write(const std::string &cookedPath, const std::string &sourcePath);
+
+	// Maps the cooked file, null when it is missing, damaged or older than its source.
+	static std::shared_ptr<MappedFile> Open(const std::string &cookedPath, const std::string &sourcePath);
+
+	static const CookedTextureHeader &GetHeader(const MappedFile &file) { return *(const CookedTextureHeader*)file.GetData(); }
+
+private:
+	CookedTexture() { }
+
+	static bool _Validate(const MappedFile &file);
+	// by name, normal maps keep only x & y (BC5)
+	static bool _IsNormalMap(const std::string &path);
+};
+
+bool CookedTexture::Write(const std::string &cookedPath, const std::string &sourcePath)
+{
+	int width, height, components;
+	unsigned char *pixels = stbi_load(sourcePath.c_str(), &width, &height, &components, 0);
+	if (pixels == NULL)
+	{
+		std::cout << "CookedTexture: cannot decode " << sourcePath << std::endl;
+		return false;
+	}
+
+	CookedTextureHeader header;
+	std::memset(&header, 0, sizeof(header));
+	CookedAsset::SetStamp(header.stamp, COOKED_TEXTURE_MAGIC, COOKED_TEXTURE_VERSION, sourcePath);
+	header.components = (uint32_t)components;
+	bool normal_map = _IsNormalMap(sourcePath);
+	header.format = BlockCompressor::ChooseFormat(pixels, width, height, components, normal_map);
+
+	// normal maps hold directions, not colors
+	MipSettings settings = { COOKED_TEXTURE_MIP_FILTER, !normal_map, COOKED_TEXTURE_ALPHA_CUTOFF };
+	std::vector<std::vector<unsigned char> > levels = MipGenerator::Build(pixels, width, height, components, settings, COOKED_TEXTURE_MAX_LEVELS);
+	stbi_image_free(pixels);
+
+	size_t offset = CookedAsset::Align(sizeof(CookedTextureHeader));
+	int level_width = width, level_height = height;
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		levels[i] = BlockCompressor::Compress(levels[i].data(), level_width, level_height, components, header.format);
+
+		CookedTextureLevel &level = header.levels[header.levelCount++];
+		level.offset = offset;
+		level.size = levels[i].size();
+		level.width = (uint32_t)level_width;
+		level.height = (uint32_t)level_height;
+		offset = CookedAsset::Align(offset + levels[i].size());
+
+		level_width = std::max(level_width / 2, 1);
+		level_height = std::max(level_height / 2, 1);
+	}
+	header.stamp.fileSize = offset;
+
+	std::string temporary_path = CookedAsset::BeginWrite(cookedPath);
+	std::ofstream file(temporary_path.c_str(), std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "CookedTexture: cannot write " << cookedPath << std::endl;
+		return false;
+	}
+
+	const char padding[8] = {};
+	file.write((const char*)&header, sizeof(header));
+	size_t written = sizeof(header);
+	for (uint32_t i = 0; i < header.levelCount; i++)
+	{
+		file.write(padding, (size_t)header.levels[i].offset - written);
+		file.write((const char*)levels[i].data(), levels[i].size());
+		written = (size_t)(header.levels[i].offset + header.levels[i].size);
+	}
+	file.write(padding, (size_t)header.stamp.fileSize - written);
+	file.close();
+	return CookedAsset::Replace(temporary_path, cookedPath, (bool)file);
+}
+
+std::shared_ptr<MappedFile> CookedTexture::Open(const std::string &cookedPath, const std::string &sourcePath)
+{
+	std::shared_ptr<MappedFile> file = FileSystem::Open(cookedPath);
+	if (!file || !_Validate(*file))
+		return nullptr;
+	if (!CookedAsset::IsCurrent(GetHeader(*file).stamp, sourcePath))
+		return nullptr;
+	return file;
+}
+
+bool CookedTexture::_Validate(const MappedFile &file)
+{
+	if (file.GetSize() < sizeof(CookedTextureHeader))
+		return false;
+	const CookedTextureHeader &header = GetHeader(file);
+	if (header.stamp.magic != COOKED_TEXTURE_MAGIC || header.stamp.version != COOKED_TEXTURE_VERSION || header.stamp.fileSize != file.GetSize() ||
+		header.components < 1 || header.components > 4 || (header.format != 0 && !BlockCompressor::IsBlockFormat(header.format)) ||
+		header.levelCount == 0 || header.levelCount > COOKED_TEXTURE_MAX_LEVELS)
+		return false;
+
+	for (uint32_t i = 0; i < header.levelCount; i++)
+	{
+		const CookedTextureLevel &level = header.levels[i];
+		uint64_t size = header.format != 0 ? BlockCompressor::GetSize(header.format, level.width, level.height) : (uint64_t)level.width * level.height * header.components;
+		if (level.width == 0 || level.height == 0 || level.size != size ||
+			level.offset < sizeof(CookedTextureHeader) || level.offset + level.size > header.stamp.fileSize)
+			return false;
+	}
+	return true;
+}
+
+bool CookedTexture::_IsNormalMap(const std::string &path)
+{
+	std::string name = path.substr(path.find_last_of("/\\") + 1);
+	std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+	return name.find("normal") != std::string::npos || name.find("_ddn") != std::string::npos || name.find("_nrm") != std::string::npos;
+}
+
+#endif
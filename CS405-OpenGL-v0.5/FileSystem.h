@@ -0,0 +1,102 @@
+#ifndef FILE_SYSTEM_H
+#define FILE_SYSTEM_H
+
+#include <string>
+#include <memory>
+#include <iostream>
+
+#include <sys/stat.h>
+
+#include "AssetArchive.h"
+#include "MappedFile.h"
+#include "StringTable.h"
+
+// FileSystem is where the game reads its files from: the mounted asset archive and the loose files.
+// A shipped game has only the archive, a file is found in its table of contents without touching the disk.
+// A tree with the sources (Resource next to the game) reads the loose files first, so an edit shows up
+// without packing again, and falls back to the archive. Without an archive everything is loose.
+class FileSystem {
+public:
+	// Mounts the archive, false when there is none. Before anything is read, reads may come from any thread.
+	static bool Mount(const std::string &archivePath);
+	static void Unmount();
+
+	// The whole file, null when it is missing or empty.
+	static std::shared_ptr<MappedFile> Open(const std::string &path);
+	static bool Exists(const std::string &path);
+	// false (and empty text) when the file is missing or empty
+	static bool ReadText(const std::string &path, std::string &text);
+
+private:
+	FileSystem() { }
+
+	static AssetArchive _archive;
+	static bool _looseFirst;
+
+	static std::shared_ptr<MappedFile> _OpenArchived(const std::string &path);
+	static std::shared_ptr<MappedFile> _OpenLoose(const std::string &path);
+};
+
+// Instantiate static variables
+AssetArchive FileSystem::_archive;
+bool FileSystem::_looseFirst = true;
+
+bool FileSystem::Mount(const std::string &archivePath)
+{
+	if (!_archive.Open(archivePath))
+		return false;
+
+	struct stat info;
+	_looseFirst = stat(DIRECTORY_RESOURCE.c_str(), &info) == 0 && (info.st_mode & S_IFDIR) != 0;
+	std::cout << "FileSystem: mounted " << archivePath << ", " << _archive.GetEntryCount() << " files"
+		<< (_looseFirst ? ", loose files first" : "") << std::endl;
+	return true;
+}
+
+void FileSystem::Unmount()
+{
+	_archive.Close();
+	_looseFirst = true;
+}
+
+std::shared_ptr<MappedFile> FileSystem::Open(const std::string &path)
+{
+	std::shared_ptr<MappedFile> file = _looseFirst ? _OpenLoose(path) : _OpenArchived(path);
+	if (!file)
+		file = _looseFirst ? _OpenArchived(path) : _OpenLoose(path);
+	return file;
+}
+
+bool FileSystem::Exists(const std::string &path)
+{
+	if (_archive.Find(AssetArchive::GetName(path)) != nullptr)
+		return true;
+	struct stat info;
+	return stat(path.c_str(), &info) == 0 && (info.st_mode & S_IFDIR) == 0;
+}
+
+bool FileSystem::ReadText(const std::string &path, std::string &text)
+{
+	std::shared_ptr<MappedFile> file = Open(path);
+	if (!file)
+	{
+		text.clear();
+		return false;
+	}
+	text.assign((const char*)file->GetData(), file->GetSize());
+	return true;
+}
+
+std::shared_ptr<MappedFile> FileSystem::_OpenArchived(const std::string &path)
+{
+	const AssetArchiveEntry *entry = _archive.Find(AssetArchive::GetName(path));
+	return entry != nullptr ? _archive.Read(*entry) : nullptr;
+}
+
+std::shared_ptr<MappedFile> FileSystem::_OpenLoose(const std::string &path)
+{
+	std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+	return file->Open(path) ? file : nullptr;
+}
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#define FRUSTUM_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+// World space bounding boxes stored as structure of arrays (center & half extents),
+// so the frustum can test four of them with a single set of SIMD instructions.
+class AABBBatch {
+public:
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+
+	void Clear();
+	void Reserve(size_t count);
+
+	// Adds a box by center and half extents, returns its index in the batch.
+	size_t Add(const glm::vec3 &center, const glm::vec3 &extents);
+
+	size_t Size() const { return _count; }
+
+	// Pads the arrays to a multiple of four with empty boxes, their results are never read.
+	void Pad();
+
+private:
+	size_t _count = 0;
+};
+
+// Frustum holds the six clip planes of a view-projection matrix.
+// Plane normals point inside, a point p is inside a plane when dot(n, p) + d >= 0.
+class Frustum {
+public:
+	Frustum() {}
+
+	// Extracts the planes (Gribb & Hartmann) from a view-projection matrix in OpenGL clip space.
+	void ExtractPlanes(const glm::mat4 &viewProjection);
+
+	// Tests a single box, mostly useful for debugging the batch path.
+	bool IsVisible(const glm::vec3 &center, const glm::vec3 &extents) const;
+
+	// Tests every box in the batch, visible[i] is set to 1 when box i intersects the frustum.
+	// visible has to have room for batch.Size() entries.
+	void Cull(AABBBatch &batch, unsigned char *visible) const;
+
+private:
+	/*  Planes as structure of arrays: left, right, bottom, top, near, far  */
+	float _normalX[6];
+	float _normalY[6];
+	float _normalZ[6];
+	float _distance[6];
+};
+
+void AABBBatch::Clear()
+{
+	centerX.clear(); centerY.clear(); centerZ.clear();
+	extentX.clear(); extentY.clear(); extentZ.clear();
+	_count = 0;
+}
+
+void AABBBatch::Reserve(size_t count)
+{
+	count = (count + 3) & ~(size_t)3;
+	centerX.reserve(count); centerY.reserve(count); centerZ.reserve(count);
+	extentX.reserve(count); extentY.reserve(count); extentZ.reserve(count);
+}
+
+size_t AABBBatch::Add(const glm::vec3 &center, const glm::vec3 &extents)
+{
+	if (centerX.size() > _count)
+	{
+		// drop the padding of a previous Pad call
+		centerX.resize(_count); centerY.resize(_count); centerZ.resize(_count);
+		extentX.resize(_count); extentY.resize(_count); extentZ.resize(_count);
+	}
+	centerX.push_back(center.x); centerY.push_back(center.y); centerZ.push_back(center.z);
+	extentX.push_back(extents.x); extentY.push_back(extents.y); extentZ.push_back(extents.z);
+	return _count++;
+}
+
+void AABBBatch::Pad()
+{
+	while (centerX.size() % 4 != 0)
+	{
+		centerX.push_back(0.0f); centerY.push_back(0.0f); centerZ.push_back(0.0f);
+		extentX.push_back(0.0f); extentY.push_back(0.0f); extentZ.push_back(0.0f);
+	}
+}
+
+void Frustum::ExtractPlanes(const glm::mat4 &m)
+{
+	// glm matrices are column major, m[column][row]
+	for (int i = 0; i < 3; i++)
+	{
+		for (int side = 0; side < 2; side++)
+		{
+			float sign = side == 0 ? 1.0f : -1.0f;
+			int plane = i * 2 + side;
+
+			_normalX[plane] = m[0][3] + sign * m[0][i];
+			_normalY[plane] = m[1][3] + sign * m[1][i];
+			_normalZ[plane] = m[2][3] + sign * m[2][i];
+			_distance[plane] = m[3][3] + sign * m[3][i];
+
+			float length = std::sqrt(_normalX[plane] * _normalX[plane] +
+				_normalY[plane] * _normalY[plane] + _normalZ[plane] * _normalZ[plane]);
+			if (length > 0.0f)
+			{
+				_normalX[plane] /= length;
+				_normalY[plane] /= length;
+				_normalZ[plane] /= length;
+				_distance[plane] /= length;
+			}
+		}
+	}
+}
+
+bool Frustum::IsVisible(const glm::vec3 &center, const glm::vec3 &extents) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		float distance = _normalX[i] * center.x + _normalY[i] * center.y + _normalZ[i] * center.z + _distance[i];
+		float radius = std::fabs(_normalX[i]) * extents.x + std::fabs(_normalY[i]) * extents.y + std::fabs(_normalZ[i]) * extents.z;
+		if (distance + radius < 0.0f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void Frustum::Cull(AABBBatch &batch, unsigned char *visible) const
+{
+	size_t count = batch.Size();
+
+#ifdef FRUSTUM_USE_SSE
+	batch.Pad();
+
+	__m128 normal_x[6], normal_y[6], normal_z[6], abs_x[6], abs_y[6], abs_z[6], distance[6];
+	for (int i = 0; i < 6; i++)
+	{
+		normal_x[i] = _mm_set1_ps(_normalX[i]);
+		normal_y[i] = _mm_set1_ps(_normalY[i]);
+		normal_z[i] = _mm_set1_ps(_normalZ[i]);
+		abs_x[i] = _mm_set1_ps(std::fabs(_normalX[i]));
+		abs_y[i] = _mm_set1_ps(std::fabs(_normalY[i]));
+		abs_z[i] = _mm_set1_ps(std::fabs(_normalZ[i]));
+		distance[i] = _mm_set1_ps(_distance[i]);
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	for (size_t box = 0; box < count; box += 4)
+	{
+		__m128 center_x = _mm_loadu_ps(&batch.centerX[box]);
+		__m128 center_y = _mm_loadu_ps(&batch.centerY[box]);
+		__m128 center_z = _mm_loadu_ps(&batch.centerZ[box]);
+		__m128 extent_x = _mm_loadu_ps(&batch.extentX[box]);
+		__m128 extent_y = _mm_loadu_ps(&batch.extentY[box]);
+		__m128 extent_z = _mm_loadu_ps(&batch.extentZ[box]);
+
+		__m128 outside = zero;
+		for (int i = 0; i < 6; i++)
+		{
+			__m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normal_x[i], center_x), _mm_mul_ps(normal_y[i], center_y)),
+				_mm_add_ps(_mm_mul_ps(normal_z[i], center_z), distance[i]));
+			__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(abs_x[i], extent_x), _mm_mul_ps(abs_y[i], extent_y)),
+				_mm_mul_ps(abs_z[i], extent_z));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, radius), zero));
+		}
+
+		int mask = _mm_movemask_ps(outside);
+		for (size_t lane = 0; lane < 4 && box + lane < count; lane++)
+		{
+			visible[box + lane] = (mask & (1 << lane)) ? 0 : 1;
+		}
+	}
+#else
+	for (size_t box = 0; box < count; box++)
+	{
+		visible[box] = IsVisible(glm::vec3(batch.centerX[box], batch.centerY[box], batch.centerZ[box]),
+			glm::vec3(batch.extentX[box], batch.extentY[box], batch.extentZ[box])) ? 1 : 0;
+	}
+#endif
+}
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include "Include/glad/glad.h"
+
+#include <iostream>
+#include <cstring>
+
+#include "RenderDevice.h"
+
+// The glad loader only covers the OpenGL 3.3 core profile. Entry points of newer versions
+// that the engine can use when the driver offers them are loaded here, callers have to check the flags.
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+typedef void (APIENTRYP PFN_MULTI_DRAW_ELEMENTS_INDIRECT)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+typedef void (APIENTRYP PFN_BUFFER_STORAGE)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+typedef void (APIENTRYP PFN_GET_PROGRAM_BINARY)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFN_PROGRAM_BINARY)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP PFN_PROGRAM_PARAMETERI)(GLuint program, GLenum pname, GLint value);
+
+// Layout of one command in a GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint  baseVertex;
+	GLuint baseInstance;
+};
+
+class GLExtensions {
+public:
+	/*  Availability  */
+	static bool MultiDrawIndirect;
+	static bool PersistentMapping;
+	// only when the driver also offers at least one binary format
+	static bool ProgramBinaries;
+	// BC1 & BC3 textures, see BlockCompressor
+	static bool TextureCompressionS3TC;
+
+	/*  Entry Points  */
+	static PFN_MULTI_DRAW_ELEMENTS_INDIRECT MultiDrawElementsIndirect;
+	static PFN_BUFFER_STORAGE BufferStorage;
+	static PFN_GET_PROGRAM_BINARY GetProgramBinary;
+	static PFN_PROGRAM_BINARY ProgramBinary;
+	static PFN_PROGRAM_PARAMETERI ProgramParameteri;
+
+	// Has to be called once the device created its context and glad is loaded.
+	static void Load(RenderDevice *device);
+
+	static void Print();
+
+private:
+	GLExtensions() { }
+
+	static bool _HasVersion(int major, int minor);
+	static bool _HasExtension(const char *name);
+};
+
+// Instantiate static variables
+bool GLExtensions::MultiDrawIndirect = false;
+bool GLExtensions::PersistentMapping = false;
+bool GLExtensions::ProgramBinaries = false;
+bool GLExtensions::TextureCompressionS3TC = false;
+PFN_MULTI_DRAW_ELEMENTS_INDIRECT GLExtensions::MultiDrawElementsIndirect = nullptr;
+PFN_BUFFER_STORAGE GLExtensions::BufferStorage = nullptr;
+PFN_GET_PROGRAM_BINARY GLExtensions::GetProgramBinary = nullptr;
+PFN_PROGRAM_BINARY GLExtensions::ProgramBinary = nullptr;
+PFN_PROGRAM_PARAMETERI GLExtensions::ProgramParameteri = nullptr;
+
+void GLExtensions::Load(RenderDevice *device)
+{
+	// a device created after another one (the tests) must not keep the previous entry points
+	MultiDrawElementsIndirect = nullptr;
+	BufferStorage = nullptr;
+	GetProgramBinary = nullptr;
+	ProgramBinary = nullptr;
+	ProgramParameteri = nullptr;
+
+	// the commands pick their instances through baseInstance, which also needs GL 4.2 or ARB_base_instance
+	bool base_instance = _HasVersion(4, 2) || _HasExtension("GL_ARB_base_instance");
+	if (base_instance && (_HasVersion(4, 3) || _HasExtension("GL_ARB_multi_draw_indirect")))
+	{
+		MultiDrawElementsIndirect = (PFN_MULTI_DRAW_ELEMENTS_INDIRECT)device->GetProcAddress("glMultiDrawElementsIndirect");
+	}
+	MultiDrawIndirect = MultiDrawElementsIndirect != nullptr;
+
+	if (_HasVersion(4, 4) || _HasExtension("GL_ARB_buffer_storage"))
+	{
+		BufferStorage = (PFN_BUFFER_STORAGE)device->GetProcAddress("glBufferStorage");
+	}
+	PersistentMapping = BufferStorage != nullptr;
+
+	if (_HasVersion(4, 1) || _HasExtension("GL_ARB_get_program_binary"))
+	{
+		GetProgramBinary = (PFN_GET_PROGRAM_BINARY)device->GetProcAddress("glGetProgramBinary");
+		ProgramBinary = (PFN_PROGRAM_BINARY)device->GetProcAddress("glProgramBinary");
+		ProgramParameteri = (PFN_PROGRAM_PARAMETERI)device->GetProcAddress("glProgramParameteri");
+	}
+	GLint binary_formats = 0;
+	if (GetProgramBinary != nullptr && ProgramBinary != nullptr && ProgramParameteri != nullptr)
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binary_formats);
+	ProgramBinaries = binary_formats > 0;
+
+	TextureCompressionS3TC = _HasExtension("GL_EXT_texture_compression_s3tc");
+
+	Print();
+}
+
+void GLExtensions::Print()
+{
+	std::cout << "OpenGL " << GLVersion.major << "." << GLVersion.minor
+		<< " | multi draw indirect: " << (MultiDrawIndirect ? "yes" : "no")
+		<< " | persistent mapping: " << (PersistentMapping ? "yes" : "no")
+		<< " | program binaries: " << (ProgramBinaries ? "yes" : "no")
+		<< " | s3tc: " << (TextureCompressionS3TC ? "yes" : "no") << std::endl;
+}
+
+bool GLExtensions::_HasVersion(int major, int minor)
+{
+	return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+bool GLExtensions::_HasExtension(const char *name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++)
+	{
+		const char *extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (extension != NULL && std::strcmp(extension, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef GLFW_RENDER_DEVICE_H
+#define GLFW_RENDER_DEVICE_H
+
+#include "Include/glad/glad.h"
+#include <GLFW/glfw3.h>
+
+#include <iostream>
+
+#include "RenderDevice.h"
+
+// The window and OpenGL 3.3 core context of the game, created through GLFW.
+class GLFWRenderDevice : public RenderDevice {
+public:
+	GLFWRenderDevice() : _window(NULL) { }
+
+	bool Create(const char *title, unsigned int width, unsigned int height);
+	void *GetProcAddress(const char *name);
+	void SetCallbacks(GLFWframebuffersizefun framebufferSize, GLFWcursorposfun cursorPosition, GLFWscrollfun scroll);
+
+	bool ShouldClose() { return glfwWindowShouldClose(_window) != 0; }
+	void RequestClose() { glfwSetWindowShouldClose(_window, true); }
+	void Present();
+	double GetTime() { return glfwGetTime(); }
+	bool IsKeyPressed(int key) { return glfwGetKey(_window, key) == GLFW_PRESS; }
+	void Destroy();
+
+private:
+	GLFWwindow *_window;
+};
+
+bool GLFWRenderDevice::Create(const char *title, unsigned int width, unsigned int height)
+{
+	// glfw: initialize and configure
+	// ------------------------------
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+#ifdef __APPLE__
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // uncomment this statement to fix compilation on OS X
+#endif
+
+	// glfw window creation
+	// --------------------
+	_window = glfwCreateWindow(width, height, title, NULL, NULL);
+	if (_window == NULL)
+	{
+		std::cout << "Failed to create GLFW window" << std::endl;
+		glfwTerminate();
+		return false;
+	}
+
+	glfwMakeContextCurrent(_window);
+
+	// tell GLFW to capture our mouse
+	glfwSetInputMode(_window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+	// glad: load all OpenGL function pointers
+	// ---------------------------------------
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	{
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void *GLFWRenderDevice::GetProcAddress(const char *name)
+{
+	return (void*)glfwGetProcAddress(name);
+}
+
+void GLFWRenderDevice::SetCallbacks(GLFWframebuffersizefun framebufferSize, GLFWcursorposfun cursorPosition, GLFWscrollfun scroll)
+{
+	glfwSetFramebufferSizeCallback(_window, framebufferSize);
+	glfwSetCursorPosCallback(_window, cursorPosition);
+	glfwSetScrollCallback(_window, scroll);
+}
+
+void GLFWRenderDevice::Present()
+{
+	// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+	glfwSwapBuffers(_window);
+	glfwPollEvents();
+}
+
+void GLFWRenderDevice::Destroy()
+{
+	glfwTerminate();
+	_window = NULL;
+}
+
+#endif
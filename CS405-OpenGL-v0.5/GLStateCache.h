@@ -0,0 +1,351 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include "Include/glad/glad.h"
+
+#include "GLExtensions.h"
+
+#include <iostream>
+#include <iomanip>
+
+// Number of texture units whose bindings are tracked.
+const unsigned int MAX_CACHED_TEXTURE_UNITS = 16;
+
+// Kinds of state changes the cache keeps counters for.
+enum GLStateCall {
+	CALL_USE_PROGRAM,
+	CALL_ACTIVE_TEXTURE,
+	CALL_BIND_TEXTURE,
+	CALL_BIND_VERTEX_ARRAY,
+	CALL_BIND_BUFFER,
+	CALL_DEPTH_FUNC,
+	CALL_DEPTH_MASK,
+	CALL_COLOR_MASK,
+	CALL_COUNT
+};
+
+// Per frame counters of the calls that reached the driver and the ones filtered out.
+struct GLStateCounters {
+	unsigned int issued[CALL_COUNT];
+	unsigned int skipped[CALL_COUNT];
+	unsigned int drawCalls;
+};
+
+// GLStateCache mirrors the parts of the OpenGL state the engine touches every frame
+// and only forwards a call to the driver when it actually changes something.
+// Every bind in the draw path has to go through here, otherwise the mirror gets stale.
+class GLStateCache {
+public:
+	/*  State Changes  */
+	static void UseProgram(GLuint program);
+	static void ActiveTexture(GLenum unit);
+	static void BindTexture(GLenum target, GLuint texture);
+	static void BindVertexArray(GLuint vertexArray);
+	static void BindBuffer(GLenum target, GLuint buffer);
+	static void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	static void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	static void DepthFunc(GLenum func);
+	static void DepthMask(GLboolean write);
+	// the same mask for all four channels
+	static void ColorMask(GLboolean write);
+
+	/*  Draw Calls  */
+	static void DrawArrays(GLenum mode, GLint first, GLsizei count);
+	static void DrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices);
+	static void DrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void *indices, GLint baseVertex);
+	static void DrawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instanceCount, GLint baseVertex);
+	// one driver call for many draws, commands is the offset into the bound GL_DRAW_INDIRECT_BUFFER
+	static void MultiDrawElementsIndirect(GLenum mode, GLenum type, const void *commands, GLsizei drawCount, GLsizei stride);
+
+	/*  Object Deletion (forgets bindings of deleted names)  */
+	static void DeleteProgram(GLuint program);
+	static void DeleteTextures(GLsizei count, const GLuint *textures);
+	static void DeleteVertexArrays(GLsizei count, const GLuint *vertexArrays);
+	static void DeleteBuffers(GLsizei count, const GLuint *buffers);
+
+	// Forgets everything, the next call of every kind reaches the driver.
+	static void Invalidate();
+
+	/*  Counters  */
+	// Moves the running counters to the last frame slot and starts a new frame.
+	static void BeginFrame();
+	static const GLStateCounters &GetLastFrameCounters() { return _lastFrame; }
+	static void PrintCounters();
+
+private:
+	GLStateCache() { }
+
+	static const GLuint _UNKNOWN = 0xFFFFFFFFu;
+
+	/*  Mirrored State  */
+	static GLuint _program;
+	static GLuint _vertexArray;
+	static GLuint _arrayBuffer;
+	static GLuint _uniformBuffer;
+	static GLenum _activeUnit;
+	static GLenum _depthFunc;
+	static GLuint _depthMask;
+	static GLuint _colorMask;
+	// bindings per texture unit for 2D, cube map and 2D array targets
+	static GLuint _textures[MAX_CACHED_TEXTURE_UNITS][3];
+
+	/*  Counters  */
+	static GLStateCounters _frame;
+	static GLStateCounters _lastFrame;
+
+	static bool _Filter(GLStateCall call, GLuint &cached, GLuint value);
+	static int _TextureTargetSlot(GLenum target);
+	static GLuint *_BufferSlot(GLenum target);
+};
+
+// Instantiate static variables
+GLuint GLStateCache::_program = GLStateCache::_UNKNOWN;
+GLuint GLStateCache::_vertexArray = GLStateCache::_UNKNOWN;
+GLuint GLStateCache::_arrayBuffer = GLStateCache::_UNKNOWN;
+GLuint GLStateCache::_uniformBuffer = GLStateCache::_UNKNOWN;
+GLenum GLStateCache::_activeUnit = GLStateCache::_UNKNOWN;
+GLenum GLStateCache::_depthFunc = GLStateCache::_UNKNOWN;
+GLuint GLStateCache::_depthMask = GLStateCache::_UNKNOWN;
+GLuint GLStateCache::_colorMask = GLStateCache::_UNKNOWN;
+GLuint GLStateCache::_textures[MAX_CACHED_TEXTURE_UNITS][3];
+GLStateCounters GLStateCache::_frame = {};
+GLStateCounters GLStateCache::_lastFrame = {};
+
+void GLStateCache::UseProgram(GLuint program)
+{
+	if (_Filter(CALL_USE_PROGRAM, _program, program))
+		glUseProgram(program);
+}
+
+void GLStateCache::ActiveTexture(GLenum unit)
+{
+	if (_Filter(CALL_ACTIVE_TEXTURE, _activeUnit, unit))
+		glActiveTexture(unit);
+}
+
+void GLStateCache::BindTexture(GLenum target, GLuint texture)
+{
+	int slot = _TextureTargetSlot(target);
+	unsigned int unit = _activeUnit - GL_TEXTURE0;
+	if (slot < 0 || _activeUnit == _UNKNOWN || unit >= MAX_CACHED_TEXTURE_UNITS)
+	{
+		// untracked target or unit, always let it through
+		_frame.issued[CALL_BIND_TEXTURE]++;
+		glBindTexture(target, texture);
+		return;
+	}
+	if (_Filter(CALL_BIND_TEXTURE, _textures[unit][slot], texture))
+		glBindTexture(target, texture);
+}
+
+void GLStateCache::BindVertexArray(GLuint vertexArray)
+{
+	if (_Filter(CALL_BIND_VERTEX_ARRAY, _vertexArray, vertexArray))
+		glBindVertexArray(vertexArray);
+}
+
+void GLStateCache::BindBuffer(GLenum target, GLuint buffer)
+{
+	// element array bindings belong to the bound vertex array, those are never filtered.
+	GLuint *slot = _BufferSlot(target);
+	if (slot == nullptr)
+	{
+		_frame.issued[CALL_BIND_BUFFER]++;
+		glBindBuffer(target, buffer);
+		return;
+	}
+	if (_Filter(CALL_BIND_BUFFER, *slot, buffer))
+		glBindBuffer(target, buffer);
+}
+
+void GLStateCache::BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	// indexed bindings also replace the generic binding of the target
+	GLuint *slot = _BufferSlot(target);
+	if (slot != nullptr)
+		*slot = buffer;
+	_frame.issued[CALL_BIND_BUFFER]++;
+	glBindBufferBase(target, index, buffer);
+}
+
+void GLStateCache::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	GLuint *slot = _BufferSlot(target);
+	if (slot != nullptr)
+		*slot = buffer;
+	_frame.issued[CALL_BIND_BUFFER]++;
+	glBindBufferRange(target, index, buffer, offset, size);
+}
+
+void GLStateCache::DepthFunc(GLenum func)
+{
+	if (_Filter(CALL_DEPTH_FUNC, _depthFunc, func))
+		glDepthFunc(func);
+}
+
+void GLStateCache::DepthMask(GLboolean write)
+{
+	if (_Filter(CALL_DEPTH_MASK, _depthMask, write))
+		glDepthMask(write);
+}
+
+void GLStateCache::ColorMask(GLboolean write)
+{
+	if (_Filter(CALL_COLOR_MASK, _colorMask, write))
+		glColorMask(write, write, write, write);
+}
+
+void GLStateCache::DrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+	_frame.drawCalls++;
+	glDrawArrays(mode, first, count);
+}
+
+void GLStateCache::DrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices)
+{
+	_frame.drawCalls++;
+	glDrawElements(mode, count, type, indices);
+}
+
+void GLStateCache::DrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void *indices, GLint baseVertex)
+{
+	_frame.drawCalls++;
+	glDrawElementsBaseVertex(mode, count, type, (void*)indices, baseVertex);
+}
+
+void GLStateCache::DrawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instanceCount, GLint baseVertex)
+{
+	_frame.drawCalls++;
+	glDrawElementsInstancedBaseVertex(mode, count, type, indices, instanceCount, baseVertex);
+}
+
+void GLStateCache::MultiDrawElementsIndirect(GLenum mode, GLenum type, const void *commands, GLsizei drawCount, GLsizei stride)
+{
+	_frame.drawCalls++;
+	GLExtensions::MultiDrawElementsIndirect(mode, type, commands, drawCount, stride);
+}
+
+void GLStateCache::DeleteProgram(GLuint program)
+{
+	// deleting the program in use only flags it, it stays current until another one is used.
+	glDeleteProgram(program);
+}
+
+void GLStateCache::DeleteTextures(GLsizei count, const GLuint *textures)
+{
+	// deleted textures are unbound from every unit by the driver
+	for (GLsizei i = 0; i < count; i++)
+		for (unsigned int unit = 0; unit < MAX_CACHED_TEXTURE_UNITS; unit++)
+			for (unsigned int slot = 0; slot < 3; slot++)
+				if (_textures[unit][slot] == textures[i])
+					_textures[unit][slot] = 0;
+	glDeleteTextures(count, textures);
+}
+
+void GLStateCache::DeleteVertexArrays(GLsizei count, const GLuint *vertexArrays)
+{
+	for (GLsizei i = 0; i < count; i++)
+		if (_vertexArray == vertexArrays[i])
+			_vertexArray = 0;
+	glDeleteVertexArrays(count, vertexArrays);
+}
+
+void GLStateCache::DeleteBuffers(GLsizei count, const GLuint *buffers)
+{
+	for (GLsizei i = 0; i < count; i++)
+	{
+		if (_arrayBuffer == buffers[i])
+			_arrayBuffer = 0;
+		if (_uniformBuffer == buffers[i])
+			_uniformBuffer = 0;
+	}
+	glDeleteBuffers(count, buffers);
+}
+
+void GLStateCache::Invalidate()
+{
+	_program = _UNKNOWN;
+	_vertexArray = _UNKNOWN;
+	_arrayBuffer = _UNKNOWN;
+	_uniformBuffer = _UNKNOWN;
+	_activeUnit = _UNKNOWN;
+	_depthFunc = _UNKNOWN;
+	_depthMask = _UNKNOWN;
+	_colorMask = _UNKNOWN;
+	for (unsigned int unit = 0; unit < MAX_CACHED_TEXTURE_UNITS; unit++)
+		for (unsigned int slot = 0; slot < 3; slot++)
+			_textures[unit][slot] = _UNKNOWN;
+}
+
+void GLStateCache::BeginFrame()
+{
+	_lastFrame = _frame;
+	_frame = GLStateCounters();
+}
+
+void GLStateCache::PrintCounters()
+{
+	static const char *names[CALL_COUNT] = {
+		"UseProgram", "ActiveTexture", "BindTexture", "BindVertexArray", "BindBuffer", "DepthFunc", "DepthMask", "ColorMask"
+	};
+
+	unsigned int total_issued = 0;
+	unsigned int total_skipped = 0;
+
+	std::cout << "\nGL State Calls (last frame)\n~~~~~~~~~~~~~~~~~~~~~~\n";
+	for (int i = 0; i < CALL_COUNT; i++)
+	{
+		std::cout << std::setw(16) << names[i]
+			<< " issued: " << std::setw(6) << _lastFrame.issued[i]
+			<< " skipped: " << std::setw(6) << _lastFrame.skipped[i] << std::endl;
+		total_issued += _lastFrame.issued[i];
+		total_skipped += _lastFrame.skipped[i];
+	}
+	std::cout << std::setw(16) << "Total"
+		<< " issued: " << std::setw(6) << total_issued
+		<< " skipped: " << std::setw(6) << total_skipped << std::endl;
+	std::cout << std::setw(16) << "Draw calls" << " : " << _lastFrame.drawCalls << std::endl;
+}
+
+// returns true when the call has to reach the driver, and records it.
+bool GLStateCache::_Filter(GLStateCall call, GLuint &cached, GLuint value)
+{
+	if (cached == value)
+	{
+		_frame.skipped[call]++;
+		return false;
+	}
+	cached = value;
+	_frame.issued[call]++;
+	return true;
+}
+
+int GLStateCache::_TextureTargetSlot(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D:
+		return 0;
+	case GL_TEXTURE_CUBE_MAP:
+		return 1;
+	case GL_TEXTURE_2D_ARRAY:
+		return 2;
+	default:
+		return -1;
+	}
+}
+
+GLuint *GLStateCache::_BufferSlot(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER:
+		return &_arrayBuffer;
+	case GL_UNIFORM_BUFFER:
+		return &_uniformBuffer;
+	default:
+		return nullptr;
+	}
+}
+
+#endif
@@ -10,6 +10,21 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "ResourceManager.h"
+#include "RenderDevice.h"
+#include "UniformBuffer.h"
+#include "StreamBuffer.h"
+#include "TextureLoader.h"
+#include "TextureCache.h"
+#include "Frustum.h"
+#include "OcclusionCuller.h"
+#include "GLExtensions.h"
+#include "RenderQueue.h"
+#include "TexturePacker.h"
+#include "HudBatch.h"
+#include "ModelLoader.h"
+#include "AssetStreamer.h"
+#include "HotReload.h"
+#include "FileSystem.h"
 
 #include "camera.h"
 #include "GameObject.h"
@@ -20,13 +35,12 @@
 #include "Enums.h"
 #include "Point.h"
 
-const float MAX_RENDER_DISTANCE = 10.0f;
-
 class GameEngine {
 public:
 	static GameEngine &GetInstance();
 
-	void Init();
+	// device provides the window, GL context and input, the engine does not take ownership
+	void Init(RenderDevice *device);
 
 	void NotifyObjectChanges();
 
@@ -34,6 +48,8 @@ public:
 
 	void FinishGame();
 
+	// The Add & Set functions only request the models, they are read in parallel on the workers
+	// and LoadObjects creates the objects in the order they were requested.
 	void AddEnemy(const std::string &filepath, const glm::vec3 &scaleVec);
 	void AddCoin(const std::string &filepath, const glm::vec3 &scaleVec);
 
@@ -43,6 +59,9 @@ public:
 	void SetScreenPanelScore(const std::string &filepath, const glm::vec3 & scaleVec);
 	void SetScreenPanelHunger(const std::string &filepath, const glm::vec3 & scaleVec);
 
+	// Waits for the requested models and creates their objects, StartGame does it for anything left.
+	void LoadObjects();
+
 	void SetSkybox(const std::vector<std::string> & faces);
 
 	void PrintObjects();
@@ -72,8 +91,18 @@ private:
 	GameObject *_screenPanelScore;
 	GameObject *_screenPanelHunger;
 
+	/*  Objects whose models are still loading  */
+	struct _PendingObject {
+		ModelHandle model;
+		ObjectType type;
+		glm::vec3 scale;
+		// where a single object (player, panel) goes, null for enemies & coins
+		GameObject **slot;
+	};
+	std::vector<_PendingObject> _pendingObjects;
+
 	/*  Game Window Data  */
-	GLFWwindow* _window;
+	RenderDevice *_device;
 	unsigned int _windowSize[2];
 	float _windowRatio;
 
@@ -81,14 +110,45 @@ private:
 	glm::mat4 _projectionMatrix;
 	glm::mat4 _viewMatrix;
 
+	/*  Per Frame Constants shared by every shader  */
+	UniformBuffer _cameraBuffer;
+
+	/*  Data rewritten every frame (camera constants, instances, draw commands)  */
+	StreamBuffer _frameStream;
+
+	/*  Culling Data  */
+	Frustum _frustum;
+	AABBBatch _cullBounds;
+	std::vector<GameObject*> _cullCandidates;
+	std::vector<unsigned char> _cullResults;
+	std::vector<float> _cullScreenSizes;
+	OcclusionCuller _occlusion;
+	std::vector<GameObject*> _visibleObjects;
+
+	/*  Batched Object Draws  */
+	RenderQueue _renderQueue;
+	bool _depthPrepass;
+
+	/*  On Screen Panels, drawn in one call  */
+	HudBatch _hud;
+
 	// Debug Controls
 	bool _isDebugMode;
 	bool _debugPrinter;
 
+	void _RequestObject(const std::string &filepath, ObjectType type, const glm::vec3 &scale, GameObject **slot);
+
 	/*  Update Objects  */
 	void _Update();
 
-	bool _IsRenderable(GameObject * object);
+	void _UpdateCameraBuffer(float time);
+
+	/*  Frustum Culling  */
+	void _AddCullCandidate(GameObject *object);
+	void _CullObjects();
+	void _CullOccluded();
+	float _ScreenSize(size_t boundsIndex);
+
 	/*  Draw & Render Objects  */
 	void _Render();
 	void _UpdateScreenPanel();
@@ -130,14 +190,20 @@ GameEngine& GameEngine::GetInstance()
 	return instance;
 }
 
-void GameEngine::Init()
+void GameEngine::Init(RenderDevice *device)
 {
+	_device = device;
+
 	_windowSize[0] = SCR_WIDTH;
 	_windowSize[1] = SCR_HEIGHT;
 
 	_windowRatio = (float)_windowSize[0] / (float)_windowSize[1];
 
 	_frameCounter = 0;
+	_depthPrepass = DEPTH_PREPASS;
+
+	// one mapping for every asset when the AssetCooker packed them, loose files otherwise
+	FileSystem::Mount(FILE_ARCHIVE);
 
 	_InitGameWindow();
 }
@@ -146,7 +212,7 @@ inline void GameEngine::NotifyObjectChanges()
 {
 	for (int i = 0; i < 100; i++)
 	{
-		float current_frame = glfwGetTime();
+		float current_frame = (float)_device->GetTime();
 
 		_deltaTime = current_frame - _lastTime;
 		_lastTime = current_frame - _lastTime;
@@ -161,14 +227,36 @@ inline void GameEngine::NotifyObjectChanges()
 
 void GameEngine::StartGame()
 {
-	while (!glfwWindowShouldClose(_window))
+	LoadObjects();
+
+	// the panels are set up by now, their textures go into the hud atlas
+	_hud.Init(*_screenPanelHP->model, *_screenPanelScore->model, *_screenPanelHunger->model);
+
+	// everything drawn through the render queue starts with its packed proxy, the AssetStreamer
+	// packs the full models as they arrive
+
+	// edits of the loose resources show up without a restart
+	if (HOT_RELOAD)
+		HotReload::Init();
+
+	while (!_device->ShouldClose())
 	{
 		// per-frame time logic
 		// --------------------
-		float current_frame = glfwGetTime();
+		float current_frame = (float)_device->GetTime();
 		_deltaTime = current_frame - _lastTime;
 		_lastTime = current_frame;
 
+		GLStateCache::BeginFrame();
+		_frameStream.BeginFrame();
+
+		// files changed since the last frame are applied before anything is drawn
+		HotReload::Update(current_frame);
+
+		// textures decoded since the last frame replace their placeholders
+		TextureLoader::Update(TEXTURE_UPLOAD_BUDGET);
+		TextureCache::Evict(TEXTURE_CACHE_UNREFERENCED);
+
 		// render
 		// ------
 		glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
@@ -190,8 +278,7 @@ void GameEngine::StartGame()
 		this->_projectionMatrix = glm::perspective(glm::radians(camera.getZoom()), _windowRatio, 0.1f, 100.0f);		
 		this->_viewMatrix = camera.GetViewMatrix();
 		
-		ResourceManager::GetShader(KEY_SHADER_OBJECT).setMat4("projection", _projectionMatrix);
-		ResourceManager::GetShader(KEY_SHADER_OBJECT).setMat4("view", _viewMatrix);
+		_UpdateCameraBuffer(current_frame);
 
 		// Take user inputs
 		// ----------------------
@@ -211,68 +298,109 @@ void GameEngine::StartGame()
 		// Lastly render skybox.
 		_UpdateSkybox();
 
-		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+		// every draw reading this frame's stream region is issued
+		_frameStream.EndFrame();
+
+		// swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
-		glfwSwapBuffers(_window);
-		glfwPollEvents();
+		_device->Present();
 	}
 }
 
 void GameEngine::FinishGame()
 {
-	glDeleteVertexArrays(1, &_skyboxVAO);
-	//glDeleteBuffers(1, &cubeVBO);
-	glDeleteBuffers(1, &_skyboxVAO);
-
-	glfwTerminate();
+	_cameraBuffer.Delete();
+	_renderQueue.Delete();
+	_frameStream.Delete();
+	AssetStreamer::Clear();
+	ModelLoader::Clear();
+	TextureLoader::Clear();
+	HotReload::Clear();
+	TexturePacker::Clear();
+	TextureCache::Clear();
+	_hud.Delete();
+	MeshPool::Clear();
+	GLStateCache::DeleteVertexArrays(1, &_skyboxVAO);
+	GLStateCache::DeleteBuffers(1, &_skyboxVBO);
+	FileSystem::Unmount();
+
+	_device->Destroy();
 }
 
 void GameEngine::AddEnemy(const std::string &filepath, const glm::vec3 &scaleVec = glm::vec3(1.0f))
 {
-	auto enemy_object = new GameObject(filepath, ObjectType::Enemy);
-	
-	enemy_object->PlaceRandomly();
-
-	enemy_object->ScaleObject(scaleVec);
-
-	_enemyObjects.push_back(enemy_object);
+	_RequestObject(filepath, ObjectType::Enemy, scaleVec, nullptr);
 }
 
 void GameEngine::AddCoin(const std::string &filepath, const glm::vec3 &scaleVec = glm::vec3(1.0f))
 {
-	auto coin_object = new GameObject(filepath, ObjectType::Coin);
-	
-	coin_object->PlaceRandomly();
-	
-	coin_object->ScaleObject(scaleVec);
-
-	_coinObjects.push_back(coin_object);
+	_RequestObject(filepath, ObjectType::Coin, scaleVec, nullptr);
 }
 
 void GameEngine::SetPlayer(const std::string &filepath, const glm::vec3 &scaleVec = glm::vec3(1.0f))
 {
-	_playerObject = new GameObject(filepath, ObjectType::Player);
-	_playerObject->ScaleObject(scaleVec);
-
-	camera.setPosition(_playerObject->GetPosition());
+	_RequestObject(filepath, ObjectType::Player, scaleVec, &_playerObject);
 }
 
 void GameEngine::SetScreenPanelHP(const std::string &filepath, const glm::vec3 &scaleVec = glm::vec3(1.0f))
 {
-	_screenPanelHP = new GameObject(filepath, ObjectType::OnScreenPanel);
-	_screenPanelHP->ScaleObject(scaleVec);
+	_RequestObject(filepath, ObjectType::OnScreenPanel, scaleVec, &_screenPanelHP);
 }
 
 void GameEngine::SetScreenPanelScore(const std::string &filepath, const glm::vec3 &scaleVec = glm::vec3(1.0f))
 {
-	_screenPanelScore = new GameObject(filepath, ObjectType::OnScreenPanel);
-	_screenPanelScore->ScaleObject(scaleVec);
+	_RequestObject(filepath, ObjectType::OnScreenPanel, scaleVec, &_screenPanelScore);
 }
 
 void GameEngine::SetScreenPanelHunger(const std::string &filepath, const glm::vec3 &scaleVec = glm::vec3(1.0f))
 {
-	_screenPanelHunger = new GameObject(filepath, ObjectType::OnScreenPanel);
-	_screenPanelHunger->ScaleObject(scaleVec);
+	_RequestObject(filepath, ObjectType::OnScreenPanel, scaleVec, &_screenPanelHunger);
+}
+
+void GameEngine::_RequestObject(const std::string &filepath, ObjectType type, const glm::vec3 &scale, GameObject **slot)
+{
+	_PendingObject pending;
+	pending.model = ModelLoader::Load(filepath);
+	pending.type = type;
+	pending.scale = scale;
+	pending.slot = slot;
+	_pendingObjects.push_back(pending);
+}
+
+void GameEngine::LoadObjects()
+{
+	// in request order, so the random placement does not depend on which model finished first
+	for (size_t i = 0; i < _pendingObjects.size(); i++)
+	{
+		const _PendingObject &pending = _pendingObjects[i];
+		// the panels are needed whole for the hud, everything else starts with a proxy and streams its model in
+		bool streamed = pending.type != ObjectType::OnScreenPanel;
+		Model *model = streamed ? AssetStreamer::CreateProxy(pending.model) : ModelLoader::Create(pending.model);
+		GameObject *object = new GameObject(model, pending.type);
+		if (streamed)
+			AssetStreamer::Add(object, pending.model);
+
+		switch (pending.type)
+		{
+		case ObjectType::Enemy:
+		case ObjectType::Coin:
+			object->PlaceRandomly();
+			object->ScaleObject(pending.scale);
+			(pending.type == ObjectType::Enemy ? _enemyObjects : _coinObjects).push_back(object);
+			break;
+		case ObjectType::Player:
+			object->ScaleObject(pending.scale);
+			camera.setPosition(object->GetPosition());
+			break;
+		default:
+			object->ScaleObject(pending.scale);
+			break;
+		}
+		if (pending.slot != nullptr)
+			*pending.slot = object;
+	}
+	_pendingObjects.clear();
+	ModelLoader::Clear();
 }
 
 void GameEngine::SetSkybox(const std::vector<std::string> & faces)
@@ -325,35 +453,13 @@ void GameEngine::SetSkybox(const std::vector<std::string> & faces)
 	//unsigned int skyboxVAO, skyboxVBO;
 	glGenVertexArrays(1, &_skyboxVAO);
 	glGenBuffers(1, &_skyboxVBO);
-	glBindVertexArray(_skyboxVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, _skyboxVBO);
+	GLStateCache::BindVertexArray(_skyboxVAO);
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, _skyboxVBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(skybox_vertices), &skybox_vertices, GL_STATIC_DRAW);
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
-	glGenTextures(1, &_skyboxTextureID);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, _skyboxTextureID);
-
-	int width, height, number_of_channels;
-	for (unsigned int i = 0; i < faces.size(); i++)
-	{
-		unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &number_of_channels, 0);
-		if (data)
-		{
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-			stbi_image_free(data);
-		}
-		else
-		{
-			std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-			stbi_image_free(data);
-		}
-	}
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	_skyboxTextureID = TextureCache::AcquireCubemap(faces);
 }
 
 void GameEngine::PrintObjects()
@@ -390,93 +496,154 @@ void GameEngine::_Update()
 	}
 }
 
-bool GameEngine::_IsRenderable(GameObject *object)
+// uploads the camera constants once, every program loaded by the ResourceManager reads them from the same block.
+void GameEngine::_UpdateCameraBuffer(float time)
 {
-	if (!object->ShouldRender())
+	CameraBlock block;
+	block.view = _viewMatrix;
+	block.projection = _projectionMatrix;
+	block.viewProjection = _projectionMatrix * _viewMatrix;
+	block.cameraPosition = camera.getPosition();
+	block.time = time;
+
+	_cameraBuffer.Update(&block, sizeof(CameraBlock));
+}
+
+void GameEngine::_AddCullCandidate(GameObject *object)
+{
+	glm::vec3 center, extents;
+	object->model->GetWorldBounds(center, extents);
+
+	_cullCandidates.push_back(object);
+	_cullBounds.Add(center, extents);
+}
+
+// collects the renderable objects and keeps the ones whose world bounds touch the view frustum.
+void GameEngine::_CullObjects()
+{
+	_cullCandidates.clear();
+	_cullBounds.Clear();
+	_visibleObjects.clear();
+
+	for (int i = 0; i < _enemyObjects.size(); i++)
 	{
-		return false;
+		if (_enemyObjects[i]->ShouldRender())
+			_AddCullCandidate(_enemyObjects[i]);
 	}
-	
-	auto dist = _playerObject->collider->GetDistance(object->collider);
 
-	if (dist.x > MAX_RENDER_DISTANCE || dist.y > MAX_RENDER_DISTANCE || dist.z > MAX_RENDER_DISTANCE
-		|| dist.x < -MAX_RENDER_DISTANCE || dist.y < -MAX_RENDER_DISTANCE || dist.z < - MAX_RENDER_DISTANCE)
+	_AddCullCandidate(_playerObject);
+
+	for (int i = 0; i < _coinObjects.size(); i++)
 	{
-		return false;
+		if (_coinObjects[i]->ShouldRender())
+			_AddCullCandidate(_coinObjects[i]);
 	}
-	return true;
-}
 
-void GameEngine::_Render()
-{
+	_frustum.ExtractPlanes(_projectionMatrix * _viewMatrix);
 
-	for (int i = 0; i < _enemyObjects.size(); i++)
+	_cullResults.resize(_cullCandidates.size());
+	_frustum.Cull(_cullBounds, _cullResults.data());
+
+	_cullScreenSizes.resize(_cullCandidates.size());
+	for (int i = 0; i < _cullCandidates.size(); i++)
+	{
+		_cullScreenSizes[i] = _cullResults[i] ? _ScreenSize(i) : 0.0f;
+	}
+
+	if (OCCLUSION_CULLING)
+		_CullOccluded();
+
+	for (int i = 0; i < _cullCandidates.size(); i++)
 	{
-		if (_IsRenderable(_enemyObjects[i]))
+		if (_cullResults[i])
 		{
-			_enemyObjects[i]->Draw(KEY_SHADER_OBJECT);
+			_cullCandidates[i]->model->SelectLod(_cullScreenSizes[i]);
+			_visibleObjects.push_back(_cullCandidates[i]);
 		}
 	}
+}
 
-	_playerObject->Draw(KEY_SHADER_OBJECT);
+// draws the models that cover a large part of the screen into the software depth buffer on the worker threads
+// and drops the remaining candidates hidden behind them.
+void GameEngine::_CullOccluded()
+{
+	ThreadPool &pool = ThreadPool::Shared();
 
-	for (int i = 0; i < _coinObjects.size(); i++)
+	_occlusion.Begin(_projectionMatrix * _viewMatrix);
+	for (int i = 0; i < _cullCandidates.size(); i++)
 	{
-		if (_IsRenderable(_coinObjects[i]))
+		if (_cullResults[i] && _cullScreenSizes[i] >= OCCLUSION_OCCLUDER_SCREEN_SIZE)
 		{
-			_coinObjects[i]->Draw(KEY_SHADER_OBJECT);
+			Model *model = _cullCandidates[i]->model;
+			_occlusion.AddOccluder(model->meshes, OCCLUSION_OCCLUDER_LOD, model->GetModelMatrix());
 		}
 	}
+	_occlusion.Rasterize(pool);
+	_occlusion.Cull(_cullBounds, _cullResults.data(), pool);
+
+	// rounding in the software rasterizer must not let an occluder hide itself, occluders are always drawn
+	for (int i = 0; i < _cullCandidates.size(); i++)
+	{
+		if (_cullScreenSizes[i] >= OCCLUSION_OCCLUDER_SCREEN_SIZE)
+			_cullResults[i] = 1;
+	}
 }
 
-void GameEngine::_UpdateScreenPanel()
+// estimates the fraction of the screen height covered by the bounding sphere of a cull candidate.
+float GameEngine::_ScreenSize(size_t boundsIndex)
 {
-	if (_frameCounter < 1000 && TOTAL_LIVES != 0)
+	glm::vec3 center(_cullBounds.centerX[boundsIndex], _cullBounds.centerY[boundsIndex], _cullBounds.centerZ[boundsIndex]);
+	glm::vec3 extents(_cullBounds.extentX[boundsIndex], _cullBounds.extentY[boundsIndex], _cullBounds.extentZ[boundsIndex]);
+
+	float radius = glm::length(extents);
+	float distance = glm::distance(camera.getPosition(), center);
+
+	float screen_size = 1.0f;
+	if (distance > radius)
 	{
-		// view/projection transformations
-		glm::mat4 ortogonal_projection_matrix = glm::orthoLH(-10, 10, -10, 10, -10, 10);
+		screen_size = radius / (distance * std::tan(glm::radians(camera.getZoom()) * 0.5f));
+	}
+	return screen_size;
+}
 
-		ResourceManager::GetShader(KEY_SHADER_OBJECT).setMat4("projection", glm::mat4x4(1));
-		ResourceManager::GetShader(KEY_SHADER_OBJECT).setMat4("view", glm::mat4x4(1));
+void GameEngine::_Render()
+{
+	_CullObjects();
 
-		glDepthFunc(GL_ALWAYS);
+	// loads & evictions follow what was just found visible, the objects switch models before they are queued
+	AssetStreamer::Update(_playerObject->GetPosition(), _visibleObjects);
 
-		for (float i = 0; i < TOTAL_LIVES; i++) {
-			ResourceManager::GetShader(KEY_SHADER_OBJECT).setMat4("model", { 1.0f,0.0f,0.0f,0.0f,//x
-																			 0.0f,1.0f,0.0f,0.0f,//y
-																			 0.0f,0.0f,0.0f,0.0f,//z
-																			 -7.50f,7.50f - i,0.0f,8.0f });
-			_screenPanelHP->Update(_deltaTime);
-			_screenPanelHP->Draw(ResourceManager::GetShader(KEY_SHADER_OBJECT));
-		}
+	_renderQueue.Begin(camera.getPosition());
+	for (int i = 0; i < _visibleObjects.size(); i++)
+	{
+		_renderQueue.Submit(*_visibleObjects[i]->model);
+	}
+
+	// the prepass trades a cheap extra geometry pass for shading every covered pixel only once
+	if (_depthPrepass)
+	{
+		Shader depth_shader = ResourceManager::GetShader(KEY_SHADER_DEPTH);
+		_renderQueue.Flush(ResourceManager::GetShader(KEY_SHADER_OBJECT), &depth_shader);
+	}
+	else
+	{
+		_renderQueue.Flush(ResourceManager::GetShader(KEY_SHADER_OBJECT));
+	}
+}
+
+void GameEngine::_UpdateScreenPanel()
+{
+	if (_frameCounter < 1000 && TOTAL_LIVES != 0)
+	{
+		GLStateCache::DepthFunc(GL_ALWAYS);
+
+		// panels are placed in clip space, the hud shader does not read the camera block.
+		// the icons are only rebuilt when one of the values changed, then drawn at once
+		_hud.Update(TOTAL_LIVES, TOTAL_SCORE, VAR_HUNGER);
+		_hud.Draw(ResourceManager::GetShader(KEY_SHADER_HUD));
 
-		int tmp_score = TOTAL_SCORE;
-		for (int i = 0; 5 <= tmp_score; i++, tmp_score -= 5)
-		{
-			ResourceManager::GetShader(KEY_SHADER_OBJECT).setMat4("model", { 1.0f,0.0f,0.0f,0.0f,//x
-																			 0.0f,1.0f,0.0f,0.0f,//y
-																			 0.0f,0.0f,0.0f,0.0f,//z
-																			 6.0f - i,6.10f ,0.0f,6.5f });
-			_screenPanelScore->Update(_deltaTime);
-			_screenPanelScore->Draw(ResourceManager::GetShader(KEY_SHADER_OBJECT));
-		}
-		for (int j = 0; 0 < tmp_score; j++, tmp_score--)
-		{
-			ResourceManager::GetShader(KEY_SHADER_OBJECT).setMat4("model", { 1.0f,0.0f,0.0f,0.0f,//x
-																			 0.0f,1.0f,0.0f,0.0f,//y
-																			 0.0f,0.0f,0.0f,0.0f,//z
-																			 7.50f - j,6.40f ,0.0f,8.0f });
-			_screenPanelScore->Update(_deltaTime);
-			_screenPanelScore->Draw(ResourceManager::GetShader(KEY_SHADER_OBJECT));
-		}
 		if (VAR_HUNGER < 10) {
-			ResourceManager::GetShader(KEY_SHADER_OBJECT).setMat4("model", { 10 - VAR_HUNGER,0.0f,0.0f,0.0f,//x
-																			 0.0f,0.5f,0.0f,0.0f,//y
-																			 0.0f,0.0f,0.0f,0.0f,//z
-																			 0.0f,-7.50f,0.0f,8.0f });
 			VAR_HUNGER += (0.000001*SCR_WIDTH);
-			_screenPanelHunger->Update(_deltaTime);
-			_screenPanelHunger->Draw(ResourceManager::GetShader(KEY_SHADER_OBJECT));
 		}
 		else if (TOTAL_LIVES > 0)
 		{
@@ -488,18 +655,14 @@ void GameEngine::_UpdateScreenPanel()
 
 void GameEngine::_UpdateSkybox()
 {
-	glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-	ResourceManager::GetShader(KEY_SHADER_SKYBOX).use();
-	_viewMatrix = glm::mat4(glm::mat3(camera.GetViewMatrix())); // remove translation from the view matrix
-	ResourceManager::GetShader(KEY_SHADER_SKYBOX).setMat4("view", _viewMatrix);
-	ResourceManager::GetShader(KEY_SHADER_SKYBOX).setMat4("projection", _projectionMatrix);
+	GLStateCache::DepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
+	ResourceManager::GetShader(KEY_SHADER_SKYBOX).use(); // the skybox shader strips the translation from the camera block's view matrix
 	// skybox cube
-	glBindVertexArray(_skyboxVAO);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, _skyboxTextureID);
-	glDrawArrays(GL_TRIANGLES, 0, 36);
-	glBindVertexArray(0);
-	glDepthFunc(GL_LESS); // set depth function back to default
+	GLStateCache::BindVertexArray(_skyboxVAO);
+	GLStateCache::ActiveTexture(GL_TEXTURE0);
+	GLStateCache::BindTexture(GL_TEXTURE_CUBE_MAP, _skyboxTextureID);
+	GLStateCache::DrawArrays(GL_TRIANGLES, 0, 36);
+	GLStateCache::DepthFunc(GL_LESS); // set depth function back to default
 }
 
 void GameEngine::_DoBoundryCollusionWith(std::vector<GameObject*> objectList)
@@ -569,72 +732,80 @@ void GameEngine::_DoCollusion()
 
 void GameEngine::_ProcessInput()
 {
-	if (glfwGetKey(_window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+	if (_device->IsKeyPressed(GLFW_KEY_ESCAPE))
 	{
-		glfwSetWindowShouldClose(_window, true);
+		_device->RequestClose();
 	}
-	if (glfwGetKey(_window, GLFW_KEY_W) == GLFW_PRESS)
+	if (_device->IsKeyPressed(GLFW_KEY_W))
 	{
 		_MovePlayer(Directions::FORWARD);
 	}
-	if (glfwGetKey(_window, GLFW_KEY_S) == GLFW_PRESS)
+	if (_device->IsKeyPressed(GLFW_KEY_S))
 	{
 		_MovePlayer(Directions::BACKWARD);
 	}
-	if (glfwGetKey(_window, GLFW_KEY_D) == GLFW_PRESS)
+	if (_device->IsKeyPressed(GLFW_KEY_D))
 	{
 		_MovePlayer(Directions::RIGHT);
 	}
-	if (glfwGetKey(_window, GLFW_KEY_A) == GLFW_PRESS)
+	if (_device->IsKeyPressed(GLFW_KEY_A))
 	{
 		_MovePlayer(Directions::LEFT);
 	}
-	if (glfwGetKey(_window, GLFW_KEY_SPACE) == GLFW_PRESS)
+	if (_device->IsKeyPressed(GLFW_KEY_SPACE))
 	{
 		_MovePlayer(Directions::UP);
 	}
-	if (glfwGetKey(_window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS)
+	if (_device->IsKeyPressed(GLFW_KEY_LEFT_CONTROL))
 	{
 		_MovePlayer(Directions::DOWN);
 	}
-	if (glfwGetKey(_window, GLFW_KEY_G) == GLFW_PRESS)
+	if (_device->IsKeyPressed(GLFW_KEY_G))
 	{
 		_isDebugMode = true;
 	}
-	if (glfwGetKey(_window, GLFW_KEY_H) == GLFW_PRESS)
+	if (_device->IsKeyPressed(GLFW_KEY_H))
 	{
 		_isDebugMode = false;
 	}
-	if (glfwGetKey(_window, GLFW_KEY_I) == GLFW_PRESS)
+	if (_device->IsKeyPressed(GLFW_KEY_J))
+	{
+		_depthPrepass = true;
+	}
+	if (_device->IsKeyPressed(GLFW_KEY_K))
+	{
+		_depthPrepass = false;
+	}
+	if (_device->IsKeyPressed(GLFW_KEY_I))
 	{
 		_debugPrinter = true;
 	}
-	if (glfwGetKey(_window, GLFW_KEY_UP) == GLFW_PRESS)
+	if (_device->IsKeyPressed(GLFW_KEY_UP))
 	{
 		_playerObject->AccelerateTowards(Directions::FORWARD);
 	}
-	if (glfwGetKey(_window, GLFW_KEY_DOWN) == GLFW_PRESS)
+	if (_device->IsKeyPressed(GLFW_KEY_DOWN))
 	{
 		_playerObject->AccelerateTowards(Directions::BACKWARD);
 	}
-	if (glfwGetKey(_window, GLFW_KEY_RIGHT) == GLFW_PRESS)
+	if (_device->IsKeyPressed(GLFW_KEY_RIGHT))
 	{
 		_playerObject->AccelerateTowards(Directions::RIGHT);
 	}
-	if (glfwGetKey(_window, GLFW_KEY_LEFT) == GLFW_PRESS)
+	if (_device->IsKeyPressed(GLFW_KEY_LEFT))
 	{
 		_playerObject->AccelerateTowards(Directions::LEFT);
 	}
-	if (glfwGetKey(_window, GLFW_KEY_PAGE_DOWN) == GLFW_PRESS)
+	if (_device->IsKeyPressed(GLFW_KEY_PAGE_DOWN))
 	{
 		_playerObject->AccelerateTowards(Directions::DOWN);
 	}
-	if (glfwGetKey(_window, GLFW_KEY_PAGE_UP) == GLFW_PRESS)
+	if (_device->IsKeyPressed(GLFW_KEY_PAGE_UP))
 	{
 		_playerObject->AccelerateTowards(Directions::UP);
 	}
 
-	if (glfwGetKey(_window, GLFW_KEY_P) == GLFW_PRESS)
+	if (_device->IsKeyPressed(GLFW_KEY_P))
 	{
 		if (_debugPrinter)
 		{
@@ -642,7 +813,22 @@ void GameEngine::_ProcessInput()
 			_debugPrinter = false;
 		}
 	}
-	if (glfwGetKey(_window, GLFW_KEY_0) == GLFW_PRESS)
+	if (_device->IsKeyPressed(GLFW_KEY_O))
+	{
+		if (_debugPrinter)
+		{
+			GLStateCache::PrintCounters();
+			_renderQueue.PrintStats();
+			_occlusion.PrintStats();
+			TexturePacker::PrintStats();
+			TextureCache::PrintStats();
+			AssetStreamer::PrintStats();
+			std::cout << "Stream Buffer: " << (_frameStream.IsPersistent() ? "persistent mapping" : "orphaning")
+				<< ", " << _frameStream.GetStallCount() << " stalled frames" << std::endl;
+			_debugPrinter = false;
+		}
+	}
+	if (_device->IsKeyPressed(GLFW_KEY_0))
 	{
 		// Clear the console.
 		std::cout << "\x1B[2J\x1B[H";
@@ -658,46 +844,33 @@ void GameEngine::_MovePlayer(Directions dir)
 
 void GameEngine::_InitGameWindow()
 {
-	// glfw: initialize and configure
-	// ------------------------------
-	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-#ifdef __APPLE__
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // uncomment this statement to fix compilation on OS X
-#endif
-
-	// glfw window creation
-	// --------------------
-	this->_window = glfwCreateWindow(_windowSize[0], _windowSize[1], WINDOW_TITLE.c_str(), NULL, NULL);
-	if (_window == NULL)
+	// window, context & GL entry points come from the device
+	// --------------------------------------------------------
+	if (!_device->Create(WINDOW_TITLE.c_str(), _windowSize[0], _windowSize[1]))
 	{
-		std::cout << "Failed to create GLFW window" << std::endl;
-		glfwTerminate();
+		_device->Destroy();
 		exit(-1);
 	}
+	_device->SetCallbacks(_FramebufferSizeCallback, _MouseCallback, _ScrollCallback);
 
-	glfwMakeContextCurrent(_window);
-	glfwSetFramebufferSizeCallback(_window, _FramebufferSizeCallback);
-	glfwSetCursorPosCallback(_window, _MouseCallback);
-	glfwSetScrollCallback(_window, _ScrollCallback);
-
-	// tell GLFW to capture our mouse
-	glfwSetInputMode(_window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-	// glad: load all OpenGL function pointers
-	// ---------------------------------------
-	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-	{
-		std::cout << "Failed to initialize GLAD" << std::endl;
-		exit(-1);
-	}
+	// the state cache starts without any knowledge of the new context
+	GLStateCache::Invalidate();
 
 	// configure global opengl state
 	// -----------------------------
 	glEnable(GL_DEPTH_TEST);
+
+	GLExtensions::Load(_device);
+	_frameStream.Create(STREAM_FRAME_BYTES);
+	TextureLoader::Init();
+
+	// per frame camera constants, streamed to the binding point every loaded shader uses
+	_cameraBuffer.Create(sizeof(CameraBlock), UNIFORM_BINDING_CAMERA, &_frameStream);
+
+	// every mesh loaded from now on is placed in the shared geometry buffers
+	MeshPool::Init(MESH_POOL_VERTICES, MESH_POOL_INDICES);
+	_renderQueue.Init(&_frameStream);
+	_occlusion.Init(OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT);
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -16,13 +16,15 @@ public:
 	Collider *collider;
 
 	GameObject(const std::string &path, ObjectType objectType);
+	// takes a model loaded before, see ModelLoader
+	GameObject(Model *objectModel, ObjectType objectType);
 	~GameObject();
 
 	void Update(const float & delta_time);
 
 	void Draw(Shader shader);
 
-	void Draw(std::string shader_key);
+	void Draw(ResourceId shader_key);
 
 	void ScaleObject(glm::vec3 scale);
 
@@ -76,10 +78,15 @@ private:
 };
 
 GameObject::GameObject(const std::string &path, ObjectType objectType) 
+	: GameObject(new Model(path), objectType)
+{
+}
+
+GameObject::GameObject(Model *objectModel, ObjectType objectType)
 	: _objectType(objectType), _ID(rand() % 1000), _scaleFactor(1.0f), _renderOn(true)
 {
 	std::cout << "\n~~~~~~~~~ ID : "<< _ID <<"~~~~~~~~~~~~~~ Type:"<< objectType <<"~~~~~~~~~~~~~~~~\n";
-	model = new Model(path);
+	model = objectModel;
 	std::cout << "Model Matrix \n";
 	model->PrintModel();
 	std::cout << "Model inital values:\n";
@@ -137,10 +144,8 @@ void GameObject::Draw(Shader shader)
 	}
 }
 
-void GameObject::Draw(std::string shader_key)
+void GameObject::Draw(ResourceId shader_key)
 {
-	ResourceManager::GetShader(shader_key).setMat4("model", model->GetModelMatrix());
-
 	Draw(ResourceManager::GetShader(shader_key));
 }
 
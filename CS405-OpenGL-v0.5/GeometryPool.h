@@ -0,0 +1,324 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include "Include/glad/glad.h"
+
+#include <iostream>
+#include <cstddef>
+#include <vector>
+
+#include "GLStateCache.h"
+
+// First attribute location of the per instance model matrix (a mat4 takes four locations).
+const GLuint INSTANCE_MATRIX_LOCATION = 5;
+// Location of the per instance material index, right after the matrix.
+const GLuint INSTANCE_MATERIAL_LOCATION = 9;
+
+// Where a mesh lives inside the shared buffers.
+struct GeometryAllocation {
+	GLint baseVertex;
+	// in elements of indexType
+	GLuint firstIndex;
+	GLuint vertexCount;
+	GLuint indexCount;
+	// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	GLenum indexType;
+};
+
+// bytes of one index of the given type
+inline size_t IndexTypeSize(GLenum indexType)
+{
+	return indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+// GeometryPool sub-allocates the geometry of every static mesh from one large vertex buffer and one
+// large index buffer, described by a single vertex array. Draws only differ in their base vertex and
+// first index, so switching meshes never rebinds a vertex array.
+// Indices are relative to the base vertex and may be 16 or 32 bit per mesh, each allocation is aligned
+// to its own index size so it can be addressed in elements of its type.
+// Freed ranges go to a free list per buffer (neighbours merged) and are reused first fit, a range at the
+// end of the used part lowers it instead.
+// Positions are also kept in a second, position only stream with its own vertex array sharing the
+// index buffer, so depth only passes fetch a fraction of the vertex data.
+// VertexType has to provide a static SetupAttributes() that describes its layout for the bound buffer,
+// a PositionType with the same for the position stream, and a static GetPosition(const VertexType&).
+template <typename VertexType>
+class GeometryPool {
+public:
+	// Creates the buffers, needs a current context. indexCapacity is counted in 32 bit indices.
+	static void Init(size_t vertexCapacity, size_t indexCapacity);
+
+	// Copies a mesh into the pool, growing the buffers when needed.
+	// indices holds indexCount elements of indexType (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT).
+	static GeometryAllocation Allocate(const VertexType *vertices, size_t vertexCount, const void *indices, size_t indexCount, GLenum indexType);
+
+	// Gives the ranges of a mesh back, nothing may draw it afterwards.
+	static void Free(const GeometryAllocation &allocation);
+
+	static GLuint GetVertexArray() { return _vertexArray; }
+	// same draws, positions only
+	static GLuint GetPositionArray() { return _positionArray; }
+	static GLuint GetVertexBuffer() { return _vertexBuffer; }
+	static GLuint GetIndexBuffer() { return _indexBuffer; }
+
+	static size_t GetVertexCount() { return _vertexCount; }
+	static size_t GetIndexBytes() { return _indexBytes; }
+
+	static void Clear();
+
+private:
+	GeometryPool() { }
+
+	/*  Buffers  */
+	static GLuint _vertexArray;
+	static GLuint _vertexBuffer;
+	static GLuint _indexBuffer;
+	static GLuint _positionArray;
+	static GLuint _positionBuffer;
+
+	/*  Usage, vertices in elements and indices in bytes  */
+	static size_t _vertexCapacity;
+	static size_t _vertexCount;
+	static size_t _indexByteCapacity;
+	static size_t _indexBytes;
+
+	/*  Freed Ranges, sorted by offset  */
+	struct _Range {
+		size_t offset;
+		size_t size;
+	};
+	static std::vector<_Range> _freeVertices;
+	static std::vector<_Range> _freeIndexBytes;
+
+	// takes size units aligned to alignment from the free list, false when no range fits
+	static bool _TakeRange(std::vector<_Range> &ranges, size_t size, size_t alignment, size_t &offset);
+	// puts a range back, merging it with its neighbours or with the end of the used part
+	static void _ReturnRange(std::vector<_Range> &ranges, size_t offset, size_t size, size_t &used);
+
+	static void _Grow(GLenum target, GLuint &buffer, size_t usedBytes, size_t newBytes);
+};
+
+// Instantiate static variables
+template <typename VertexType> GLuint GeometryPool<VertexType>::_vertexArray = 0;
+template <typename VertexType> GLuint GeometryPool<VertexType>::_vertexBuffer = 0;
+template <typename VertexType> GLuint GeometryPool<VertexType>::_indexBuffer = 0;
+template <typename VertexType> GLuint GeometryPool<VertexType>::_positionArray = 0;
+template <typename VertexType> GLuint GeometryPool<VertexType>::_positionBuffer = 0;
+template <typename VertexType> size_t GeometryPool<VertexType>::_vertexCapacity = 0;
+template <typename VertexType> size_t GeometryPool<VertexType>::_vertexCount = 0;
+template <typename VertexType> size_t GeometryPool<VertexType>::_indexByteCapacity = 0;
+template <typename VertexType> size_t GeometryPool<VertexType>::_indexBytes = 0;
+template <typename VertexType> std::vector<typename GeometryPool<VertexType>::_Range> GeometryPool<VertexType>::_freeVertices;
+template <typename VertexType> std::vector<typename GeometryPool<VertexType>::_Range> GeometryPool<VertexType>::_freeIndexBytes;
+
+template <typename VertexType>
+void GeometryPool<VertexType>::Init(size_t vertexCapacity, size_t indexCapacity)
+{
+	_vertexCapacity = vertexCapacity;
+	_indexByteCapacity = indexCapacity * sizeof(GLuint);
+	_vertexCount = 0;
+	_indexBytes = 0;
+
+	glGenVertexArrays(1, &_vertexArray);
+	glGenBuffers(1, &_vertexBuffer);
+	glGenBuffers(1, &_indexBuffer);
+
+	GLStateCache::BindVertexArray(_vertexArray);
+
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, _vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, _vertexCapacity * sizeof(VertexType), NULL, GL_STATIC_DRAW);
+	VertexType::SetupAttributes();
+
+	GLStateCache::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, _indexByteCapacity, NULL, GL_STATIC_DRAW);
+
+	glGenVertexArrays(1, &_positionArray);
+	glGenBuffers(1, &_positionBuffer);
+
+	GLStateCache::BindVertexArray(_positionArray);
+
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, _positionBuffer);
+	glBufferData(GL_ARRAY_BUFFER, _vertexCapacity * sizeof(typename VertexType::PositionType), NULL, GL_STATIC_DRAW);
+	VertexType::PositionType::SetupAttributes();
+	GLStateCache::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer);
+}
+
+template <typename VertexType>
+GeometryAllocation GeometryPool<VertexType>::Allocate(const VertexType *vertices, size_t vertexCount, const void *indices, size_t indexCount, GLenum indexType)
+{
+	size_t index_size = IndexTypeSize(indexType);
+	size_t index_bytes = indexCount * index_size;
+
+	// freed ranges first, then the end of the used part
+	size_t vertex_start;
+	bool reused_vertices = _TakeRange(_freeVertices, vertexCount, 1, vertex_start);
+	if (!reused_vertices)
+		vertex_start = _vertexCount;
+	size_t index_offset;
+	bool reused_indices = _TakeRange(_freeIndexBytes, index_bytes, index_size, index_offset);
+	if (!reused_indices)
+		index_offset = (_indexBytes + index_size - 1) / index_size * index_size;
+
+	if (!reused_vertices && _vertexCount + vertexCount > _vertexCapacity)
+	{
+		size_t capacity = _vertexCapacity * 2;
+		while (capacity < _vertexCount + vertexCount)
+			capacity *= 2;
+		_Grow(GL_ARRAY_BUFFER, _vertexBuffer, _vertexCount * sizeof(VertexType), capacity * sizeof(VertexType));
+		_Grow(GL_ARRAY_BUFFER, _positionBuffer, _vertexCount * sizeof(typename VertexType::PositionType),
+			capacity * sizeof(typename VertexType::PositionType));
+		_vertexCapacity = capacity;
+
+		// the vertex arrays still point at the old buffers
+		GLStateCache::BindVertexArray(_vertexArray);
+		GLStateCache::BindBuffer(GL_ARRAY_BUFFER, _vertexBuffer);
+		VertexType::SetupAttributes();
+
+		GLStateCache::BindVertexArray(_positionArray);
+		GLStateCache::BindBuffer(GL_ARRAY_BUFFER, _positionBuffer);
+		VertexType::PositionType::SetupAttributes();
+	}
+	if (!reused_indices && index_offset + index_bytes > _indexByteCapacity)
+	{
+		size_t capacity = _indexByteCapacity * 2;
+		while (capacity < index_offset + index_bytes)
+			capacity *= 2;
+		_Grow(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer, _indexBytes, capacity);
+		_indexByteCapacity = capacity;
+
+		GLStateCache::BindVertexArray(_vertexArray);
+		GLStateCache::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer);
+		GLStateCache::BindVertexArray(_positionArray);
+		GLStateCache::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer);
+	}
+
+	GeometryAllocation allocation;
+	allocation.baseVertex = (GLint)vertex_start;
+	allocation.firstIndex = (GLuint)(index_offset / index_size);
+	allocation.vertexCount = (GLuint)vertexCount;
+	allocation.indexCount = (GLuint)indexCount;
+	allocation.indexType = indexType;
+
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, _vertexBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER, vertex_start * sizeof(VertexType), vertexCount * sizeof(VertexType), vertices);
+
+	std::vector<typename VertexType::PositionType> positions(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+		positions[i] = VertexType::GetPosition(vertices[i]);
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, _positionBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER, vertex_start * sizeof(typename VertexType::PositionType),
+		vertexCount * sizeof(typename VertexType::PositionType), positions.data());
+
+	// the element array binding belongs to the vertex array, so upload through the pool's own
+	GLStateCache::BindVertexArray(_vertexArray);
+	GLStateCache::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer);
+	glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, index_offset, index_bytes, indices);
+
+	if (!reused_vertices)
+		_vertexCount += vertexCount;
+	if (!reused_indices)
+	{
+		// the alignment gap is free as well
+		size_t gap_start = _indexBytes;
+		_indexBytes = index_offset + index_bytes;
+		_ReturnRange(_freeIndexBytes, gap_start, index_offset - gap_start, _indexBytes);
+	}
+
+	return allocation;
+}
+
+template <typename VertexType>
+void GeometryPool<VertexType>::Free(const GeometryAllocation &allocation)
+{
+	size_t index_size = IndexTypeSize(allocation.indexType);
+	_ReturnRange(_freeVertices, (size_t)allocation.baseVertex, allocation.vertexCount, _vertexCount);
+	_ReturnRange(_freeIndexBytes, allocation.firstIndex * index_size, allocation.indexCount * index_size, _indexBytes);
+}
+
+template <typename VertexType>
+void GeometryPool<VertexType>::Clear()
+{
+	GLStateCache::DeleteVertexArrays(1, &_vertexArray);
+	GLStateCache::DeleteBuffers(1, &_vertexBuffer);
+	GLStateCache::DeleteBuffers(1, &_indexBuffer);
+	GLStateCache::DeleteVertexArrays(1, &_positionArray);
+	GLStateCache::DeleteBuffers(1, &_positionBuffer);
+	_vertexCount = _vertexCapacity = 0;
+	_indexBytes = _indexByteCapacity = 0;
+	_freeVertices.clear();
+	_freeIndexBytes.clear();
+}
+
+template <typename VertexType>
+bool GeometryPool<VertexType>::_TakeRange(std::vector<_Range> &ranges, size_t size, size_t alignment, size_t &offset)
+{
+	if (size == 0)
+		return false;
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		_Range range = ranges[i];
+		size_t start = (range.offset + alignment - 1) / alignment * alignment;
+		if (start + size > range.offset + range.size)
+			continue;
+
+		// what is left on either side stays free
+		ranges.erase(ranges.begin() + i);
+		if (start + size < range.offset + range.size)
+			ranges.insert(ranges.begin() + i, _Range{ start + size, range.offset + range.size - start - size });
+		if (start > range.offset)
+			ranges.insert(ranges.begin() + i, _Range{ range.offset, start - range.offset });
+		offset = start;
+		return true;
+	}
+	return false;
+}
+
+template <typename VertexType>
+void GeometryPool<VertexType>::_ReturnRange(std::vector<_Range> &ranges, size_t offset, size_t size, size_t &used)
+{
+	if (size == 0)
+		return;
+	size_t i = 0;
+	while (i < ranges.size() && ranges[i].offset < offset)
+		i++;
+	ranges.insert(ranges.begin() + i, _Range{ offset, size });
+
+	if (i + 1 < ranges.size() && ranges[i].offset + ranges[i].size == ranges[i + 1].offset)
+	{
+		ranges[i].size += ranges[i + 1].size;
+		ranges.erase(ranges.begin() + i + 1);
+	}
+	if (i > 0 && ranges[i - 1].offset + ranges[i - 1].size == ranges[i].offset)
+	{
+		ranges[i - 1].size += ranges[i].size;
+		ranges.erase(ranges.begin() + i);
+		i--;
+	}
+	// the last range reaching the end of the used part is not a gap anymore
+	if (ranges[i].offset + ranges[i].size == used && i + 1 == ranges.size())
+	{
+		used = ranges[i].offset;
+		ranges.pop_back();
+	}
+}
+
+// replaces buffer with a bigger one holding the same first usedBytes
+template <typename VertexType>
+void GeometryPool<VertexType>::_Grow(GLenum target, GLuint &buffer, size_t usedBytes, size_t newBytes)
+{
+	std::cout << "GeometryPool: growing " << (target == GL_ARRAY_BUFFER ? "vertex" : "index")
+		<< " buffer to " << newBytes / (1024 * 1024) << " MB" << std::endl;
+
+	GLuint bigger;
+	glGenBuffers(1, &bigger);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, bigger);
+	glBufferData(GL_COPY_WRITE_BUFFER, newBytes, NULL, GL_STATIC_DRAW);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+
+	GLStateCache::DeleteBuffers(1, &buffer);
+	buffer = bigger;
+}
+
+#endif
@@ -0,0 +1,233 @@
+#ifndef HOT_RELOAD_H
+#define HOT_RELOAD_H
+
+#include "Include/glad/glad.h"
+
+#include <string>
+#include <map>
+#include <algorithm>
+#include <iostream>
+#include <cctype>
+
+#if defined(__linux__)
+#define HOT_RELOAD_USE_INOTIFY
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+#include "ResourceManager.h"
+#include "TextureCache.h"
+#include "TexturePacker.h"
+#include "AssetStreamer.h"
+#include "StringTable.h"
+#include "values.h"
+
+// HotReload watches the Resource directory while the game runs and applies what changed between two frames:
+// a shader stage recompiles the programs using it, an image is read again into its packed layers (and the texture
+// of the file when one is loaded), a model or material library is read again by the AssetStreamer. Everything else keeps running, a change that
+// does not compile or load leaves the old resource in place.
+// Editors write a file in several steps, a file is applied once it was quiet for HOT_RELOAD_SETTLE_TIME.
+// The watcher uses inotify, elsewhere Init reports that hot reloading is not supported.
+class HotReload {
+public:
+	// Watches DIRECTORY_RESOURCE and everything below it, false when it can not.
+	static bool Init();
+
+	// Once per frame on the GL thread, writes the images read since the last frame. now is the frame time in seconds.
+	static void Update(double now);
+
+	static void Clear();
+
+private:
+	HotReload() { }
+
+	// changed files by path, with the time of their last change
+	static std::map<std::string, double> _changed;
+
+#ifdef HOT_RELOAD_USE_INOTIFY
+	static int _descriptor;
+	// the directory of every watch
+	static std::map<int, std::string> _directories;
+
+	static void _Watch(const std::string &directory);
+	static void _ReadEvents(double now);
+#endif
+
+	static void _Apply(const std::string &path);
+	static std::string _GetExtension(const std::string &path);
+	static bool _IsShader(const std::string &extension);
+	static bool _IsImage(const std::string &extension);
+	static bool _IsModel(const std::string &extension);
+};
+
+// Instantiate static variables
+std::map<std::string, double> HotReload::_changed;
+#ifdef HOT_RELOAD_USE_INOTIFY
+int HotReload::_descriptor = -1;
+std::map<int, std::string> HotReload::_directories;
+#endif
+
+bool HotReload::Init()
+{
+#ifdef HOT_RELOAD_USE_INOTIFY
+	Clear();
+	_descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (_descriptor < 0)
+	{
+		std::cout << "HotReload: inotify is not available" << std::endl;
+		return false;
+	}
+	_Watch(DIRECTORY_RESOURCE);
+	if (_directories.empty())
+	{
+		Clear();
+		return false;
+	}
+	std::cout << "HotReload: watching " << _directories.size() << " directories in " << DIRECTORY_RESOURCE << std::endl;
+	return true;
+#else
+	std::cout << "HotReload: not supported on this platform" << std::endl;
+	return false;
+#endif
+}
+
+void HotReload::Update(double now)
+{
+#ifdef HOT_RELOAD_USE_INOTIFY
+	if (_descriptor >= 0)
+		_ReadEvents(now);
+#endif
+
+	for (std::map<std::string, double>::iterator it = _changed.begin(); it != _changed.end();)
+	{
+		if (now - it->second < HOT_RELOAD_SETTLE_TIME)
+		{
+			++it;
+			continue;
+		}
+		_Apply(it->first);
+		it = _changed.erase(it);
+	}
+	TexturePacker::Update();
+}
+
+void HotReload::Clear()
+{
+	_changed.clear();
+#ifdef HOT_RELOAD_USE_INOTIFY
+	if (_descriptor >= 0)
+		close(_descriptor);
+	_descriptor = -1;
+	_directories.clear();
+#endif
+}
+
+#ifdef HOT_RELOAD_USE_INOTIFY
+// inotify watches one directory, every directory below gets its own watch
+void HotReload::_Watch(const std::string &directory)
+{
+	int watch = inotify_add_watch(_descriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+	if (watch < 0)
+		return;
+	_directories[watch] = directory;
+
+	DIR *entries = opendir(directory.c_str());
+	if (entries == NULL)
+		return;
+	while (struct dirent *entry = readdir(entries))
+	{
+		std::string name = entry->d_name;
+		if (name == "." || name == "..")
+			continue;
+		std::string path = directory + "/" + name;
+		// links are not followed, one to a directory above would be watched without end
+		struct stat info;
+		if (lstat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode))
+			_Watch(path);
+	}
+	closedir(entries);
+}
+
+void HotReload::_ReadEvents(double now)
+{
+	// aligned for the events read into it
+	alignas(struct inotify_event) char buffer[4096];
+	for (;;)
+	{
+		ssize_t length = read(_descriptor, buffer, sizeof(buffer));
+		if (length <= 0)
+			return;
+		for (ssize_t offset = 0; offset < length;)
+		{
+			const struct inotify_event *event = (const struct inotify_event*)(buffer + offset);
+			offset += sizeof(struct inotify_event) + event->len;
+			std::map<int, std::string>::const_iterator directory = _directories.find(event->wd);
+			if (event->len == 0 || directory == _directories.end())
+				continue;
+
+			std::string path = directory->second + "/" + event->name;
+			if (event->mask & IN_ISDIR)
+			{
+				// a directory created (or moved in) later, its files show up from now on
+				if (event->mask & (IN_CREATE | IN_MOVED_TO))
+					_Watch(path);
+			}
+			else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+			{
+				_changed[path] = now;
+			}
+		}
+	}
+}
+#endif
+
+void HotReload::_Apply(const std::string &path)
+{
+	std::string extension = _GetExtension(path);
+	unsigned int users = 0;
+	if (_IsShader(extension))
+	{
+		users = ResourceManager::ReloadShaders(path);
+	}
+	else if (_IsImage(extension))
+	{
+		users = TextureCache::Reload(path) ? 1 : 0;
+		users += TexturePacker::Reload(path);
+	}
+	else if (_IsModel(extension) || extension == ".mtl")
+	{
+		users = AssetStreamer::Reload(path);
+	}
+
+	if (users != 0)
+		std::cout << "HotReload: " << path << " changed" << std::endl;
+}
+
+std::string HotReload::_GetExtension(const std::string &path)
+{
+	size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos || path.find('/', dot) != std::string::npos)
+		return "";
+	std::string extension = path.substr(dot);
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	return extension;
+}
+
+bool HotReload::_IsShader(const std::string &extension)
+{
+	return extension == ".vs" || extension == ".fs" || extension == ".gs";
+}
+
+bool HotReload::_IsImage(const std::string &extension)
+{
+	return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp";
+}
+
+bool HotReload::_IsModel(const std::string &extension)
+{
+	return extension == ".obj" || extension == ".fbx" || extension == ".dae" || extension == ".3ds";
+}
+
+#endif
@@ -0,0 +1,340 @@
+#ifndef HUD_BATCH_H
+#define HUD_BATCH_H
+
+#include "Include/glad/glad.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+
+#include "GLStateCache.h"
+#include "TextureCache.h"
+#include "TextureLoader.h"
+#include "shader.h"
+#include "model.h"
+#include "values.h"
+
+// One corner of a HUD triangle, already placed in clip space.
+struct HudVertex {
+	glm::vec4 Position;
+	glm::vec2 TexCoords;
+};
+
+// HudBatch draws every on screen icon (lives, score and the hunger bar) with a single draw call.
+// The diffuse textures of the panel models are copied into one atlas at Init, and the triangles of
+// all visible icons are kept in one vertex buffer that is only rebuilt when a displayed value changes.
+class HudBatch {
+public:
+	HudBatch() : _vertexArray(0), _vertexBuffer(0), _atlas(0), _bufferCapacity(0), _lives(-1), _score(-1), _hungerStep(-1) {}
+
+	// Builds the atlas and the icon templates from the panel models, needs a current context.
+	void Init(Model &lives, Model &score, Model &hunger);
+
+	// Rebuilds the quad list when one of the values differs from the last call.
+	void Update(int lives, int score, float hunger);
+
+	void Draw(Shader shader);
+
+	void Delete();
+
+private:
+	enum HudIcon { HUD_ICON_LIFE, HUD_ICON_SCORE, HUD_ICON_HUNGER, HUD_ICON_COUNT };
+
+	// where a source texture ended up in the atlas, in texels
+	struct AtlasRegion {
+		GLuint texture;
+		int x, y, width, height;
+	};
+
+	/*  GL Objects  */
+	GLuint _vertexArray;
+	GLuint _vertexBuffer;
+	GLuint _atlas;
+	size_t _bufferCapacity;
+
+	/*  Icon Geometry  */
+	// model space triangles with atlas coordinates, placed per icon on rebuild
+	std::vector<HudVertex> _icons[HUD_ICON_COUNT];
+	std::vector<HudVertex> _vertices;
+
+	/*  Displayed Values  */
+	int _lives;
+	int _score;
+	int _hungerStep;
+
+	void _BuildAtlas(Model *models[HUD_ICON_COUNT]);
+	void _AddIcon(HudIcon icon, const glm::mat4 &placement);
+	void _Rebuild(int lives, int score, float hunger);
+
+	static std::string _DiffusePath(const Mesh &mesh);
+	static bool _ReadTexture(GLuint texture, std::vector<unsigned char> &pixels, int &width, int &height);
+};
+
+void HudBatch::Init(Model &lives, Model &score, Model &hunger)
+{
+	Model *models[HUD_ICON_COUNT] = { &lives, &score, &hunger };
+	_BuildAtlas(models);
+
+	glGenVertexArrays(1, &_vertexArray);
+	glGenBuffers(1, &_vertexBuffer);
+
+	GLStateCache::BindVertexArray(_vertexArray);
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, _vertexBuffer);
+	// clip space position
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (void*)offsetof(HudVertex, Position));
+	// atlas coordinates
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (void*)offsetof(HudVertex, TexCoords));
+}
+
+void HudBatch::Update(int lives, int score, float hunger)
+{
+	int hunger_step = (int)(hunger * HUD_HUNGER_STEPS / 10.0f);
+	if (lives == _lives && score == _score && hunger_step == _hungerStep)
+		return;
+
+	_lives = lives;
+	_score = score;
+	_hungerStep = hunger_step;
+	_Rebuild(lives, score, hunger_step * 10.0f / HUD_HUNGER_STEPS);
+}
+
+void HudBatch::Draw(Shader shader)
+{
+	if (_vertices.empty())
+		return;
+
+	shader.use();
+	shader.setInt("texture_diffuse1", 0);
+	GLStateCache::ActiveTexture(GL_TEXTURE0);
+	GLStateCache::BindTexture(GL_TEXTURE_2D, _atlas);
+	GLStateCache::BindVertexArray(_vertexArray);
+	GLStateCache::DrawArrays(GL_TRIANGLES, 0, (GLsizei)_vertices.size());
+}
+
+void HudBatch::Delete()
+{
+	GLStateCache::DeleteVertexArrays(1, &_vertexArray);
+	GLStateCache::DeleteBuffers(1, &_vertexBuffer);
+	GLStateCache::DeleteTextures(1, &_atlas);
+}
+
+// the placements match the clip space layout the panels always had, w scales the icons down
+void HudBatch::_Rebuild(int lives, int score, float hunger)
+{
+	_vertices.clear();
+
+	for (int i = 0; i < lives; i++)
+	{
+		_AddIcon(HUD_ICON_LIFE, glm::mat4(1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 0.0f,
+			-7.50f, 7.50f - i, 0.0f, 8.0f));
+	}
+
+	// a big icon per five points, a small one for each point left
+	int i = 0;
+	for (; 5 <= score; i++, score -= 5)
+	{
+		_AddIcon(HUD_ICON_SCORE, glm::mat4(1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 0.0f,
+			6.0f - i, 6.10f, 0.0f, 6.5f));
+	}
+	for (int j = 0; 0 < score; j++, score--)
+	{
+		_AddIcon(HUD_ICON_SCORE, glm::mat4(1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 0.0f,
+			7.50f - j, 6.40f, 0.0f, 8.0f));
+	}
+
+	if (hunger < 10.0f)
+	{
+		_AddIcon(HUD_ICON_HUNGER, glm::mat4(10.0f - hunger, 0.0f, 0.0f, 0.0f,
+			0.0f, 0.5f, 0.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, -7.50f, 0.0f, 8.0f));
+	}
+
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, _vertexBuffer);
+	if (_vertices.size() > _bufferCapacity)
+	{
+		_bufferCapacity = std::max(_vertices.size(), _bufferCapacity * 2);
+		glBufferData(GL_ARRAY_BUFFER, _bufferCapacity * sizeof(HudVertex), NULL, GL_DYNAMIC_DRAW);
+	}
+	if (!_vertices.empty())
+		glBufferSubData(GL_ARRAY_BUFFER, 0, _vertices.size() * sizeof(HudVertex), _vertices.data());
+}
+
+void HudBatch::_AddIcon(HudIcon icon, const glm::mat4 &placement)
+{
+	const std::vector<HudVertex> &source = _icons[icon];
+	for (unsigned int i = 0; i < source.size(); i++)
+	{
+		HudVertex vertex = { placement * source[i].Position, source[i].TexCoords };
+		_vertices.push_back(vertex);
+	}
+}
+
+void HudBatch::_BuildAtlas(Model *models[HUD_ICON_COUNT])
+{
+	// the first diffuse texture of every panel mesh, each only once. Models only name their textures, the
+	// hud loads them itself and gives them back once they are copied.
+	std::map<std::string, GLuint> textures;
+	for (int icon = 0; icon < HUD_ICON_COUNT; icon++)
+	{
+		for (unsigned int m = 0; m < models[icon]->meshes.size(); m++)
+		{
+			std::string path = _DiffusePath(models[icon]->meshes[m]);
+			if (!path.empty() && textures.count(path) == 0)
+				textures[path] = TextureCache::Acquire(path);
+		}
+	}
+	TextureLoader::Finish();
+
+	std::vector<AtlasRegion> regions;
+	std::vector<std::vector<unsigned char> > images;
+	std::vector<std::vector<int> > mesh_regions(HUD_ICON_COUNT);
+	int atlas_width = 0;
+	int atlas_height = 1;
+
+	for (int icon = 0; icon < HUD_ICON_COUNT; icon++)
+	{
+		for (unsigned int m = 0; m < models[icon]->meshes.size(); m++)
+		{
+			std::string path = _DiffusePath(models[icon]->meshes[m]);
+			GLuint texture = path.empty() ? 0 : textures[path];
+
+			int found = -1;
+			for (unsigned int r = 0; r < regions.size(); r++)
+			{
+				if (regions[r].texture == texture)
+					found = (int)r;
+			}
+			if (found < 0)
+			{
+				AtlasRegion region = { texture, atlas_width, 0, 1, 1 };
+				std::vector<unsigned char> pixels;
+				if (texture == 0 || !_ReadTexture(texture, pixels, region.width, region.height))
+				{
+					// meshes without a texture get a white texel
+					pixels.assign(4, 255);
+					region.width = region.height = 1;
+				}
+
+				found = (int)regions.size();
+				regions.push_back(region);
+				images.push_back(pixels);
+				// one texel gap so linear filtering never reaches the neighbour
+				atlas_width += region.width + 1;
+				atlas_height = std::max(atlas_height, region.height);
+			}
+			mesh_regions[icon].push_back(found);
+		}
+	}
+
+	for (std::map<std::string, GLuint>::const_iterator it = textures.begin(); it != textures.end(); ++it)
+		TextureCache::Release(it->second);
+
+	// copy the regions side by side
+	std::vector<unsigned char> atlas((size_t)atlas_width * atlas_height * 4, 0);
+	for (unsigned int r = 0; r < regions.size(); r++)
+	{
+		const AtlasRegion &region = regions[r];
+		for (int row = 0; row < region.height; row++)
+		{
+			std::copy(images[r].begin() + (size_t)row * region.width * 4, images[r].begin() + (size_t)(row + 1) * region.width * 4,
+				atlas.begin() + ((size_t)row * atlas_width + region.x) * 4);
+		}
+	}
+
+	glGenTextures(1, &_atlas);
+	GLStateCache::BindTexture(GL_TEXTURE_2D, _atlas);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, atlas_width, atlas_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, atlas.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// icon templates, texture coordinates are clamped to their region with half a texel inset
+	for (int icon = 0; icon < HUD_ICON_COUNT; icon++)
+	{
+		_icons[icon].clear();
+		for (unsigned int m = 0; m < models[icon]->meshes.size(); m++)
+		{
+			const Mesh &mesh = models[icon]->meshes[m];
+			const AtlasRegion &region = regions[mesh_regions[icon][m]];
+			const MeshLod &level = mesh.GetLod(0);
+			for (unsigned int i = level.indexOffset; i < level.indexOffset + level.indexCount; i++)
+			{
+				unsigned int index = mesh.GetIndex(i);
+				glm::vec2 uv = glm::clamp(mesh.GetTexCoords(index), 0.0f, 1.0f);
+
+				HudVertex vertex;
+				vertex.Position = glm::vec4(mesh.GetPosition(index), 1.0f);
+				vertex.TexCoords.x = (region.x + 0.5f + uv.x * (region.width - 1)) / atlas_width;
+				vertex.TexCoords.y = (region.y + 0.5f + uv.y * (region.height - 1)) / atlas_height;
+				_icons[icon].push_back(vertex);
+			}
+		}
+	}
+}
+
+// reads level 0 of a texture as RGBA, shrunk by a whole factor until it fits HUD_ATLAS_TILE_SIZE
+// empty for a mesh without one
+std::string HudBatch::_DiffusePath(const Mesh &mesh)
+{
+	for (unsigned int t = 0; t < mesh.textures.size(); t++)
+	{
+		if (mesh.textures[t].type == "texture_diffuse")
+			return mesh.textures[t].path;
+	}
+	return "";
+}
+
+bool HudBatch::_ReadTexture(GLuint texture, std::vector<unsigned char> &pixels, int &width, int &height)
+{
+	GLStateCache::BindTexture(GL_TEXTURE_2D, texture);
+	int source_width = 0, source_height = 0;
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &source_width);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &source_height);
+	if (source_width <= 0 || source_height <= 0)
+		return false;
+
+	std::vector<unsigned char> source((size_t)source_width * source_height * 4);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, source.data());
+
+	int factor = 1;
+	while (source_width / factor > HUD_ATLAS_TILE_SIZE || source_height / factor > HUD_ATLAS_TILE_SIZE)
+		factor++;
+	width = std::max(source_width / factor, 1);
+	height = std::max(source_height / factor, 1);
+
+	// box filter over factor x factor texels
+	pixels.assign((size_t)width * height * 4, 0);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				unsigned int sum = 0;
+				for (int sy = 0; sy < factor; sy++)
+				{
+					for (int sx = 0; sx < factor; sx++)
+						sum += source[(((size_t)(y * factor + sy) * source_width) + x * factor + sx) * 4 + c];
+				}
+				pixels[((size_t)y * width + x) * 4 + c] = (unsigned char)(sum / (factor * factor));
+			}
+		}
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef LZ4_BLOCK_H
+#define LZ4_BLOCK_H
+
+#include <vector>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+// LZ4Block reads & writes the LZ4 block format (no frame around it), any LZ4 decoder reads what it writes.
+// A block is a run of sequences: a token (literal count << 4 | match length - 4), the literals, the 2 byte
+// offset of the match, counts of 15 and more going on in bytes of 255. The last sequence only has literals.
+// The compressor is the greedy one of the reference implementation: a hash table of the last position of
+// every 4 byte sequence, skipping ahead faster the longer nothing matches (already compressed images).
+class LZ4Block {
+public:
+	// the compressed bytes of size bytes, at most GetBound(size) of them
+	static std::vector<unsigned char> Compress(const unsigned char *source, size_t size);
+
+	// Fills exactly targetSize bytes of target, false when the block is damaged or does not decompress to that.
+	static bool Decompress(const unsigned char *source, size_t sourceSize, unsigned char *target, size_t targetSize);
+
+	static size_t GetBound(size_t size) { return size + size / 255 + 16; }
+
+	// the most a block of sourceSize bytes can decompress to, nearly every byte a match length of 255
+	static uint64_t GetMaxSize(uint64_t sourceSize) { return sourceSize * 255 + 16; }
+
+private:
+	LZ4Block() { }
+
+	static const int _MIN_MATCH = 4;
+	// the last match starts at least 12 bytes before the end, the last 5 bytes are always literals
+	static const size_t _MATCH_LIMIT = 12;
+	static const size_t _LAST_LITERALS = 5;
+	static const size_t _MAX_OFFSET = 65535;
+	static const int _HASH_BITS = 14;
+	// misses before the compressor starts skipping
+	static const int _SKIP_STRENGTH = 6;
+
+	static uint32_t _Read32(const unsigned char *bytes);
+	static uint32_t _Hash(uint32_t sequence) { return (sequence * 2654435761U) >> (32 - _HASH_BITS); }
+	static void _WriteLength(std::vector<unsigned char> &target, size_t length);
+	static void _WriteSequence(std::vector<unsigned char> &target, const unsigned char *literals, size_t literalCount, size_t offset, size_t matchLength);
+	// the rest of a count of 15 or more, false when it runs past the end
+	static bool _ReadLength(const unsigned char *source, size_t sourceSize, size_t &position, size_t &length);
+};
+
+std::vector<unsigned char> LZ4Block::Compress(const unsigned char *source, size_t size)
+{
+	std::vector<unsigned char> target;
+	target.reserve(GetBound(size));
+
+	size_t anchor = 0;
+	if (size > _MATCH_LIMIT)
+	{
+		std::vector<uint32_t> table((size_t)1 << _HASH_BITS, 0);
+		size_t limit = size - _MATCH_LIMIT, match_end = size - _LAST_LITERALS;
+		size_t position = 1, misses = 0;
+		while (position < limit)
+		{
+			uint32_t sequence = _Read32(source + position);
+			uint32_t &slot = table[_Hash(sequence)];
+			size_t candidate = slot;
+			slot = (uint32_t)position;
+			if (candidate >= position || position - candidate > _MAX_OFFSET || _Read32(source + candidate) != sequence)
+			{
+				position += 1 + (misses++ >> _SKIP_STRENGTH);
+				continue;
+			}
+
+			// the match may begin before the sequence that was found
+			while (position > anchor && candidate > 0 && source[position - 1] == source[candidate - 1])
+			{
+				position--;
+				candidate--;
+			}
+			size_t length = _MIN_MATCH;
+			while (position + length < match_end && source[position + length] == source[candidate + length])
+				length++;
+
+			_WriteSequence(target, source + anchor, position - anchor, position - candidate, length);
+			position += length;
+			anchor = position;
+			misses = 0;
+		}
+	}
+	_WriteSequence(target, source + anchor, size - anchor, 0, 0);
+	return target;
+}
+
+bool LZ4Block::Decompress(const unsigned char *source, size_t sourceSize, unsigned char *target, size_t targetSize)
+{
+	size_t in = 0, out = 0;
+	while (in < sourceSize)
+	{
+		unsigned char token = source[in++];
+		size_t literals = token >> 4;
+		if (literals == 15 && !_ReadLength(source, sourceSize, in, literals))
+			return false;
+		if (literals > sourceSize - in || literals > targetSize - out)
+			return false;
+		std::memcpy(target + out, source + in, literals);
+		in += literals;
+		out += literals;
+		if (in == sourceSize)
+			break;
+
+		if (sourceSize - in < 2)
+			return false;
+		size_t offset = source[in] | (size_t)source[in + 1] << 8;
+		in += 2;
+		size_t length = token & 15;
+		if (length == 15 && !_ReadLength(source, sourceSize, in, length))
+			return false;
+		length += _MIN_MATCH;
+		if (offset == 0 || offset > out || length > targetSize - out)
+			return false;
+
+		// a match closer than its length repeats the bytes it is copying
+		unsigned char *match = target + out - offset;
+		if (offset >= length)
+		{
+			std::memcpy(target + out, match, length);
+		}
+		else
+		{
+			for (size_t i = 0; i < length; i++)
+				target[out + i] = match[i];
+		}
+		out += length;
+	}
+	return out == targetSize;
+}
+
+uint32_t LZ4Block::_Read32(const unsigned char *bytes)
+{
+	uint32_t value;
+	std::memcpy(&value, bytes, sizeof(value));
+	return value;
+}
+
+void LZ4Block::_WriteLength(std::vector<unsigned char> &target, size_t length)
+{
+	for (; length >= 255; length -= 255)
+		target.push_back(255);
+	target.push_back((unsigned char)length);
+}
+
+void LZ4Block::_WriteSequence(std::vector<unsigned char> &target, const unsigned char *literals, size_t literalCount, size_t offset, size_t matchLength)
+{
+	size_t match = matchLength >= _MIN_MATCH ? matchLength - _MIN_MATCH : 0;
+	unsigned char token = (unsigned char)((literalCount < 15 ? literalCount : 15) << 4);
+	if (offset != 0)
+		token |= (unsigned char)(match < 15 ? match : 15);
+	target.push_back(token);
+	if (literalCount >= 15)
+		_WriteLength(target, literalCount - 15);
+	target.insert(target.end(), literals, literals + literalCount);
+
+	if (offset == 0)
+		return;
+	target.push_back((unsigned char)(offset & 0xFF));
+	target.push_back((unsigned char)(offset >> 8));
+	if (match >= 15)
+		_WriteLength(target, match - 15);
+}
+
+bool LZ4Block::_ReadLength(const unsigned char *source, size_t sourceSize, size_t &position, size_t &length)
+{
+	unsigned char byte;
+	do
+	{
+		if (position >= sourceSize)
+			return false;
+		byte = source[position++];
+		length += byte;
+	} while (byte == 255);
+	return true;
+}
+
+#endif
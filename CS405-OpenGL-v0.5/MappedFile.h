@@ -0,0 +1,172 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// MappedFile maps a whole file read only into memory, the OS pages it in on first touch.
+// Cooked assets are read straight from the mapping, which stays valid until the object is destroyed.
+// It also stands in for files that are not mapped on their own: a part of a mapped archive, kept
+// mapped by the view, or bytes in memory (a decompressed archive entry).
+class MappedFile {
+public:
+	MappedFile() : _data(nullptr), _size(0)
+#ifdef _WIN32
+		, _file(INVALID_HANDLE_VALUE), _mapping(NULL)
+#endif
+	{}
+	~MappedFile() { Close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile &operator=(const MappedFile&) = delete;
+
+	// false when the file does not exist, is empty or can not be mapped
+	bool Open(const std::string &path);
+	// size bytes at offset of owner, false when they are not all inside it or there are none
+	bool OpenView(const std::shared_ptr<MappedFile> &owner, size_t offset, size_t size);
+	// takes the bytes, which are left empty; false when there are none
+	bool Assign(std::vector<unsigned char> &bytes);
+	void Close();
+
+	const unsigned char *GetData() const { return _data; }
+	size_t GetSize() const { return _size; }
+
+private:
+	const unsigned char *_data;
+	size_t _size;
+	// of a view, and of assigned bytes; neither is a mapping of its own
+	std::shared_ptr<MappedFile> _owner;
+	std::vector<unsigned char> _bytes;
+
+#ifdef _WIN32
+	HANDLE _file;
+	HANDLE _mapping;
+#endif
+};
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string &path)
+{
+	Close();
+
+	_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	_mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (_mapping == NULL)
+	{
+		Close();
+		return false;
+	}
+	_data = (const unsigned char*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (_data == nullptr)
+	{
+		Close();
+		return false;
+	}
+	_size = (size_t)size.QuadPart;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (_data != nullptr && _mapping != NULL)
+		UnmapViewOfFile(_data);
+	if (_mapping != NULL)
+		CloseHandle(_mapping);
+	if (_file != INVALID_HANDLE_VALUE)
+		CloseHandle(_file);
+	_data = nullptr;
+	_size = 0;
+	_mapping = NULL;
+	_file = INVALID_HANDLE_VALUE;
+	_owner.reset();
+	std::vector<unsigned char>().swap(_bytes);
+}
+
+#else
+
+bool MappedFile::Open(const std::string &path)
+{
+	Close();
+
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size == 0)
+	{
+		close(file);
+		return false;
+	}
+
+	// the mapping keeps its own reference to the file
+	void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (data == MAP_FAILED)
+		return false;
+
+	_data = (const unsigned char*)data;
+	_size = (size_t)info.st_size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (_data != nullptr && !_owner && _bytes.empty())
+		munmap((void*)_data, _size);
+	_data = nullptr;
+	_size = 0;
+	_owner.reset();
+	std::vector<unsigned char>().swap(_bytes);
+}
+
+#endif
+
+bool MappedFile::OpenView(const std::shared_ptr<MappedFile> &owner, size_t offset, size_t size)
+{
+	Close();
+	if (!owner || size == 0 || offset > owner->GetSize() || size > owner->GetSize() - offset)
+		return false;
+	_owner = owner;
+	_data = owner->GetData() + offset;
+	_size = size;
+	return true;
+}
+
+bool MappedFile::Assign(std::vector<unsigned char> &bytes)
+{
+	Close();
+	if (bytes.empty())
+		return false;
+	_bytes.swap(bytes);
+	_data = _bytes.data();
+	_size = _bytes.size();
+	return true;
+}
+
+#endif
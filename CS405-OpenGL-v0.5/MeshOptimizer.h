@@ -0,0 +1,306 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include "mesh.h"
+
+// MeshOptimizer reorders imported geometry for the GPU without changing what is drawn.
+// Triangles are ordered for the post transform vertex cache (Forsyth's linear speed optimizer),
+// optionally regrouped so outward facing clusters are drawn first (Sander et al., less overdraw),
+// and vertices are renumbered in the order they are first used, for fetch locality.
+class MeshOptimizer {
+public:
+	// Average cache miss ratio, transformed vertices per triangle through a FIFO cache of cacheSize entries.
+	// 3.0 is the worst case, 0.5 is the best a regular grid can reach.
+	static float ComputeACMR(const unsigned int *indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = 16);
+
+	// Reorders the triangles of a triangle list in place for vertex cache locality.
+	static void OptimizeVertexCache(unsigned int *indices, size_t indexCount, size_t vertexCount);
+
+	// Reorders cache optimized triangles in clusters so the ones facing away from the mesh center come first.
+	// The new order is only kept while its ACMR stays within threshold times the cache optimized one.
+	static void OptimizeOverdraw(const std::vector<Vertex> &vertices, unsigned int *indices, size_t indexCount, float threshold);
+
+	// Renumbers the vertices in the order indices first reference them, unreferenced vertices are dropped.
+	static void OptimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices);
+
+private:
+	MeshOptimizer() { }
+
+	// cache size the scoring assumes, larger than most hardware caches on purpose (see Forsyth)
+	static const int _SCORE_CACHE_SIZE = 32;
+
+	static float _VertexScore(int cachePosition, unsigned int remainingTriangles);
+};
+
+float MeshOptimizer::ComputeACMR(const unsigned int *indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+{
+	if (indexCount < 3)
+		return 0.0f;
+
+	// a vertex is in the cache while it was pushed less than cacheSize misses ago
+	std::vector<size_t> pushed_at(vertexCount, 0);
+	size_t misses = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		unsigned int vertex = indices[i];
+		if (pushed_at[vertex] == 0 || misses - pushed_at[vertex] + 1 > cacheSize)
+		{
+			misses++;
+			pushed_at[vertex] = misses;
+		}
+	}
+	return (float)misses / (float)(indexCount / 3);
+}
+
+float MeshOptimizer::_VertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+	// vertices without triangles left do not pull anything
+	if (remainingTriangles == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		// the last triangle's vertices get a fixed score so the next triangle does not simply reuse them
+		if (cachePosition < 3)
+			score = 0.75f;
+		else
+			score = std::pow(1.0f - (float)(cachePosition - 3) / (float)(_SCORE_CACHE_SIZE - 3), 1.5f);
+	}
+	// finish off vertices with few triangles left, so they leave the cache for good
+	score += 2.0f / std::sqrt((float)remainingTriangles);
+	return score;
+}
+
+void MeshOptimizer::OptimizeVertexCache(unsigned int *indices, size_t indexCount, size_t vertexCount)
+{
+	size_t triangle_count = indexCount / 3;
+	if (triangle_count < 2)
+		return;
+
+	// triangles around every vertex, the live ones are kept at the front of each list
+	std::vector<unsigned int> remaining(vertexCount, 0);
+	for (size_t i = 0; i < indexCount; i++)
+		remaining[indices[i]]++;
+
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v + 1] = offsets[v] + remaining[v];
+
+	std::vector<unsigned int> adjacency(indexCount);
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t t = 0; t < triangle_count; t++)
+	{
+		for (int k = 0; k < 3; k++)
+			adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+	}
+
+	std::vector<int> cache_position(vertexCount, -1);
+	std::vector<float> vertex_score(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		vertex_score[v] = _VertexScore(-1, remaining[v]);
+
+	std::vector<float> triangle_score(triangle_count);
+	std::vector<unsigned char> emitted(triangle_count, 0);
+	size_t best = 0;
+	for (size_t t = 0; t < triangle_count; t++)
+	{
+		triangle_score[t] = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+		if (triangle_score[t] > triangle_score[best])
+			best = t;
+	}
+
+	std::vector<unsigned int> result;
+	result.reserve(indexCount);
+	std::vector<unsigned int> cache, next_cache;
+	cache.reserve(_SCORE_CACHE_SIZE + 3);
+	next_cache.reserve(_SCORE_CACHE_SIZE + 3);
+	size_t scan = 0;
+
+	while (result.size() < indexCount)
+	{
+		unsigned int a = indices[best * 3], b = indices[best * 3 + 1], c = indices[best * 3 + 2];
+		result.push_back(a);
+		result.push_back(b);
+		result.push_back(c);
+		emitted[best] = 1;
+
+		// drop the triangle from its vertices
+		unsigned int corners[3] = { a, b, c };
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = corners[k];
+			unsigned int *begin = &adjacency[offsets[v]];
+			unsigned int *end = begin + remaining[v];
+			unsigned int *found = std::find(begin, end, (unsigned int)best);
+			std::swap(*found, *(end - 1));
+			remaining[v]--;
+		}
+
+		// the emitted triangle goes to the front of the LRU cache
+		next_cache.clear();
+		next_cache.push_back(a);
+		next_cache.push_back(b);
+		next_cache.push_back(c);
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			if (cache[i] != a && cache[i] != b && cache[i] != c)
+				next_cache.push_back(cache[i]);
+		}
+		for (size_t i = 0; i < next_cache.size(); i++)
+		{
+			unsigned int v = next_cache[i];
+			cache_position[v] = i < (size_t)_SCORE_CACHE_SIZE ? (int)i : -1;
+			vertex_score[v] = _VertexScore(cache_position[v], remaining[v]);
+		}
+		if (next_cache.size() > (size_t)_SCORE_CACHE_SIZE)
+			next_cache.resize(_SCORE_CACHE_SIZE);
+		cache.swap(next_cache);
+
+		// only triangles touching the cache changed their score, the best next one is among them
+		float best_score = -1.0f;
+		bool found_best = false;
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			unsigned int v = cache[i];
+			for (unsigned int j = 0; j < remaining[v]; j++)
+			{
+				unsigned int t = adjacency[offsets[v] + j];
+				triangle_score[t] = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+				if (triangle_score[t] > best_score)
+				{
+					best_score = triangle_score[t];
+					best = t;
+					found_best = true;
+				}
+			}
+		}
+
+		// dead end, continue with the next triangle that was not emitted yet
+		if (!found_best && result.size() < indexCount)
+		{
+			while (emitted[scan])
+				scan++;
+			best = scan;
+		}
+	}
+
+	std::copy(result.begin(), result.end(), indices);
+}
+
+void MeshOptimizer::OptimizeOverdraw(const std::vector<Vertex> &vertices, unsigned int *indices, size_t indexCount, float threshold)
+{
+	size_t triangle_count = indexCount / 3;
+	if (triangle_count < 2)
+		return;
+
+	const unsigned int cache_size = 16;
+	float original_acmr = ComputeACMR(indices, indexCount, vertices.size(), cache_size);
+
+	// split where the cache has to start over: every vertex of the triangle misses
+	std::vector<size_t> cluster_starts;
+	std::vector<size_t> pushed_at(vertices.size(), 0);
+	size_t misses = 0;
+	for (size_t t = 0; t < triangle_count; t++)
+	{
+		int triangle_misses = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = indices[t * 3 + k];
+			if (pushed_at[v] == 0 || misses - pushed_at[v] + 1 > cache_size)
+			{
+				misses++;
+				pushed_at[v] = misses;
+				triangle_misses++;
+			}
+		}
+		if (t == 0 || triangle_misses == 3)
+			cluster_starts.push_back(t);
+	}
+	cluster_starts.push_back(triangle_count);
+
+	size_t cluster_count = cluster_starts.size() - 1;
+	if (cluster_count < 2)
+		return;
+
+	glm::vec3 mesh_center(0.0f);
+	float mesh_area = 0.0f;
+	std::vector<glm::vec3> cluster_center(cluster_count, glm::vec3(0.0f));
+	std::vector<glm::vec3> cluster_normal(cluster_count, glm::vec3(0.0f));
+	for (size_t c = 0; c < cluster_count; c++)
+	{
+		float cluster_area = 0.0f;
+		for (size_t t = cluster_starts[c]; t < cluster_starts[c + 1]; t++)
+		{
+			const glm::vec3 &p0 = vertices[indices[t * 3]].Position;
+			const glm::vec3 &p1 = vertices[indices[t * 3 + 1]].Position;
+			const glm::vec3 &p2 = vertices[indices[t * 3 + 2]].Position;
+
+			// length of the cross product is twice the area, the factor cancels out
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float area = glm::length(normal);
+			glm::vec3 center = (p0 + p1 + p2) / 3.0f;
+
+			cluster_center[c] += center * area;
+			cluster_normal[c] += normal;
+			cluster_area += area;
+		}
+		mesh_center += cluster_center[c];
+		mesh_area += cluster_area;
+		if (cluster_area > 0.0f)
+			cluster_center[c] /= cluster_area;
+	}
+	if (mesh_area > 0.0f)
+		mesh_center /= mesh_area;
+
+	// clusters far out along their own normal are likely to hide the rest of the mesh
+	std::vector<float> sort_key(cluster_count);
+	std::vector<size_t> order(cluster_count);
+	for (size_t c = 0; c < cluster_count; c++)
+	{
+		float length = glm::length(cluster_normal[c]);
+		glm::vec3 direction = length > 0.0f ? cluster_normal[c] / length : glm::vec3(0.0f);
+		sort_key[c] = glm::dot(cluster_center[c] - mesh_center, direction);
+		order[c] = c;
+	}
+	std::stable_sort(order.begin(), order.end(), [&sort_key](size_t lhs, size_t rhs) { return sort_key[lhs] > sort_key[rhs]; });
+
+	std::vector<unsigned int> result;
+	result.reserve(indexCount);
+	for (size_t i = 0; i < cluster_count; i++)
+	{
+		size_t c = order[i];
+		result.insert(result.end(), indices + cluster_starts[c] * 3, indices + cluster_starts[c + 1] * 3);
+	}
+
+	if (ComputeACMR(result.data(), result.size(), vertices.size(), cache_size) <= original_acmr * threshold)
+		std::copy(result.begin(), result.end(), indices);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+	const unsigned int unused = 0xffffffff;
+	std::vector<unsigned int> remap(vertices.size(), unused);
+	std::vector<Vertex> result;
+	result.reserve(vertices.size());
+
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		unsigned int &index = indices[i];
+		if (remap[index] == unused)
+		{
+			remap[index] = (unsigned int)result.size();
+			result.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(result);
+}
+
+#endif
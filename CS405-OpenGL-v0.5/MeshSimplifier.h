@@ -0,0 +1,330 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "mesh.h"
+
+// MeshSimplifier builds reduced index lists for level of detail meshes.
+// It collapses edges onto one of their existing end points using quadric error metrics (Garland & Heckbert),
+// so every simplified index list still refers to the original vertex buffer.
+class MeshSimplifier {
+public:
+	// Simplifies a triangle list until it has at most targetIndexCount indices, or until every remaining
+	// collapse would move the surface further than maxError (relative to the largest extent of the mesh).
+	// resultError receives the largest error that was accepted, in the same relative unit.
+	static std::vector<unsigned int> Simplify(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
+		size_t targetIndexCount, float maxError, float *resultError);
+
+private:
+	MeshSimplifier() { }
+
+	// symmetric 4x4 matrix of the plane equation sum, only the upper triangle is stored
+	struct Quadric {
+		double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+	};
+
+	struct Collapse {
+		unsigned int from;
+		unsigned int to;
+		double cost;
+	};
+
+	static void _AddPlane(Quadric &q, double a, double b, double c, double d, double weight);
+	static void _AddQuadric(Quadric &q, const Quadric &other);
+	static double _Evaluate(const Quadric &q, const glm::vec3 &p);
+
+	static void _BuildPositionRemap(const std::vector<glm::vec3> &positions, std::vector<unsigned int> &remap);
+	static void _FindLockedVertices(const std::vector<unsigned int> &indices, const std::vector<unsigned int> &positionRemap,
+		std::vector<unsigned char> &locked);
+	static bool _CollapseFlipsTriangle(const std::vector<glm::vec3> &positions, const std::vector<unsigned int> &indices,
+		const std::vector<unsigned int> &adjacencyOffsets, const std::vector<unsigned int> &adjacency, unsigned int from, unsigned int to);
+};
+
+std::vector<unsigned int> MeshSimplifier::Simplify(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
+	size_t targetIndexCount, float maxError, float *resultError)
+{
+	std::vector<unsigned int> result = indices;
+	if (resultError != nullptr)
+		*resultError = 0.0f;
+	if (vertices.empty() || indices.size() <= targetIndexCount)
+		return result;
+
+	// work on positions normalized to the unit cube so the errors are relative to the mesh size
+	glm::vec3 bounds_min = vertices[0].Position;
+	glm::vec3 bounds_max = vertices[0].Position;
+	for (unsigned int i = 1; i < vertices.size(); i++)
+	{
+		bounds_min = glm::min(bounds_min, vertices[i].Position);
+		bounds_max = glm::max(bounds_max, vertices[i].Position);
+	}
+	glm::vec3 size = bounds_max - bounds_min;
+	float extent = std::max(size.x, std::max(size.y, size.z));
+	float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+
+	std::vector<glm::vec3> positions(vertices.size());
+	for (unsigned int i = 0; i < vertices.size(); i++)
+		positions[i] = (vertices[i].Position - bounds_min) * scale;
+
+	// vertices split along uv or normal seams share one position and one quadric
+	std::vector<unsigned int> position_remap;
+	_BuildPositionRemap(positions, position_remap);
+
+	std::vector<unsigned char> locked;
+	_FindLockedVertices(result, position_remap, locked);
+
+	std::vector<Quadric> quadrics(vertices.size(), Quadric());
+	for (size_t i = 0; i + 2 < result.size(); i += 3)
+	{
+		const glm::vec3 &p0 = positions[result[i + 0]];
+		const glm::vec3 &p1 = positions[result[i + 1]];
+		const glm::vec3 &p2 = positions[result[i + 2]];
+
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float area = glm::length(normal);
+		if (area <= 0.0f)
+			continue;
+		normal = normal / area;
+
+		double distance = -glm::dot(normal, p0);
+		for (int k = 0; k < 3; k++)
+			_AddPlane(quadrics[position_remap[result[i + k]]], normal.x, normal.y, normal.z, distance, area * 0.5);
+	}
+
+	double max_cost = (double)maxError * (double)maxError;
+	double accepted_cost = 0.0;
+
+	std::vector<unsigned int> remap(vertices.size());
+	std::vector<unsigned char> touched(vertices.size());
+	std::vector<unsigned int> adjacency_offsets(vertices.size() + 1);
+	std::vector<unsigned int> adjacency;
+	std::vector<Collapse> collapses;
+
+	while (result.size() > targetIndexCount)
+	{
+		// vertex -> triangle adjacency of the current index list
+		std::fill(adjacency_offsets.begin(), adjacency_offsets.end(), 0);
+		for (size_t i = 0; i < result.size(); i++)
+			adjacency_offsets[result[i] + 1]++;
+		for (size_t v = 0; v < vertices.size(); v++)
+			adjacency_offsets[v + 1] += adjacency_offsets[v];
+		adjacency.resize(result.size());
+		std::vector<unsigned int> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+		for (size_t i = 0; i < result.size(); i++)
+			adjacency[fill[result[i]]++] = (unsigned int)(i / 3);
+
+		// every edge can collapse in both directions, as long as the vertex that goes away is free
+		collapses.clear();
+		for (size_t i = 0; i + 2 < result.size(); i += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int a = result[i + k];
+				unsigned int b = result[i + (k + 1) % 3];
+
+				Quadric q = quadrics[position_remap[a]];
+				_AddQuadric(q, quadrics[position_remap[b]]);
+
+				if (!locked[a])
+				{
+					Collapse collapse = { a, b, _Evaluate(q, positions[b]) };
+					collapses.push_back(collapse);
+				}
+				if (!locked[b])
+				{
+					Collapse collapse = { b, a, _Evaluate(q, positions[a]) };
+					collapses.push_back(collapse);
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse &lhs, const Collapse &rhs) { return lhs.cost < rhs.cost; });
+
+		for (unsigned int v = 0; v < remap.size(); v++)
+			remap[v] = v;
+		std::fill(touched.begin(), touched.end(), 0);
+
+		// each collapse removes about two triangles, stop the pass once the target is reachable
+		size_t triangles_to_remove = (result.size() - targetIndexCount) / 3;
+		size_t removed = 0;
+		size_t collapsed = 0;
+
+		for (size_t c = 0; c < collapses.size() && removed < triangles_to_remove; c++)
+		{
+			const Collapse &collapse = collapses[c];
+			if (collapse.cost > max_cost)
+				break;
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+			if (_CollapseFlipsTriangle(positions, result, adjacency_offsets, adjacency, collapse.from, collapse.to))
+				continue;
+
+			remap[collapse.from] = collapse.to;
+			_AddQuadric(quadrics[position_remap[collapse.to]], quadrics[position_remap[collapse.from]]);
+			accepted_cost = std::max(accepted_cost, collapse.cost);
+
+			// the neighbourhood is stale until the next pass, keep it out of further collapses
+			for (unsigned int t = adjacency_offsets[collapse.from]; t < adjacency_offsets[collapse.from + 1]; t++)
+			{
+				unsigned int triangle = adjacency[t];
+				for (int k = 0; k < 3; k++)
+					touched[result[triangle * 3 + k]] = 1;
+				if (result[triangle * 3 + 0] == collapse.to || result[triangle * 3 + 1] == collapse.to || result[triangle * 3 + 2] == collapse.to)
+					removed++;
+			}
+			collapsed++;
+		}
+
+		if (collapsed == 0)
+			break;
+
+		// apply the collapses and drop the triangles that became degenerate
+		size_t write = 0;
+		for (size_t i = 0; i + 2 < result.size(); i += 3)
+		{
+			unsigned int a = remap[result[i + 0]];
+			unsigned int b = remap[result[i + 1]];
+			unsigned int c = remap[result[i + 2]];
+			if (a == b || b == c || c == a)
+				continue;
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+	}
+
+	if (resultError != nullptr)
+		*resultError = (float)std::sqrt(accepted_cost);
+
+	return result;
+}
+
+void MeshSimplifier::_AddPlane(Quadric &q, double a, double b, double c, double d, double weight)
+{
+	q.a2 += a * a * weight; q.ab += a * b * weight; q.ac += a * c * weight; q.ad += a * d * weight;
+	q.b2 += b * b * weight; q.bc += b * c * weight; q.bd += b * d * weight;
+	q.c2 += c * c * weight; q.cd += c * d * weight;
+	q.d2 += d * d * weight;
+}
+
+void MeshSimplifier::_AddQuadric(Quadric &q, const Quadric &other)
+{
+	q.a2 += other.a2; q.ab += other.ab; q.ac += other.ac; q.ad += other.ad;
+	q.b2 += other.b2; q.bc += other.bc; q.bd += other.bd;
+	q.c2 += other.c2; q.cd += other.cd;
+	q.d2 += other.d2;
+}
+
+double MeshSimplifier::_Evaluate(const Quadric &q, const glm::vec3 &p)
+{
+	double x = p.x, y = p.y, z = p.z;
+	double error = q.a2 * x * x + 2.0 * q.ab * x * y + 2.0 * q.ac * x * z + 2.0 * q.ad * x
+		+ q.b2 * y * y + 2.0 * q.bc * y * z + 2.0 * q.bd * y
+		+ q.c2 * z * z + 2.0 * q.cd * z
+		+ q.d2;
+	return std::fabs(error);
+}
+
+// maps every vertex to the first vertex with the exact same position
+void MeshSimplifier::_BuildPositionRemap(const std::vector<glm::vec3> &positions, std::vector<unsigned int> &remap)
+{
+	std::vector<unsigned int> order(positions.size());
+	for (unsigned int i = 0; i < order.size(); i++)
+		order[i] = i;
+
+	auto less = [&positions](unsigned int lhs, unsigned int rhs) {
+		const glm::vec3 &a = positions[lhs];
+		const glm::vec3 &b = positions[rhs];
+		if (a.x != b.x) return a.x < b.x;
+		if (a.y != b.y) return a.y < b.y;
+		if (a.z != b.z) return a.z < b.z;
+		return lhs < rhs;
+	};
+	std::sort(order.begin(), order.end(), less);
+
+	remap.resize(positions.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		if (i > 0 && positions[order[i]] == positions[order[i - 1]])
+			remap[order[i]] = remap[order[i - 1]];
+		else
+			remap[order[i]] = order[i];
+	}
+}
+
+// vertices on open borders or on attribute seams never move, otherwise holes and uv cracks would appear.
+void MeshSimplifier::_FindLockedVertices(const std::vector<unsigned int> &indices, const std::vector<unsigned int> &positionRemap,
+	std::vector<unsigned char> &locked)
+{
+	locked.assign(positionRemap.size(), 0);
+
+	// more than one vertex on the same position means a seam
+	std::vector<unsigned int> wedges(positionRemap.size(), 0);
+	for (size_t i = 0; i < positionRemap.size(); i++)
+		wedges[positionRemap[i]]++;
+	for (size_t i = 0; i < positionRemap.size(); i++)
+		if (wedges[positionRemap[i]] > 1)
+			locked[i] = 1;
+
+	// a directed edge without its opposite is on a border of the (position welded) surface
+	std::vector<uint64_t> edges;
+	edges.reserve(indices.size());
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			uint64_t a = positionRemap[indices[i + k]];
+			uint64_t b = positionRemap[indices[i + (k + 1) % 3]];
+			edges.push_back((a << 32) | b);
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+
+	std::vector<unsigned char> border(positionRemap.size(), 0);
+	for (size_t i = 0; i < edges.size(); i++)
+	{
+		uint64_t opposite = (edges[i] << 32) | (edges[i] >> 32);
+		if (!std::binary_search(edges.begin(), edges.end(), opposite))
+		{
+			border[edges[i] >> 32] = 1;
+			border[edges[i] & 0xFFFFFFFFu] = 1;
+		}
+	}
+	for (size_t i = 0; i < positionRemap.size(); i++)
+		if (border[positionRemap[i]])
+			locked[i] = 1;
+}
+
+bool MeshSimplifier::_CollapseFlipsTriangle(const std::vector<glm::vec3> &positions, const std::vector<unsigned int> &indices,
+	const std::vector<unsigned int> &adjacencyOffsets, const std::vector<unsigned int> &adjacency, unsigned int from, unsigned int to)
+{
+	for (unsigned int t = adjacencyOffsets[from]; t < adjacencyOffsets[from + 1]; t++)
+	{
+		unsigned int triangle = adjacency[t];
+		unsigned int a = indices[triangle * 3 + 0];
+		unsigned int b = indices[triangle * 3 + 1];
+		unsigned int c = indices[triangle * 3 + 2];
+
+		// triangles on the collapsed edge disappear
+		if (a == to || b == to || c == to)
+			continue;
+
+		// rotate so the collapsing vertex comes first, keeping the winding
+		if (b == from) { unsigned int tmp = a; a = b; b = c; c = tmp; }
+		else if (c == from) { unsigned int tmp = c; c = b; b = a; a = tmp; }
+
+		glm::vec3 old_normal = glm::cross(positions[b] - positions[a], positions[c] - positions[a]);
+		glm::vec3 new_normal = glm::cross(positions[b] - positions[to], positions[c] - positions[to]);
+
+		if (glm::dot(old_normal, new_normal) <= 0.0f)
+			return true;
+	}
+	return false;
+}
+
+#endif
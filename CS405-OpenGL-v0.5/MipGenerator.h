@@ -0,0 +1,307 @@
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#define MIP_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+#include "ThreadPool.h"
+
+enum MipFilter {
+	// average of the texels a level texel covers, what glGenerateMipmap does
+	MIP_FILTER_BOX,
+	// windowed sinc, sharper levels without the aliasing of a box
+	MIP_FILTER_KAISER
+};
+
+struct MipSettings {
+	MipFilter filter;
+	// the color channels of 3 & 4 component images are sRGB encoded and averaged in linear space
+	bool srgb;
+	// alpha tested images keep the share of texels above the cutoff at every level, 0 leaves alpha alone
+	float alphaCutoff;
+};
+
+// MipGenerator builds mip chains on the CPU. Every level is filtered from the one before it, kept as float
+// RGBA (one SSE register per texel) so nothing is rounded until a level is written out, the rows of a level
+// are filtered in parallel on the shared thread pool. Both filters are separable and wrap around the edges
+// like the GL_REPEAT the textures are sampled with.
+class MipGenerator {
+public:
+	// Level 0 (a copy of pixels) and the levels below it down to 1x1, at most levelLimit of them.
+	// Every level is tightly packed with the components of the image.
+	static std::vector<std::vector<unsigned char> > Build(const unsigned char *pixels, int width, int height, int components,
+		const MipSettings &settings, unsigned int levelLimit);
+
+private:
+	MipGenerator() { }
+
+	// rows per task of a filter pass
+	static const size_t _ROWS_PER_TASK = 16;
+	// support of the Kaiser window in texels of the smaller level, and its shape
+	static constexpr float _KAISER_WIDTH = 3.0f;
+	static constexpr float _KAISER_ALPHA = 4.0f;
+	// steps of the search for the alpha scale that restores the coverage
+	static const int _COVERAGE_STEPS = 12;
+
+	// the source texels and weights of every texel of a smaller row or column
+	struct _Taps {
+		std::vector<size_t> offsets;
+		std::vector<int> indices;
+		std::vector<float> weights;
+	};
+
+	struct _Image {
+		int width, height;
+		// RGBA, linear
+		std::vector<float> texels;
+	};
+
+	static _Taps _MakeTaps(int size, int nextSize, MipFilter filter);
+	static float _Weight(float distance, MipFilter filter);
+	static float _BesselI0(float x);
+	// half the size, horizontally then vertically
+	static _Image _Downsample(const _Image &image, const MipSettings &settings);
+	static void _Accumulate(float *target, const float *texel, float weight);
+
+	static _Image _Decode(const unsigned char *pixels, int width, int height, int components, bool srgb);
+	static std::vector<unsigned char> _Encode(const _Image &image, int components, bool srgb, float alphaScale);
+	static float _Coverage(const _Image &image, float cutoff, float alphaScale);
+	// the scale of alpha at which the image covers as much as coverage
+	static float _CoverageScale(const _Image &image, float cutoff, float coverage);
+
+	static float _ToLinear(unsigned char value);
+	static unsigned char _ToSrgb(float value);
+};
+
+std::vector<std::vector<unsigned char> > MipGenerator::Build(const unsigned char *pixels, int width, int height, int components,
+	const MipSettings &settings, unsigned int levelLimit)
+{
+	// only images with a color & an alpha channel have both kinds
+	bool srgb = settings.srgb && components >= 3;
+	bool coverage = settings.alphaCutoff > 0.0f && components == 4;
+
+	std::vector<std::vector<unsigned char> > levels;
+	levels.push_back(std::vector<unsigned char>(pixels, pixels + (size_t)width * height * components));
+
+	_Image image = _Decode(pixels, width, height, components, srgb);
+	float base_coverage = coverage ? _Coverage(image, settings.alphaCutoff, 1.0f) : 0.0f;
+	while ((image.width > 1 || image.height > 1) && levels.size() < levelLimit)
+	{
+		image = _Downsample(image, settings);
+		float alpha_scale = coverage ? _CoverageScale(image, settings.alphaCutoff, base_coverage) : 1.0f;
+		levels.push_back(_Encode(image, components, srgb, alpha_scale));
+	}
+	return levels;
+}
+
+MipGenerator::_Taps MipGenerator::_MakeTaps(int size, int nextSize, MipFilter filter)
+{
+	_Taps taps;
+	float scale = (float)size / nextSize;
+	float support = filter == MIP_FILTER_KAISER ? _KAISER_WIDTH * scale : 0.5f * scale;
+	for (int i = 0; i < nextSize; i++)
+	{
+		taps.offsets.push_back(taps.indices.size());
+		// texel centers of both levels line up at the edges
+		float center = (i + 0.5f) * scale - 0.5f;
+		int first = (int)std::ceil(center - support), last = (int)std::floor(center + support);
+		float total = 0.0f;
+		size_t begin = taps.weights.size();
+		for (int source = first; source <= last; source++)
+		{
+			float weight = _Weight((source - center) / scale, filter);
+			if (weight == 0.0f)
+				continue;
+			taps.indices.push_back(((source % size) + size) % size);
+			taps.weights.push_back(weight);
+			total += weight;
+		}
+		for (size_t w = begin; w < taps.weights.size(); w++)
+			taps.weights[w] /= total;
+	}
+	taps.offsets.push_back(taps.indices.size());
+	return taps;
+}
+
+float MipGenerator::_Weight(float distance, MipFilter filter)
+{
+	distance = std::fabs(distance);
+	if (filter == MIP_FILTER_BOX)
+		return distance <= 0.5f ? 1.0f : 0.0f;
+
+	if (distance >= _KAISER_WIDTH)
+		return 0.0f;
+	const float pi = 3.14159265358979f;
+	float sinc = distance < 1e-5f ? 1.0f : std::sin(pi * distance) / (pi * distance);
+	float ratio = distance / _KAISER_WIDTH;
+	return sinc * _BesselI0(_KAISER_ALPHA * std::sqrt(1.0f - ratio * ratio)) / _BesselI0(_KAISER_ALPHA);
+}
+
+// modified Bessel function of the first kind, by its power series
+float MipGenerator::_BesselI0(float x)
+{
+	float sum = 1.0f, term = 1.0f, half = x * 0.5f;
+	for (int k = 1; k < 32 && term > sum * 1e-7f; k++)
+	{
+		term *= (half / k) * (half / k);
+		sum += term;
+	}
+	return sum;
+}
+
+MipGenerator::_Image MipGenerator::_Downsample(const _Image &image, const MipSettings &settings)
+{
+	int next_width = std::max(image.width / 2, 1);
+	int next_height = std::max(image.height / 2, 1);
+	_Taps columns = _MakeTaps(image.width, next_width, settings.filter);
+	_Taps rows = _MakeTaps(image.height, next_height, settings.filter);
+
+	_Image narrow;
+	narrow.width = next_width;
+	narrow.height = image.height;
+	narrow.texels.assign((size_t)next_width * image.height * 4, 0.0f);
+	ThreadPool::Shared().ParallelFor((size_t)image.height, _ROWS_PER_TASK, [&](size_t begin, size_t end) {
+		for (size_t y = begin; y < end; y++)
+		{
+			const float *source = &image.texels[y * image.width * 4];
+			float *target = &narrow.texels[y * next_width * 4];
+			for (int x = 0; x < next_width; x++)
+			{
+				for (size_t t = columns.offsets[x]; t < columns.offsets[x + 1]; t++)
+					_Accumulate(target + x * 4, source + (size_t)columns.indices[t] * 4, columns.weights[t]);
+			}
+		}
+	});
+
+	_Image next;
+	next.width = next_width;
+	next.height = next_height;
+	next.texels.assign((size_t)next_width * next_height * 4, 0.0f);
+	ThreadPool::Shared().ParallelFor((size_t)next_height, _ROWS_PER_TASK, [&](size_t begin, size_t end) {
+		for (size_t y = begin; y < end; y++)
+		{
+			float *target = &next.texels[y * next_width * 4];
+			for (size_t t = rows.offsets[y]; t < rows.offsets[y + 1]; t++)
+			{
+				const float *source = &narrow.texels[(size_t)rows.indices[t] * next_width * 4];
+				for (int x = 0; x < next_width; x++)
+					_Accumulate(target + x * 4, source + x * 4, rows.weights[t]);
+			}
+		}
+	});
+	return next;
+}
+
+void MipGenerator::_Accumulate(float *target, const float *texel, float weight)
+{
+#ifdef MIP_USE_SSE
+	_mm_storeu_ps(target, _mm_add_ps(_mm_loadu_ps(target), _mm_mul_ps(_mm_loadu_ps(texel), _mm_set1_ps(weight))));
+#else
+	for (int c = 0; c < 4; c++)
+		target[c] += texel[c] * weight;
+#endif
+}
+
+MipGenerator::_Image MipGenerator::_Decode(const unsigned char *pixels, int width, int height, int components, bool srgb)
+{
+	_Image image;
+	image.width = width;
+	image.height = height;
+	image.texels.assign((size_t)width * height * 4, 0.0f);
+	size_t count = (size_t)width * height;
+	for (size_t i = 0; i < count; i++)
+	{
+		for (int c = 0; c < components; c++)
+		{
+			unsigned char value = pixels[i * components + c];
+			image.texels[i * 4 + c] = srgb && c < 3 ? _ToLinear(value) : value / 255.0f;
+		}
+	}
+	return image;
+}
+
+std::vector<unsigned char> MipGenerator::_Encode(const _Image &image, int components, bool srgb, float alphaScale)
+{
+	size_t count = (size_t)image.width * image.height;
+	std::vector<unsigned char> pixels(count * components);
+	for (size_t i = 0; i < count; i++)
+	{
+		for (int c = 0; c < components; c++)
+		{
+			float value = image.texels[i * 4 + c];
+			if (c == 3)
+				value *= alphaScale;
+			value = std::min(std::max(value, 0.0f), 1.0f);
+			pixels[i * components + c] = srgb && c < 3 ? _ToSrgb(value) : (unsigned char)(value * 255.0f + 0.5f);
+		}
+	}
+	return pixels;
+}
+
+float MipGenerator::_Coverage(const _Image &image, float cutoff, float alphaScale)
+{
+	size_t count = (size_t)image.width * image.height, covered = 0;
+	for (size_t i = 0; i < count; i++)
+		covered += image.texels[i * 4 + 3] * alphaScale > cutoff;
+	return (float)covered / count;
+}
+
+float MipGenerator::_CoverageScale(const _Image &image, float cutoff, float coverage)
+{
+	float low = 0.0f, high = 4.0f, scale = 1.0f;
+	for (int step = 0; step < _COVERAGE_STEPS; step++)
+	{
+		float current = _Coverage(image, cutoff, scale);
+		if (current < coverage)
+			low = scale;
+		else if (current > coverage)
+			high = scale;
+		else
+			break;
+		scale = (low + high) * 0.5f;
+	}
+	return scale;
+}
+
+float MipGenerator::_ToLinear(unsigned char value)
+{
+	static std::vector<float> table;
+	static std::once_flag filled;
+	std::call_once(filled, []() {
+		table.resize(256);
+		for (int i = 0; i < 256; i++)
+		{
+			float s = i / 255.0f;
+			table[i] = s <= 0.04045f ? s / 12.92f : std::pow((s + 0.055f) / 1.055f, 2.4f);
+		}
+	});
+	return table[value];
+}
+
+unsigned char MipGenerator::_ToSrgb(float value)
+{
+	// fine enough that every byte is reached, the dark end of sRGB is steep
+	static const int steps = 8192;
+	static std::vector<unsigned char> table;
+	static std::once_flag filled;
+	std::call_once(filled, []() {
+		table.resize(steps + 1);
+		for (int i = 0; i <= steps; i++)
+		{
+			float l = (float)i / steps;
+			float s = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+			table[i] = (unsigned char)(std::min(std::max(s, 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+	});
+	return table[(int)(value * steps + 0.5f)];
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include <string>
+#include <map>
+#include <memory>
+#include <future>
+#include <chrono>
+
+#include "model.h"
+#include "CookedAsset.h"
+#include "ThreadPool.h"
+
+// a model requested from ModelLoader, ready once the workers finished reading it
+typedef std::shared_future<std::shared_ptr<const ModelImport> > ModelHandle;
+
+// ModelLoader reads models on the worker threads: mapping the cooked file or running the ASSIMP
+// import, simplification and optimization all happen there, many models at once. Only creating the
+// buffers and textures is left for the GL thread, so loading a scene costs about as much as its
+// slowest model. Requests for a path already in flight share one import.
+class ModelLoader {
+public:
+	// Starts reading the model in the background, the handle resolves to what Model::Prepare read.
+	static ModelHandle Load(const std::string &path);
+
+	static bool IsReady(const ModelHandle &handle);
+
+	// Waits for the model if needed and creates a new Model from it, GL thread only.
+	// Every call makes its own Model, the import itself is shared.
+	static Model *Create(const ModelHandle &handle);
+
+	// Forgets the import of one path, the next Load reads it again.
+	static void Forget(const std::string &path);
+
+	// Waits for the imports in flight and forgets them, models created from them keep what they use.
+	static void Clear();
+
+private:
+	ModelLoader() { }
+
+	// imports by normalized path, only touched on the thread requesting models
+	static std::map<std::string, ModelHandle> _imports;
+};
+
+// Instantiate static variables
+std::map<std::string, ModelHandle> ModelLoader::_imports;
+
+ModelHandle ModelLoader::Load(const std::string &path)
+{
+	std::string key = CookedAsset::NormalizePath(path);
+	std::map<std::string, ModelHandle>::const_iterator known = _imports.find(key);
+	if (known != _imports.end())
+		return known->second;
+
+	ModelHandle handle = ThreadPool::Shared().Submit([path]() {
+		std::shared_ptr<ModelImport> import = std::make_shared<ModelImport>();
+		Model::Prepare(path, *import);
+		return std::shared_ptr<const ModelImport>(import);
+	}).share();
+	_imports[key] = handle;
+	return handle;
+}
+
+bool ModelLoader::IsReady(const ModelHandle &handle)
+{
+	return handle.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+Model *ModelLoader::Create(const ModelHandle &handle)
+{
+	return new Model(*handle.get());
+}
+
+void ModelLoader::Forget(const std::string &path)
+{
+	_imports.erase(CookedAsset::NormalizePath(path));
+}
+
+void ModelLoader::Clear()
+{
+	// the workers read through the FileSystem, it can only be unmounted once they are done
+	for (std::map<std::string, ModelHandle>::const_iterator it = _imports.begin(); it != _imports.end(); ++it)
+		it->second.wait();
+	_imports.clear();
+}
+
+#endif
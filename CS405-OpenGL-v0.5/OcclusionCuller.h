@@ -0,0 +1,387 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "Frustum.h"
+#include "ThreadPool.h"
+#include "mesh.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#define OCCLUSION_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+// An occluder triangle after clipping and projection, ready for the edge function loops.
+// Every edge is E(x, y) = a * x + b * y + c, positive inside. Depth is a plane over the screen.
+struct OcclusionTriangle {
+	float edgeA[3], edgeB[3], edgeC[3];
+	float depthA, depthB, depthC;
+	int minX, maxX, minY, maxY;
+};
+
+// OcclusionCuller draws a few large occluders into a small depth buffer on the CPU and rejects
+// candidate boxes that are completely behind it, before anything is sent to the GPU.
+// The buffer is split into horizontal bands that are rasterized in parallel, four pixels at a time.
+// Depth is NDC z (-1 near, 1 far). Coverage is sampled at pixel centers like the GPU does, so a
+// candidate peeking through less than a pixel of the low resolution buffer may still be rejected.
+class OcclusionCuller {
+public:
+	OcclusionCuller() : _width(0), _height(0), _triangleCount(0), _testedCount(0), _occludedCount(0) {}
+
+	// width is rounded up to a multiple of four
+	void Init(int width, int height);
+
+	// Clears the depth buffer and forgets the previous occluders.
+	void Begin(const glm::mat4 &viewProjection);
+
+	// Queues the triangles of one level of the model's meshes, drawn with the model matrix.
+	void AddOccluder(const std::vector<Mesh> &meshes, unsigned int lod, const glm::mat4 &model);
+
+	// Sets up and rasterizes every queued occluder on the pool.
+	void Rasterize(ThreadPool &pool);
+
+	// True unless every pixel the box covers has an occluder in front of the box.
+	bool IsVisible(const glm::vec3 &center, const glm::vec3 &extents) const;
+
+	// Tests the boxes still marked in visible and clears the ones that are occluded.
+	void Cull(const AABBBatch &batch, unsigned char *visible, ThreadPool &pool);
+
+	int GetWidth() const { return _width; }
+	int GetHeight() const { return _height; }
+	const float *GetDepth() const { return _depth.data(); }
+
+	void PrintStats();
+
+private:
+	struct Occluder {
+		const std::vector<Mesh> *meshes;
+		unsigned int lod;
+		glm::mat4 matrix;
+	};
+
+	int _width;
+	int _height;
+	std::vector<float> _depth;
+	glm::mat4 _viewProjection;
+
+	std::vector<Occluder> _occluders;
+	// triangles of every occluder, filled in parallel
+	std::vector<std::vector<OcclusionTriangle> > _triangles;
+
+	/*  Stats of the last frame  */
+	size_t _triangleCount;
+	size_t _testedCount;
+	size_t _occludedCount;
+
+	void _SetupOccluder(const Occluder &occluder, std::vector<OcclusionTriangle> &triangles) const;
+	void _AddTriangle(const glm::vec4 &p0, const glm::vec4 &p1, const glm::vec4 &p2, std::vector<OcclusionTriangle> &triangles) const;
+	void _RasterizeBand(int firstRow, int endRow);
+	void _RasterizeTriangle(const OcclusionTriangle &triangle, int firstRow, int endRow);
+};
+
+void OcclusionCuller::Init(int width, int height)
+{
+	_width = (width + 3) & ~3;
+	_height = height;
+	_depth.assign((size_t)_width * _height, 1.0f);
+}
+
+void OcclusionCuller::Begin(const glm::mat4 &viewProjection)
+{
+	_viewProjection = viewProjection;
+	_occluders.clear();
+	std::fill(_depth.begin(), _depth.end(), 1.0f);
+	_triangleCount = 0;
+	_testedCount = 0;
+	_occludedCount = 0;
+}
+
+void OcclusionCuller::AddOccluder(const std::vector<Mesh> &meshes, unsigned int lod, const glm::mat4 &model)
+{
+	Occluder occluder = { &meshes, lod, model };
+	_occluders.push_back(occluder);
+}
+
+void OcclusionCuller::Rasterize(ThreadPool &pool)
+{
+	if (_occluders.empty())
+		return;
+
+	if (_triangles.size() < _occluders.size())
+		_triangles.resize(_occluders.size());
+	pool.ParallelFor(_occluders.size(), 1, [this](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			_SetupOccluder(_occluders[i], _triangles[i]);
+	});
+	for (size_t i = 0; i < _occluders.size(); i++)
+		_triangleCount += _triangles[i].size();
+
+	// bands own their rows, no two threads write the same pixel
+	const int band_height = 16;
+	int band_count = (_height + band_height - 1) / band_height;
+	pool.ParallelFor((size_t)band_count, 1, [this, band_height](size_t begin, size_t end) {
+		for (size_t band = begin; band < end; band++)
+			_RasterizeBand((int)band * band_height, std::min((int)band * band_height + band_height, _height));
+	});
+}
+
+void OcclusionCuller::_SetupOccluder(const Occluder &occluder, std::vector<OcclusionTriangle> &triangles) const
+{
+	triangles.clear();
+	glm::mat4 to_clip = _viewProjection * occluder.matrix;
+
+	std::vector<glm::vec4> clip;
+	// a coarser level only uses some of the vertices, each is transformed when its first triangle needs it
+	std::vector<unsigned char> transformed;
+	for (size_t m = 0; m < occluder.meshes->size(); m++)
+	{
+		const Mesh &mesh = (*occluder.meshes)[m];
+		clip.resize(mesh.GetVertexCount());
+		transformed.assign(mesh.GetVertexCount(), 0);
+
+		const MeshLod &level = mesh.GetLod(occluder.lod);
+		for (unsigned int i = level.indexOffset; i + 2 < level.indexOffset + level.indexCount; i += 3)
+		{
+			const glm::vec4 *corners[3];
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int vertex = mesh.GetIndex(i + k);
+				if (!transformed[vertex])
+				{
+					clip[vertex] = to_clip * glm::vec4(mesh.GetPosition(vertex), 1.0f);
+					transformed[vertex] = 1;
+				}
+				corners[k] = &clip[vertex];
+			}
+
+			// clip against the near plane (z = -w), giving up to four corners
+			glm::vec4 polygon[4];
+			int count = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				const glm::vec4 &a = *corners[k];
+				const glm::vec4 &b = *corners[(k + 1) % 3];
+				float da = a.z + a.w, db = b.z + b.w;
+				if (da >= 0.0f)
+					polygon[count++] = a;
+				if ((da >= 0.0f) != (db >= 0.0f))
+					polygon[count++] = a + (b - a) * (da / (da - db));
+			}
+			for (int k = 2; k < count; k++)
+				_AddTriangle(polygon[0], polygon[k - 1], polygon[k], triangles);
+		}
+	}
+}
+
+void OcclusionCuller::_AddTriangle(const glm::vec4 &p0, const glm::vec4 &p1, const glm::vec4 &p2, std::vector<OcclusionTriangle> &triangles) const
+{
+	const glm::vec4 *clip[3] = { &p0, &p1, &p2 };
+	float x[3], y[3], z[3];
+	for (int k = 0; k < 3; k++)
+	{
+		// on the near plane w can still reach zero for points at the camera
+		float w = std::max(clip[k]->w, 1e-6f);
+		x[k] = (clip[k]->x / w * 0.5f + 0.5f) * _width;
+		y[k] = (clip[k]->y / w * 0.5f + 0.5f) * _height;
+		z[k] = clip[k]->z / w;
+	}
+
+	// counter clockwise triangles face the camera, the others are hidden behind them anyway
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (!(area > 0.0f))
+		return;
+
+	OcclusionTriangle triangle;
+	triangle.minX = std::max((int)std::floor(std::min(x[0], std::min(x[1], x[2]))), 0);
+	triangle.maxX = std::min((int)std::ceil(std::max(x[0], std::max(x[1], x[2]))), _width - 1);
+	triangle.minY = std::max((int)std::floor(std::min(y[0], std::min(y[1], y[2]))), 0);
+	triangle.maxY = std::min((int)std::ceil(std::max(y[0], std::max(y[1], y[2]))), _height - 1);
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+		return;
+
+	for (int k = 0; k < 3; k++)
+	{
+		int a = (k + 1) % 3, b = (k + 2) % 3;
+		// edge opposite to corner k, positive on the side of k
+		triangle.edgeA[k] = y[a] - y[b];
+		triangle.edgeB[k] = x[b] - x[a];
+		triangle.edgeC[k] = x[a] * y[b] - x[b] * y[a];
+	}
+
+	// depth interpolates linearly over the screen in NDC
+	float inverse_area = 1.0f / area;
+	triangle.depthA = (triangle.edgeA[0] * z[0] + triangle.edgeA[1] * z[1] + triangle.edgeA[2] * z[2]) * inverse_area;
+	triangle.depthB = (triangle.edgeB[0] * z[0] + triangle.edgeB[1] * z[1] + triangle.edgeB[2] * z[2]) * inverse_area;
+	triangle.depthC = (triangle.edgeC[0] * z[0] + triangle.edgeC[1] * z[1] + triangle.edgeC[2] * z[2]) * inverse_area;
+
+	triangles.push_back(triangle);
+}
+
+void OcclusionCuller::_RasterizeBand(int firstRow, int endRow)
+{
+	for (size_t i = 0; i < _occluders.size(); i++)
+	{
+		const std::vector<OcclusionTriangle> &triangles = _triangles[i];
+		for (size_t t = 0; t < triangles.size(); t++)
+		{
+			if (triangles[t].maxY >= firstRow && triangles[t].minY < endRow)
+				_RasterizeTriangle(triangles[t], firstRow, endRow);
+		}
+	}
+}
+
+void OcclusionCuller::_RasterizeTriangle(const OcclusionTriangle &triangle, int firstRow, int endRow)
+{
+	int min_y = std::max(triangle.minY, firstRow);
+	int max_y = std::min(triangle.maxY, endRow - 1);
+	// four pixel groups start at a multiple of four, the buffer width is one too
+	int min_x = triangle.minX & ~3;
+
+#ifdef OCCLUSION_USE_SSE
+	const __m128 zero = _mm_setzero_ps();
+	__m128 a[3], b[3], c[3];
+	for (int k = 0; k < 3; k++)
+	{
+		a[k] = _mm_set1_ps(triangle.edgeA[k]);
+		b[k] = _mm_set1_ps(triangle.edgeB[k]);
+		c[k] = _mm_set1_ps(triangle.edgeC[k]);
+	}
+	__m128 depth_a = _mm_set1_ps(triangle.depthA);
+	__m128 depth_b = _mm_set1_ps(triangle.depthB);
+	__m128 depth_c = _mm_set1_ps(triangle.depthC);
+	__m128 step_x = _mm_set1_ps(4.0f);
+
+	for (int y = min_y; y <= max_y; y++)
+	{
+		__m128 py = _mm_set1_ps((float)y + 0.5f);
+		__m128 px = _mm_add_ps(_mm_set1_ps((float)min_x + 0.5f), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+
+		// E(x, y) = a * x + (b * y + c), the row part stays constant
+		__m128 row[3];
+		for (int k = 0; k < 3; k++)
+			row[k] = _mm_add_ps(_mm_mul_ps(b[k], py), c[k]);
+		__m128 depth_row = _mm_add_ps(_mm_mul_ps(depth_b, py), depth_c);
+
+		float *pixels = &_depth[(size_t)y * _width];
+		for (int x = min_x; x <= triangle.maxX; x += 4, px = _mm_add_ps(px, step_x))
+		{
+			__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a[0], px), row[0]), zero);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a[1], px), row[1]), zero));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a[2], px), row[2]), zero));
+			if (_mm_movemask_ps(inside) == 0)
+				continue;
+
+			__m128 depth = _mm_add_ps(_mm_mul_ps(depth_a, px), depth_row);
+			__m128 previous = _mm_loadu_ps(pixels + x);
+			__m128 nearest = _mm_min_ps(previous, depth);
+			_mm_storeu_ps(pixels + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, previous)));
+		}
+	}
+#else
+	for (int y = min_y; y <= max_y; y++)
+	{
+		float py = (float)y + 0.5f;
+		float *pixels = &_depth[(size_t)y * _width];
+		for (int x = min_x; x <= triangle.maxX; x++)
+		{
+			float px = (float)x + 0.5f;
+			bool inside = true;
+			for (int k = 0; k < 3; k++)
+				inside = inside && triangle.edgeA[k] * px + triangle.edgeB[k] * py + triangle.edgeC[k] >= 0.0f;
+			if (!inside)
+				continue;
+
+			float depth = triangle.depthA * px + triangle.depthB * py + triangle.depthC;
+			pixels[x] = std::min(pixels[x], depth);
+		}
+	}
+#endif
+}
+
+bool OcclusionCuller::IsVisible(const glm::vec3 &center, const glm::vec3 &extents) const
+{
+	float min_x = 1e30f, max_x = -1e30f, min_y = 1e30f, max_y = -1e30f, min_z = 1e30f;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		glm::vec3 offset((corner & 1) ? extents.x : -extents.x, (corner & 2) ? extents.y : -extents.y, (corner & 4) ? extents.z : -extents.z);
+		glm::vec4 clip = _viewProjection * glm::vec4(center + offset, 1.0f);
+
+		// boxes reaching the near plane are too close to be hidden
+		if (clip.w <= 1e-6f || clip.z < -clip.w)
+			return true;
+
+		float x = (clip.x / clip.w * 0.5f + 0.5f) * _width;
+		float y = (clip.y / clip.w * 0.5f + 0.5f) * _height;
+		min_x = std::min(min_x, x); max_x = std::max(max_x, x);
+		min_y = std::min(min_y, y); max_y = std::max(max_y, y);
+		min_z = std::min(min_z, clip.z / clip.w);
+	}
+
+	// every pixel the box overlaps, not only the covered centers
+	int first_x = std::max((int)std::floor(min_x), 0);
+	int last_x = std::min((int)std::ceil(max_x) - 1, _width - 1);
+	int first_y = std::max((int)std::floor(min_y), 0);
+	int last_y = std::min((int)std::ceil(max_y) - 1, _height - 1);
+	if (first_x > last_x || first_y > last_y)
+		return true;
+
+	for (int y = first_y; y <= last_y; y++)
+	{
+		const float *pixels = &_depth[(size_t)y * _width];
+		int x = first_x;
+#ifdef OCCLUSION_USE_SSE
+		__m128 box_depth = _mm_set1_ps(min_z);
+		for (; x + 3 <= last_x; x += 4)
+		{
+			if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(pixels + x), box_depth)) != 0)
+				return true;
+		}
+#endif
+		for (; x <= last_x; x++)
+		{
+			if (pixels[x] >= min_z)
+				return true;
+		}
+	}
+	return false;
+}
+
+void OcclusionCuller::Cull(const AABBBatch &batch, unsigned char *visible, ThreadPool &pool)
+{
+	if (_occluders.empty())
+		return;
+
+	size_t count = batch.Size();
+	for (size_t i = 0; i < count; i++)
+		_testedCount += visible[i] ? 1 : 0;
+
+	pool.ParallelFor(count, 16, [this, &batch, visible](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			if (visible[i] && !IsVisible(glm::vec3(batch.centerX[i], batch.centerY[i], batch.centerZ[i]),
+				glm::vec3(batch.extentX[i], batch.extentY[i], batch.extentZ[i])))
+			{
+				visible[i] = 0;
+			}
+		}
+	});
+
+	size_t still_visible = 0;
+	for (size_t i = 0; i < count; i++)
+		still_visible += visible[i] ? 1 : 0;
+	_occludedCount += _testedCount - still_visible;
+}
+
+void OcclusionCuller::PrintStats()
+{
+	std::cout << "Occlusion Culling: " << _width << "x" << _height << " depth, " << _occluders.size() << " occluders, "
+		<< _triangleCount << " triangles, " << _occludedCount << " of " << _testedCount << " boxes hidden" << std::endl;
+}
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef PROGRAM_BINARY_CACHE_H
+#define PROGRAM_BINARY_CACHE_H
+
+#include "Include/glad/glad.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "GLExtensions.h"
+#include "StringTable.h"
+
+// ProgramBinaryCache keeps the driver's binary of every linked program on disk, so later launches
+// skip compiling and linking. A binary is looked up by a hash of the shader sources and of the GL
+// vendor, renderer and version strings: editing a shader or updating the driver simply misses.
+// Drivers may still reject a binary they wrote, callers compile from source whenever Load fails.
+class ProgramBinaryCache {
+public:
+	// Key of a program made of these sources on the current context.
+	static std::string MakeKey(const std::string &vertexSource, const std::string &fragmentSource, const std::string &geometrySource);
+
+	// Fills program (created, not linked) from the cached binary, false when there is none or it does not link.
+	static bool Load(GLuint program, const std::string &key);
+
+	// Writes the binary of the linked program, it has to be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT.
+	static void Store(GLuint program, const std::string &key);
+
+private:
+	ProgramBinaryCache() { }
+
+	// written in front of every binary, the key is repeated to catch mismatching files
+	struct _Header {
+		uint32_t magic;
+		uint32_t format;
+		uint32_t length;
+		uint64_t key;
+	};
+	static const uint32_t _MAGIC = 0x42505343; // "CSPB"
+
+	static uint64_t _Hash(uint64_t hash, const std::string &text);
+	static std::string _Path(const std::string &key);
+	static uint64_t _KeyValue(const std::string &key);
+};
+
+std::string ProgramBinaryCache::MakeKey(const std::string &vertexSource, const std::string &fragmentSource, const std::string &geometrySource)
+{
+	// FNV-1a, with the stage sources separated so moving text between them changes the key
+	uint64_t hash = 14695981039346656037ULL;
+	hash = _Hash(hash, vertexSource);
+	hash = _Hash(hash, "\x01");
+	hash = _Hash(hash, fragmentSource);
+	hash = _Hash(hash, "\x01");
+	hash = _Hash(hash, geometrySource);
+
+	const GLenum driver_strings[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+	for (int i = 0; i < 3; i++)
+	{
+		const char *value = (const char*)glGetString(driver_strings[i]);
+		hash = _Hash(hash, "\x01");
+		hash = _Hash(hash, value != NULL ? value : "");
+	}
+
+	std::stringstream key;
+	key << std::hex << std::setw(16) << std::setfill('0') << hash;
+	return key.str();
+}
+
+bool ProgramBinaryCache::Load(GLuint program, const std::string &key)
+{
+	if (!GLExtensions::ProgramBinaries)
+		return false;
+
+	std::ifstream file(_Path(key).c_str(), std::ios::binary);
+	if (!file)
+		return false;
+
+	_Header header;
+	file.read((char*)&header, sizeof(header));
+	if (!file || header.magic != _MAGIC || header.key != _KeyValue(key) || header.length == 0)
+		return false;
+
+	std::vector<char> binary(header.length);
+	file.read(binary.data(), header.length);
+	if (!file)
+		return false;
+
+	GLExtensions::ProgramBinary(program, (GLenum)header.format, binary.data(), (GLsizei)header.length);
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked != GL_TRUE)
+	{
+		std::cout << "ProgramBinaryCache: binary " << key << " was rejected, compiling from source" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void ProgramBinaryCache::Store(GLuint program, const std::string &key)
+{
+	if (!GLExtensions::ProgramBinaries)
+		return;
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (linked != GL_TRUE || length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	GLsizei written = 0;
+	GLExtensions::GetProgramBinary(program, length, &written, &format, binary.data());
+	if (written <= 0)
+		return;
+
+#ifdef _WIN32
+	_mkdir(DIRECTORY_SHADER_CACHE.c_str());
+#else
+	mkdir(DIRECTORY_SHADER_CACHE.c_str(), 0755);
+#endif
+
+	std::ofstream file(_Path(key).c_str(), std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout << "ProgramBinaryCache: cannot write " << _Path(key) << std::endl;
+		return;
+	}
+
+	_Header header = { _MAGIC, (uint32_t)format, (uint32_t)written, _KeyValue(key) };
+	file.write((const char*)&header, sizeof(header));
+	file.write(binary.data(), written);
+}
+
+uint64_t ProgramBinaryCache::_Hash(uint64_t hash, const std::string &text)
+{
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		hash ^= (unsigned char)text[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+std::string ProgramBinaryCache::_Path(const std::string &key)
+{
+	return DIRECTORY_SHADER_CACHE + "/" + key + ".bin";
+}
+
+uint64_t ProgramBinaryCache::_KeyValue(const std::string &key)
+{
+	uint64_t value = 0;
+	std::stringstream stream(key);
+	stream >> std::hex >> value;
+	return value;
+}
+
+#endif
@@ -0,0 +1,1500 @@
+#ifndef RECORDING_RENDER_DEVICE_H
+#define RECORDING_RENDER_DEVICE_H
+
+#include "Include/glad/glad.h"
+#include <GLFW/glfw3.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+#include "RenderDevice.h"
+#include "GLExtensions.h"
+#include "BlockCompressor.h"
+
+// What one frame cost on the recording device.
+struct RecordingFrameStats {
+	unsigned int drawCalls;
+	unsigned int instances;
+	// binds, program and fixed function changes that reached the device
+	unsigned int stateChanges;
+	// the part of stateChanges that set what was already set
+	unsigned int redundantStateChanges;
+	// buffer and texture data sent
+	size_t uploadBytes;
+};
+
+// RecordingRenderDevice replaces the driver with GL functions that only keep track of the objects and state
+// they are given. It needs no window or GPU, so the complete frame (culling, render queue, HUD, skybox) can
+// run on a build machine. Every call is validated (unknown names, missing bindings, out of range uploads and
+// draws), buffer and texture memory is tracked, and draws and state changes are counted per frame.
+// A fixed number of frames is rendered with a fixed time step and no keys pressed.
+// The context reports GL 3.3 unless a newer version is given; from 4.4 on GLExtensions also finds multi draw
+// indirect, persistent mapping and program binaries, so those paths are recorded and validated as well.
+// The recorded state is global like the GL context it stands for, so only one device can exist at a time,
+// Create starts from an empty context. Every GL function the engine calls needs an entry in the table of
+// GetProcAddress.
+class RecordingRenderDevice : public RenderDevice {
+public:
+	RecordingRenderDevice(unsigned int frameCount, int majorVersion = 3, int minorVersion = 3)
+		: _frameCount(frameCount), _closeRequested(false), _requestedMajor(majorVersion), _requestedMinor(minorVersion) { }
+
+	bool Create(const char *title, unsigned int width, unsigned int height);
+	void *GetProcAddress(const char *name);
+	void SetCallbacks(GLFWframebuffersizefun framebufferSize, GLFWcursorposfun cursorPosition, GLFWscrollfun scroll) { }
+
+	bool ShouldClose() { return _closeRequested || _frame >= _frameCount; }
+	void RequestClose() { _closeRequested = true; }
+	void Present();
+	double GetTime() { return _frame / 60.0; }
+	bool IsKeyPressed(int key) { return false; }
+	void Destroy();
+
+	/*  Results  */
+	static const RecordingFrameStats &GetLastFrame() { return _lastFrame; }
+	// the highest count of every field over all frames, not one frame
+	static const RecordingFrameStats &GetMaxFrame() { return _maxFrame; }
+	static unsigned int GetFrameCount() { return _frame; }
+	static unsigned int GetErrorCount() { return _errorCount; }
+	static size_t GetBufferBytes();
+	static size_t GetTextureBytes();
+
+	static void PrintReport();
+
+private:
+	struct TextureRecord {
+		GLenum target;
+		int width, height;
+		// layers of array textures, 1 otherwise
+		int depth;
+		// of level 0
+		GLenum internalFormat;
+		bool mipmapped;
+		// level & face to bytes
+		std::map<std::pair<GLenum, GLint>, size_t> images;
+	};
+
+	struct ProgramRecord {
+		bool linked;
+		std::unordered_map<std::string, GLint> uniforms;
+	};
+
+	// CPU memory handed out by glMapBufferRange
+	struct MappingRecord {
+		size_t offset;
+		// stays mapped while the buffer is drawn from, what is written to it is not seen
+		bool persistent;
+		std::vector<unsigned char> memory;
+	};
+
+	unsigned int _frameCount;
+	bool _closeRequested;
+	int _requestedMajor, _requestedMinor;
+
+	/*  Context  */
+	static int _majorVersion, _minorVersion;
+	static std::string _versionString;
+
+	/*  Objects  */
+	static GLuint _nextName;
+	static std::unordered_map<GLuint, size_t> _buffers;
+	// buffers created with glBufferStorage, their size is fixed
+	static std::unordered_set<GLuint> _immutableBuffers;
+	// until the buffer is unmapped
+	static std::unordered_map<GLuint, MappingRecord> _mappings;
+	static std::unordered_map<GLuint, TextureRecord> _textures;
+	// vertex array to its element buffer
+	static std::unordered_map<GLuint, GLuint> _vertexArrays;
+	static std::unordered_map<GLuint, bool> _shaders;
+	static std::unordered_map<GLuint, ProgramRecord> _programs;
+	static std::unordered_set<GLuint> _syncs;
+
+	/*  Context State  */
+	static GLuint _program;
+	static GLuint _vertexArray;
+	static GLuint _activeTexture;
+	static std::map<GLenum, GLuint> _bufferBindings;
+	static std::map<std::pair<GLuint, GLenum>, GLuint> _textureBindings;
+	static std::map<GLenum, GLint> _state;
+
+	/*  Counters  */
+	static unsigned int _frame;
+	static RecordingFrameStats _current;
+	static RecordingFrameStats _lastFrame;
+	static RecordingFrameStats _maxFrame;
+	static RecordingFrameStats _totalFrames;
+	static unsigned int _errorCount;
+
+	// the loader handed to glad
+	static void *_GetProcAddress(const char *name);
+
+	// forgets every object, binding and counter of the previous device
+	static void _Reset();
+	static bool _HasVersion(int major, int minor);
+
+	static void _Error(const char *function, const std::string &message);
+	static void _StateChange(GLenum state, GLint value);
+	static GLuint *_BufferBinding(GLenum target);
+	static TextureRecord *_BoundTexture(GLenum target, const char *function);
+	static bool _ValidateDraw(const char *function);
+	static bool _ValidateElements(const char *function, GLsizei count, GLenum type, const void *indices);
+	static void _ValidateUniform(const char *function, GLint location);
+	static size_t _PixelBytes(GLenum format, GLenum type);
+
+	/*  Recording GL Entry Points  */
+	static const GLubyte *APIENTRY _GetString(GLenum name);
+	static const GLubyte *APIENTRY _GetStringi(GLenum name, GLuint index);
+	static void APIENTRY _GetIntegerv(GLenum name, GLint *data);
+	static GLenum APIENTRY _GetError();
+
+	static void APIENTRY _ClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) { }
+	static void APIENTRY _Clear(GLbitfield mask) { }
+	static void APIENTRY _Viewport(GLint x, GLint y, GLsizei width, GLsizei height) { }
+	static void APIENTRY _Enable(GLenum cap) { _StateChange(cap, 1); }
+	static void APIENTRY _Disable(GLenum cap) { _StateChange(cap, 0); }
+	static void APIENTRY _DepthFunc(GLenum func) { _StateChange(GL_DEPTH_FUNC, (GLint)func); }
+	static void APIENTRY _DepthMask(GLboolean flag) { _StateChange(GL_DEPTH_WRITEMASK, flag); }
+	static void APIENTRY _ColorMask(GLboolean r, GLboolean g, GLboolean b, GLboolean a) { _StateChange(GL_COLOR_WRITEMASK, r | (g << 1) | (b << 2) | (a << 3)); }
+	static void APIENTRY _PixelStorei(GLenum name, GLint param) { }
+
+	static void APIENTRY _GenBuffers(GLsizei count, GLuint *buffers);
+	static void APIENTRY _DeleteBuffers(GLsizei count, const GLuint *buffers);
+	static void APIENTRY _BindBuffer(GLenum target, GLuint buffer);
+	static void APIENTRY _BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	static void APIENTRY _BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	static void APIENTRY _BufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage);
+	static void APIENTRY _BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data);
+	static void APIENTRY _CopyBufferSubData(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size);
+	static void *APIENTRY _MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+	static GLboolean APIENTRY _UnmapBuffer(GLenum target);
+	static void APIENTRY _BufferStorage(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+	static GLsync APIENTRY _FenceSync(GLenum condition, GLbitfield flags);
+	static GLenum APIENTRY _ClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout);
+	static void APIENTRY _DeleteSync(GLsync sync);
+
+	static void APIENTRY _GenVertexArrays(GLsizei count, GLuint *arrays);
+	static void APIENTRY _DeleteVertexArrays(GLsizei count, const GLuint *arrays);
+	static void APIENTRY _BindVertexArray(GLuint array);
+	static void APIENTRY _EnableVertexAttribArray(GLuint index);
+	static void APIENTRY _DisableVertexAttribArray(GLuint index) { }
+	static void APIENTRY _VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer);
+	static void APIENTRY _VertexAttribDivisor(GLuint index, GLuint divisor) { }
+
+	static void APIENTRY _GenTextures(GLsizei count, GLuint *textures);
+	static void APIENTRY _DeleteTextures(GLsizei count, const GLuint *textures);
+	static void APIENTRY _ActiveTexture(GLenum texture);
+	static void APIENTRY _BindTexture(GLenum target, GLuint texture);
+	static void APIENTRY _TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void *pixels);
+	static void APIENTRY _TexImage3D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void *pixels);
+	static void APIENTRY _TexSubImage3D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void *pixels);
+	static void APIENTRY _CompressedTexImage2D(GLenum target, GLint level, GLenum internalFormat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const void *data);
+	static void APIENTRY _CompressedTexImage3D(GLenum target, GLint level, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLsizei imageSize, const void *data);
+	static void APIENTRY _CompressedTexSubImage3D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLsizei imageSize, const void *data);
+	static void APIENTRY _TexParameteri(GLenum target, GLenum name, GLint param);
+	static void APIENTRY _GenerateMipmap(GLenum target);
+	static void APIENTRY _GetTexLevelParameteriv(GLenum target, GLint level, GLenum name, GLint *params);
+	static void APIENTRY _GetTexImage(GLenum target, GLint level, GLenum format, GLenum type, void *pixels);
+	static void APIENTRY _GetCompressedTexImage(GLenum target, GLint level, void *pixels);
+
+	static GLuint APIENTRY _CreateShader(GLenum type);
+	static void APIENTRY _ShaderSource(GLuint shader, GLsizei count, const GLchar *const *source, const GLint *length);
+	static void APIENTRY _CompileShader(GLuint shader);
+	static void APIENTRY _GetShaderiv(GLuint shader, GLenum name, GLint *params);
+	static void APIENTRY _GetShaderInfoLog(GLuint shader, GLsizei bufferSize, GLsizei *length, GLchar *infoLog);
+	static void APIENTRY _DeleteShader(GLuint shader);
+	static GLuint APIENTRY _CreateProgram();
+	static void APIENTRY _AttachShader(GLuint program, GLuint shader);
+	static void APIENTRY _LinkProgram(GLuint program);
+	static void APIENTRY _GetProgramiv(GLuint program, GLenum name, GLint *params);
+	static void APIENTRY _GetProgramInfoLog(GLuint program, GLsizei bufferSize, GLsizei *length, GLchar *infoLog);
+	static void APIENTRY _DeleteProgram(GLuint program);
+	static void APIENTRY _UseProgram(GLuint program);
+	static GLint APIENTRY _GetUniformLocation(GLuint program, const GLchar *name);
+	static GLuint APIENTRY _GetUniformBlockIndex(GLuint program, const GLchar *name);
+	static void APIENTRY _UniformBlockBinding(GLuint program, GLuint blockIndex, GLuint binding);
+	static void APIENTRY _ProgramParameteri(GLuint program, GLenum name, GLint value);
+	static void APIENTRY _GetProgramBinary(GLuint program, GLsizei bufferSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+	static void APIENTRY _ProgramBinary(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+
+	static void APIENTRY _Uniform1i(GLint location, GLint v0) { _ValidateUniform("glUniform1i", location); }
+	static void APIENTRY _Uniform1f(GLint location, GLfloat v0) { _ValidateUniform("glUniform1f", location); }
+	static void APIENTRY _Uniform2f(GLint location, GLfloat v0, GLfloat v1) { _ValidateUniform("glUniform2f", location); }
+	static void APIENTRY _Uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) { _ValidateUniform("glUniform3f", location); }
+	static void APIENTRY _Uniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) { _ValidateUniform("glUniform4f", location); }
+	static void APIENTRY _Uniform2fv(GLint location, GLsizei count, const GLfloat *value) { _ValidateUniform("glUniform2fv", location); }
+	static void APIENTRY _Uniform3fv(GLint location, GLsizei count, const GLfloat *value) { _ValidateUniform("glUniform3fv", location); }
+	static void APIENTRY _Uniform4fv(GLint location, GLsizei count, const GLfloat *value) { _ValidateUniform("glUniform4fv", location); }
+	static void APIENTRY _UniformMatrix2fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) { _ValidateUniform("glUniformMatrix2fv", location); }
+	static void APIENTRY _UniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) { _ValidateUniform("glUniformMatrix3fv", location); }
+	static void APIENTRY _UniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) { _ValidateUniform("glUniformMatrix4fv", location); }
+
+	static void APIENTRY _DrawArrays(GLenum mode, GLint first, GLsizei count);
+	static void APIENTRY _DrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices);
+	static void APIENTRY _DrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void *indices, GLint baseVertex);
+	static void APIENTRY _DrawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instanceCount, GLint baseVertex);
+	static void APIENTRY _MultiDrawElementsIndirect(GLenum mode, GLenum type, const void *indirect, GLsizei drawCount, GLsizei stride);
+};
+
+// the binary every linked program hands out, glProgramBinary only takes this one back
+static const char RECORDING_PROGRAM_BINARY[] = "CS405 recorded program";
+const GLenum RECORDING_PROGRAM_BINARY_FORMAT = 0xC405;
+
+// Instantiate static variables
+int RecordingRenderDevice::_majorVersion = 3;
+int RecordingRenderDevice::_minorVersion = 3;
+std::string RecordingRenderDevice::_versionString = "3.3.0 Core Profile";
+GLuint RecordingRenderDevice::_nextName = 1;
+std::unordered_map<GLuint, size_t> RecordingRenderDevice::_buffers;
+std::unordered_set<GLuint> RecordingRenderDevice::_immutableBuffers;
+std::unordered_map<GLuint, RecordingRenderDevice::MappingRecord> RecordingRenderDevice::_mappings;
+std::unordered_map<GLuint, RecordingRenderDevice::TextureRecord> RecordingRenderDevice::_textures;
+std::unordered_map<GLuint, GLuint> RecordingRenderDevice::_vertexArrays;
+std::unordered_map<GLuint, bool> RecordingRenderDevice::_shaders;
+std::unordered_map<GLuint, RecordingRenderDevice::ProgramRecord> RecordingRenderDevice::_programs;
+std::unordered_set<GLuint> RecordingRenderDevice::_syncs;
+GLuint RecordingRenderDevice::_program = 0;
+GLuint RecordingRenderDevice::_vertexArray = 0;
+GLuint RecordingRenderDevice::_activeTexture = 0;
+std::map<GLenum, GLuint> RecordingRenderDevice::_bufferBindings;
+std::map<std::pair<GLuint, GLenum>, GLuint> RecordingRenderDevice::_textureBindings;
+std::map<GLenum, GLint> RecordingRenderDevice::_state;
+unsigned int RecordingRenderDevice::_frame = 0;
+RecordingFrameStats RecordingRenderDevice::_current = {};
+RecordingFrameStats RecordingRenderDevice::_lastFrame = {};
+RecordingFrameStats RecordingRenderDevice::_maxFrame = {};
+RecordingFrameStats RecordingRenderDevice::_totalFrames = {};
+unsigned int RecordingRenderDevice::_errorCount = 0;
+
+bool RecordingRenderDevice::Create(const char *title, unsigned int width, unsigned int height)
+{
+	_Reset();
+	_majorVersion = _requestedMajor;
+	_minorVersion = _requestedMinor;
+	_versionString = std::to_string(_majorVersion) + "." + std::to_string(_minorVersion) + ".0 Core Profile";
+
+	std::cout << "RecordingRenderDevice: rendering " << _frameCount << " frames of \"" << title << "\" ("
+		<< width << "x" << height << ") on GL " << _majorVersion << "." << _minorVersion << " without a GPU" << std::endl;
+
+	if (!gladLoadGLLoader((GLADloadproc)_GetProcAddress))
+	{
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void *RecordingRenderDevice::GetProcAddress(const char *name)
+{
+	return _GetProcAddress(name);
+}
+
+void RecordingRenderDevice::Present()
+{
+	_lastFrame = _current;
+
+	_maxFrame.drawCalls = std::max(_maxFrame.drawCalls, _current.drawCalls);
+	_maxFrame.instances = std::max(_maxFrame.instances, _current.instances);
+	_maxFrame.stateChanges = std::max(_maxFrame.stateChanges, _current.stateChanges);
+	_maxFrame.redundantStateChanges = std::max(_maxFrame.redundantStateChanges, _current.redundantStateChanges);
+	_maxFrame.uploadBytes = std::max(_maxFrame.uploadBytes, _current.uploadBytes);
+
+	_totalFrames.drawCalls += _current.drawCalls;
+	_totalFrames.instances += _current.instances;
+	_totalFrames.stateChanges += _current.stateChanges;
+	_totalFrames.redundantStateChanges += _current.redundantStateChanges;
+	_totalFrames.uploadBytes += _current.uploadBytes;
+
+	_current = RecordingFrameStats();
+	_frame++;
+}
+
+void RecordingRenderDevice::Destroy()
+{
+	PrintReport();
+}
+
+size_t RecordingRenderDevice::GetBufferBytes()
+{
+	size_t bytes = 0;
+	for (auto it = _buffers.begin(); it != _buffers.end(); ++it)
+		bytes += it->second;
+	return bytes;
+}
+
+size_t RecordingRenderDevice::GetTextureBytes()
+{
+	size_t bytes = 0;
+	for (auto it = _textures.begin(); it != _textures.end(); ++it)
+	{
+		size_t texture_bytes = 0;
+		for (auto image = it->second.images.begin(); image != it->second.images.end(); ++image)
+			texture_bytes += image->second;
+		// a full mip chain adds a third
+		bytes += it->second.mipmapped ? texture_bytes * 4 / 3 : texture_bytes;
+	}
+	return bytes;
+}
+
+void RecordingRenderDevice::PrintReport()
+{
+	unsigned int frames = std::max(_frame, 1u);
+	std::cout << "Recording report: " << _frame << " frames on GL " << _majorVersion << "." << _minorVersion << ", "
+		<< _errorCount << " validation errors" << std::endl;
+	std::cout << "  draw calls     avg " << _totalFrames.drawCalls / frames << " max " << _maxFrame.drawCalls << std::endl;
+	std::cout << "  instances      avg " << _totalFrames.instances / frames << " max " << _maxFrame.instances << std::endl;
+	std::cout << "  state changes  avg " << _totalFrames.stateChanges / frames << " max " << _maxFrame.stateChanges
+		<< " (redundant avg " << _totalFrames.redundantStateChanges / frames << ")" << std::endl;
+	std::cout << "  uploads        avg " << _totalFrames.uploadBytes / frames << " B max " << _maxFrame.uploadBytes << " B" << std::endl;
+	std::cout << "  resident       " << _buffers.size() << " buffers " << GetBufferBytes() / 1024 << " KB, "
+		<< _textures.size() << " textures " << GetTextureBytes() / 1024 << " KB" << std::endl;
+}
+
+void *RecordingRenderDevice::_GetProcAddress(const char *name)
+{
+	struct EntryPoint {
+		const char *name;
+		void *function;
+	};
+	static const EntryPoint entry_points[] = {
+		{ "glGetString", (void*)_GetString },
+		{ "glGetStringi", (void*)_GetStringi },
+		{ "glGetIntegerv", (void*)_GetIntegerv },
+		{ "glGetError", (void*)_GetError },
+		{ "glClearColor", (void*)_ClearColor },
+		{ "glClear", (void*)_Clear },
+		{ "glViewport", (void*)_Viewport },
+		{ "glEnable", (void*)_Enable },
+		{ "glDisable", (void*)_Disable },
+		{ "glDepthFunc", (void*)_DepthFunc },
+		{ "glDepthMask", (void*)_DepthMask },
+		{ "glColorMask", (void*)_ColorMask },
+		{ "glPixelStorei", (void*)_PixelStorei },
+		{ "glGenBuffers", (void*)_GenBuffers },
+		{ "glDeleteBuffers", (void*)_DeleteBuffers },
+		{ "glBindBuffer", (void*)_BindBuffer },
+		{ "glBindBufferBase", (void*)_BindBufferBase },
+		{ "glBindBufferRange", (void*)_BindBufferRange },
+		{ "glBufferData", (void*)_BufferData },
+		{ "glBufferSubData", (void*)_BufferSubData },
+		{ "glCopyBufferSubData", (void*)_CopyBufferSubData },
+		{ "glMapBufferRange", (void*)_MapBufferRange },
+		{ "glUnmapBuffer", (void*)_UnmapBuffer },
+		{ "glBufferStorage", (void*)_BufferStorage },
+		{ "glFenceSync", (void*)_FenceSync },
+		{ "glClientWaitSync", (void*)_ClientWaitSync },
+		{ "glDeleteSync", (void*)_DeleteSync },
+		{ "glGenVertexArrays", (void*)_GenVertexArrays },
+		{ "glDeleteVertexArrays", (void*)_DeleteVertexArrays },
+		{ "glBindVertexArray", (void*)_BindVertexArray },
+		{ "glEnableVertexAttribArray", (void*)_EnableVertexAttribArray },
+		{ "glDisableVertexAttribArray", (void*)_DisableVertexAttribArray },
+		{ "glVertexAttribPointer", (void*)_VertexAttribPointer },
+		{ "glVertexAttribDivisor", (void*)_VertexAttribDivisor },
+		{ "glGenTextures", (void*)_GenTextures },
+		{ "glDeleteTextures", (void*)_DeleteTextures },
+		{ "glActiveTexture", (void*)_ActiveTexture },
+		{ "glBindTexture", (void*)_BindTexture },
+		{ "glTexImage2D", (void*)_TexImage2D },
+		{ "glTexImage3D", (void*)_TexImage3D },
+		{ "glTexSubImage3D", (void*)_TexSubImage3D },
+		{ "glCompressedTexImage2D", (void*)_CompressedTexImage2D },
+		{ "glCompressedTexImage3D", (void*)_CompressedTexImage3D },
+		{ "glCompressedTexSubImage3D", (void*)_CompressedTexSubImage3D },
+		{ "glTexParameteri", (void*)_TexParameteri },
+		{ "glGenerateMipmap", (void*)_GenerateMipmap },
+		{ "glGetTexLevelParameteriv", (void*)_GetTexLevelParameteriv },
+		{ "glGetTexImage", (void*)_GetTexImage },
+		{ "glGetCompressedTexImage", (void*)_GetCompressedTexImage },
+		{ "glCreateShader", (void*)_CreateShader },
+		{ "glShaderSource", (void*)_ShaderSource },
+		{ "glCompileShader", (void*)_CompileShader },
+		{ "glGetShaderiv", (void*)_GetShaderiv },
+		{ "glGetShaderInfoLog", (void*)_GetShaderInfoLog },
+		{ "glDeleteShader", (void*)_DeleteShader },
+		{ "glCreateProgram", (void*)_CreateProgram },
+		{ "glAttachShader", (void*)_AttachShader },
+		{ "glLinkProgram", (void*)_LinkProgram },
+		{ "glGetProgramiv", (void*)_GetProgramiv },
+		{ "glGetProgramInfoLog", (void*)_GetProgramInfoLog },
+		{ "glDeleteProgram", (void*)_DeleteProgram },
+		{ "glUseProgram", (void*)_UseProgram },
+		{ "glGetUniformLocation", (void*)_GetUniformLocation },
+		{ "glGetUniformBlockIndex", (void*)_GetUniformBlockIndex },
+		{ "glUniformBlockBinding", (void*)_UniformBlockBinding },
+		{ "glProgramParameteri", (void*)_ProgramParameteri },
+		{ "glGetProgramBinary", (void*)_GetProgramBinary },
+		{ "glProgramBinary", (void*)_ProgramBinary },
+		{ "glUniform1i", (void*)_Uniform1i },
+		{ "glUniform1f", (void*)_Uniform1f },
+		{ "glUniform2f", (void*)_Uniform2f },
+		{ "glUniform3f", (void*)_Uniform3f },
+		{ "glUniform4f", (void*)_Uniform4f },
+		{ "glUniform2fv", (void*)_Uniform2fv },
+		{ "glUniform3fv", (void*)_Uniform3fv },
+		{ "glUniform4fv", (void*)_Uniform4fv },
+		{ "glUniformMatrix2fv", (void*)_UniformMatrix2fv },
+		{ "glUniformMatrix3fv", (void*)_UniformMatrix3fv },
+		{ "glUniformMatrix4fv", (void*)_UniformMatrix4fv },
+		{ "glDrawArrays", (void*)_DrawArrays },
+		{ "glDrawElements", (void*)_DrawElements },
+		{ "glDrawElementsBaseVertex", (void*)_DrawElementsBaseVertex },
+		{ "glDrawElementsInstancedBaseVertex", (void*)_DrawElementsInstancedBaseVertex },
+		{ "glMultiDrawElementsIndirect", (void*)_MultiDrawElementsIndirect },
+	};
+
+	for (unsigned int i = 0; i < sizeof(entry_points) / sizeof(entry_points[0]); i++)
+	{
+		if (std::strcmp(entry_points[i].name, name) == 0)
+			return entry_points[i].function;
+	}
+	// glad asks for every 3.3 function, the ones the engine never calls stay unresolved
+	return NULL;
+}
+
+void RecordingRenderDevice::_Reset()
+{
+	_nextName = 1;
+	_buffers.clear();
+	_immutableBuffers.clear();
+	_mappings.clear();
+	_textures.clear();
+	_vertexArrays.clear();
+	_shaders.clear();
+	_programs.clear();
+	_syncs.clear();
+	_program = 0;
+	_vertexArray = 0;
+	_activeTexture = 0;
+	_bufferBindings.clear();
+	_textureBindings.clear();
+	_state.clear();
+	_frame = 0;
+	_current = RecordingFrameStats();
+	_lastFrame = RecordingFrameStats();
+	_maxFrame = RecordingFrameStats();
+	_totalFrames = RecordingFrameStats();
+	_errorCount = 0;
+}
+
+bool RecordingRenderDevice::_HasVersion(int major, int minor)
+{
+	return _majorVersion > major || (_majorVersion == major && _minorVersion >= minor);
+}
+
+void RecordingRenderDevice::_Error(const char *function, const std::string &message)
+{
+	// the first errors are enough to find the cause, the count tells the rest
+	if (_errorCount < 32)
+		std::cout << "RecordingRenderDevice: " << function << ": " << message << " (frame " << _frame << ")" << std::endl;
+	_errorCount++;
+}
+
+void RecordingRenderDevice::_StateChange(GLenum state, GLint value)
+{
+	_current.stateChanges++;
+	auto it = _state.find(state);
+	if (it != _state.end() && it->second == value)
+		_current.redundantStateChanges++;
+	_state[state] = value;
+}
+
+GLuint *RecordingRenderDevice::_BufferBinding(GLenum target)
+{
+	// the element array binding is part of the vertex array
+	if (target == GL_ELEMENT_ARRAY_BUFFER)
+	{
+		if (_vertexArray == 0)
+			return NULL;
+		return &_vertexArrays[_vertexArray];
+	}
+	return &_bufferBindings[target];
+}
+
+RecordingRenderDevice::TextureRecord *RecordingRenderDevice::_BoundTexture(GLenum target, const char *function)
+{
+	GLenum binding_target = target;
+	if (target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z)
+		binding_target = GL_TEXTURE_CUBE_MAP;
+
+	GLuint texture = _textureBindings[std::make_pair(_activeTexture, binding_target)];
+	auto it = _textures.find(texture);
+	if (texture == 0 || it == _textures.end())
+	{
+		_Error(function, "no texture bound");
+		return NULL;
+	}
+	return &it->second;
+}
+
+bool RecordingRenderDevice::_ValidateDraw(const char *function)
+{
+	_current.drawCalls++;
+
+	auto program = _programs.find(_program);
+	if (_program == 0 || program == _programs.end() || !program->second.linked)
+	{
+		_Error(function, "no linked program in use");
+		return false;
+	}
+	if (_vertexArray == 0)
+	{
+		_Error(function, "no vertex array bound");
+		return false;
+	}
+	return true;
+}
+
+bool RecordingRenderDevice::_ValidateElements(const char *function, GLsizei count, GLenum type, const void *indices)
+{
+	if (type != GL_UNSIGNED_BYTE && type != GL_UNSIGNED_SHORT && type != GL_UNSIGNED_INT)
+	{
+		_Error(function, "invalid index type");
+		return false;
+	}
+	GLuint element_buffer = _vertexArrays[_vertexArray];
+	if (element_buffer == 0)
+	{
+		_Error(function, "vertex array has no element buffer");
+		return false;
+	}
+
+	size_t index_size = type == GL_UNSIGNED_BYTE ? 1 : (type == GL_UNSIGNED_SHORT ? 2 : 4);
+	size_t offset = (size_t)indices;
+	if (offset % index_size != 0 || offset + (size_t)count * index_size > _buffers[element_buffer])
+	{
+		_Error(function, "index range outside the element buffer");
+		return false;
+	}
+	return true;
+}
+
+void RecordingRenderDevice::_ValidateUniform(const char *function, GLint location)
+{
+	// -1 is silently ignored by GL
+	if (location == -1)
+		return;
+
+	auto program = _programs.find(_program);
+	if (_program == 0 || program == _programs.end())
+	{
+		_Error(function, "no program in use");
+		return;
+	}
+	if (location < 0 || location >= (GLint)program->second.uniforms.size())
+		_Error(function, "location does not belong to the program in use");
+}
+
+size_t RecordingRenderDevice::_PixelBytes(GLenum format, GLenum type)
+{
+	size_t components = 4;
+	if (format == GL_RED || format == GL_DEPTH_COMPONENT)
+		components = 1;
+	else if (format == GL_RG)
+		components = 2;
+	else if (format == GL_RGB || format == GL_BGR)
+		components = 3;
+
+	size_t component_size = 1;
+	if (type == GL_FLOAT || type == GL_UNSIGNED_INT || type == GL_INT)
+		component_size = 4;
+	else if (type == GL_HALF_FLOAT || type == GL_UNSIGNED_SHORT || type == GL_SHORT)
+		component_size = 2;
+	return components * component_size;
+}
+
+/*  Queries  */
+
+const GLubyte *RecordingRenderDevice::_GetString(GLenum name)
+{
+	switch (name)
+	{
+	case GL_VENDOR: return (const GLubyte*)"CS405";
+	case GL_RENDERER: return (const GLubyte*)"RecordingRenderDevice";
+	case GL_VERSION: return (const GLubyte*)_versionString.c_str();
+	case GL_SHADING_LANGUAGE_VERSION: return (const GLubyte*)"3.30";
+	}
+	_Error("glGetString", "unknown name");
+	return NULL;
+}
+
+const GLubyte *RecordingRenderDevice::_GetStringi(GLenum name, GLuint index)
+{
+	// glad expects at least one extension, block compressed uploads are recorded like the others
+	if (name == GL_EXTENSIONS && index == 0)
+		return (const GLubyte*)"GL_CS405_recording_device";
+	if (name == GL_EXTENSIONS && index == 1)
+		return (const GLubyte*)"GL_EXT_texture_compression_s3tc";
+	_Error("glGetStringi", "index out of range");
+	return NULL;
+}
+
+void RecordingRenderDevice::_GetIntegerv(GLenum name, GLint *data)
+{
+	switch (name)
+	{
+	case GL_NUM_EXTENSIONS: *data = 2; break;
+	case GL_MAJOR_VERSION: *data = _majorVersion; break;
+	case GL_MINOR_VERSION: *data = _minorVersion; break;
+	case GL_NUM_PROGRAM_BINARY_FORMATS: *data = _HasVersion(4, 1) ? 1 : 0; break;
+	case GL_MAX_TEXTURE_SIZE: *data = 16384; break;
+	case GL_MAX_ARRAY_TEXTURE_LAYERS: *data = 2048; break;
+	case GL_MAX_TEXTURE_IMAGE_UNITS: *data = 16; break;
+	case GL_MAX_VERTEX_ATTRIBS: *data = 16; break;
+	case GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT: *data = 256; break;
+	default: *data = 0; break;
+	}
+}
+
+GLenum RecordingRenderDevice::_GetError()
+{
+	return GL_NO_ERROR;
+}
+
+/*  Buffers  */
+
+void RecordingRenderDevice::_GenBuffers(GLsizei count, GLuint *buffers)
+{
+	for (GLsizei i = 0; i < count; i++)
+	{
+		buffers[i] = _nextName++;
+		_buffers[buffers[i]] = 0;
+	}
+}
+
+void RecordingRenderDevice::_DeleteBuffers(GLsizei count, const GLuint *buffers)
+{
+	for (GLsizei i = 0; i < count; i++)
+	{
+		if (buffers[i] == 0)
+			continue;
+		if (_buffers.erase(buffers[i]) == 0)
+			_Error("glDeleteBuffers", "unknown buffer");
+		// deleting a mapped buffer unmaps it
+		_immutableBuffers.erase(buffers[i]);
+		_mappings.erase(buffers[i]);
+
+		// deleting a bound buffer unbinds it
+		for (auto it = _bufferBindings.begin(); it != _bufferBindings.end(); ++it)
+		{
+			if (it->second == buffers[i])
+				it->second = 0;
+		}
+		if (_vertexArray != 0 && _vertexArrays[_vertexArray] == buffers[i])
+			_vertexArrays[_vertexArray] = 0;
+	}
+}
+
+void RecordingRenderDevice::_BindBuffer(GLenum target, GLuint buffer)
+{
+	if (buffer != 0 && _buffers.find(buffer) == _buffers.end())
+	{
+		_Error("glBindBuffer", "unknown buffer");
+		return;
+	}
+	GLuint *binding = _BufferBinding(target);
+	if (binding == NULL)
+	{
+		_Error("glBindBuffer", "element buffer bound without a vertex array");
+		return;
+	}
+
+	_current.stateChanges++;
+	if (*binding == buffer)
+		_current.redundantStateChanges++;
+	*binding = buffer;
+}
+
+void RecordingRenderDevice::_BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	if (buffer != 0 && _buffers.find(buffer) == _buffers.end())
+	{
+		_Error("glBindBufferBase", "unknown buffer");
+		return;
+	}
+	// binds the indexed point and the generic one
+	_current.stateChanges++;
+	_bufferBindings[target] = buffer;
+}
+
+void RecordingRenderDevice::_BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	if (_buffers.find(buffer) == _buffers.end())
+	{
+		_Error("glBindBufferRange", "unknown buffer");
+		return;
+	}
+	if (offset < 0 || size <= 0 || (size_t)(offset + size) > _buffers[buffer])
+	{
+		_Error("glBindBufferRange", "range outside the buffer");
+		return;
+	}
+	if (target == GL_UNIFORM_BUFFER && offset % 256 != 0)
+	{
+		_Error("glBindBufferRange", "offset not aligned to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT");
+		return;
+	}
+	_current.stateChanges++;
+	_bufferBindings[target] = buffer;
+}
+
+void RecordingRenderDevice::_BufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage)
+{
+	GLuint *binding = _BufferBinding(target);
+	if (binding == NULL || *binding == 0)
+	{
+		_Error("glBufferData", "no buffer bound");
+		return;
+	}
+	if (size < 0)
+	{
+		_Error("glBufferData", "negative size");
+		return;
+	}
+	if (_immutableBuffers.count(*binding) != 0)
+	{
+		_Error("glBufferData", "buffer storage is immutable");
+		return;
+	}
+	_buffers[*binding] = (size_t)size;
+	if (data != NULL)
+		_current.uploadBytes += (size_t)size;
+}
+
+void RecordingRenderDevice::_BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data)
+{
+	GLuint *binding = _BufferBinding(target);
+	if (binding == NULL || *binding == 0)
+	{
+		_Error("glBufferSubData", "no buffer bound");
+		return;
+	}
+	if (offset < 0 || size < 0 || (size_t)(offset + size) > _buffers[*binding])
+	{
+		_Error("glBufferSubData", "range outside the buffer");
+		return;
+	}
+	_current.uploadBytes += (size_t)size;
+}
+
+void RecordingRenderDevice::_CopyBufferSubData(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size)
+{
+	GLuint *read = _BufferBinding(readTarget);
+	GLuint *write = _BufferBinding(writeTarget);
+	if (read == NULL || write == NULL || *read == 0 || *write == 0)
+	{
+		_Error("glCopyBufferSubData", "no buffer bound");
+		return;
+	}
+	if ((size_t)(readOffset + size) > _buffers[*read] || (size_t)(writeOffset + size) > _buffers[*write])
+		_Error("glCopyBufferSubData", "range outside the buffers");
+}
+
+void *RecordingRenderDevice::_MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+	GLuint *binding = _BufferBinding(target);
+	if (binding == NULL || *binding == 0)
+	{
+		_Error("glMapBufferRange", "no buffer bound");
+		return NULL;
+	}
+	if (offset < 0 || length <= 0 || (size_t)(offset + length) > _buffers[*binding])
+	{
+		_Error("glMapBufferRange", "range outside the buffer");
+		return NULL;
+	}
+	if (_mappings.find(*binding) != _mappings.end())
+	{
+		_Error("glMapBufferRange", "buffer is already mapped");
+		return NULL;
+	}
+	bool persistent = (access & GL_MAP_PERSISTENT_BIT) != 0;
+	if (persistent && _immutableBuffers.count(*binding) == 0)
+	{
+		_Error("glMapBufferRange", "persistent mapping of a buffer without glBufferStorage");
+		return NULL;
+	}
+	MappingRecord &mapping = _mappings[*binding];
+	mapping.offset = (size_t)offset;
+	mapping.persistent = persistent;
+	mapping.memory.assign((size_t)length, 0);
+	return mapping.memory.data();
+}
+
+GLboolean RecordingRenderDevice::_UnmapBuffer(GLenum target)
+{
+	GLuint *binding = _BufferBinding(target);
+	if (binding == NULL || _mappings.find(*binding) == _mappings.end())
+	{
+		_Error("glUnmapBuffer", "buffer is not mapped");
+		return GL_FALSE;
+	}
+	// whatever was written through a temporary mapping counts as uploaded
+	if (!_mappings[*binding].persistent)
+		_current.uploadBytes += _mappings[*binding].memory.size();
+	_mappings.erase(*binding);
+	return GL_TRUE;
+}
+
+void RecordingRenderDevice::_BufferStorage(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags)
+{
+	GLuint *binding = _BufferBinding(target);
+	if (binding == NULL || *binding == 0)
+	{
+		_Error("glBufferStorage", "no buffer bound");
+		return;
+	}
+	if (!_HasVersion(4, 4))
+		_Error("glBufferStorage", "needs GL 4.4");
+	if (size <= 0 || _immutableBuffers.count(*binding) != 0)
+	{
+		_Error("glBufferStorage", "invalid size or storage already immutable");
+		return;
+	}
+	if ((flags & GL_MAP_COHERENT_BIT) != 0 && (flags & GL_MAP_PERSISTENT_BIT) == 0)
+		_Error("glBufferStorage", "coherent without persistent");
+	_buffers[*binding] = (size_t)size;
+	_immutableBuffers.insert(*binding);
+	if (data != NULL)
+		_current.uploadBytes += (size_t)size;
+}
+
+/*  Sync Objects  */
+
+GLsync RecordingRenderDevice::_FenceSync(GLenum condition, GLbitfield flags)
+{
+	GLuint sync = _nextName++;
+	_syncs.insert(sync);
+	return (GLsync)(uintptr_t)sync;
+}
+
+// nothing runs behind the recording, every fence is signaled right away
+GLenum RecordingRenderDevice::_ClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout)
+{
+	if (_syncs.count((GLuint)(uintptr_t)sync) == 0)
+	{
+		_Error("glClientWaitSync", "unknown sync");
+		return GL_WAIT_FAILED;
+	}
+	return GL_ALREADY_SIGNALED;
+}
+
+void RecordingRenderDevice::_DeleteSync(GLsync sync)
+{
+	if (sync != 0 && _syncs.erase((GLuint)(uintptr_t)sync) == 0)
+		_Error("glDeleteSync", "unknown sync");
+}
+
+/*  Vertex Arrays  */
+
+void RecordingRenderDevice::_GenVertexArrays(GLsizei count, GLuint *arrays)
+{
+	for (GLsizei i = 0; i < count; i++)
+	{
+		arrays[i] = _nextName++;
+		_vertexArrays[arrays[i]] = 0;
+	}
+}
+
+void RecordingRenderDevice::_DeleteVertexArrays(GLsizei count, const GLuint *arrays)
+{
+	for (GLsizei i = 0; i < count; i++)
+	{
+		if (arrays[i] == 0)
+			continue;
+		if (_vertexArrays.erase(arrays[i]) == 0)
+			_Error("glDeleteVertexArrays", "unknown vertex array");
+		if (_vertexArray == arrays[i])
+			_vertexArray = 0;
+	}
+}
+
+void RecordingRenderDevice::_BindVertexArray(GLuint array)
+{
+	if (array != 0 && _vertexArrays.find(array) == _vertexArrays.end())
+	{
+		_Error("glBindVertexArray", "unknown vertex array");
+		return;
+	}
+	_current.stateChanges++;
+	if (_vertexArray == array)
+		_current.redundantStateChanges++;
+	_vertexArray = array;
+}
+
+void RecordingRenderDevice::_EnableVertexAttribArray(GLuint index)
+{
+	if (_vertexArray == 0)
+		_Error("glEnableVertexAttribArray", "no vertex array bound");
+}
+
+void RecordingRenderDevice::_VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer)
+{
+	if (_vertexArray == 0)
+		_Error("glVertexAttribPointer", "no vertex array bound");
+	else if (_bufferBindings[GL_ARRAY_BUFFER] == 0)
+		_Error("glVertexAttribPointer", "no array buffer bound");
+	else if ((type == GL_INT_2_10_10_10_REV || type == GL_UNSIGNED_INT_2_10_10_10_REV) && size != 4)
+		_Error("glVertexAttribPointer", "packed formats need a size of 4");
+}
+
+/*  Textures  */
+
+void RecordingRenderDevice::_GenTextures(GLsizei count, GLuint *textures)
+{
+	for (GLsizei i = 0; i < count; i++)
+	{
+		textures[i] = _nextName++;
+		// nothing is known before the first bind & image, GL_NONE and 0 alike
+		TextureRecord record = {};
+		_textures[textures[i]] = record;
+	}
+}
+
+void RecordingRenderDevice::_DeleteTextures(GLsizei count, const GLuint *textures)
+{
+	for (GLsizei i = 0; i < count; i++)
+	{
+		if (textures[i] == 0)
+			continue;
+		if (_textures.erase(textures[i]) == 0)
+			_Error("glDeleteTextures", "unknown texture");
+		for (auto it = _textureBindings.begin(); it != _textureBindings.end(); ++it)
+		{
+			if (it->second == textures[i])
+				it->second = 0;
+		}
+	}
+}
+
+void RecordingRenderDevice::_ActiveTexture(GLenum texture)
+{
+	if (texture < GL_TEXTURE0 || texture >= GL_TEXTURE0 + 16)
+	{
+		_Error("glActiveTexture", "unit out of range");
+		return;
+	}
+	_current.stateChanges++;
+	if (_activeTexture == texture - GL_TEXTURE0)
+		_current.redundantStateChanges++;
+	_activeTexture = texture - GL_TEXTURE0;
+}
+
+void RecordingRenderDevice::_BindTexture(GLenum target, GLuint texture)
+{
+	auto it = _textures.find(texture);
+	if (texture != 0 && it == _textures.end())
+	{
+		_Error("glBindTexture", "unknown texture");
+		return;
+	}
+	if (texture != 0)
+	{
+		// the first bind fixes the target of a texture
+		if (it->second.target == GL_NONE)
+			it->second.target = target;
+		else if (it->second.target != target)
+			_Error("glBindTexture", "texture bound to a different target");
+	}
+
+	GLuint &binding = _textureBindings[std::make_pair(_activeTexture, target)];
+	_current.stateChanges++;
+	if (binding == texture)
+		_current.redundantStateChanges++;
+	binding = texture;
+}
+
+void RecordingRenderDevice::_TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void *pixels)
+{
+	TextureRecord *texture = _BoundTexture(target, "glTexImage2D");
+	if (texture == NULL)
+		return;
+	if (width < 0 || height < 0 || level < 0 || border != 0)
+	{
+		_Error("glTexImage2D", "invalid size, level or border");
+		return;
+	}
+
+	size_t bytes = (size_t)width * height * _PixelBytes(format, type);
+	// with a pixel unpack buffer bound, pixels is an offset into it (the bytes were counted when it was filled)
+	GLuint unpack_buffer = _bufferBindings[GL_PIXEL_UNPACK_BUFFER];
+	if (unpack_buffer != 0)
+	{
+		if (_mappings.find(unpack_buffer) != _mappings.end())
+			_Error("glTexImage2D", "pixel unpack buffer is mapped");
+		else if ((size_t)pixels + bytes > _buffers[unpack_buffer])
+			_Error("glTexImage2D", "image outside the pixel unpack buffer");
+	}
+	texture->images[std::make_pair(target, level)] = bytes;
+	if (level == 0)
+	{
+		texture->width = width;
+		texture->height = height;
+		texture->depth = 1;
+		texture->internalFormat = (GLenum)internalFormat;
+	}
+	if (pixels != NULL && unpack_buffer == 0)
+		_current.uploadBytes += bytes;
+}
+
+void RecordingRenderDevice::_TexImage3D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void *pixels)
+{
+	TextureRecord *texture = _BoundTexture(target, "glTexImage3D");
+	if (texture == NULL)
+		return;
+	if (width < 0 || height < 0 || depth < 0 || level < 0 || border != 0)
+	{
+		_Error("glTexImage3D", "invalid size, level or border");
+		return;
+	}
+
+	size_t bytes = (size_t)width * height * depth * _PixelBytes(format, type);
+	texture->images[std::make_pair(target, level)] = bytes;
+	if (level == 0)
+	{
+		texture->width = width;
+		texture->height = height;
+		texture->depth = depth;
+		texture->internalFormat = (GLenum)internalFormat;
+	}
+	if (pixels != NULL)
+		_current.uploadBytes += bytes;
+}
+
+void RecordingRenderDevice::_CompressedTexImage2D(GLenum target, GLint level, GLenum internalFormat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const void *data)
+{
+	TextureRecord *texture = _BoundTexture(target, "glCompressedTexImage2D");
+	if (texture == NULL)
+		return;
+	if (width < 0 || height < 0 || level < 0 || border != 0 || !BlockCompressor::IsBlockFormat(internalFormat))
+	{
+		_Error("glCompressedTexImage2D", "invalid size, level, border or format");
+		return;
+	}
+	if ((size_t)imageSize != BlockCompressor::GetSize(internalFormat, width, height))
+	{
+		_Error("glCompressedTexImage2D", "image size does not match the format");
+		return;
+	}
+
+	GLuint unpack_buffer = _bufferBindings[GL_PIXEL_UNPACK_BUFFER];
+	if (unpack_buffer != 0)
+	{
+		if (_mappings.find(unpack_buffer) != _mappings.end())
+			_Error("glCompressedTexImage2D", "pixel unpack buffer is mapped");
+		else if ((size_t)data + imageSize > _buffers[unpack_buffer])
+			_Error("glCompressedTexImage2D", "image outside the pixel unpack buffer");
+	}
+	texture->images[std::make_pair(target, level)] = (size_t)imageSize;
+	if (level == 0)
+	{
+		texture->width = width;
+		texture->height = height;
+		texture->depth = 1;
+		texture->internalFormat = internalFormat;
+	}
+	if (data != NULL && unpack_buffer == 0)
+		_current.uploadBytes += (size_t)imageSize;
+}
+
+void RecordingRenderDevice::_CompressedTexImage3D(GLenum target, GLint level, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLsizei imageSize, const void *data)
+{
+	TextureRecord *texture = _BoundTexture(target, "glCompressedTexImage3D");
+	if (texture == NULL)
+		return;
+	if (width < 0 || height < 0 || depth < 0 || level < 0 || border != 0 || !BlockCompressor::IsBlockFormat(internalFormat))
+	{
+		_Error("glCompressedTexImage3D", "invalid size, level, border or format");
+		return;
+	}
+	if ((size_t)imageSize != BlockCompressor::GetSize(internalFormat, width, height) * depth)
+	{
+		_Error("glCompressedTexImage3D", "image size does not match the format");
+		return;
+	}
+
+	texture->images[std::make_pair(target, level)] = (size_t)imageSize;
+	if (level == 0)
+	{
+		texture->width = width;
+		texture->height = height;
+		texture->depth = depth;
+		texture->internalFormat = internalFormat;
+	}
+	if (data != NULL)
+		_current.uploadBytes += (size_t)imageSize;
+}
+
+void RecordingRenderDevice::_CompressedTexSubImage3D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLsizei imageSize, const void *data)
+{
+	TextureRecord *texture = _BoundTexture(target, "glCompressedTexSubImage3D");
+	if (texture == NULL)
+		return;
+	if (texture->images.find(std::make_pair(target, level)) == texture->images.end())
+	{
+		_Error("glCompressedTexSubImage3D", "level has no image");
+		return;
+	}
+	if (format != texture->internalFormat)
+	{
+		_Error("glCompressedTexSubImage3D", "format differs from the image");
+		return;
+	}
+	// whole blocks only, a region may end at the edge of a level that is not a multiple of 4
+	int level_width = std::max(texture->width >> level, 1), level_height = std::max(texture->height >> level, 1);
+	if (xoffset < 0 || yoffset < 0 || zoffset < 0 || xoffset % 4 != 0 || yoffset % 4 != 0 ||
+		xoffset + width > level_width || yoffset + height > level_height || zoffset + depth > texture->depth ||
+		(width % 4 != 0 && xoffset + width != level_width) || (height % 4 != 0 && yoffset + height != level_height))
+	{
+		_Error("glCompressedTexSubImage3D", "region outside the image or not block aligned");
+		return;
+	}
+	if ((size_t)imageSize != BlockCompressor::GetSize(format, width, height) * depth)
+	{
+		_Error("glCompressedTexSubImage3D", "image size does not match the format");
+		return;
+	}
+	if (data != NULL)
+		_current.uploadBytes += (size_t)imageSize;
+}
+
+void RecordingRenderDevice::_TexSubImage3D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void *pixels)
+{
+	TextureRecord *texture = _BoundTexture(target, "glTexSubImage3D");
+	if (texture == NULL)
+		return;
+	if (texture->images.find(std::make_pair(target, level)) == texture->images.end())
+	{
+		_Error("glTexSubImage3D", "level has no image");
+		return;
+	}
+	if (level == 0 && (xoffset < 0 || yoffset < 0 || zoffset < 0 || xoffset + width > texture->width ||
+		yoffset + height > texture->height || zoffset + depth > texture->depth))
+	{
+		_Error("glTexSubImage3D", "region outside the image");
+		return;
+	}
+	_current.uploadBytes += (size_t)width * height * depth * _PixelBytes(format, type);
+}
+
+void RecordingRenderDevice::_TexParameteri(GLenum target, GLenum name, GLint param)
+{
+	_BoundTexture(target, "glTexParameteri");
+}
+
+void RecordingRenderDevice::_GenerateMipmap(GLenum target)
+{
+	TextureRecord *texture = _BoundTexture(target, "glGenerateMipmap");
+	if (texture == NULL)
+		return;
+	if (texture->images.empty())
+		_Error("glGenerateMipmap", "texture has no image");
+	texture->mipmapped = true;
+}
+
+void RecordingRenderDevice::_GetTexLevelParameteriv(GLenum target, GLint level, GLenum name, GLint *params)
+{
+	*params = 0;
+	TextureRecord *texture = _BoundTexture(target, "glGetTexLevelParameteriv");
+	if (texture == NULL)
+		return;
+	// levels that were never specified read as 0 like they do on a driver
+	auto image = texture->images.find(std::make_pair(target, level));
+	if (image == texture->images.end() && !(level > 0 && texture->mipmapped))
+		return;
+
+	if (name == GL_TEXTURE_WIDTH)
+		*params = std::max(texture->width >> level, 1);
+	else if (name == GL_TEXTURE_HEIGHT)
+		*params = std::max(texture->height >> level, 1);
+	else if (name == GL_TEXTURE_INTERNAL_FORMAT)
+		*params = (GLint)texture->internalFormat;
+	else if (name == GL_TEXTURE_COMPRESSED)
+		*params = BlockCompressor::IsBlockFormat(texture->internalFormat);
+	else if (name == GL_TEXTURE_COMPRESSED_IMAGE_SIZE && BlockCompressor::IsBlockFormat(texture->internalFormat) && image != texture->images.end())
+		*params = (GLint)image->second;
+}
+
+void RecordingRenderDevice::_GetTexImage(GLenum target, GLint level, GLenum format, GLenum type, void *pixels)
+{
+	TextureRecord *texture = _BoundTexture(target, "glGetTexImage");
+	if (texture == NULL)
+		return;
+	// the contents are not recorded, read back opaque white. An array returns every layer of the level.
+	int width = std::max(texture->width >> level, 1);
+	int height = std::max(texture->height >> level, 1);
+	int depth = target == GL_TEXTURE_2D_ARRAY ? texture->depth : 1;
+	std::memset(pixels, 0xff, (size_t)width * height * depth * _PixelBytes(format, type));
+}
+
+void RecordingRenderDevice::_GetCompressedTexImage(GLenum target, GLint level, void *pixels)
+{
+	TextureRecord *texture = _BoundTexture(target, "glGetCompressedTexImage");
+	if (texture == NULL)
+		return;
+	auto image = texture->images.find(std::make_pair(target, level));
+	if (image == texture->images.end() || !BlockCompressor::IsBlockFormat(texture->internalFormat))
+	{
+		_Error("glGetCompressedTexImage", "level has no compressed image");
+		return;
+	}
+	std::memset(pixels, 0, image->second);
+}
+
+/*  Shaders & Programs  */
+
+GLuint RecordingRenderDevice::_CreateShader(GLenum type)
+{
+	GLuint shader = _nextName++;
+	_shaders[shader] = false;
+	return shader;
+}
+
+void RecordingRenderDevice::_ShaderSource(GLuint shader, GLsizei count, const GLchar *const *source, const GLint *length)
+{
+	if (_shaders.find(shader) == _shaders.end())
+		_Error("glShaderSource", "unknown shader");
+}
+
+void RecordingRenderDevice::_CompileShader(GLuint shader)
+{
+	if (_shaders.find(shader) == _shaders.end())
+		_Error("glCompileShader", "unknown shader");
+	else
+		_shaders[shader] = true;
+}
+
+void RecordingRenderDevice::_GetShaderiv(GLuint shader, GLenum name, GLint *params)
+{
+	*params = 0;
+	if (name == GL_COMPILE_STATUS)
+		*params = _shaders[shader] ? GL_TRUE : GL_FALSE;
+}
+
+void RecordingRenderDevice::_GetShaderInfoLog(GLuint shader, GLsizei bufferSize, GLsizei *length, GLchar *infoLog)
+{
+	if (length != NULL)
+		*length = 0;
+	if (bufferSize > 0)
+		infoLog[0] = '\0';
+}
+
+void RecordingRenderDevice::_DeleteShader(GLuint shader)
+{
+	if (shader != 0 && _shaders.erase(shader) == 0)
+		_Error("glDeleteShader", "unknown shader");
+}
+
+GLuint RecordingRenderDevice::_CreateProgram()
+{
+	GLuint program = _nextName++;
+	_programs[program].linked = false;
+	return program;
+}
+
+void RecordingRenderDevice::_AttachShader(GLuint program, GLuint shader)
+{
+	if (_programs.find(program) == _programs.end())
+		_Error("glAttachShader", "unknown program");
+	else if (_shaders.find(shader) == _shaders.end() || !_shaders[shader])
+		_Error("glAttachShader", "unknown or uncompiled shader");
+}
+
+void RecordingRenderDevice::_LinkProgram(GLuint program)
+{
+	if (_programs.find(program) == _programs.end())
+		_Error("glLinkProgram", "unknown program");
+	else
+		_programs[program].linked = true;
+}
+
+void RecordingRenderDevice::_GetProgramiv(GLuint program, GLenum name, GLint *params)
+{
+	*params = 0;
+	if (name == GL_LINK_STATUS)
+		*params = _programs[program].linked ? GL_TRUE : GL_FALSE;
+	else if (name == GL_PROGRAM_BINARY_LENGTH && _programs[program].linked)
+		*params = (GLint)sizeof(RECORDING_PROGRAM_BINARY);
+}
+
+void RecordingRenderDevice::_GetProgramInfoLog(GLuint program, GLsizei bufferSize, GLsizei *length, GLchar *infoLog)
+{
+	_GetShaderInfoLog(program, bufferSize, length, infoLog);
+}
+
+void RecordingRenderDevice::_DeleteProgram(GLuint program)
+{
+	if (program != 0 && _programs.erase(program) == 0)
+		_Error("glDeleteProgram", "unknown program");
+	if (_program == program)
+		_program = 0;
+}
+
+void RecordingRenderDevice::_UseProgram(GLuint program)
+{
+	if (program != 0 && _programs.find(program) == _programs.end())
+	{
+		_Error("glUseProgram", "unknown program");
+		return;
+	}
+	_current.stateChanges++;
+	if (_program == program)
+		_current.redundantStateChanges++;
+	_program = program;
+}
+
+GLint RecordingRenderDevice::_GetUniformLocation(GLuint program, const GLchar *name)
+{
+	auto it = _programs.find(program);
+	if (it == _programs.end() || !it->second.linked)
+	{
+		_Error("glGetUniformLocation", "unknown or unlinked program");
+		return -1;
+	}
+	// the sources are not parsed, every name gets a location of its own
+	std::unordered_map<std::string, GLint> &uniforms = it->second.uniforms;
+	auto uniform = uniforms.find(name);
+	if (uniform != uniforms.end())
+		return uniform->second;
+	GLint location = (GLint)uniforms.size();
+	uniforms[name] = location;
+	return location;
+}
+
+GLuint RecordingRenderDevice::_GetUniformBlockIndex(GLuint program, const GLchar *name)
+{
+	if (_programs.find(program) == _programs.end())
+		_Error("glGetUniformBlockIndex", "unknown program");
+	return 0;
+}
+
+void RecordingRenderDevice::_UniformBlockBinding(GLuint program, GLuint blockIndex, GLuint binding)
+{
+	if (_programs.find(program) == _programs.end())
+		_Error("glUniformBlockBinding", "unknown program");
+}
+
+void RecordingRenderDevice::_ProgramParameteri(GLuint program, GLenum name, GLint value)
+{
+	if (!_HasVersion(4, 1))
+		_Error("glProgramParameteri", "needs GL 4.1");
+	if (_programs.find(program) == _programs.end())
+		_Error("glProgramParameteri", "unknown program");
+	else if (name != GL_PROGRAM_BINARY_RETRIEVABLE_HINT)
+		_Error("glProgramParameteri", "unknown parameter");
+}
+
+void RecordingRenderDevice::_GetProgramBinary(GLuint program, GLsizei bufferSize, GLsizei *length, GLenum *binaryFormat, void *binary)
+{
+	if (length != NULL)
+		*length = 0;
+	auto it = _programs.find(program);
+	if (it == _programs.end() || !it->second.linked)
+	{
+		_Error("glGetProgramBinary", "unknown or unlinked program");
+		return;
+	}
+	if (bufferSize < (GLsizei)sizeof(RECORDING_PROGRAM_BINARY))
+	{
+		_Error("glGetProgramBinary", "buffer smaller than GL_PROGRAM_BINARY_LENGTH");
+		return;
+	}
+	std::memcpy(binary, RECORDING_PROGRAM_BINARY, sizeof(RECORDING_PROGRAM_BINARY));
+	*binaryFormat = RECORDING_PROGRAM_BINARY_FORMAT;
+	if (length != NULL)
+		*length = (GLsizei)sizeof(RECORDING_PROGRAM_BINARY);
+}
+
+// like a driver, a binary from elsewhere is not an error, the program just stays unlinked
+void RecordingRenderDevice::_ProgramBinary(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length)
+{
+	auto it = _programs.find(program);
+	if (it == _programs.end())
+	{
+		_Error("glProgramBinary", "unknown program");
+		return;
+	}
+	it->second.linked = binaryFormat == RECORDING_PROGRAM_BINARY_FORMAT && length == (GLsizei)sizeof(RECORDING_PROGRAM_BINARY)
+		&& std::memcmp(binary, RECORDING_PROGRAM_BINARY, sizeof(RECORDING_PROGRAM_BINARY)) == 0;
+}
+
+/*  Draws  */
+
+void RecordingRenderDevice::_DrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+	if (_ValidateDraw("glDrawArrays"))
+		_current.instances++;
+}
+
+void RecordingRenderDevice::_DrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices)
+{
+	if (_ValidateDraw("glDrawElements") && _ValidateElements("glDrawElements", count, type, indices))
+		_current.instances++;
+}
+
+void RecordingRenderDevice::_DrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void *indices, GLint baseVertex)
+{
+	if (_ValidateDraw("glDrawElementsBaseVertex") && _ValidateElements("glDrawElementsBaseVertex", count, type, indices))
+		_current.instances++;
+}
+
+void RecordingRenderDevice::_DrawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instanceCount, GLint baseVertex)
+{
+	if (_ValidateDraw("glDrawElementsInstancedBaseVertex") && _ValidateElements("glDrawElementsInstancedBaseVertex", count, type, indices))
+		_current.instances += instanceCount;
+}
+
+// The commands are only known when the indirect buffer is mapped (the persistent stream buffer), every command
+// is validated then. Commands uploaded with glBufferSubData are not kept, each counts as one instance.
+void RecordingRenderDevice::_MultiDrawElementsIndirect(GLenum mode, GLenum type, const void *indirect, GLsizei drawCount, GLsizei stride)
+{
+	if (!_HasVersion(4, 3))
+		_Error("glMultiDrawElementsIndirect", "needs GL 4.3");
+	if (!_ValidateDraw("glMultiDrawElementsIndirect"))
+		return;
+
+	GLuint buffer = _bufferBindings[GL_DRAW_INDIRECT_BUFFER];
+	if (buffer == 0)
+	{
+		_Error("glMultiDrawElementsIndirect", "no indirect buffer bound");
+		return;
+	}
+	size_t command_stride = stride != 0 ? (size_t)stride : sizeof(DrawElementsIndirectCommand);
+	size_t offset = (size_t)indirect;
+	if (drawCount <= 0 || offset % 4 != 0 || command_stride % 4 != 0
+		|| offset + (size_t)(drawCount - 1) * command_stride + sizeof(DrawElementsIndirectCommand) > _buffers[buffer])
+	{
+		_Error("glMultiDrawElementsIndirect", "commands outside the indirect buffer");
+		return;
+	}
+
+	auto mapping = _mappings.find(buffer);
+	if (mapping == _mappings.end())
+	{
+		_current.instances += (unsigned int)drawCount;
+		return;
+	}
+	size_t index_size = type == GL_UNSIGNED_BYTE ? 1 : (type == GL_UNSIGNED_SHORT ? 2 : 4);
+	for (GLsizei i = 0; i < drawCount; i++)
+	{
+		size_t command_offset = offset + (size_t)i * command_stride;
+		if (command_offset < mapping->second.offset
+			|| command_offset + sizeof(DrawElementsIndirectCommand) > mapping->second.offset + mapping->second.memory.size())
+		{
+			_Error("glMultiDrawElementsIndirect", "command outside the mapped range");
+			return;
+		}
+		DrawElementsIndirectCommand command;
+		std::memcpy(&command, &mapping->second.memory[command_offset - mapping->second.offset], sizeof(command));
+		if (!_ValidateElements("glMultiDrawElementsIndirect", (GLsizei)command.count, type, (const void*)((size_t)command.firstIndex * index_size)))
+			return;
+		_current.instances += command.instanceCount;
+	}
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef RENDER_DEVICE_H
+#define RENDER_DEVICE_H
+
+#include "Include/glad/glad.h"
+#include <GLFW/glfw3.h>
+
+// RenderDevice owns the window, the GL context and the input of the game.
+// Every subsystem keeps calling GL through the glad entry points, the device decides where those lead:
+// GLFWRenderDevice loads the driver's functions, RecordingRenderDevice loads its own recording functions
+// so the whole frame runs without a window or GPU.
+class RenderDevice {
+public:
+	virtual ~RenderDevice() { }
+
+	// Creates the context and loads the GL entry points, returns false when that fails.
+	virtual bool Create(const char *title, unsigned int width, unsigned int height) = 0;
+
+	// Resolves a GL entry point by name, for functions newer than the glad loader covers.
+	virtual void *GetProcAddress(const char *name) = 0;
+
+	// Input callbacks use the GLFW signatures, devices without input ignore them.
+	virtual void SetCallbacks(GLFWframebuffersizefun framebufferSize, GLFWcursorposfun cursorPosition, GLFWscrollfun scroll) = 0;
+
+	virtual bool ShouldClose() = 0;
+	virtual void RequestClose() = 0;
+
+	// Ends the frame: swaps buffers and polls events.
+	virtual void Present() = 0;
+
+	// Seconds since Create.
+	virtual double GetTime() = 0;
+
+	// key is a GLFW_KEY_* code
+	virtual bool IsKeyPressed(int key) = 0;
+
+	virtual void Destroy() = 0;
+};
+
+#endif
@@ -0,0 +1,420 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "Include/glad/glad.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "GLExtensions.h"
+#include "GLStateCache.h"
+#include "GeometryPool.h"
+#include "StreamBuffer.h"
+#include "shader.h"
+#include "mesh.h"
+#include "model.h"
+#include "TexturePacker.h"
+
+// One mesh of one submitted model.
+struct DrawItem {
+	const Mesh *mesh;
+	unsigned int lod;
+	// index into the model matrices of the frame
+	unsigned int matrix;
+	// squared distance from the camera to the model's center
+	float distance;
+};
+
+// Consecutive commands that share the array textures of their first mesh and the index type.
+// The depth prepass only splits by index type, material is left null there.
+struct DrawBatch {
+	const Mesh *material;
+	GLenum indexType;
+	size_t firstCommand;
+	size_t commandCount;
+};
+
+// RenderQueue collects every mesh drawn with the object shader during a frame and issues them together.
+// Items are sorted by array textures, same mesh & level submissions become instances of a single command,
+// and each texture set is drawn with one glMultiDrawElementsIndirect (or one instanced draw per command
+// on contexts without it). Model matrices and material indices are per instance attributes, they and the
+// commands are written to the frame's stream buffer. Meshes whose textures are not packed yet are packed
+// on submission (TexturePacker), which stalls, so models should be packed when they are loaded.
+// Instances and the commands of a texture set are ordered front to back. With a depth shader the opaque
+// draws are first rendered depth only from the mesh pool's position stream, nearest first across every
+// texture set, and the shaded pass then only runs the fragments that survived, with GL_EQUAL.
+class RenderQueue {
+public:
+	RenderQueue() : _stream(nullptr), _depthPrepass(false) {}
+
+	// Enables the instance attributes in the mesh pool's vertex arrays, instances & commands come from stream.
+	void Init(StreamBuffer *stream);
+
+	// distances for the front to back order are measured from cameraPosition
+	void Begin(const glm::vec3 &cameraPosition);
+
+	// Queues every mesh of the model with its current model matrix and level of detail.
+	void Submit(Model &model);
+
+	// Sorts, uploads and draws everything submitted since Begin.
+	// depthShader enables the depth prepass, it has to place vertices exactly like shader.
+	void Flush(Shader shader, Shader *depthShader = nullptr);
+
+	void Delete();
+
+	void PrintStats();
+
+private:
+	/*  Buffers  */
+	StreamBuffer *_stream;
+	StreamAllocation _instanceRange;
+	StreamAllocation _materialRange;
+	StreamAllocation _commandRange;
+
+	/*  Frame Data  */
+	glm::vec3 _cameraPosition;
+	std::vector<glm::mat4> _matrices;
+	std::vector<float> _distances;
+	std::vector<DrawItem> _items;
+	std::vector<glm::mat4> _instances;
+	std::vector<GLfloat> _instanceMaterials;
+	std::vector<DrawElementsIndirectCommand> _commands;
+	// distance of the nearest instance of every command
+	std::vector<float> _commandDistances;
+	std::vector<DrawBatch> _batches;
+
+	/*  Depth Prepass  */
+	std::vector<DrawElementsIndirectCommand> _depthCommands;
+	std::vector<DrawBatch> _depthBatches;
+	StreamAllocation _depthCommandRange;
+	bool _depthPrepass;
+
+	static bool _SameMaterial(const Mesh *lhs, const Mesh *rhs);
+	static bool _DrawOrder(const DrawItem &lhs, const DrawItem &rhs);
+
+	void _BuildCommands();
+	void _SortCommands(size_t first, size_t count);
+	void _BuildDepthCommands();
+	void _Upload(bool depthPrepass);
+	void _DrawBatches(const std::vector<DrawBatch> &batches, const std::vector<DrawElementsIndirectCommand> &commands,
+		const StreamAllocation &commandRange, const Shader *shader);
+	void _PointInstanceAttributes(size_t firstInstance);
+};
+
+void RenderQueue::Init(StreamBuffer *stream)
+{
+	_stream = stream;
+
+	GLuint vertex_arrays[2] = { MeshPool::GetVertexArray(), MeshPool::GetPositionArray() };
+	for (int a = 0; a < 2; a++)
+	{
+		GLStateCache::BindVertexArray(vertex_arrays[a]);
+		for (GLuint i = 0; i < 4; i++)
+		{
+			glEnableVertexAttribArray(INSTANCE_MATRIX_LOCATION + i);
+			glVertexAttribDivisor(INSTANCE_MATRIX_LOCATION + i, 1);
+		}
+	}
+
+	// only the shaded pass reads the material
+	GLStateCache::BindVertexArray(MeshPool::GetVertexArray());
+	glEnableVertexAttribArray(INSTANCE_MATERIAL_LOCATION);
+	glVertexAttribDivisor(INSTANCE_MATERIAL_LOCATION, 1);
+}
+
+void RenderQueue::Begin(const glm::vec3 &cameraPosition)
+{
+	_cameraPosition = cameraPosition;
+	_matrices.clear();
+	_distances.clear();
+	_items.clear();
+}
+
+void RenderQueue::Submit(Model &model)
+{
+	// packing happens at load time or in the AssetStreamer, a model whose pack failed is not drawn
+	if (!TexturePacker::IsPacked(model))
+		return;
+
+	unsigned int matrix = (unsigned int)_matrices.size();
+	_matrices.push_back(model.GetModelMatrix());
+
+	glm::vec3 center, extents;
+	model.GetWorldBounds(center, extents);
+	glm::vec3 offset = center - _cameraPosition;
+	float distance = glm::dot(offset, offset);
+
+	for (unsigned int i = 0; i < model.meshes.size(); i++)
+	{
+		DrawItem item = { &model.meshes[i], model.GetLod(), matrix, distance };
+		_items.push_back(item);
+	}
+}
+
+void RenderQueue::Flush(Shader shader, Shader *depthShader)
+{
+	if (_items.empty())
+		return;
+
+	std::sort(_items.begin(), _items.end(), _DrawOrder);
+	_BuildCommands();
+	if (depthShader != nullptr)
+		_BuildDepthCommands();
+	_Upload(depthShader != nullptr);
+	_depthPrepass = depthShader != nullptr;
+
+	if (depthShader != nullptr)
+	{
+		// depth only, the nearest surfaces end up in the depth buffer without shading anything
+		GLStateCache::ColorMask(GL_FALSE);
+		depthShader->use();
+		GLStateCache::BindVertexArray(MeshPool::GetPositionArray());
+		_DrawBatches(_depthBatches, _depthCommands, _depthCommandRange, nullptr);
+
+		// every pixel is shaded once, by the fragment that wrote its depth
+		GLStateCache::ColorMask(GL_TRUE);
+		GLStateCache::DepthFunc(GL_EQUAL);
+		GLStateCache::DepthMask(GL_FALSE);
+	}
+
+	shader.use();
+	GLStateCache::BindVertexArray(MeshPool::GetVertexArray());
+	_DrawBatches(_batches, _commands, _commandRange, &shader);
+
+	if (depthShader != nullptr)
+	{
+		// glClear honors the depth mask, the next frame needs it back
+		GLStateCache::DepthFunc(GL_LESS);
+		GLStateCache::DepthMask(GL_TRUE);
+	}
+}
+
+// draws the batches with the bound vertex array, textures are only bound when a shader is given
+void RenderQueue::_DrawBatches(const std::vector<DrawBatch> &batches, const std::vector<DrawElementsIndirectCommand> &commands,
+	const StreamAllocation &commandRange, const Shader *shader)
+{
+	// the instances move through the ring every frame
+	_PointInstanceAttributes(0);
+	if (GLExtensions::MultiDrawIndirect)
+		GLStateCache::BindBuffer(GL_DRAW_INDIRECT_BUFFER, commandRange.buffer);
+
+	for (unsigned int b = 0; b < batches.size(); b++)
+	{
+		const DrawBatch &batch = batches[b];
+		if (shader != nullptr)
+			batch.material->BindTextures(*shader);
+
+		if (GLExtensions::MultiDrawIndirect)
+		{
+			GLStateCache::MultiDrawElementsIndirect(GL_TRIANGLES, batch.indexType,
+				(void*)(commandRange.offset + batch.firstCommand * sizeof(DrawElementsIndirectCommand)), (GLsizei)batch.commandCount, 0);
+			continue;
+		}
+
+		// without base instance support the instance attributes are moved to each command's first matrix
+		for (size_t c = batch.firstCommand; c < batch.firstCommand + batch.commandCount; c++)
+		{
+			const DrawElementsIndirectCommand &command = commands[c];
+			_PointInstanceAttributes(command.baseInstance);
+			GLStateCache::DrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, batch.indexType,
+				(void*)(command.firstIndex * IndexTypeSize(batch.indexType)), command.instanceCount, command.baseVertex);
+		}
+	}
+}
+
+void RenderQueue::Delete()
+{
+	// the frame data belongs to the stream
+	_stream = nullptr;
+}
+
+void RenderQueue::PrintStats()
+{
+	std::cout << "Render Queue: " << _items.size() << " meshes, " << _commands.size() << " commands, "
+		<< _batches.size() << " batches, " << _instances.size() << " instances ("
+		<< (GLExtensions::MultiDrawIndirect ? "multi draw indirect" : "instanced fallback") << ")";
+	if (_depthPrepass)
+		std::cout << ", depth prepass in " << _depthBatches.size() << " batches";
+	std::cout << std::endl;
+}
+
+// the layers come from the material table, only the arrays have to match
+bool RenderQueue::_SameMaterial(const Mesh *lhs, const Mesh *rhs)
+{
+	for (int slot = 0; slot < MATERIAL_SLOT_COUNT; slot++)
+	{
+		if (lhs->materialArrays[slot] != rhs->materialArrays[slot])
+			return false;
+	}
+	return true;
+}
+
+// array textures and index type first, then mesh and level so equal draws end up next to each other,
+// the instances of a draw nearest first
+bool RenderQueue::_DrawOrder(const DrawItem &lhs, const DrawItem &rhs)
+{
+	if (lhs.mesh->allocation.indexType != rhs.mesh->allocation.indexType)
+		return lhs.mesh->allocation.indexType < rhs.mesh->allocation.indexType;
+
+	for (int slot = 0; slot < MATERIAL_SLOT_COUNT; slot++)
+	{
+		if (lhs.mesh->materialArrays[slot] != rhs.mesh->materialArrays[slot])
+			return lhs.mesh->materialArrays[slot] < rhs.mesh->materialArrays[slot];
+	}
+	if (lhs.mesh != rhs.mesh)
+		return lhs.mesh < rhs.mesh;
+	if (lhs.lod != rhs.lod)
+		return lhs.lod < rhs.lod;
+	if (lhs.distance != rhs.distance)
+		return lhs.distance < rhs.distance;
+	return lhs.matrix < rhs.matrix;
+}
+
+void RenderQueue::_BuildCommands()
+{
+	_instances.clear();
+	_instanceMaterials.clear();
+	_commands.clear();
+	_commandDistances.clear();
+	_batches.clear();
+
+	for (size_t i = 0; i < _items.size(); i++)
+	{
+		const DrawItem &item = _items[i];
+
+		bool new_batch = _batches.empty() || _batches.back().indexType != item.mesh->allocation.indexType ||
+			!_SameMaterial(_batches.back().material, item.mesh);
+		if (new_batch)
+		{
+			DrawBatch batch = { item.mesh, item.mesh->allocation.indexType, _commands.size(), 0 };
+			_batches.push_back(batch);
+		}
+
+		bool new_command = new_batch || _items[i - 1].mesh != item.mesh || _items[i - 1].lod != item.lod;
+		if (new_command)
+		{
+			const MeshLod &level = item.mesh->GetLod(item.lod);
+
+			DrawElementsIndirectCommand command;
+			command.count = level.indexCount;
+			command.instanceCount = 0;
+			command.firstIndex = item.mesh->allocation.firstIndex + level.indexOffset;
+			command.baseVertex = item.mesh->allocation.baseVertex;
+			command.baseInstance = (GLuint)_instances.size();
+
+			_commands.push_back(command);
+			_commandDistances.push_back(item.distance);
+			_batches.back().commandCount++;
+		}
+
+		_commands.back().instanceCount++;
+		// the mesh's dequantization is folded into the model matrix
+		_instances.push_back(_matrices[item.matrix] * item.mesh->dequantize);
+		_instanceMaterials.push_back((GLfloat)item.mesh->material);
+	}
+
+	// the texture sets keep their order, inside of one the nearest draws go first
+	for (size_t b = 0; b < _batches.size(); b++)
+		_SortCommands(_batches[b].firstCommand, _batches[b].commandCount);
+}
+
+void RenderQueue::_SortCommands(size_t first, size_t count)
+{
+	if (count < 2)
+		return;
+
+	std::vector<size_t> order(count);
+	for (size_t i = 0; i < count; i++)
+		order[i] = first + i;
+	std::stable_sort(order.begin(), order.end(), [this](size_t lhs, size_t rhs) { return _commandDistances[lhs] < _commandDistances[rhs]; });
+
+	std::vector<DrawElementsIndirectCommand> commands(count);
+	std::vector<float> distances(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		commands[i] = _commands[order[i]];
+		distances[i] = _commandDistances[order[i]];
+	}
+	std::copy(commands.begin(), commands.end(), _commands.begin() + first);
+	std::copy(distances.begin(), distances.end(), _commandDistances.begin() + first);
+}
+
+// the same commands without textures, one batch per index type and strictly front to back inside of it
+void RenderQueue::_BuildDepthCommands()
+{
+	std::vector<GLenum> index_types(_commands.size());
+	for (size_t b = 0; b < _batches.size(); b++)
+		std::fill(index_types.begin() + _batches[b].firstCommand, index_types.begin() + _batches[b].firstCommand + _batches[b].commandCount, _batches[b].indexType);
+
+	std::vector<size_t> order(_commands.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [this, &index_types](size_t lhs, size_t rhs) {
+		if (index_types[lhs] != index_types[rhs])
+			return index_types[lhs] < index_types[rhs];
+		return _commandDistances[lhs] < _commandDistances[rhs];
+	});
+
+	_depthCommands.clear();
+	_depthBatches.clear();
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		GLenum index_type = index_types[order[i]];
+		if (_depthBatches.empty() || _depthBatches.back().indexType != index_type)
+		{
+			DrawBatch batch = { nullptr, index_type, _depthCommands.size(), 0 };
+			_depthBatches.push_back(batch);
+		}
+		_depthCommands.push_back(_commands[order[i]]);
+		_depthBatches.back().commandCount++;
+	}
+}
+
+void RenderQueue::_Upload(bool depthPrepass)
+{
+	size_t instance_bytes = _instances.size() * sizeof(glm::mat4);
+	_instanceRange = _stream->Allocate(instance_bytes, sizeof(glm::vec4));
+	std::memcpy(_instanceRange.data, _instances.data(), instance_bytes);
+	_stream->Commit(_instanceRange);
+
+	size_t material_bytes = _instanceMaterials.size() * sizeof(GLfloat);
+	_materialRange = _stream->Allocate(material_bytes, sizeof(GLfloat));
+	std::memcpy(_materialRange.data, _instanceMaterials.data(), material_bytes);
+	_stream->Commit(_materialRange);
+
+	if (GLExtensions::MultiDrawIndirect)
+	{
+		size_t command_bytes = _commands.size() * sizeof(DrawElementsIndirectCommand);
+		_commandRange = _stream->Allocate(command_bytes, sizeof(GLuint));
+		std::memcpy(_commandRange.data, _commands.data(), command_bytes);
+		_stream->Commit(_commandRange);
+
+		if (depthPrepass)
+		{
+			_depthCommandRange = _stream->Allocate(command_bytes, sizeof(GLuint));
+			std::memcpy(_depthCommandRange.data, _depthCommands.data(), command_bytes);
+			_stream->Commit(_depthCommandRange);
+		}
+	}
+}
+
+// points the four matrix columns and the material at the given instance, expects one of the mesh pool's
+// vertex arrays to be bound
+void RenderQueue::_PointInstanceAttributes(size_t firstInstance)
+{
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, _instanceRange.buffer);
+	for (GLuint i = 0; i < 4; i++)
+	{
+		glVertexAttribPointer(INSTANCE_MATRIX_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+			(void*)(_instanceRange.offset + firstInstance * sizeof(glm::mat4) + i * sizeof(glm::vec4)));
+	}
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, _materialRange.buffer);
+	glVertexAttribPointer(INSTANCE_MATERIAL_LOCATION, 1, GL_FLOAT, GL_FALSE, sizeof(GLfloat),
+		(void*)(_materialRange.offset + firstInstance * sizeof(GLfloat)));
+}
+
+#endif
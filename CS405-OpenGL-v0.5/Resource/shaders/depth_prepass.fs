@@ -0,0 +1,6 @@
+#version 330 core
+
+// color writes are off during the prepass, only the depth is kept
+void main()
+{
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#version 330 core
+// depth only pass, reads nothing but the position stream of the mesh pool.
+// gl_Position has to match model_loading.vs bit for bit, the main pass tests against it with GL_EQUAL.
+layout (location = 0) in vec3 aPos;
+layout (location = 5) in mat4 aModel;
+
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec3 cameraPosition;
+    float time;
+};
+
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = viewProjection * aModel * vec4(aPos, 1.0);
+}
\ No newline at end of file
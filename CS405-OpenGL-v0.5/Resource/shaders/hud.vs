@@ -0,0 +1,12 @@
+#version 330 core
+layout (location = 0) in vec4 aPos;
+layout (location = 1) in vec2 aTexCoords;
+
+out vec2 TexCoords;
+
+// the batched panel icons are placed in clip space on the CPU
+void main()
+{
+    TexCoords = aTexCoords;    
+    gl_Position = aPos;
+}
\ No newline at end of file
@@ -2,10 +2,23 @@
 out vec4 FragColor;
 
 in vec2 TexCoords;
+flat in vec4 DiffuseRect;
+flat in float DiffuseLayer;
 
-uniform sampler2D texture_diffuse1;
+// the textures of every material are layers (or parts of atlas layers) of array textures
+uniform sampler2DArray texture_diffuse1;
 
 void main()
-{    
-    FragColor = texture(texture_diffuse1, TexCoords);
+{
+    // meshes without a diffuse texture
+    if (DiffuseLayer < 0.0)
+    {
+        FragColor = vec4(1.0);
+        return;
+    }
+
+    // repeating coordinates are wrapped into the atlas rectangle by hand, the gradients are taken
+    // before wrapping so the mip level does not jump where fract does
+    vec2 uv = DiffuseRect.xy + fract(TexCoords) * DiffuseRect.zw;
+    FragColor = textureGrad(texture_diffuse1, vec3(uv, DiffuseLayer), dFdx(TexCoords) * DiffuseRect.zw, dFdy(TexCoords) * DiffuseRect.zw);
 }
\ No newline at end of file
@@ -1,16 +1,45 @@
 #version 330 core
+// positions arrive quantized to [0, 1] inside the mesh bounds, aModel includes the mapping back.
+// the normal is unpacked from 10-10-10-2, the tangent stream is bound but nothing here lights with it.
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 1) in vec4 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in mat4 aModel;
+layout (location = 9) in float aMaterial;
 
 out vec2 TexCoords;
+// where the diffuse texture lies in its array: offset & scale inside the layer, and the layer
+flat out vec4 DiffuseRect;
+flat out float DiffuseLayer;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec3 cameraPosition;
+    float time;
+};
+
+// one entry per packed material, see MaterialEntry in TexturePacker.h
+struct Material
+{
+    vec4 rects[4];
+    vec4 layers;
+};
+
+layout (std140) uniform Materials
+{
+    Material materials[128];
+};
+
+// computed exactly like depth_prepass.vs so the GL_EQUAL test after the prepass holds
+invariant gl_Position;
 
 void main()
 {
-    TexCoords = aTexCoords;    
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    TexCoords = aTexCoords;
+    DiffuseRect = materials[int(aMaterial)].rects[0];
+    DiffuseLayer = materials[int(aMaterial)].layers[0];
+    gl_Position = viewProjection * aModel * vec4(aPos, 1.0);
 }
\ No newline at end of file
@@ -1,72 +1,113 @@
 #ifndef RESOURCE_MANAGER_H
 #define RESOURCE_MANAGER_H
 
-#include <map>
+#include "ResourceTable.h"
 
 #include "shader.h"
-#include "texture.h"
+#include "ProgramBinaryCache.h"
+#include "GLStateCache.h"
+#include "ShaderBundle.h"
+#include "FileSystem.h"
+#include "values.h"
+#include "StringTable.h"
+
+#include <cassert>
 
 //#include <SOIL.h>
 
 class ResourceManager {
 public:
 	// Resource storage
-	static std::map<std::string, Shader>    Shaders;
-	static std::map<std::string, Texture3D> Textures;
+	static ResourceTable<Shader> Shaders;
 	// Loads (and generates) a shader program from file loading vertex, fragment (and geometry) shader's source code. If gShaderFile is not nullptr, it also loads a geometry shader
-	static Shader   LoadShader(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile, std::string name);
-	// Retrieves a stored sader
-	static Shader   GetShader(std::string name);
-	// Loads (and generates) a texture from file
-
-
-	// Possible bug here.
-	static Texture3D LoadTexture(const GLchar *file, GLboolean alpha, std::string name);
-	
-	
-	
-	// Retrieves a stored texture
-	static Texture3D GetTexture(std::string name);
+	static Shader   LoadShader(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile, ResourceId name);
+	// Retrieves a stored sader, a hashed lookup cheap enough for every draw. The shader has to be loaded.
+	static Shader  &GetShader(ResourceId name);
+	// Compiles the programs using a changed stage file again, a program that fails to link keeps the old one.
+	// Returns how many were replaced.
+	static unsigned int ReloadShaders(const std::string &path);
+	// Textures are shared through the TextureCache
 	// Properly de-allocates all loaded resources
 	static void      Clear();
 private:
 	// Private constructor, that is we do not want any actual resource manager objects. Its members and functions should be publicly available (static).
 	ResourceManager() { }
+	// the stage files of a program, empty for a missing stage
+	struct ShaderFiles {
+		std::string vertex, fragment, geometry;
+	};
+	static ResourceTable<ShaderFiles> shaderFiles;
+	// the program with its uniform blocks bound
+	static Shader    loadProgram(const ShaderFiles &files);
 	// Loads and generates a shader from file
 	static Shader    loadShaderFromFile(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile = nullptr);
-	// Loads a single texture from file
-	static Texture3D loadTextureFromFile(const GLchar *file, GLboolean alpha);
+	// Reads the source of a single stage, from the cooked shader bundle when it has the current one, else from its file
+	static std::string readShaderFile(const GLchar *file);
 };
 
 // Instantiate static variables
-std::map<std::string, Texture3D>    ResourceManager::Textures;
-std::map<std::string, Shader>       ResourceManager::Shaders;
+ResourceTable<Shader>              ResourceManager::Shaders;
+ResourceTable<ResourceManager::ShaderFiles> ResourceManager::shaderFiles;
 
 
-Shader ResourceManager::LoadShader(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile, std::string name)
+Shader ResourceManager::LoadShader(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile, ResourceId name)
 {
-	Shaders[name] = loadShaderFromFile(vShaderFile, fShaderFile, gShaderFile);
-	return Shaders[name];
+	ShaderFiles &files = shaderFiles[name];
+	files.vertex = vShaderFile;
+	files.fragment = fShaderFile;
+	files.geometry = gShaderFile != nullptr ? gShaderFile : "";
+	Shader &shader = Shaders[name];
+	shader = loadProgram(files);
+	return shader;
 }
 
-Shader ResourceManager::GetShader(std::string name)
+Shader &ResourceManager::GetShader(ResourceId name)
 {
-	return Shaders[name];
+	Shader *shader = Shaders.Find(name);
+	if (shader == nullptr)
+	{
+		// inserting here could grow the table and move the shaders other callers hold references to
+		std::cout << "ERROR::RESOURCE_MANAGER: shader " << name << " was never loaded" << std::endl;
+		assert(!"GetShader of a shader that was never loaded");
+		// program 0, draws with it do nothing
+		static Shader missing;
+		return missing;
+	}
+	return *shader;
 }
 
-Texture3D ResourceManager::GetTexture(std::string name)
+unsigned int ResourceManager::ReloadShaders(const std::string &path)
 {
-	return Textures[name];
+	// the same file however its path is spelled
+	std::string name = AssetArchive::GetName(path);
+	unsigned int reloaded = 0;
+	shaderFiles.ForEach([&](ResourceId id, ShaderFiles &files) {
+		if (AssetArchive::GetName(files.vertex) != name && AssetArchive::GetName(files.fragment) != name &&
+			(files.geometry.empty() || AssetArchive::GetName(files.geometry) != name))
+			return;
+		Shader shader = loadProgram(files);
+		if (!shader.isLinked())
+		{
+			std::cout << "ResourceManager: " << path << " does not link, keeping the old program" << std::endl;
+			GLStateCache::DeleteProgram(shader.getID());
+			return;
+		}
+		// draws look the program up by id, the next one uses the new program
+		Shader &old = *Shaders.Find(id);
+		GLStateCache::DeleteProgram(old.getID());
+		old = shader;
+		reloaded++;
+	});
+	return reloaded;
 }
 
 void ResourceManager::Clear()
 {
 	// (Properly) delete all shaders	
-	for (auto iter : Shaders)
-		glDeleteProgram(iter.second.getID());
-	// (Properly) delete all textures
-	for (auto iter : Textures)
-		glDeleteTextures(1, &iter.second.ID);
+	Shaders.ForEach([](ResourceId name, Shader &shader) { GLStateCache::DeleteProgram(shader.getID()); });
+	Shaders.Clear();
+	shaderFiles.Clear();
+	ShaderBundle::Close();
 }
 
 Shader ResourceManager::loadShaderFromFile(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile)
@@ -77,28 +118,11 @@ Shader ResourceManager::loadShaderFromFile(const GLchar *vShaderFile, const GLch
 	std::string geometryCode;
 	try
 	{
-		// Open files
-		std::ifstream vertexShaderFile(vShaderFile);
-		std::ifstream fragmentShaderFile(fShaderFile);
-		std::stringstream vShaderStream, fShaderStream;
-		// Read file's buffer contents into streams
-		vShaderStream << vertexShaderFile.rdbuf();
-		fShaderStream << fragmentShaderFile.rdbuf();
-		// close file handlers
-		vertexShaderFile.close();
-		fragmentShaderFile.close();
-		// Convert stream into string
-		vertexCode = vShaderStream.str();
-		fragmentCode = fShaderStream.str();
+		vertexCode = readShaderFile(vShaderFile);
+		fragmentCode = readShaderFile(fShaderFile);
 		// If geometry shader path is present, also load a geometry shader
 		if (gShaderFile != nullptr)
-		{
-			std::ifstream geometryShaderFile(gShaderFile);
-			std::stringstream gShaderStream;
-			gShaderStream << geometryShaderFile.rdbuf();
-			geometryShaderFile.close();
-			geometryCode = gShaderStream.str();
-		}
+			geometryCode = readShaderFile(gShaderFile);
 	}
 	catch (std::exception e)
 	{
@@ -107,52 +131,37 @@ Shader ResourceManager::loadShaderFromFile(const GLchar *vShaderFile, const GLch
 	const GLchar *vShaderCode = vertexCode.c_str();
 	const GLchar *fShaderCode = fragmentCode.c_str();
 	const GLchar *gShaderCode = geometryCode.c_str();
-	// 2. Now create shader object from source code
+	// 2. Now create shader object, from the binary an earlier launch linked or else from source code
 	Shader shader;
+	std::string cache_key = ProgramBinaryCache::MakeKey(vertexCode, fragmentCode, geometryCode);
+	if (shader.LoadBinary(cache_key))
+		return shader;
 	//Shader shader(vShaderFile, fShaderFile, gShaderFile != nullptr ? gShaderCode : nullptr);
 	shader.Compile(vShaderCode, fShaderCode, gShaderFile != nullptr ? gShaderCode : nullptr);
+	ProgramBinaryCache::Store(shader.getID(), cache_key);
 	return shader;
 }
 
-Texture3D ResourceManager::loadTextureFromFile(const GLchar *file, GLboolean alpha)
+Shader ResourceManager::loadProgram(const ShaderFiles &files)
 {
-	// Create Texture object
-	Texture3D texture;
-	if (alpha)
-	{
-		texture.setInternal_Format(GL_RGBA);
-		texture.setImage_Format(GL_RGBA);
-	}
-	// Load image
-	int width, height, nrComponents;
-	unsigned char *data = stbi_load(file, &width, &height, &nrComponents, 0);
-	if (data)
-	{
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
-
-		glBindTexture(GL_TEXTURE_2D, texture.ID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	Shader shader = loadShaderFromFile(files.vertex.c_str(), files.fragment.c_str(), files.geometry.empty() ? nullptr : files.geometry.c_str());
+	// every program reads the per frame camera constants and the packed materials from the same buffers
+	if (!shader.isLinked())
+		return shader;
+	shader.bindUniformBlock(KEY_BLOCK_CAMERA, UNIFORM_BINDING_CAMERA);
+	shader.bindUniformBlock(KEY_BLOCK_MATERIALS, UNIFORM_BINDING_MATERIALS);
+	return shader;
+}
 
-		stbi_image_free(data);
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << file << std::endl;
-		stbi_image_free(data);
-	}
-	return texture;
+std::string ResourceManager::readShaderFile(const GLchar *file)
+{
+	std::string code;
+	if (ShaderBundle::Read(file, code))
+		return code;
+	// from the asset archive or the loose file
+	if (!FileSystem::ReadText(file, code))
+		std::cout << "ERROR::SHADER: Failed to read " << file << std::endl;
+	return code;
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,133 @@
+#ifndef RESOURCE_TABLE_H
+#define RESOURCE_TABLE_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Resources are named by the hash of their name, worked out by the compiler for the keys in StringTable.h,
+// so looking one up compares integers instead of strings.
+typedef uint32_t ResourceId;
+
+// FNV-1a over a zero terminated name
+constexpr ResourceId HashResourceName(const char *name, ResourceId hash = 2166136261u)
+{
+	return *name == 0 ? hash : HashResourceName(name + 1, (hash ^ (unsigned char)*name) * 16777619u);
+}
+
+// true when no two of the count ids are equal, for a static_assert over every key (see StringTable.h)
+constexpr bool ResourceIdsDistinct(const ResourceId *ids, size_t count, size_t first = 0, size_t second = 1)
+{
+	return first + 1 >= count ? true
+		: second >= count ? ResourceIdsDistinct(ids, count, first + 1, first + 2)
+		: ids[first] != ids[second] && ResourceIdsDistinct(ids, count, first, second + 1);
+}
+
+// ResourceTable maps ids to resources in one flat array with open addressing (linear probing), a lookup
+// is a multiply, a mask and usually a single compare. The table stays at most half full.
+// References into the table stay valid until the next insert of a new id.
+template <typename T>
+class ResourceTable {
+public:
+	ResourceTable() : _count(0) { _slots.resize(_MIN_CAPACITY); }
+
+	// the resource of an id, null when there is none
+	T *Find(ResourceId id);
+
+	// the resource of an id, default constructed when there was none (like std::map)
+	T &operator[](ResourceId id);
+
+	size_t GetCount() const { return _count; }
+
+	// calls function(id, resource) for every resource
+	template <typename F>
+	void ForEach(F function);
+
+	void Clear();
+
+private:
+	static const size_t _MIN_CAPACITY = 16;
+
+	struct _Slot {
+		ResourceId id;
+		bool used;
+		T value;
+
+		_Slot() : id(0), used(false), value() { }
+	};
+
+	std::vector<_Slot> _slots;
+	size_t _count;
+
+	// the slot holding id, or the empty slot it would go to
+	size_t _Probe(ResourceId id) const;
+	void _Grow();
+};
+
+template <typename T>
+T *ResourceTable<T>::Find(ResourceId id)
+{
+	_Slot &slot = _slots[_Probe(id)];
+	return slot.used ? &slot.value : nullptr;
+}
+
+template <typename T>
+T &ResourceTable<T>::operator[](ResourceId id)
+{
+	size_t index = _Probe(id);
+	if (_slots[index].used)
+		return _slots[index].value;
+
+	if ((_count + 1) * 2 > _slots.size())
+	{
+		_Grow();
+		index = _Probe(id);
+	}
+	_slots[index].id = id;
+	_slots[index].used = true;
+	_count++;
+	return _slots[index].value;
+}
+
+template <typename T>
+template <typename F>
+void ResourceTable<T>::ForEach(F function)
+{
+	for (size_t i = 0; i < _slots.size(); i++)
+	{
+		if (_slots[i].used)
+			function(_slots[i].id, _slots[i].value);
+	}
+}
+
+template <typename T>
+void ResourceTable<T>::Clear()
+{
+	_slots.assign(_MIN_CAPACITY, _Slot());
+	_count = 0;
+}
+
+template <typename T>
+size_t ResourceTable<T>::_Probe(ResourceId id) const
+{
+	// the capacity is a power of two and the ids are hashes already, their low bits pick the slot
+	size_t mask = _slots.size() - 1;
+	size_t index = (size_t)id & mask;
+	while (_slots[index].used && _slots[index].id != id)
+		index = (index + 1) & mask;
+	return index;
+}
+
+template <typename T>
+void ResourceTable<T>::_Grow()
+{
+	std::vector<_Slot> old_slots(_slots.size() * 2);
+	old_slots.swap(_slots);
+	for (size_t i = 0; i < old_slots.size(); i++)
+	{
+		if (old_slots[i].used)
+			_slots[_Probe(old_slots[i].id)] = old_slots[i];
+	}
+}
+
+#endif
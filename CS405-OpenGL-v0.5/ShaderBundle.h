@@ -0,0 +1,198 @@
+#ifndef SHADER_BUNDLE_H
+#define SHADER_BUNDLE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+
+#include "CookedAsset.h"
+#include "MappedFile.h"
+#include "FileSystem.h"
+#include "StringTable.h"
+
+// The shader bundle keeps the source of every shader stage in one cooked file, so loading the
+// programs opens a single mapping instead of a file per stage.
+// Layout: ShaderBundleHeader | ShaderBundleEntry per stage | strings (paths & sources).
+// The header stamp belongs to the bundle itself, every entry carries the stamp of its own source.
+
+const uint32_t SHADER_BUNDLE_MAGIC = 0x42485343; // "CSHB"
+const uint32_t SHADER_BUNDLE_VERSION = 1;
+
+struct ShaderBundleHeader {
+	CookedStamp stamp;
+	uint32_t entryCount;
+	uint32_t reserved;
+	uint64_t stringOffset;
+};
+
+struct ShaderBundleEntry {
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	// ranges of the string block
+	uint32_t pathOffset;
+	uint32_t pathLength;
+	uint32_t textOffset;
+	uint32_t textLength;
+};
+
+class ShaderBundle {
+public:
+	// Reads every source into the bundle, false when one can not be read or the bundle not written.
+	static bool Write(const std::string &bundlePath, const std::vector<std::string> &sourcePaths);
+
+	// Source of a stage from the bundle, false when the bundle lacks it or the file changed since.
+	static bool Read(const std::string &sourcePath, std::string &text);
+
+	// true while the bundle is valid and none of its sources changed since it was written
+	static bool IsCurrent(const std::string &bundlePath);
+
+	// Unmaps the bundle, the next Read maps it again.
+	static void Close();
+
+private:
+	ShaderBundle() { }
+
+	static std::shared_ptr<MappedFile> _bundle;
+	static bool _opened;
+
+	static bool _Validate(const MappedFile &file);
+};
+
+// Instantiate static variables
+std::shared_ptr<MappedFile> ShaderBundle::_bundle;
+bool ShaderBundle::_opened = false;
+
+bool ShaderBundle::Write(const std::string &bundlePath, const std::vector<std::string> &sourcePaths)
+{
+	std::vector<ShaderBundleEntry> entries(sourcePaths.size());
+	std::string strings;
+	for (size_t i = 0; i < sourcePaths.size(); i++)
+	{
+		std::ifstream source(sourcePaths[i].c_str(), std::ios::binary);
+		if (!source)
+		{
+			std::cout << "ShaderBundle: cannot read " << sourcePaths[i] << std::endl;
+			return false;
+		}
+		std::string text((std::istreambuf_iterator<char>(source)), std::istreambuf_iterator<char>());
+		std::string path = CookedAsset::NormalizePath(sourcePaths[i]);
+
+		ShaderBundleEntry &entry = entries[i];
+		CookedAsset::GetSourceStamp(sourcePaths[i], entry.sourceSize, entry.sourceTime);
+		entry.pathOffset = (uint32_t)strings.size();
+		entry.pathLength = (uint32_t)path.size();
+		strings += path;
+		entry.textOffset = (uint32_t)strings.size();
+		entry.textLength = (uint32_t)text.size();
+		strings += text;
+	}
+
+	ShaderBundleHeader header;
+	std::memset(&header, 0, sizeof(header));
+	header.stamp.magic = SHADER_BUNDLE_MAGIC;
+	header.stamp.version = SHADER_BUNDLE_VERSION;
+	header.entryCount = (uint32_t)entries.size();
+	header.stringOffset = sizeof(ShaderBundleHeader) + entries.size() * sizeof(ShaderBundleEntry);
+	header.stamp.fileSize = header.stringOffset + strings.size();
+
+	std::string temporary_path = CookedAsset::BeginWrite(bundlePath);
+	std::ofstream file(temporary_path.c_str(), std::ios::binary | std::ios::trunc);
+	file.write((const char*)&header, sizeof(header));
+	if (!entries.empty())
+		file.write((const char*)entries.data(), entries.size() * sizeof(ShaderBundleEntry));
+	file.write(strings.data(), strings.size());
+	file.close();
+
+	// a mapping of the old bundle has to go before it can be replaced
+	Close();
+	return CookedAsset::Replace(temporary_path, bundlePath, (bool)file);
+}
+
+bool ShaderBundle::Read(const std::string &sourcePath, std::string &text)
+{
+	if (!_opened)
+	{
+		_opened = true;
+		_bundle = FileSystem::Open(FILE_COOKED_SHADERS);
+		if (_bundle && !_Validate(*_bundle))
+			_bundle.reset();
+	}
+	if (!_bundle)
+		return false;
+
+	const unsigned char *data = _bundle->GetData();
+	const ShaderBundleHeader &header = *(const ShaderBundleHeader*)data;
+	const ShaderBundleEntry *entries = (const ShaderBundleEntry*)(data + sizeof(ShaderBundleHeader));
+	const char *strings = (const char*)data + header.stringOffset;
+
+	std::string path = CookedAsset::NormalizePath(sourcePath);
+	for (uint32_t i = 0; i < header.entryCount; i++)
+	{
+		const ShaderBundleEntry &entry = entries[i];
+		if (entry.pathLength != path.size() || std::memcmp(strings + entry.pathOffset, path.data(), path.size()) != 0)
+			continue;
+
+		// an edited shader is read from its file until the bundle is cooked again
+		CookedStamp stamp;
+		stamp.sourceSize = entry.sourceSize;
+		stamp.sourceTime = entry.sourceTime;
+		if (!CookedAsset::IsCurrent(stamp, sourcePath))
+			return false;
+		text.assign(strings + entry.textOffset, entry.textLength);
+		return true;
+	}
+	return false;
+}
+
+bool ShaderBundle::IsCurrent(const std::string &bundlePath)
+{
+	MappedFile file;
+	if (!file.Open(bundlePath) || !_Validate(file))
+		return false;
+
+	const ShaderBundleHeader &header = *(const ShaderBundleHeader*)file.GetData();
+	const ShaderBundleEntry *entries = (const ShaderBundleEntry*)(file.GetData() + sizeof(ShaderBundleHeader));
+	const char *strings = (const char*)file.GetData() + header.stringOffset;
+	for (uint32_t i = 0; i < header.entryCount; i++)
+	{
+		CookedStamp stamp;
+		stamp.sourceSize = entries[i].sourceSize;
+		stamp.sourceTime = entries[i].sourceTime;
+		if (!CookedAsset::IsCurrent(stamp, std::string(strings + entries[i].pathOffset, entries[i].pathLength)))
+			return false;
+	}
+	return true;
+}
+
+void ShaderBundle::Close()
+{
+	_bundle.reset();
+	_opened = false;
+}
+
+bool ShaderBundle::_Validate(const MappedFile &file)
+{
+	if (file.GetSize() < sizeof(ShaderBundleHeader))
+		return false;
+	const ShaderBundleHeader &header = *(const ShaderBundleHeader*)file.GetData();
+	if (header.stamp.magic != SHADER_BUNDLE_MAGIC || header.stamp.version != SHADER_BUNDLE_VERSION || header.stamp.fileSize != file.GetSize() ||
+		header.stringOffset != sizeof(ShaderBundleHeader) + (uint64_t)header.entryCount * sizeof(ShaderBundleEntry) ||
+		header.stringOffset > header.stamp.fileSize)
+		return false;
+
+	uint64_t string_size = header.stamp.fileSize - header.stringOffset;
+	const ShaderBundleEntry *entries = (const ShaderBundleEntry*)(file.GetData() + sizeof(ShaderBundleHeader));
+	for (uint32_t i = 0; i < header.entryCount; i++)
+	{
+		if ((uint64_t)entries[i].pathOffset + entries[i].pathLength > string_size ||
+			(uint64_t)entries[i].textOffset + entries[i].textLength > string_size)
+			return false;
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,233 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include "Include/glad/glad.h"
+
+#include <vector>
+#include <cstring>
+#include <iostream>
+
+#include "GLExtensions.h"
+#include "GLStateCache.h"
+
+// Frames the CPU may be ahead of the GPU, each one writes its own region of the ring.
+const unsigned int STREAM_FRAME_COUNT = 3;
+
+// A piece of this frame's stream memory. Write size bytes to data, then Commit.
+struct StreamAllocation {
+	void *data;
+	GLuint buffer;
+	size_t offset;
+	size_t size;
+};
+
+// StreamBuffer holds the data that is written anew every frame (instance matrices, draw commands,
+// camera constants) in one buffer that is never reallocated.
+// With GL 4.4 / ARB_buffer_storage it is a persistent, coherent mapping split into STREAM_FRAME_COUNT
+// regions; a fence at the end of every frame tells when the GPU is done with a region so the CPU can
+// write it again. Older contexts write to a CPU copy that is uploaded on Commit, and orphan the
+// buffer once per frame with glBufferData so the driver never waits for the previous frame.
+class StreamBuffer {
+public:
+	StreamBuffer();
+
+	// frameBytes is the room one frame gets, needs a current context and GLExtensions loaded.
+	void Create(size_t frameBytes);
+
+	// Moves to the next region, waiting for the GPU only when it still reads it.
+	void BeginFrame();
+
+	// Places size bytes at a multiple of alignment inside this frame's region.
+	StreamAllocation Allocate(size_t size, size_t alignment);
+
+	// Makes the written data visible to the GPU.
+	void Commit(const StreamAllocation &allocation);
+
+	// Fences the region, after the last draw reading it was issued.
+	void EndFrame();
+
+	void Delete();
+
+	GLuint GetBuffer() const { return _buffer; }
+	bool IsPersistent() const { return _mapped != NULL; }
+
+	// frames that had to wait for their region
+	unsigned int GetStallCount() const { return _stalls; }
+
+private:
+	GLuint _buffer;
+	size_t _frameBytes;
+	unsigned int _region;
+	size_t _head;
+
+	/*  Persistent Mapping  */
+	unsigned char *_mapped;
+	GLsync _fences[STREAM_FRAME_COUNT];
+
+	/*  Orphaning Fallback  */
+	std::vector<unsigned char> _staging;
+
+	/*  Overflow  */
+	// a frame that does not fit gets buffers of its own, they live until the region comes around again
+	std::vector<GLuint> _spills[STREAM_FRAME_COUNT];
+	std::vector<std::vector<unsigned char> > _spillStaging;
+	bool _overflowReported;
+
+	unsigned int _stalls;
+
+	StreamAllocation _Spill(size_t size);
+};
+
+StreamBuffer::StreamBuffer() : _buffer(0), _frameBytes(0), _region(0), _head(0), _mapped(NULL), _overflowReported(false), _stalls(0)
+{
+	for (unsigned int i = 0; i < STREAM_FRAME_COUNT; i++)
+		_fences[i] = 0;
+}
+
+void StreamBuffer::Create(size_t frameBytes)
+{
+	_frameBytes = frameBytes;
+	_region = 0;
+	_head = 0;
+
+	glGenBuffers(1, &_buffer);
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, _buffer);
+
+	if (GLExtensions::PersistentMapping)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		GLExtensions::BufferStorage(GL_ARRAY_BUFFER, _frameBytes * STREAM_FRAME_COUNT, NULL, flags);
+		_mapped = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, _frameBytes * STREAM_FRAME_COUNT, flags);
+	}
+	if (_mapped == NULL)
+	{
+		// one region is enough, orphaning gives every frame fresh storage
+		glBufferData(GL_ARRAY_BUFFER, _frameBytes, NULL, GL_STREAM_DRAW);
+		_staging.resize(_frameBytes);
+	}
+
+	if (_mapped != NULL)
+		std::cout << "StreamBuffer: " << STREAM_FRAME_COUNT << " x " << _frameBytes / 1024 << " KB, persistent mapping" << std::endl;
+	else
+		std::cout << "StreamBuffer: " << _frameBytes / 1024 << " KB, orphaning" << std::endl;
+}
+
+void StreamBuffer::BeginFrame()
+{
+	_region = (_region + 1) % STREAM_FRAME_COUNT;
+	_head = 0;
+
+	if (_mapped != NULL && _fences[_region] != 0)
+	{
+		GLenum result = glClientWaitSync(_fences[_region], 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED)
+		{
+			_stalls++;
+			do
+			{
+				result = glClientWaitSync(_fences[_region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+			} while (result == GL_TIMEOUT_EXPIRED);
+		}
+		glDeleteSync(_fences[_region]);
+		_fences[_region] = 0;
+	}
+	else if (_mapped == NULL)
+	{
+		GLStateCache::BindBuffer(GL_ARRAY_BUFFER, _buffer);
+		glBufferData(GL_ARRAY_BUFFER, _frameBytes, NULL, GL_STREAM_DRAW);
+	}
+
+	// the GPU is done with the spills of this region as well
+	if (!_spills[_region].empty())
+	{
+		GLStateCache::DeleteBuffers((GLsizei)_spills[_region].size(), _spills[_region].data());
+		_spills[_region].clear();
+	}
+	_spillStaging.clear();
+}
+
+StreamAllocation StreamBuffer::Allocate(size_t size, size_t alignment)
+{
+	if (alignment == 0)
+		alignment = 1;
+	size_t offset = (_head + alignment - 1) / alignment * alignment;
+	if (offset + size > _frameBytes)
+		return _Spill(size);
+	_head = offset + size;
+
+	StreamAllocation allocation;
+	allocation.buffer = _buffer;
+	allocation.size = size;
+	if (_mapped != NULL)
+	{
+		allocation.offset = _region * _frameBytes + offset;
+		allocation.data = _mapped + allocation.offset;
+	}
+	else
+	{
+		allocation.offset = offset;
+		allocation.data = &_staging[offset];
+	}
+	return allocation;
+}
+
+void StreamBuffer::Commit(const StreamAllocation &allocation)
+{
+	// coherent mappings need nothing, the fence at the end of the frame orders the writes
+	if (allocation.buffer == _buffer && _mapped != NULL)
+		return;
+
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, allocation.buffer);
+	glBufferSubData(GL_ARRAY_BUFFER, allocation.offset, allocation.size, allocation.data);
+}
+
+void StreamBuffer::EndFrame()
+{
+	if (_mapped != NULL)
+		_fences[_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void StreamBuffer::Delete()
+{
+	for (unsigned int i = 0; i < STREAM_FRAME_COUNT; i++)
+	{
+		if (_fences[i] != 0)
+			glDeleteSync(_fences[i]);
+		_fences[i] = 0;
+		if (!_spills[i].empty())
+			GLStateCache::DeleteBuffers((GLsizei)_spills[i].size(), _spills[i].data());
+		_spills[i].clear();
+	}
+	if (_mapped != NULL)
+	{
+		GLStateCache::BindBuffer(GL_ARRAY_BUFFER, _buffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		_mapped = NULL;
+	}
+	GLStateCache::DeleteBuffers(1, &_buffer);
+}
+
+StreamAllocation StreamBuffer::_Spill(size_t size)
+{
+	if (!_overflowReported)
+	{
+		std::cout << "StreamBuffer: frame needs more than " << _frameBytes / 1024 << " KB, raise the frame size" << std::endl;
+		_overflowReported = true;
+	}
+
+	GLuint spill;
+	glGenBuffers(1, &spill);
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, spill);
+	glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+	_spills[_region].push_back(spill);
+	_spillStaging.push_back(std::vector<unsigned char>(size));
+
+	StreamAllocation allocation;
+	allocation.data = _spillStaging.back().data();
+	allocation.buffer = spill;
+	allocation.offset = 0;
+	allocation.size = size;
+	return allocation;
+}
+
+#endif
@@ -2,13 +2,25 @@
 #define STRINGTABLE_H
 #include <string>
 
+#include "ResourceTable.h"
+
 // STRING TABLE
 // -----------------------------
 std::string WINDOW_TITLE = "Fish In the sea";
 
-std::string KEY_SHADER_SKYBOX = "SKYBOX_SHADER";
-std::string KEY_SHADER_OBJECT = "OBJECT_SHADER";
-std::string KEY_TEXTURE_MARBLE = "TEXTURE_MARBLE";
+// resource keys are hashed by the compiler, see ResourceTable.h
+constexpr ResourceId KEY_SHADER_SKYBOX = HashResourceName("SKYBOX_SHADER");
+constexpr ResourceId KEY_SHADER_OBJECT = HashResourceName("OBJECT_SHADER");
+constexpr ResourceId KEY_SHADER_HUD = HashResourceName("HUD_SHADER");
+constexpr ResourceId KEY_SHADER_DEPTH = HashResourceName("DEPTH_SHADER");
+constexpr ResourceId KEY_TEXTURE_MARBLE = HashResourceName("TEXTURE_MARBLE");
+
+// two names hashing to the same id would silently share one resource, every key has to be listed here
+constexpr ResourceId RESOURCE_KEYS[] = { KEY_SHADER_SKYBOX, KEY_SHADER_OBJECT, KEY_SHADER_HUD, KEY_SHADER_DEPTH, KEY_TEXTURE_MARBLE };
+static_assert(ResourceIdsDistinct(RESOURCE_KEYS, sizeof(RESOURCE_KEYS) / sizeof(RESOURCE_KEYS[0])), "two resource keys hash to the same id, rename one");
+
+std::string KEY_BLOCK_CAMERA = "Camera";
+std::string KEY_BLOCK_MATERIALS = "Materials";
 
 
 std::string FILE_SHADER_FRAGMENT_SKYBOX = "./Resource/shaders/skybox.fs";
@@ -17,6 +29,29 @@ std::string FILE_SHADER_VERTEX_SKYBOX = "./Resource/shaders/skybox.vs";
 std::string FILE_SHADER_FRAGMENT_STANDART_OBJECT = "./Resource/shaders/model_loading.fs";
 std::string FILE_SHADER_VERTEX_STANDARD_OBJECT = "./Resource/shaders/model_loading.vs";
 
+std::string FILE_SHADER_VERTEX_HUD = "./Resource/shaders/hud.vs";
+std::string FILE_SHADER_FRAGMENT_HUD = "./Resource/shaders/hud.fs";
+
+// linked program binaries of the current driver, safe to delete
+std::string DIRECTORY_SHADER_CACHE = "./ShaderCache";
+
+// assets converted by the AssetCooker (models also on first load), rebuilt from the sources when missing
+std::string DIRECTORY_COOKED = "./Cooked";
+std::string FILE_COOKED_MANIFEST = "./Cooked/manifest.txt";
+std::string FILE_COOKED_SHADERS = "./Cooked/shaders.bundle";
+
+// the sources & cooked files packed by the AssetCooker, the game reads through it when it is there
+std::string FILE_ARCHIVE = "./Assets.pak";
+
+// sources the AssetCooker walks
+std::string DIRECTORY_RESOURCE = "./Resource";
+std::string DIRECTORY_OBJECTS = "./Resource/objects";
+std::string DIRECTORY_TEXTURES = "./Resource/textures";
+std::string DIRECTORY_SHADERS = "./Resource/shaders";
+
+std::string FILE_SHADER_FRAGMENT_DEPTH = "./Resource/shaders/depth_prepass.fs";
+std::string FILE_SHADER_VERTEX_DEPTH = "./Resource/shaders/depth_prepass.vs";
+
 
 std::string FILE_OBJECT_HP = "./Resource/objects/Galp/Galp.obj";
 std::string FILE_OBJECT_SCORE = "./Resource/objects/Score/Score.obj";
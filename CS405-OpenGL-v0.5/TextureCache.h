@@ -0,0 +1,269 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "Include/glad/glad.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <cstdlib>
+
+#include "stb_image.h"
+
+#include "GLStateCache.h"
+#include "TextureLoader.h"
+#include "CookedAsset.h"
+#include "FileSystem.h"
+
+#ifndef _WIN32
+#include <climits>
+#include <unistd.h>
+#endif
+
+// TextureCache owns every texture loaded from a file, one texture object per image however many models
+// use it. Textures are found by the normalized absolute path of their file (a cube map by the paths of its
+// faces) and counted: every Acquire takes a reference that Release gives back. A texture nobody references
+// stays cached, so a model loaded again finds it, until Evict deletes it.
+class TextureCache {
+public:
+	// Texture of an image file, new ones are decoded in the background by TextureLoader.
+	static GLuint Acquire(const std::string &path);
+
+	// Cube map of six face images (+X, -X, +Y, -Y, +Z, -Z), new ones are loaded right away.
+	static GLuint AcquireCubemap(const std::vector<std::string> &faces);
+
+	static void Release(GLuint texture);
+
+	// Deletes unreferenced textures except the keepCount released last. Nothing is deleted while
+	// TextureLoader still has images to upload, they could belong to one of them.
+	static void Evict(size_t keepCount);
+
+	// Loads a changed image file again: its texture in the background (showing the old image until then),
+	// the cube maps with it as a face right away. False when no cached texture uses the file.
+	static bool Reload(const std::string &path);
+
+	// the same file always gives the same key, however the path is spelled
+	static std::string GetKey(const std::string &path);
+
+	static void PrintStats();
+
+	// Deletes every texture, referenced or not.
+	static void Clear();
+
+private:
+	TextureCache() { }
+
+	struct _Entry {
+		GLuint texture;
+		unsigned int references;
+		// when the last reference went, orders the unreferenced textures for Evict
+		unsigned long long released;
+	};
+
+	static std::unordered_map<std::string, _Entry> _entries;
+	static std::unordered_map<GLuint, std::string> _keys;
+	static unsigned long long _releaseCount;
+	static size_t _unreferencedCount;
+
+	/*  Statistics  */
+	static size_t _hitCount;
+	static size_t _loadCount;
+
+	static GLuint _Acquire(const std::string &key);
+	static void _Insert(const std::string &key, GLuint texture);
+	// into a texture that may already hold the faces
+	static void _LoadCubemap(GLuint texture, const std::vector<std::string> &faces);
+};
+
+// Instantiate static variables
+std::unordered_map<std::string, TextureCache::_Entry> TextureCache::_entries;
+std::unordered_map<GLuint, std::string> TextureCache::_keys;
+unsigned long long TextureCache::_releaseCount = 0;
+size_t TextureCache::_unreferencedCount = 0;
+size_t TextureCache::_hitCount = 0;
+size_t TextureCache::_loadCount = 0;
+
+GLuint TextureCache::Acquire(const std::string &path)
+{
+	std::string key = GetKey(path);
+	GLuint texture = _Acquire(key);
+	if (texture != 0)
+		return texture;
+
+	texture = TextureLoader::Load(path);
+	_Insert(key, texture);
+	return texture;
+}
+
+GLuint TextureCache::AcquireCubemap(const std::vector<std::string> &faces)
+{
+	// '|' never shows up in a file key, a cube map can not collide with one of its faces
+	std::string key = "cubemap";
+	for (size_t i = 0; i < faces.size(); i++)
+		key += "|" + GetKey(faces[i]);
+	GLuint texture = _Acquire(key);
+	if (texture != 0)
+		return texture;
+
+	glGenTextures(1, &texture);
+	_LoadCubemap(texture, faces);
+	_Insert(key, texture);
+	return texture;
+}
+
+void TextureCache::Release(GLuint texture)
+{
+	std::unordered_map<GLuint, std::string>::const_iterator key = _keys.find(texture);
+	if (key == _keys.end())
+		return;
+	_Entry &entry = _entries[key->second];
+	if (entry.references == 0)
+		return;
+	if (--entry.references == 0)
+	{
+		entry.released = ++_releaseCount;
+		_unreferencedCount++;
+	}
+}
+
+void TextureCache::Evict(size_t keepCount)
+{
+	if (_unreferencedCount <= keepCount || TextureLoader::GetPendingCount() != 0)
+		return;
+
+	std::vector<std::pair<unsigned long long, GLuint> > unreferenced;
+	for (std::unordered_map<std::string, _Entry>::const_iterator it = _entries.begin(); it != _entries.end(); ++it)
+	{
+		if (it->second.references == 0)
+			unreferenced.push_back(std::make_pair(it->second.released, it->second.texture));
+	}
+	// released last first, everything after the kept ones goes
+	std::sort(unreferenced.begin(), unreferenced.end(), std::greater<std::pair<unsigned long long, GLuint> >());
+	std::vector<GLuint> evicted;
+	for (size_t i = keepCount; i < unreferenced.size(); i++)
+	{
+		GLuint texture = unreferenced[i].second;
+		evicted.push_back(texture);
+		_entries.erase(_keys[texture]);
+		_keys.erase(texture);
+	}
+	_unreferencedCount -= evicted.size();
+	if (!evicted.empty())
+		GLStateCache::DeleteTextures((GLsizei)evicted.size(), evicted.data());
+}
+
+bool TextureCache::Reload(const std::string &path)
+{
+	std::string key = GetKey(path);
+	bool reloaded = false;
+	for (std::unordered_map<std::string, _Entry>::const_iterator it = _entries.begin(); it != _entries.end(); ++it)
+	{
+		if (it->first == key)
+		{
+			TextureLoader::Reload(it->second.texture, path);
+			reloaded = true;
+			continue;
+		}
+		// the faces of a cube map are the keys after its prefix
+		if (it->first.compare(0, 8, "cubemap|") != 0 || (it->first + "|").find("|" + key + "|") == std::string::npos)
+			continue;
+		std::vector<std::string> faces;
+		for (size_t begin = 8; begin <= it->first.size();)
+		{
+			size_t end = std::min(it->first.find('|', begin), it->first.size());
+			faces.push_back(it->first.substr(begin, end - begin));
+			begin = end + 1;
+		}
+		_LoadCubemap(it->second.texture, faces);
+		reloaded = true;
+	}
+	return reloaded;
+}
+
+std::string TextureCache::GetKey(const std::string &path)
+{
+	// resolves the path against the working directory, files that do not exist keep their relative path
+#ifdef _WIN32
+	char absolute[_MAX_PATH];
+	if (_fullpath(absolute, path.c_str(), _MAX_PATH) != NULL)
+		return CookedAsset::NormalizePath(absolute);
+#else
+	char absolute[PATH_MAX];
+	if (realpath(path.c_str(), absolute) != NULL)
+		return CookedAsset::NormalizePath(absolute);
+#endif
+	return CookedAsset::NormalizePath(path);
+}
+
+void TextureCache::PrintStats()
+{
+	std::cout << "Texture Cache: " << _entries.size() << " textures (" << _unreferencedCount << " unreferenced), "
+		<< _loadCount << " loaded, " << _hitCount << " shared" << std::endl;
+}
+
+void TextureCache::Clear()
+{
+	std::vector<GLuint> textures;
+	for (std::unordered_map<std::string, _Entry>::const_iterator it = _entries.begin(); it != _entries.end(); ++it)
+		textures.push_back(it->second.texture);
+	if (!textures.empty())
+		GLStateCache::DeleteTextures((GLsizei)textures.size(), textures.data());
+	_entries.clear();
+	_keys.clear();
+	_unreferencedCount = 0;
+}
+
+// reference to a cached texture, 0 when the key is not cached
+GLuint TextureCache::_Acquire(const std::string &key)
+{
+	std::unordered_map<std::string, _Entry>::iterator found = _entries.find(key);
+	if (found == _entries.end())
+		return 0;
+	if (found->second.references++ == 0)
+		_unreferencedCount--;
+	_hitCount++;
+	return found->second.texture;
+}
+
+void TextureCache::_Insert(const std::string &key, GLuint texture)
+{
+	_Entry entry;
+	entry.texture = texture;
+	entry.references = 1;
+	entry.released = 0;
+	_entries[key] = entry;
+	_keys[texture] = key;
+	_loadCount++;
+}
+
+void TextureCache::_LoadCubemap(GLuint texture, const std::vector<std::string> &faces)
+{
+	GLStateCache::BindTexture(GL_TEXTURE_CUBE_MAP, texture);
+
+	int width, height, number_of_channels;
+	for (unsigned int i = 0; i < faces.size(); i++)
+	{
+		std::shared_ptr<MappedFile> file = FileSystem::Open(faces[i]);
+		unsigned char *data = file ? stbi_load_from_memory(file->GetData(), (int)file->GetSize(), &width, &height, &number_of_channels, 0) : NULL;
+		if (data)
+		{
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+			stbi_image_free(data);
+		}
+		else
+		{
+			std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
+			stbi_image_free(data);
+		}
+	}
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+}
+
+#endif
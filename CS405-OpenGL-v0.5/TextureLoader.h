@@ -0,0 +1,356 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include "Include/glad/glad.h"
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <cstring>
+#include <iostream>
+
+#include "stb_image.h"
+
+#include "GLStateCache.h"
+#include "GLExtensions.h"
+#include "ThreadPool.h"
+#include "CookedTexture.h"
+#include "FileSystem.h"
+
+// An image decoded on a worker, waiting for the GL thread.
+struct DecodedImage {
+	GLuint texture;
+	std::string path;
+	int width;
+	int height;
+	int components;
+	// what the upload copies
+	size_t bytes;
+	// stbi_load memory, NULL when the file could not be decoded or is cooked
+	unsigned char *pixels;
+	// the cooked texture with every level, mapped instead of decoding
+	std::shared_ptr<MappedFile> cooked;
+	// the request of the texture it answers, counting up
+	unsigned int generation;
+};
+
+// TextureLoader decodes image files on the worker threads and uploads them on the GL thread through
+// pixel buffer objects, so neither the decode nor the copy blocks a frame.
+// A requested texture is usable right away: it holds a single grey texel until its image arrives.
+// Images the AssetCooker cooked are mapped instead of decoded and bring their own mip chain, their blocks are
+// uploaded as they are. Without S3TC support the BC1 & BC3 ones are decoded from their source instead.
+// Update has to be called on the GL thread every frame, it uploads what finished within a byte budget.
+// A texture requested again before its image arrived only gets the newest one, in whatever order the workers finish.
+class TextureLoader {
+public:
+	// Creates the pixel buffers, needs a current context.
+	static void Init();
+
+	// New texture object with the placeholder, the file is decoded in the background.
+	static GLuint Load(const std::string &path);
+	// Same for a texture object that already exists.
+	static void Load(GLuint texture, const std::string &path);
+	// Decodes the file again into a texture, which keeps showing its old image until the new one arrives.
+	static void Reload(GLuint texture, const std::string &path);
+
+	// Uploads finished images until byteBudget is used up, at least one per call.
+	static void Update(size_t byteBudget);
+
+	// Blocks until every requested image is decoded and uploaded.
+	static void Finish();
+
+	static unsigned int GetPendingCount() { return _pending; }
+
+	// true until the newest image requested for the texture is uploaded, GL thread only
+	static bool IsPending(GLuint texture);
+
+	// Waits for the workers and releases the pixel buffers.
+	static void Clear();
+
+private:
+	TextureLoader() { }
+
+	static const unsigned int _PIXEL_BUFFER_COUNT = 2;
+	static GLuint _pixelBuffers[_PIXEL_BUFFER_COUNT];
+	static unsigned int _nextPixelBuffer;
+
+	/*  Shared with the workers  */
+	static std::mutex _mutex;
+	static std::condition_variable _decoded;
+	static std::deque<DecodedImage> _ready;
+	// requested but not uploaded yet
+	static std::atomic<unsigned int> _pending;
+
+	// the decodes in flight of a texture and its newest request, only touched on the GL thread
+	struct _Request {
+		unsigned int pending;
+		unsigned int generation;
+		unsigned int uploaded;
+	};
+	static std::unordered_map<GLuint, _Request> _requests;
+
+	static void _Decode(GLuint texture, const std::string &path, unsigned int generation);
+	static void _Upload(DecodedImage &image);
+	static void _UploadCooked(DecodedImage &image);
+	static void _SetPlaceholder(GLuint texture);
+};
+
+// Instantiate static variables
+GLuint TextureLoader::_pixelBuffers[TextureLoader::_PIXEL_BUFFER_COUNT] = {};
+unsigned int TextureLoader::_nextPixelBuffer = 0;
+std::mutex TextureLoader::_mutex;
+std::condition_variable TextureLoader::_decoded;
+std::deque<DecodedImage> TextureLoader::_ready;
+std::atomic<unsigned int> TextureLoader::_pending(0);
+std::unordered_map<GLuint, TextureLoader::_Request> TextureLoader::_requests;
+
+void TextureLoader::Init()
+{
+	glGenBuffers(_PIXEL_BUFFER_COUNT, _pixelBuffers);
+	_nextPixelBuffer = 0;
+}
+
+GLuint TextureLoader::Load(const std::string &path)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	Load(texture, path);
+	return texture;
+}
+
+void TextureLoader::Load(GLuint texture, const std::string &path)
+{
+	_SetPlaceholder(texture);
+	Reload(texture, path);
+}
+
+void TextureLoader::Reload(GLuint texture, const std::string &path)
+{
+	_Request &request = _requests[texture];
+	request.pending++;
+	unsigned int generation = ++request.generation;
+	_pending++;
+	ThreadPool::Shared().Submit([texture, path, generation]() { _Decode(texture, path, generation); });
+}
+
+void TextureLoader::Update(size_t byteBudget)
+{
+	size_t uploaded = 0;
+	while (uploaded == 0 || uploaded < byteBudget)
+	{
+		DecodedImage image;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_ready.empty())
+				return;
+			image = _ready.front();
+			_ready.pop_front();
+		}
+		// an older image finishing after a newer one was requested is dropped
+		_Request &request = _requests[image.texture];
+		if (image.generation == request.generation)
+		{
+			_Upload(image);
+			request.uploaded = image.generation;
+			uploaded += image.bytes + 1;
+		}
+		else if (image.pixels != NULL)
+		{
+			stbi_image_free(image.pixels);
+		}
+		if (--request.pending == 0)
+			_requests.erase(image.texture);
+		_pending--;
+	}
+}
+
+bool TextureLoader::IsPending(GLuint texture)
+{
+	std::unordered_map<GLuint, _Request>::const_iterator request = _requests.find(texture);
+	return request != _requests.end() && request->second.uploaded != request->second.generation;
+}
+
+void TextureLoader::Finish()
+{
+	while (_pending > 0)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_decoded.wait(lock, []() { return !_ready.empty(); });
+		}
+		Update((size_t)-1);
+	}
+}
+
+void TextureLoader::Clear()
+{
+	Finish();
+	GLStateCache::DeleteBuffers(_PIXEL_BUFFER_COUNT, _pixelBuffers);
+	for (unsigned int i = 0; i < _PIXEL_BUFFER_COUNT; i++)
+		_pixelBuffers[i] = 0;
+}
+
+void TextureLoader::_Decode(GLuint texture, const std::string &path, unsigned int generation)
+{
+	DecodedImage image;
+	image.texture = texture;
+	image.generation = generation;
+	image.path = path;
+	image.width = image.height = image.components = 0;
+	image.bytes = 0;
+	image.pixels = NULL;
+	image.cooked = CookedTexture::Open(CookedTexture::GetPath(path), path);
+	if (image.cooked && BlockCompressor::NeedsS3TC(CookedTexture::GetHeader(*image.cooked).format) && !GLExtensions::TextureCompressionS3TC)
+		image.cooked.reset();
+
+	if (image.cooked)
+	{
+		const CookedTextureHeader &header = CookedTexture::GetHeader(*image.cooked);
+		const CookedTextureLevel &last = header.levels[header.levelCount - 1];
+		image.width = (int)header.levels[0].width;
+		image.height = (int)header.levels[0].height;
+		image.components = (int)header.components;
+		image.bytes = (size_t)(last.offset + last.size - header.levels[0].offset);
+	}
+	else
+	{
+		std::shared_ptr<MappedFile> file = FileSystem::Open(path);
+		if (file)
+			image.pixels = stbi_load_from_memory(file->GetData(), (int)file->GetSize(), &image.width, &image.height, &image.components, 0);
+		image.bytes = image.pixels != NULL ? (size_t)image.width * image.height * image.components : 0;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_ready.push_back(image);
+	}
+	_decoded.notify_one();
+}
+
+void TextureLoader::_Upload(DecodedImage &image)
+{
+	if (image.cooked)
+	{
+		_UploadCooked(image);
+		return;
+	}
+	if (image.pixels == NULL)
+	{
+		std::cout << "Texture failed to load at path: " << image.path << std::endl;
+		return;
+	}
+
+	GLenum format = GL_RGBA;
+	if (image.components == 1)
+		format = GL_RED;
+	else if (image.components == 2)
+		format = GL_RG;
+	else if (image.components == 3)
+		format = GL_RGB;
+	size_t bytes = image.bytes;
+
+	// orphaning the pixel buffer lets the driver keep copying the previous image from the old storage
+	GLuint pixel_buffer = _pixelBuffers[_nextPixelBuffer];
+	_nextPixelBuffer = (_nextPixelBuffer + 1) % _PIXEL_BUFFER_COUNT;
+	GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+	void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (mapped != NULL)
+	{
+		std::memcpy(mapped, image.pixels, bytes);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+	else
+	{
+		glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, bytes, image.pixels);
+	}
+	stbi_image_free(image.pixels);
+	image.pixels = NULL;
+
+	// rows of 1 and 3 channel images are not 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	GLStateCache::BindTexture(GL_TEXTURE_2D, image.texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, (void*)0);
+	// a reloaded texture may have had a shorter cooked chain
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	// later client memory uploads must not read from the pixel buffer
+	GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+// one copy of all levels into the pixel buffer, then every level is specified from its offset
+void TextureLoader::_UploadCooked(DecodedImage &image)
+{
+	const CookedTextureHeader &header = CookedTexture::GetHeader(*image.cooked);
+	GLenum format = GL_RGBA;
+	if (header.components == 1)
+		format = GL_RED;
+	else if (header.components == 2)
+		format = GL_RG;
+	else if (header.components == 3)
+		format = GL_RGB;
+
+	size_t first = (size_t)header.levels[0].offset;
+	size_t bytes = image.bytes;
+	const unsigned char *levels = image.cooked->GetData() + first;
+
+	GLuint pixel_buffer = _pixelBuffers[_nextPixelBuffer];
+	_nextPixelBuffer = (_nextPixelBuffer + 1) % _PIXEL_BUFFER_COUNT;
+	GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+	void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (mapped != NULL)
+	{
+		std::memcpy(mapped, levels, bytes);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+	else
+	{
+		glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, bytes, levels);
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	GLStateCache::BindTexture(GL_TEXTURE_2D, image.texture);
+	for (uint32_t i = 0; i < header.levelCount; i++)
+	{
+		const CookedTextureLevel &level = header.levels[i];
+		void *offset = (void*)(size_t)(level.offset - first);
+		if (header.format != 0)
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, header.format, level.width, level.height, 0, (GLsizei)level.size, offset);
+		else
+			glTexImage2D(GL_TEXTURE_2D, i, format, level.width, level.height, 0, format, GL_UNSIGNED_BYTE, offset);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header.levelCount - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// the header lives in the mapping, it goes last
+	image.cooked.reset();
+}
+
+void TextureLoader::_SetPlaceholder(GLuint texture)
+{
+	const unsigned char grey[4] = { 128, 128, 128, 255 };
+	GLStateCache::BindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+#endif
@@ -0,0 +1,984 @@
+#ifndef TEXTURE_PACKER_H
+#define TEXTURE_PACKER_H
+
+#include "Include/glad/glad.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <map>
+#include <tuple>
+#include <string>
+#include <memory>
+#include <future>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "GLStateCache.h"
+#include "GLExtensions.h"
+#include "UniformBuffer.h"
+#include "BlockCompressor.h"
+#include "MipGenerator.h"
+#include "CookedTexture.h"
+#include "FileSystem.h"
+#include "TextureCache.h"
+#include "ThreadPool.h"
+#include "model.h"
+#include "values.h"
+
+// One entry of the std140 "Materials" block in model_loading.vs.
+struct MaterialEntry {
+	// per slot, offset (xy) and scale (zw) of the texture inside its layer
+	glm::vec4 rects[MATERIAL_SLOT_COUNT];
+	// per slot, the layer of its array texture, -1 for an empty slot
+	glm::vec4 layers;
+};
+
+// A texture read for packing, in the format and layout it takes in its array: the levels of a layer, or those
+// of its block aligned atlas slot with the gutter around the image. A width of 0 marks a file that was not read.
+struct TexturePackImage {
+	std::string path;
+	int width, height;
+	// GL_RGBA8 (level 0 only, the GL builds the mips) or a block format
+	GLenum format;
+	bool atlas;
+	// colors (diffuse & specular) rather than data, their mips are averaged in linear space
+	bool srgb;
+	std::vector<std::vector<unsigned char> > levels;
+};
+
+// The textures of some models that were not packed yet, read and compressed on the workers by TexturePacker::Prepare.
+struct TexturePack {
+	std::vector<TexturePackImage> images;
+};
+
+typedef std::shared_future<std::shared_ptr<const TexturePack> > TexturePackHandle;
+
+// TexturePacker moves the textures of the models into a few array textures.
+// Textures of the same size become layers of one GL_TEXTURE_2D_ARRAY, small ones are packed into atlas
+// pages (the layers of another array) and addressed through a rectangle. A mesh then only keeps the
+// arrays of its slots and an index into the material table, a uniform buffer holding the layers and
+// rectangles; meshes whose slots use the same arrays are drawn without binding anything in between.
+// Textures are shared by path, so every copy of a model ends up with the same layers.
+// Prepare reads the files on the workers and builds every level a texture takes in its array, Pack then only
+// lays them out and uploads them on the GL thread. Nothing is read back from the GL.
+// Cooked textures keep their blocks & mips, the others are compressed on the CPU when the GL samples
+// BC1 & BC3. An atlas holds textures of one format and every slot (its origin, size and gutter) is aligned to
+// whole blocks on every level, so the blocks of a texture go in as they are and only its gutter is compressed.
+// The material table has MATERIAL_MAX_COUNT entries, a pack that needs more fails and leaves its meshes unpacked.
+// Arrays count the packed meshes using them, Release drops a model's meshes and an array nobody uses
+// anymore is deleted together with its placements and materials.
+// Reload reads a changed file again and Update writes it over its layer or atlas slot in place, for hot reloading.
+class TexturePacker {
+public:
+	// Starts reading the textures of the models' unpacked meshes that are not packed yet, on the workers.
+	static TexturePackHandle Prepare(const std::vector<Model*> &models);
+
+	// Packs the textures of every mesh that is not packed yet from what Prepare read for them, waiting for it.
+	// False when the material table is full, the meshes stay unpacked then.
+	static bool Pack(const std::vector<Model*> &models, const TexturePackHandle &pack);
+
+	static bool IsReady(const TexturePackHandle &pack) { return pack.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+
+	// Prepare and Pack at once, for load time.
+	static bool Pack(const std::vector<Model*> &models) { return Pack(models, Prepare(models)); }
+
+	static bool IsPacked(const Model &model) { return model.meshes.empty() || model.meshes[0].material >= 0; }
+
+	// Unpacks the meshes of a packed model, arrays no other mesh uses are deleted.
+	static void Release(Model &model);
+
+	// true when the texture of the file was packed into an array
+	static bool IsPlaced(const std::string &path);
+
+	// Reads the changed file again on the workers for every spelling of it that was packed, returns how many.
+	static unsigned int Reload(const std::string &path);
+
+	// Once per frame on the GL thread: writes the images Reload read over the packed ones, every mesh sampling
+	// them sees the change and nothing moves. An image of another size needs packing again (a restart).
+	static void Update();
+
+	// bytes of the layers (or parts of atlas layers) the model's meshes sample, without mips
+	static size_t GetTextureBytes(const Model &model);
+
+	static void PrintStats();
+
+	// Deletes the arrays and the material table, waits for the reloads in flight.
+	static void Clear();
+
+private:
+	TexturePacker() { }
+
+	// where a texture ended up
+	struct _Placement {
+		GLuint array;
+		int layer;
+		glm::vec4 rect;
+		// a reload builds the mips like the pack did
+		bool srgb;
+	};
+
+	// a texture file as read, before it takes the format of its array
+	struct _Source {
+		int width, height;
+		// RGBA, empty when the blocks were read instead
+		std::vector<unsigned char> pixels;
+		// block format of a cooked texture and its blocks per level, 0 when the pixels were read
+		GLenum format;
+		std::vector<std::vector<unsigned char> > levels;
+	};
+
+	// position of an image on an atlas page, in texels
+	struct _AtlasSlot {
+		size_t image;
+		int page, x, y;
+	};
+
+	// an array texture and how many packed meshes use it
+	struct _Array {
+		int width, height, layers;
+		// internal format, GL_RGBA8 or a block format
+		GLenum format;
+		int levels;
+		bool atlas;
+		unsigned int users;
+	};
+
+	/*  Packed Textures  */
+	static std::map<std::string, _Placement> _placements;
+	static std::map<GLuint, _Array> _arrays;
+	static size_t _textureBytes;
+	// images of changed files by path, only the newest read of a path is written
+	static std::map<std::string, std::shared_future<std::shared_ptr<const TexturePackImage> > > _reloads;
+
+	/*  Material Table  */
+	static std::vector<MaterialEntry> _materials;
+	// the arrays of every entry's slots, empty for an entry whose arrays were deleted (free to reuse)
+	static std::vector<std::vector<GLuint> > _materialArrays;
+	static UniformBuffer _materialBuffer;
+
+	/*  Workers  */
+	static bool _ReadSource(const std::string &path, _Source &source);
+	// the levels the source takes in an array of the format, from its atlas slot when atlas is set
+	static void _PrepareImage(const _Source &source, GLenum format, bool atlas, bool srgb, TexturePackImage &image);
+	// the blocks of the source when it has them, BC1 or BC3 with S3TC support, RGBA8 otherwise
+	static GLenum _PackFormat(const _Source &source);
+	// the levels of an array layer in the format, RGBA8 only brings level 0
+	static std::vector<std::vector<unsigned char> > _LayerLevels(const _Source &source, GLenum format, bool srgb, int levelCount);
+	// the levels of the source's atlas slot, the gutter and the rest of the slot repeat its edges
+	static std::vector<std::vector<unsigned char> > _BuildTile(const _Source &source, GLenum format, bool srgb, int levelCount);
+	// RGBA of the texels x, y, width, height around an image placed at offset, its edges repeated outwards
+	static std::vector<unsigned char> _Extend(const unsigned char *pixels, int imageWidth, int imageHeight, int offset, int x, int y, int width, int height);
+	static std::vector<unsigned char> _GetPixels(const _Source &source);
+	// the blocks of every level of an RGBA image, box filtered
+	static std::vector<std::vector<unsigned char> > _CompressLevels(const unsigned char *pixels, int width, int height, GLenum format, bool srgb, int levelCount);
+	static bool _IsOpaque(const _Source &source);
+
+	/*  GL Thread  */
+	static void _PackArrays(const std::vector<TexturePackImage> &images, const std::vector<size_t> &members, std::vector<_Placement> &placements);
+	static void _PackAtlas(const std::vector<TexturePackImage> &images, const std::vector<size_t> &members, std::vector<_Placement> &placements);
+	static int _PlaceShelves(const std::vector<TexturePackImage> &images, const std::vector<size_t> &order, int pageSize, std::vector<_AtlasSlot> &slots);
+	// blocks of an image into the blocks of a larger one at texel x & y, RGBA8 copies texels
+	static void _CopyBlocks(const unsigned char *source, int width, int height, unsigned char *target, int targetWidth, int x, int y, GLenum format);
+	// every layer brings its levels, RGBA8 layers only level 0 and the GL builds their mips
+	static GLuint _CreateArray(int width, int height, GLenum format, const std::vector<const std::vector<std::vector<unsigned char> >*> &layers, bool atlas);
+	// writes a reloaded image over its placement
+	static void _Write(const std::string &path, const TexturePackImage &image);
+	// the levels an array of the format gets, RGBA8 arrays are given level 0 and build the rest
+	static int _PackLevelCount(GLenum format, bool atlas, int width, int height);
+	static int _AtlasLevelCount();
+	// slots, their gutters and their sizes are multiples of it, whole blocks down to the last atlas level
+	static int _AtlasAlignment() { return 4 << (_AtlasLevelCount() - 1); }
+	static int _AtlasGutter() { return (TEXTURE_ATLAS_PADDING + _AtlasAlignment() - 1) / _AtlasAlignment() * _AtlasAlignment(); }
+	static int _TileSize(int extent) { return 2 * _AtlasGutter() + (extent + _AtlasAlignment() - 1) / _AtlasAlignment() * _AtlasAlignment(); }
+	static int _LevelCount(int width, int height);
+	static int _FindMaterial(const MaterialEntry &entry, const GLuint arrays[MATERIAL_SLOT_COUNT]);
+	// -1 when the table is full
+	static int _AddMaterial(const MaterialEntry &entry, const GLuint arrays[MATERIAL_SLOT_COUNT]);
+	// the entry of the mesh's textures and the arrays of its slots, the first texture of a slot is the one sampled
+	static MaterialEntry _GetMaterial(const Mesh &mesh, GLuint arrays[MATERIAL_SLOT_COUNT]);
+	// calls function once for every distinct array of a packed mesh
+	template <typename F>
+	static void _ForEachArray(const Mesh &mesh, F function);
+	static void _DeleteArray(GLuint array);
+};
+
+// Instantiate static variables
+std::map<std::string, TexturePacker::_Placement> TexturePacker::_placements;
+std::map<GLuint, TexturePacker::_Array> TexturePacker::_arrays;
+size_t TexturePacker::_textureBytes = 0;
+std::map<std::string, std::shared_future<std::shared_ptr<const TexturePackImage> > > TexturePacker::_reloads;
+std::vector<MaterialEntry> TexturePacker::_materials;
+std::vector<std::vector<GLuint> > TexturePacker::_materialArrays;
+UniformBuffer TexturePacker::_materialBuffer;
+
+// Only the new paths are read, the first texture of every slot as that is the one sampled.
+TexturePackHandle TexturePacker::Prepare(const std::vector<Model*> &models)
+{
+	std::vector<std::string> paths;
+	std::vector<bool> srgb;
+	for (size_t m = 0; m < models.size(); m++)
+	{
+		for (size_t i = 0; i < models[m]->meshes.size(); i++)
+		{
+			const Mesh &mesh = models[m]->meshes[i];
+			if (mesh.material >= 0)
+				continue;
+			bool used[MATERIAL_SLOT_COUNT] = {};
+			for (size_t t = 0; t < mesh.textures.size(); t++)
+			{
+				const std::string &path = mesh.textures[t].path;
+				int slot = MaterialSlotOf(mesh.textures[t].type);
+				if (slot < 0 || used[slot])
+					continue;
+				used[slot] = true;
+				if (_placements.count(path) == 0 && std::find(paths.begin(), paths.end(), path) == paths.end())
+				{
+					paths.push_back(path);
+					srgb.push_back(slot == MATERIAL_DIFFUSE || slot == MATERIAL_SPECULAR);
+				}
+			}
+		}
+	}
+
+	// nothing to read (proxies, models of textures packed before) is ready right away
+	if (paths.empty())
+	{
+		std::promise<std::shared_ptr<const TexturePack> > empty;
+		empty.set_value(std::make_shared<TexturePack>());
+		return empty.get_future().share();
+	}
+
+	return ThreadPool::Shared().Submit([paths, srgb]() {
+		std::shared_ptr<TexturePack> pack = std::make_shared<TexturePack>();
+		pack->images.resize(paths.size());
+		ThreadPool::Shared().ParallelFor(paths.size(), 1, [&paths, &srgb, &pack](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+			{
+				TexturePackImage &image = pack->images[i];
+				image.path = paths[i];
+				image.srgb = srgb[i];
+				_Source source;
+				if (!_ReadSource(paths[i], source))
+				{
+					std::cout << "TexturePacker: " << paths[i] << " could not be read" << std::endl;
+					image.width = image.height = 0;
+					continue;
+				}
+				bool atlas = source.width <= TEXTURE_ATLAS_MAX_SIZE && source.height <= TEXTURE_ATLAS_MAX_SIZE;
+				_PrepareImage(source, _PackFormat(source), atlas, srgb[i], image);
+			}
+		});
+		return std::shared_ptr<const TexturePack>(pack);
+	}).share();
+}
+
+bool TexturePacker::Pack(const std::vector<Model*> &models, const TexturePackHandle &pack)
+{
+	// a path another pack placed in the meantime keeps its placement
+	const std::vector<TexturePackImage> &images = pack.get()->images;
+	std::map<std::tuple<int, int, GLenum>, std::vector<size_t> > sizes;
+	std::map<GLenum, std::vector<size_t> > small;
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		const TexturePackImage &image = images[i];
+		if (image.width == 0 || _placements.count(image.path) != 0)
+			continue;
+		if (image.atlas)
+			small[image.format].push_back(i);
+		else
+			sizes[std::make_tuple(image.width, image.height, image.format)].push_back(i);
+	}
+
+	// large textures by size and format into arrays, the rest by format into atlas pages
+	std::vector<_Placement> placements(images.size(), _Placement());
+	for (auto it = sizes.begin(); it != sizes.end(); ++it)
+		_PackArrays(images, it->second, placements);
+	for (auto it = small.begin(); it != small.end(); ++it)
+		_PackAtlas(images, it->second, placements);
+
+	std::vector<GLuint> created;
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		if (placements[i].array == 0)
+			continue;
+		_placements[images[i].path] = placements[i];
+		if (std::find(created.begin(), created.end(), placements[i].array) == created.end())
+			created.push_back(placements[i].array);
+	}
+
+	// the material of every mesh, meshes with the same textures share one
+	std::vector<Mesh*> packed;
+	std::vector<int> added;
+	bool full = false;
+	for (size_t m = 0; m < models.size() && !full; m++)
+	{
+		for (size_t i = 0; i < models[m]->meshes.size() && !full; i++)
+		{
+			Mesh &mesh = models[m]->meshes[i];
+			if (mesh.material >= 0)
+				continue;
+
+			GLuint arrays[MATERIAL_SLOT_COUNT] = {};
+			MaterialEntry entry = _GetMaterial(mesh, arrays);
+			int material = _FindMaterial(entry, arrays);
+			if (material < 0)
+			{
+				material = _AddMaterial(entry, arrays);
+				if (material < 0)
+				{
+					full = true;
+					break;
+				}
+				added.push_back(material);
+			}
+
+			mesh.material = material;
+			for (int slot = 0; slot < MATERIAL_SLOT_COUNT; slot++)
+				mesh.materialArrays[slot] = _materialArrays[material][slot];
+			_ForEachArray(mesh, [](GLuint array) { _arrays[array].users++; });
+			packed.push_back(&mesh);
+		}
+	}
+
+	if (full)
+	{
+		// all or nothing: the meshes packed by this call go back, the entries and arrays it created with them
+		std::cout << "TexturePacker: more than " << MATERIAL_MAX_COUNT << " materials, the models stay unpacked" << std::endl;
+		for (size_t i = 0; i < packed.size(); i++)
+		{
+			_ForEachArray(*packed[i], [](GLuint array) { _arrays[array].users--; });
+			packed[i]->material = -1;
+			for (int slot = 0; slot < MATERIAL_SLOT_COUNT; slot++)
+				packed[i]->materialArrays[slot] = 0;
+		}
+		for (size_t i = 0; i < added.size(); i++)
+			_materialArrays[added[i]].clear();
+		for (size_t i = 0; i < created.size(); i++)
+		{
+			if (_arrays[created[i]].users == 0)
+				_DeleteArray(created[i]);
+		}
+	}
+
+	if (_materialBuffer.getID() == 0)
+		_materialBuffer.Create(MATERIAL_MAX_COUNT * sizeof(MaterialEntry), UNIFORM_BINDING_MATERIALS);
+	if (!_materials.empty())
+		_materialBuffer.Update(_materials.data(), _materials.size() * sizeof(MaterialEntry));
+	return !full;
+}
+
+void TexturePacker::Release(Model &model)
+{
+	std::vector<GLuint> unused;
+	for (size_t i = 0; i < model.meshes.size(); i++)
+	{
+		Mesh &mesh = model.meshes[i];
+		if (mesh.material < 0)
+			continue;
+		_ForEachArray(mesh, [&unused](GLuint array) {
+			if (--_arrays[array].users == 0)
+				unused.push_back(array);
+		});
+		mesh.material = -1;
+		for (int slot = 0; slot < MATERIAL_SLOT_COUNT; slot++)
+			mesh.materialArrays[slot] = 0;
+	}
+	for (size_t i = 0; i < unused.size(); i++)
+		_DeleteArray(unused[i]);
+}
+
+bool TexturePacker::IsPlaced(const std::string &path)
+{
+	std::string key = TextureCache::GetKey(path);
+	for (auto it = _placements.begin(); it != _placements.end(); ++it)
+	{
+		if (TextureCache::GetKey(it->first) == key)
+			return true;
+	}
+	return false;
+}
+
+// Every spelling is read into the format and layout of its array, a second change before the first was written
+// replaces it.
+unsigned int TexturePacker::Reload(const std::string &path)
+{
+	std::string key = TextureCache::GetKey(path);
+	unsigned int reloading = 0;
+	for (auto it = _placements.begin(); it != _placements.end(); ++it)
+	{
+		if (TextureCache::GetKey(it->first) != key)
+			continue;
+		const _Array &array = _arrays[it->second.array];
+		std::string spelling = it->first;
+		GLenum format = array.format;
+		bool atlas = array.atlas;
+		bool srgb = it->second.srgb;
+		_reloads[spelling] = ThreadPool::Shared().Submit([spelling, format, atlas, srgb]() {
+			std::shared_ptr<TexturePackImage> image = std::make_shared<TexturePackImage>();
+			image->path = spelling;
+			image->srgb = srgb;
+			_Source source;
+			if (_ReadSource(spelling, source))
+				_PrepareImage(source, format, atlas, srgb, *image);
+			else
+				image->width = image->height = 0;
+			return std::shared_ptr<const TexturePackImage>(image);
+		}).share();
+		reloading++;
+	}
+	return reloading;
+}
+
+void TexturePacker::Update()
+{
+	for (auto it = _reloads.begin(); it != _reloads.end();)
+	{
+		if (it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			++it;
+			continue;
+		}
+		_Write(it->first, *it->second.get());
+		it = _reloads.erase(it);
+	}
+}
+
+size_t TexturePacker::GetTextureBytes(const Model &model)
+{
+	// every texture once, however many meshes sample it
+	std::map<std::string, size_t> textures;
+	for (size_t i = 0; i < model.meshes.size(); i++)
+	{
+		const Mesh &mesh = model.meshes[i];
+		for (size_t t = 0; t < mesh.textures.size(); t++)
+		{
+			auto placement = _placements.find(mesh.textures[t].path);
+			if (placement == _placements.end())
+				continue;
+			const _Array &array = _arrays[placement->second.array];
+			textures[mesh.textures[t].path] = BlockCompressor::GetSize(array.format, (int)(array.width * placement->second.rect.z), (int)(array.height * placement->second.rect.w));
+		}
+	}
+	size_t bytes = 0;
+	for (auto it = textures.begin(); it != textures.end(); ++it)
+		bytes += it->second;
+	return bytes;
+}
+
+void TexturePacker::PrintStats()
+{
+	std::cout << "Texture Packer: " << _placements.size() << " textures in " << _arrays.size() << " arrays ("
+		<< _textureBytes / 1024 << " KB without mips), " << _materials.size() << " materials" << std::endl;
+}
+
+void TexturePacker::Clear()
+{
+	// the workers read through the FileSystem
+	for (auto it = _reloads.begin(); it != _reloads.end(); ++it)
+		it->second.wait();
+	_reloads.clear();
+	for (auto it = _arrays.begin(); it != _arrays.end(); ++it)
+		GLStateCache::DeleteTextures(1, &it->first);
+	_arrays.clear();
+	_placements.clear();
+	_materials.clear();
+	_materialArrays.clear();
+	_textureBytes = 0;
+	if (_materialBuffer.getID() != 0)
+		_materialBuffer.Delete();
+}
+
+// The blocks & mips of the cooked texture when the GL can sample them, otherwise the file decoded to RGBA the way
+// the GL samples it: one channel as (r, 0, 0, 1), two as (r, g, 0, 1).
+bool TexturePacker::_ReadSource(const std::string &path, _Source &source)
+{
+	source.width = source.height = 0;
+	source.format = 0;
+	std::shared_ptr<MappedFile> cooked = CookedTexture::Open(CookedTexture::GetPath(path), path);
+	if (cooked)
+	{
+		const CookedTextureHeader &header = CookedTexture::GetHeader(*cooked);
+		GLenum format = (GLenum)header.format;
+		if (BlockCompressor::IsBlockFormat(format) && (!BlockCompressor::NeedsS3TC(format) || GLExtensions::TextureCompressionS3TC))
+		{
+			source.width = (int)header.levels[0].width;
+			source.height = (int)header.levels[0].height;
+			source.format = format;
+			for (uint32_t level = 0; level < header.levelCount; level++)
+			{
+				const unsigned char *blocks = cooked->GetData() + header.levels[level].offset;
+				source.levels.push_back(std::vector<unsigned char>(blocks, blocks + header.levels[level].size));
+			}
+			return true;
+		}
+	}
+
+	std::shared_ptr<MappedFile> file = FileSystem::Open(path);
+	if (!file)
+		return false;
+	int components = 0;
+	unsigned char *pixels = stbi_load_from_memory(file->GetData(), (int)file->GetSize(), &source.width, &source.height, &components, 0);
+	if (pixels == NULL)
+		return false;
+
+	const unsigned char opaque[4] = { 0, 0, 0, 255 };
+	size_t count = (size_t)source.width * source.height;
+	source.pixels.resize(count * 4);
+	for (size_t i = 0; i < count; i++)
+	{
+		for (int c = 0; c < 4; c++)
+			source.pixels[i * 4 + c] = c < components ? pixels[i * components + c] : opaque[c];
+	}
+	stbi_image_free(pixels);
+	return true;
+}
+
+void TexturePacker::_PrepareImage(const _Source &source, GLenum format, bool atlas, bool srgb, TexturePackImage &image)
+{
+	image.width = source.width;
+	image.height = source.height;
+	image.format = format;
+	image.atlas = atlas;
+	image.srgb = srgb;
+	int level_count = _PackLevelCount(format, atlas, source.width, source.height);
+	image.levels = atlas ? _BuildTile(source, format, srgb, level_count) : _LayerLevels(source, format, srgb, level_count);
+}
+
+GLenum TexturePacker::_PackFormat(const _Source &source)
+{
+	if (source.format != 0)
+		return source.format;
+	if (!GLExtensions::TextureCompressionS3TC)
+		return GL_RGBA8;
+	return _IsOpaque(source) ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+std::vector<std::vector<unsigned char> > TexturePacker::_LayerLevels(const _Source &source, GLenum format, bool srgb, int levelCount)
+{
+	if (source.format == format && source.levels.size() >= (size_t)levelCount)
+		return std::vector<std::vector<unsigned char> >(source.levels.begin(), source.levels.begin() + levelCount);
+	std::vector<unsigned char> pixels = _GetPixels(source);
+	if (format == GL_RGBA8)
+		return std::vector<std::vector<unsigned char> >(1, pixels);
+	return _CompressLevels(pixels.data(), source.width, source.height, format, srgb, levelCount);
+}
+
+// The image starts at the gutter on every level. Blocks of the format are copied as they are, only the texels
+// around them are decoded, extended and compressed, in strips above, below, left and right of the image.
+std::vector<std::vector<unsigned char> > TexturePacker::_BuildTile(const _Source &source, GLenum format, bool srgb, int levelCount)
+{
+	const int gutter = _AtlasGutter();
+	int tile_width = _TileSize(source.width), tile_height = _TileSize(source.height);
+	if (source.format != format || source.levels.size() < (size_t)levelCount)
+	{
+		std::vector<unsigned char> pixels = _GetPixels(source);
+		std::vector<unsigned char> tile = _Extend(pixels.data(), source.width, source.height, gutter, 0, 0, tile_width, tile_height);
+		if (format == GL_RGBA8)
+			return std::vector<std::vector<unsigned char> >(1, tile);
+		return _CompressLevels(tile.data(), tile_width, tile_height, format, srgb, levelCount);
+	}
+
+	std::vector<std::vector<unsigned char> > levels(levelCount);
+	for (int level = 0; level < levelCount; level++)
+	{
+		int width = tile_width >> level, height = tile_height >> level, offset = gutter >> level;
+		int image_width = std::max(source.width >> level, 1), image_height = std::max(source.height >> level, 1);
+		// the image's blocks, its edge texels repeated to whole blocks
+		int inner_width = (image_width + 3) & ~3, inner_height = (image_height + 3) & ~3;
+		std::vector<unsigned char> pixels = BlockCompressor::Decompress(source.levels[level].data(), image_width, image_height, format);
+
+		levels[level].assign(BlockCompressor::GetSize(format, width, height), 0);
+		const int strips[4][4] = {
+			{ 0, 0, width, offset },
+			{ 0, offset + inner_height, width, height - offset - inner_height },
+			{ 0, offset, offset, inner_height },
+			{ offset + inner_width, offset, width - offset - inner_width, inner_height },
+		};
+		for (int s = 0; s < 4; s++)
+		{
+			std::vector<unsigned char> strip = _Extend(pixels.data(), image_width, image_height, offset, strips[s][0], strips[s][1], strips[s][2], strips[s][3]);
+			std::vector<unsigned char> blocks = BlockCompressor::Compress(strip.data(), strips[s][2], strips[s][3], 4, format);
+			_CopyBlocks(blocks.data(), strips[s][2], strips[s][3], levels[level].data(), width, strips[s][0], strips[s][1], format);
+		}
+		_CopyBlocks(source.levels[level].data(), inner_width, inner_height, levels[level].data(), width, offset, offset, format);
+	}
+	return levels;
+}
+
+std::vector<unsigned char> TexturePacker::_Extend(const unsigned char *pixels, int imageWidth, int imageHeight, int offset, int x, int y, int width, int height)
+{
+	std::vector<unsigned char> texels((size_t)width * height * 4);
+	for (int row = 0; row < height; row++)
+	{
+		int source_row = std::min(std::max(y + row - offset, 0), imageHeight - 1);
+		for (int column = 0; column < width; column++)
+		{
+			int source_column = std::min(std::max(x + column - offset, 0), imageWidth - 1);
+			std::memcpy(&texels[((size_t)row * width + column) * 4], &pixels[((size_t)source_row * imageWidth + source_column) * 4], 4);
+		}
+	}
+	return texels;
+}
+
+std::vector<unsigned char> TexturePacker::_GetPixels(const _Source &source)
+{
+	if (source.format == 0)
+		return source.pixels;
+	return BlockCompressor::Decompress(source.levels[0].data(), source.width, source.height, source.format);
+}
+
+// colors are averaged in linear space like the cooker's mips, data (normals, heights) as it is stored
+std::vector<std::vector<unsigned char> > TexturePacker::_CompressLevels(const unsigned char *pixels, int width, int height, GLenum format, bool srgb, int levelCount)
+{
+	MipSettings settings = { MIP_FILTER_BOX, srgb, 0.0f };
+	std::vector<std::vector<unsigned char> > levels = MipGenerator::Build(pixels, width, height, 4, settings, levelCount);
+	for (int level = 0; level < levelCount; level++)
+		levels[level] = BlockCompressor::Compress(levels[level].data(), std::max(width >> level, 1), std::max(height >> level, 1), 4, format);
+	return levels;
+}
+
+bool TexturePacker::_IsOpaque(const _Source &source)
+{
+	for (size_t i = 3; i < source.pixels.size(); i += 4)
+	{
+		if (source.pixels[i] != 255)
+			return false;
+	}
+	return true;
+}
+
+// textures of one size, as many layers per array as the GL allows
+void TexturePacker::_PackArrays(const std::vector<TexturePackImage> &images, const std::vector<size_t> &members, std::vector<_Placement> &placements)
+{
+	GLint max_layers = 0;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+	if (max_layers <= 0)
+		max_layers = 256;
+
+	for (size_t first = 0; first < members.size(); first += max_layers)
+	{
+		size_t count = std::min(members.size() - first, (size_t)max_layers);
+		const TexturePackImage &size = images[members[first]];
+		std::vector<const std::vector<std::vector<unsigned char> >*> layers(count);
+		for (size_t i = 0; i < count; i++)
+			layers[i] = &images[members[first + i]].levels;
+		GLuint array = _CreateArray(size.width, size.height, size.format, layers, false);
+		for (size_t i = 0; i < count; i++)
+		{
+			_Placement placement = { array, (int)i, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f), images[members[first + i]].srgb };
+			placements[members[first + i]] = placement;
+		}
+	}
+}
+
+// every image in a block aligned slot, on the smallest power of two pages that hold all of them on one
+// (or on several of the largest size)
+void TexturePacker::_PackAtlas(const std::vector<TexturePackImage> &images, const std::vector<size_t> &members, std::vector<_Placement> &placements)
+{
+	GLenum format = images[members[0]].format;
+	std::vector<size_t> order(members);
+	std::stable_sort(order.begin(), order.end(), [&images](size_t lhs, size_t rhs) { return images[lhs].height > images[rhs].height; });
+
+	int page_size = 1;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		while (page_size < _TileSize(images[order[i]].width) || page_size < _TileSize(images[order[i]].height))
+			page_size *= 2;
+	}
+
+	std::vector<_AtlasSlot> slots;
+	int page_count = _PlaceShelves(images, order, page_size, slots);
+	while (page_count > 1 && page_size < TEXTURE_ATLAS_PAGE_SIZE)
+	{
+		page_size *= 2;
+		page_count = _PlaceShelves(images, order, page_size, slots);
+	}
+
+	// the tiles were built on the workers, the empty parts of the pages are never sampled
+	int level_count = _PackLevelCount(format, true, page_size, page_size);
+	std::vector<std::vector<std::vector<unsigned char> > > pages(page_count, std::vector<std::vector<unsigned char> >(level_count));
+	for (int p = 0; p < page_count; p++)
+	{
+		for (int level = 0; level < level_count; level++)
+			pages[p][level].assign(BlockCompressor::GetSize(format, page_size >> level, page_size >> level), 0);
+	}
+	const int gutter = _AtlasGutter();
+	for (size_t s = 0; s < slots.size(); s++)
+	{
+		const TexturePackImage &image = images[slots[s].image];
+		for (int level = 0; level < level_count; level++)
+			_CopyBlocks(image.levels[level].data(), _TileSize(image.width) >> level, _TileSize(image.height) >> level, pages[slots[s].page][level].data(),
+				page_size >> level, (slots[s].x - gutter) >> level, (slots[s].y - gutter) >> level, format);
+	}
+	std::vector<const std::vector<std::vector<unsigned char> >*> layers(page_count);
+	for (int p = 0; p < page_count; p++)
+		layers[p] = &pages[p];
+	GLuint array = _CreateArray(page_size, page_size, format, layers, true);
+
+	for (size_t s = 0; s < slots.size(); s++)
+	{
+		const _AtlasSlot &slot = slots[s];
+		const TexturePackImage &image = images[slot.image];
+		_Placement placement = { array, slot.page, glm::vec4((float)slot.x / page_size, (float)slot.y / page_size,
+			(float)image.width / page_size, (float)image.height / page_size), image.srgb };
+		placements[slot.image] = placement;
+	}
+}
+
+// rows of slots from left to right, tallest first, returns the number of pages used
+int TexturePacker::_PlaceShelves(const std::vector<TexturePackImage> &images, const std::vector<size_t> &order, int pageSize, std::vector<_AtlasSlot> &slots)
+{
+	const int gutter = _AtlasGutter();
+	slots.clear();
+	int page = 0, x = 0, y = 0, shelf_height = 0;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		const TexturePackImage &image = images[order[i]];
+		int width = _TileSize(image.width);
+		int height = _TileSize(image.height);
+		if (x + width > pageSize)
+		{
+			x = 0;
+			y += shelf_height;
+			shelf_height = 0;
+		}
+		if (y + height > pageSize)
+		{
+			page++;
+			x = y = shelf_height = 0;
+		}
+
+		_AtlasSlot slot = { order[i], page, x + gutter, y + gutter };
+		slots.push_back(slot);
+		x += width;
+		shelf_height = std::max(shelf_height, height);
+	}
+	return page + 1;
+}
+
+void TexturePacker::_CopyBlocks(const unsigned char *source, int width, int height, unsigned char *target, int targetWidth, int x, int y, GLenum format)
+{
+	int block = format == GL_RGBA8 ? 1 : 4;
+	size_t block_size = BlockCompressor::GetSize(format, block, block);
+	size_t row = (size_t)((width + block - 1) / block) * block_size;
+	size_t target_row = (size_t)((targetWidth + block - 1) / block) * block_size;
+	for (int by = 0; by < (height + block - 1) / block; by++)
+		std::memcpy(target + (size_t)(y / block + by) * target_row + (size_t)(x / block) * block_size, source + (size_t)by * row, row);
+}
+
+// atlas pages only get the mip levels at which the gutters still separate their images
+GLuint TexturePacker::_CreateArray(int width, int height, GLenum format, const std::vector<const std::vector<std::vector<unsigned char> >*> &layers, bool atlas)
+{
+	GLuint array;
+	glGenTextures(1, &array);
+	GLStateCache::BindTexture(GL_TEXTURE_2D_ARRAY, array);
+
+	int level_count;
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	if (format == GL_RGBA8)
+	{
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, (GLsizei)layers.size(), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		for (size_t layer = 0; layer < layers.size(); layer++)
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, (*layers[layer])[0].data());
+		level_count = atlas ? _AtlasLevelCount() : _LevelCount(width, height);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, level_count - 1);
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	}
+	else
+	{
+		// compressed arrays can not generate their mips, every layer of a level goes in at once
+		level_count = (int)layers[0]->size();
+		for (int level = 0; level < level_count; level++)
+		{
+			std::vector<unsigned char> blocks;
+			for (size_t layer = 0; layer < layers.size(); layer++)
+				blocks.insert(blocks.end(), (*layers[layer])[level].begin(), (*layers[layer])[level].end());
+			int level_width = std::max(width >> level, 1), level_height = std::max(height >> level, 1);
+			glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, format, level_width, level_height, (GLsizei)layers.size(), 0, (GLsizei)blocks.size(), blocks.data());
+		}
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, level_count - 1);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	// atlas coordinates are wrapped in the shader, whole layers repeat like the textures did
+	GLint wrap = atlas ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	_Array info = { width, height, (int)layers.size(), format, level_count, atlas, 0 };
+	_arrays[array] = info;
+	_textureBytes += BlockCompressor::GetSize(format, width, height) * layers.size();
+	return array;
+}
+
+// An atlas image is written with its slot, which holds no texel of another image on any level. The array may have
+// been deleted (or packed again) since the read started, the image is dropped then.
+void TexturePacker::_Write(const std::string &path, const TexturePackImage &image)
+{
+	auto found = _placements.find(path);
+	if (found == _placements.end() || image.width == 0)
+		return;
+	const _Placement &placement = found->second;
+	const _Array &array = _arrays[placement.array];
+	if (image.format != array.format || image.atlas != array.atlas)
+		return;
+
+	int x = (int)std::lround(placement.rect.x * array.width), y = (int)std::lround(placement.rect.y * array.height);
+	int width = (int)std::lround(placement.rect.z * array.width), height = (int)std::lround(placement.rect.w * array.height);
+	if (image.width != width || image.height != height)
+	{
+		std::cout << "TexturePacker: " << path << " is " << image.width << "x" << image.height << " now instead of "
+			<< width << "x" << height << ", restart to pack it again" << std::endl;
+		return;
+	}
+	if (array.atlas)
+	{
+		x -= _AtlasGutter();
+		y -= _AtlasGutter();
+		width = _TileSize(width);
+		height = _TileSize(height);
+	}
+
+	GLStateCache::BindTexture(GL_TEXTURE_2D_ARRAY, placement.array);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int level = 0; level < (int)image.levels.size(); level++)
+	{
+		int level_width = std::max(width >> level, 1), level_height = std::max(height >> level, 1);
+		if (array.format == GL_RGBA8)
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, x >> level, y >> level, placement.layer, level_width, level_height, 1, GL_RGBA, GL_UNSIGNED_BYTE, image.levels[level].data());
+		else
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, x >> level, y >> level, placement.layer, level_width, level_height, 1,
+				array.format, (GLsizei)image.levels[level].size(), image.levels[level].data());
+	}
+	if (array.format == GL_RGBA8)
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+int TexturePacker::_PackLevelCount(GLenum format, bool atlas, int width, int height)
+{
+	if (format == GL_RGBA8)
+		return 1;
+	return atlas ? _AtlasLevelCount() : _LevelCount(width, height);
+}
+
+// down to the level at which the gutters are a texel wide
+int TexturePacker::_AtlasLevelCount()
+{
+	int levels = 1;
+	while ((2 << (levels - 1)) <= TEXTURE_ATLAS_PADDING)
+		levels++;
+	return levels;
+}
+
+// the full chain down to 1x1
+int TexturePacker::_LevelCount(int width, int height)
+{
+	int levels = 1;
+	while ((width >> levels) > 0 || (height >> levels) > 0)
+		levels++;
+	return levels;
+}
+
+int TexturePacker::_FindMaterial(const MaterialEntry &entry, const GLuint arrays[MATERIAL_SLOT_COUNT])
+{
+	for (size_t m = 0; m < _materials.size(); m++)
+	{
+		if (_materialArrays[m].empty())
+			continue;
+		bool same = _materials[m].layers == entry.layers;
+		for (int slot = 0; slot < MATERIAL_SLOT_COUNT && same; slot++)
+			same = _materials[m].rects[slot] == entry.rects[slot] && _materialArrays[m][slot] == arrays[slot];
+		if (same)
+			return (int)m;
+	}
+	return -1;
+}
+
+int TexturePacker::_AddMaterial(const MaterialEntry &entry, const GLuint arrays[MATERIAL_SLOT_COUNT])
+{
+	// entries of deleted arrays first
+	size_t material = 0;
+	while (material < _materials.size() && !_materialArrays[material].empty())
+		material++;
+	if (material == _materials.size())
+	{
+		if (_materials.size() >= MATERIAL_MAX_COUNT)
+			return -1;
+		_materials.push_back(entry);
+		_materialArrays.push_back(std::vector<GLuint>());
+	}
+	_materials[material] = entry;
+	_materialArrays[material].assign(arrays, arrays + MATERIAL_SLOT_COUNT);
+	return (int)material;
+}
+
+MaterialEntry TexturePacker::_GetMaterial(const Mesh &mesh, GLuint arrays[MATERIAL_SLOT_COUNT])
+{
+	MaterialEntry entry;
+	for (int slot = 0; slot < MATERIAL_SLOT_COUNT; slot++)
+	{
+		entry.rects[slot] = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+		entry.layers[slot] = -1.0f;
+		arrays[slot] = 0;
+	}
+	bool used[MATERIAL_SLOT_COUNT] = {};
+	for (size_t t = 0; t < mesh.textures.size(); t++)
+	{
+		int slot = MaterialSlotOf(mesh.textures[t].type);
+		if (slot < 0 || used[slot])
+			continue;
+		used[slot] = true;
+		auto placement = _placements.find(mesh.textures[t].path);
+		if (placement == _placements.end())
+			continue;
+		arrays[slot] = placement->second.array;
+		entry.rects[slot] = placement->second.rect;
+		entry.layers[slot] = (float)placement->second.layer;
+	}
+	return entry;
+}
+
+template <typename F>
+void TexturePacker::_ForEachArray(const Mesh &mesh, F function)
+{
+	for (int slot = 0; slot < MATERIAL_SLOT_COUNT; slot++)
+	{
+		GLuint array = mesh.materialArrays[slot];
+		bool seen = array == 0;
+		for (int before = 0; before < slot && !seen; before++)
+			seen = mesh.materialArrays[before] == array;
+		if (!seen)
+			function(array);
+	}
+}
+
+void TexturePacker::_DeleteArray(GLuint array)
+{
+	const _Array &info = _arrays[array];
+	_textureBytes -= BlockCompressor::GetSize(info.format, info.width, info.height) * info.layers;
+	_arrays.erase(array);
+	GLStateCache::DeleteTextures(1, &array);
+
+	for (auto it = _placements.begin(); it != _placements.end();)
+	{
+		if (it->second.array == array)
+			it = _placements.erase(it);
+		else
+			++it;
+	}
+	// the entries sampling it are free, the table keeps its size
+	for (size_t m = 0; m < _materialArrays.size(); m++)
+	{
+		if (std::find(_materialArrays[m].begin(), _materialArrays[m].end(), array) != _materialArrays[m].end())
+			_materialArrays[m].clear();
+	}
+}
+
+#endif
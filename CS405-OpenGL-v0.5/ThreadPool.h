@@ -0,0 +1,181 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+
+// ThreadPool runs CPU work (culling, decoding, importing) on a fixed set of worker threads.
+// Tasks never touch OpenGL, only the thread owning the context may do that.
+class ThreadPool {
+public:
+	// Starts threadCount workers, 0 picks one less than the hardware threads (the caller works too).
+	explicit ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool &operator=(const ThreadPool&) = delete;
+
+	// Pool shared by the whole engine, started on first use.
+	static ThreadPool &Shared();
+
+	unsigned int GetThreadCount() const { return (unsigned int)_workers.size(); }
+
+	// Queues a task, the future hands back its result (or rethrows its exception).
+	template<typename Function>
+	std::future<typename std::result_of<Function()>::type> Submit(Function task);
+
+	// Calls work(begin, end) for chunks of [0, count) on the workers and the calling thread,
+	// returns once every chunk is done.
+	void ParallelFor(size_t count, size_t chunkSize, const std::function<void(size_t, size_t)> &work);
+
+	// Returns once no task is queued or running, the tasks those queue included. Not from a task.
+	void Wait();
+
+private:
+	std::vector<std::thread> _workers;
+	std::deque<std::function<void()> > _tasks;
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	std::condition_variable _idle;
+	// tasks taken from the queue and not finished yet
+	size_t _running;
+	bool _stop;
+
+	void _Push(std::function<void()> task);
+	void _WorkerLoop();
+};
+
+ThreadPool::ThreadPool(unsigned int threadCount) : _running(0), _stop(false)
+{
+	if (threadCount == 0)
+	{
+		unsigned int hardware = std::thread::hardware_concurrency();
+		threadCount = hardware > 1 ? hardware - 1 : 1;
+	}
+	for (unsigned int i = 0; i < threadCount; i++)
+		_workers.push_back(std::thread(&ThreadPool::_WorkerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+	_wake.notify_all();
+	for (size_t i = 0; i < _workers.size(); i++)
+		_workers[i].join();
+}
+
+ThreadPool &ThreadPool::Shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+template<typename Function>
+std::future<typename std::result_of<Function()>::type> ThreadPool::Submit(Function task)
+{
+	typedef typename std::result_of<Function()>::type Result;
+
+	// std::function needs a copyable target, the packaged task is shared
+	std::shared_ptr<std::packaged_task<Result()> > packaged = std::make_shared<std::packaged_task<Result()> >(task);
+	std::future<Result> result = packaged->get_future();
+	_Push([packaged]() { (*packaged)(); });
+	return result;
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t chunkSize, const std::function<void(size_t, size_t)> &work)
+{
+	if (count == 0)
+		return;
+	if (chunkSize == 0)
+		chunkSize = 1;
+
+	size_t chunk_count = (count + chunkSize - 1) / chunkSize;
+	if (chunk_count == 1 || _workers.empty())
+	{
+		work(0, count);
+		return;
+	}
+
+	// chunks are claimed from a shared counter, so the caller keeps working instead of waiting idle
+	struct Job {
+		std::atomic<size_t> next;
+		std::atomic<size_t> done;
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+	std::shared_ptr<Job> job = std::make_shared<Job>();
+	job->next = 0;
+	job->done = 0;
+
+	std::function<void()> run = [job, count, chunkSize, chunk_count, &work]() {
+		size_t chunk;
+		while ((chunk = job->next++) < chunk_count)
+		{
+			size_t begin = chunk * chunkSize;
+			work(begin, std::min(begin + chunkSize, count));
+			if (++job->done == chunk_count)
+			{
+				std::lock_guard<std::mutex> lock(job->mutex);
+				job->finished.notify_all();
+			}
+		}
+	};
+
+	size_t helpers = std::min(chunk_count - 1, _workers.size());
+	for (size_t i = 0; i < helpers; i++)
+		_Push(run);
+	run();
+
+	std::unique_lock<std::mutex> lock(job->mutex);
+	job->finished.wait(lock, [&job, chunk_count]() { return job->done == chunk_count; });
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_idle.wait(lock, [this]() { return _tasks.empty() && _running == 0; });
+}
+
+void ThreadPool::_Push(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_tasks.push_back(task);
+	}
+	_wake.notify_one();
+}
+
+void ThreadPool::_WorkerLoop()
+{
+	for (;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wake.wait(lock, [this]() { return _stop || !_tasks.empty(); });
+			if (_stop && _tasks.empty())
+				return;
+			task = _tasks.front();
+			_tasks.pop_front();
+			_running++;
+		}
+		task();
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (--_running == 0 && _tasks.empty())
+			_idle.notify_all();
+	}
+}
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include "Include/glad/glad.h"
+
+#include <glm/glm.hpp>
+
+#include <cstring>
+#include <iostream>
+
+#include "GLStateCache.h"
+#include "StreamBuffer.h"
+
+// Per frame camera constants, laid out to match the std140 "Camera" block in the shaders.
+// Add new per frame constants at the end and mirror them in every shader declaring the block.
+struct CameraBlock {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	glm::vec3 cameraPosition;
+	float time;
+};
+
+// UniformBuffer owns a buffer object that is permanently attached to one uniform block binding point.
+// Constants rewritten every frame can live in a StreamBuffer instead, then each Update writes a new
+// range of the frame's region and binds that range to the binding point.
+class UniformBuffer {
+public:
+	UniformBuffer() : _ID(0), _binding(0), _size(0), _stream(nullptr), _alignment(0) {}
+
+	GLuint getID() { return this->_ID; }
+	GLuint getBinding() { return this->_binding; }
+
+	// Allocates the buffer storage and attaches it to the given binding point
+	void Create(GLsizeiptr size, GLuint binding);
+	// Same, but every Update takes its storage from the stream
+	void Create(GLsizeiptr size, GLuint binding, StreamBuffer *stream);
+	// Replaces the contents starting from the beginning of the buffer
+	void Update(const void *data, GLsizeiptr size);
+
+	void Delete();
+
+private:
+	GLuint _ID;
+	GLuint _binding;
+	GLsizeiptr _size;
+
+	StreamBuffer *_stream;
+	GLint _alignment;
+};
+
+void UniformBuffer::Create(GLsizeiptr size, GLuint binding)
+{
+	_size = size;
+	_binding = binding;
+	_stream = nullptr;
+
+	glGenBuffers(1, &_ID);
+	GLStateCache::BindBuffer(GL_UNIFORM_BUFFER, _ID);
+	glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+	GLStateCache::BindBufferBase(GL_UNIFORM_BUFFER, binding, _ID);
+}
+
+void UniformBuffer::Create(GLsizeiptr size, GLuint binding, StreamBuffer *stream)
+{
+	_size = size;
+	_binding = binding;
+	_stream = stream;
+
+	// bound ranges have to start at a multiple of this
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &_alignment);
+	if (_alignment <= 0)
+		_alignment = 256;
+}
+
+void UniformBuffer::Update(const void *data, GLsizeiptr size)
+{
+	if (size > _size)
+	{
+		std::cout << "ERROR::UNIFORM_BUFFER: Update of " << size << " bytes exceeds buffer size " << _size << std::endl;
+		return;
+	}
+	if (_stream != nullptr)
+	{
+		StreamAllocation range = _stream->Allocate(size, _alignment);
+		std::memcpy(range.data, data, size);
+		_stream->Commit(range);
+		_ID = range.buffer;
+		GLStateCache::BindBufferRange(GL_UNIFORM_BUFFER, _binding, range.buffer, range.offset, size);
+		return;
+	}
+	GLStateCache::BindBuffer(GL_UNIFORM_BUFFER, _ID);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+}
+
+void UniformBuffer::Delete()
+{
+	// streamed ranges belong to the stream
+	if (_stream != nullptr)
+	{
+		_stream = nullptr;
+		_ID = 0;
+		return;
+	}
+	GLStateCache::DeleteBuffers(1, &_ID);
+	_ID = 0;
+}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef VERTEX_PACKING_H
+#define VERTEX_PACKING_H
+
+#include "Include/glad/glad.h"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstring>
+
+// Conversions from float attributes to the compact formats the vertex shaders read.
+// Every function matches the GL conversion of the type it produces, so the shader gets the values
+// back through the normalized attribute fetch without any manual unpacking.
+
+// IEEE 754 binary16 for GL_HALF_FLOAT, rounded to nearest.
+inline GLushort PackHalf(float value)
+{
+	GLuint bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	GLuint sign = (bits >> 16) & 0x8000;
+	int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+	GLuint mantissa = bits & 0x7fffff;
+
+	// nan & infinity, or too large for a half
+	if (((bits >> 23) & 0xff) == 0xff)
+		return (GLushort)(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+	if (exponent >= 31)
+		return (GLushort)(sign | 0x7c00);
+
+	// denormal or zero
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+			return (GLushort)sign;
+		mantissa |= 0x800000;
+		GLuint shift = (GLuint)(14 - exponent);
+		GLuint half = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1)
+			half++;
+		return (GLushort)(sign | half);
+	}
+
+	// a carry out of the mantissa correctly bumps the exponent
+	GLuint half = sign | ((GLuint)exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000)
+		half++;
+	return (GLushort)half;
+}
+
+// binary16 back to float, for reading packed vertices on the CPU.
+inline float UnpackHalf(GLushort half)
+{
+	GLuint sign = (GLuint)(half & 0x8000) << 16;
+	GLuint exponent = (half >> 10) & 0x1f;
+	GLuint mantissa = half & 0x3ff;
+
+	GLuint bits;
+	if (exponent == 0x1f)
+	{
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	}
+	else if (exponent == 0)
+	{
+		// zero stays zero, denormals become normal floats
+		if (mantissa == 0)
+			return sign != 0 ? -0.0f : 0.0f;
+		float value = std::ldexp((float)mantissa, -24);
+		return sign != 0 ? -value : value;
+	}
+	else
+	{
+		bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	}
+
+	float value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+// [0, 1] to GL_UNSIGNED_SHORT normalized.
+inline GLushort PackUnorm16(float value)
+{
+	return (GLushort)std::floor(glm::clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+}
+
+// one 10 bit two's complement component of a GL_INT_2_10_10_10_REV
+inline GLuint PackSnorm10(float value)
+{
+	int component = (int)std::floor(glm::clamp(value, -1.0f, 1.0f) * 511.0f + 0.5f);
+	return (GLuint)component & 0x3ff;
+}
+
+// Unit vector and a sign to GL_INT_2_10_10_10_REV normalized, x in the lowest bits.
+// The 2 bit w only stores +1 or -1, read it back in the shader by its sign.
+inline GLuint PackSnorm1010102(const glm::vec3 &value, float sign)
+{
+	GLuint w = sign < 0.0f ? 0x3 : 0x1;
+	return PackSnorm10(value.x) | (PackSnorm10(value.y) << 10) | (PackSnorm10(value.z) << 20) | (w << 30);
+}
+
+// handedness of the tangent frame, the shader rebuilds the bitangent as cross(normal, tangent) * sign
+inline float BitangentSign(const glm::vec3 &normal, const glm::vec3 &tangent, const glm::vec3 &bitangent)
+{
+	return glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+}
+
+#endif
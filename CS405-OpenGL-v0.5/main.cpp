@@ -1,10 +1,34 @@
 ﻿#include "GameEngine.h"
+#include "GLFWRenderDevice.h"
+#include "RecordingRenderDevice.h"
 
-int main()
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+
+int main(int argc, char **argv)
 {
+	// "--record N [major.minor]" renders N frames on the recording device, without a window or GPU, with the
+	// GL version it reports (3.3 by default). the exit code is 1 when the device saw invalid GL usage.
+	RenderDevice *device = nullptr;
+	bool recording = argc >= 3 && std::strcmp(argv[1], "--record") == 0;
+	if (recording)
+	{
+		int major = 3, minor = 3;
+		if (argc >= 4 && std::sscanf(argv[3], "%d.%d", &major, &minor) != 2)
+		{
+			std::cout << "usage: --record frames [major.minor]" << std::endl;
+			return 2;
+		}
+		device = new RecordingRenderDevice((unsigned int)std::atoi(argv[2]), major, minor);
+	}
+	else
+		device = new GLFWRenderDevice();
+
 	GameEngine engine = GameEngine::GetInstance();
 
-	engine.Init();
+	engine.Init(device);
 
 	std::vector<std::string> faces
 	{
@@ -28,6 +52,12 @@ int main()
 	ResourceManager::LoadShader(FILE_SHADER_VERTEX_STANDARD_OBJECT.c_str(),
 		FILE_SHADER_FRAGMENT_STANDART_OBJECT.c_str(), nullptr, KEY_SHADER_OBJECT);
 
+	ResourceManager::LoadShader(FILE_SHADER_VERTEX_HUD.c_str(),
+		FILE_SHADER_FRAGMENT_HUD.c_str(), nullptr, KEY_SHADER_HUD);
+
+	ResourceManager::LoadShader(FILE_SHADER_VERTEX_DEPTH.c_str(),
+		FILE_SHADER_FRAGMENT_DEPTH.c_str(), nullptr, KEY_SHADER_DEPTH);
+
 
 	// shader configuration
 	// --------------------
@@ -68,6 +98,9 @@ int main()
 	engine.SetScreenPanelScore(FILE_OBJECT_SCORE, scaleScore);
 	engine.SetScreenPanelHunger(FILE_OBJECT_HUNGER, scaleHunger);
 
+	// the models above are read in parallel, wait for them and create the objects
+	engine.LoadObjects();
+
 
 	//engine.NotifyObjectChanges();
 
@@ -82,5 +115,8 @@ int main()
 	// ---------------------
 	engine.FinishGame();
 
-	return 0;
+	int result = recording && RecordingRenderDevice::GetErrorCount() > 0 ? 1 : 0;
+	delete device;
+
+	return result;
 }
@@ -8,12 +8,17 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "shader.h"
+#include "GeometryPool.h"
+#include "VertexPacking.h"
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <vector>
+#include <memory>
+
+#include "MappedFile.h"
 
 struct Vertex {
 	// position
@@ -28,43 +33,288 @@ struct Vertex {
 	glm::vec3 Bitangent;
 };
 
+// Position only copy of a PackedVertex, the mesh pool's second stream for depth only passes.
+struct PackedPosition {
+	GLushort Position[4];
+
+	// same format and location as the position of PackedVertex
+	static void SetupAttributes()
+	{
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedPosition), (void*)0);
+	}
+};
+
+// The vertex as it is stored on the GPU, 20 bytes instead of the 56 of Vertex.
+// Positions are quantized to the bounds of their mesh, the model matrix undoes that (see Mesh::dequantize).
+// Normals & tangents are 10-10-10-2 snorm with the bitangent sign in the tangent's w, texCoords are half floats.
+struct PackedVertex {
+	// position, unorm16 inside the mesh bounds, w is padding
+	GLushort Position[4];
+	// normal
+	GLuint Normal;
+	// tangent & bitangent sign
+	GLuint Tangent;
+	// texCoords
+	GLushort TexCoords[2];
+
+	static PackedVertex Pack(const Vertex &vertex, const glm::vec3 &boundsMin, const glm::vec3 &boundsSize)
+	{
+		PackedVertex packed;
+		for (int i = 0; i < 3; i++)
+		{
+			packed.Position[i] = boundsSize[i] > 0.0f ? PackUnorm16((vertex.Position[i] - boundsMin[i]) / boundsSize[i]) : 0;
+		}
+		packed.Position[3] = 0;
+		packed.Normal = PackSnorm1010102(vertex.Normal, 1.0f);
+		packed.Tangent = PackSnorm1010102(vertex.Tangent, BitangentSign(vertex.Normal, vertex.Tangent, vertex.Bitangent));
+		packed.TexCoords[0] = PackHalf(vertex.TexCoords.x);
+		packed.TexCoords[1] = PackHalf(vertex.TexCoords.y);
+		return packed;
+	}
+
+	typedef PackedPosition PositionType;
+
+	static PackedPosition GetPosition(const PackedVertex &vertex)
+	{
+		PackedPosition position;
+		for (int i = 0; i < 4; i++)
+			position.Position[i] = vertex.Position[i];
+		return position;
+	}
+
+	// describes the layout above for the bound GL_ARRAY_BUFFER on the bound vertex array
+	static void SetupAttributes()
+	{
+		// vertex Positions
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Position));
+		// vertex normals
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Normal));
+		// vertex texture coords
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, TexCoords));
+		// vertex tangent, the bitangent is rebuilt in the shader
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Tangent));
+	}
+};
+
+// every static mesh is stored in the same buffers
+typedef GeometryPool<PackedVertex> MeshPool;
+
+// A level of detail is a range of the mesh's index buffer, all levels share the same vertices.
+struct MeshLod {
+	unsigned int indexOffset;
+	unsigned int indexCount;
+	// largest surface deviation from the full mesh, relative to the mesh extent
+	float error;
+};
+
 struct Texture {
 	unsigned int id;
 	std::string type;
 	std::string path;
 };
 
+// Texture slots of a packed material, in the order of the samplers the object shader declares.
+enum MaterialSlot { MATERIAL_DIFFUSE, MATERIAL_SPECULAR, MATERIAL_NORMAL, MATERIAL_HEIGHT, MATERIAL_SLOT_COUNT };
+
+// sampler name and texture type of every slot, only the first texture of a type is packed
+const char *const MATERIAL_SLOT_NAMES[MATERIAL_SLOT_COUNT] = { "texture_diffuse", "texture_specular", "texture_normal", "texture_height" };
+
+// One imported mesh before anything is uploaded: every level of detail in indices, texture ids are 0.
+struct MeshSource {
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<MeshLod> lods;
+	std::vector<Texture> textures;
+};
+
+// Everything a model file turns into, built without a GL context (see Model::Import & CookedMesh).
+struct ModelSource {
+	std::vector<MeshSource> meshes;
+	// the box the importer gathers for collisions (GameObject)
+	glm::vec3 initialMin;
+	glm::vec3 initialMax;
+};
+
+inline int MaterialSlotOf(const std::string &type)
+{
+	for (int slot = 0; slot < MATERIAL_SLOT_COUNT; slot++)
+	{
+		if (type == MATERIAL_SLOT_NAMES[slot])
+			return slot;
+	}
+	return -1;
+}
+
 class Mesh {
 public:
 	/*  Mesh Data  */
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
 	std::vector<Texture> textures;
-	unsigned int VAO;
+	std::vector<MeshLod> lods;
+
+	/*  Location in the shared mesh buffers  */
+	GeometryAllocation allocation;
+
+	/*  Bounds in model space  */
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+
+	// maps the quantized positions in the mesh buffers back to model space
+	glm::mat4 dequantize;
+
+	/*  Packed Material, filled in by TexturePacker  */
+	// array texture holding each slot's texture, 0 for an empty slot
+	GLuint materialArrays[MATERIAL_SLOT_COUNT];
+	// entry in the material table with the layers, -1 while the textures are separate
+	int material;
 
 	/*  Functions  */
-	// constructor
-	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures)
+	// constructor, indices may hold several levels of detail back to back as described by lods.
+	// without lods the whole index buffer is the only level.
+	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, std::vector<MeshLod> lods = std::vector<MeshLod>())
 	{
 		this->vertices = vertices;
 		this->indices = indices;
 		this->textures = textures;
+		this->lods = lods;
+
+		material = -1;
+		for (int slot = 0; slot < MATERIAL_SLOT_COUNT; slot++)
+			materialArrays[slot] = 0;
+		_cookedVertices = nullptr;
+		_cookedIndices = nullptr;
+		_cookedVertexCount = 0;
+
+		if (this->lods.empty())
+		{
+			MeshLod full = { 0, (unsigned int)indices.size(), 0.0f };
+			this->lods.push_back(full);
+		}
+
+		CalculateBounds(vertices, boundsMin, boundsMax);
 
 		// now that we have all the required data, set the vertex buffers and its attribute pointers.
 		setupMesh();
 	}
 
-	// render the mesh
-	void Draw(Shader shader)
+	// a mesh cooked ahead of time: the packed vertices & indices are uploaded straight from the file's
+	// mapping and stay there for the CPU side readers, vertices & indices remain empty.
+	// owner keeps the packed data alive, the mapping or anything else holding it (see Model's proxies).
+	Mesh(const std::shared_ptr<const void> &owner, const PackedVertex *packedVertices, size_t vertexCount,
+		const void *packedIndices, size_t indexCount, GLenum indexType, std::vector<Texture> textures, std::vector<MeshLod> lods,
+		const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
 	{
-		// bind appropriate textures
+		this->textures = textures;
+		this->lods = lods;
+		this->boundsMin = boundsMin;
+		this->boundsMax = boundsMax;
+
+		material = -1;
+		for (int slot = 0; slot < MATERIAL_SLOT_COUNT; slot++)
+			materialArrays[slot] = 0;
+		_owner = owner;
+		_cookedVertices = packedVertices;
+		_cookedIndices = packedIndices;
+		_cookedVertexCount = vertexCount;
+
+		dequantize = glm::scale(glm::translate(glm::mat4(1.0f), boundsMin), boundsMax - boundsMin);
+		allocation = MeshPool::Allocate(packedVertices, vertexCount, packedIndices, indexCount, indexType);
+	}
+
+	/*  CPU Side Geometry (culling, hud), from the imported vertices or the cooked mapping  */
+	size_t GetVertexCount() const
+	{
+		return _cookedVertices != nullptr ? _cookedVertexCount : vertices.size();
+	}
+
+	// model space position
+	glm::vec3 GetPosition(size_t vertex) const
+	{
+		if (_cookedVertices == nullptr)
+			return vertices[vertex].Position;
+		const GLushort *position = _cookedVertices[vertex].Position;
+		glm::vec3 quantized(position[0] / 65535.0f, position[1] / 65535.0f, position[2] / 65535.0f);
+		return boundsMin + quantized * (boundsMax - boundsMin);
+	}
+
+	glm::vec2 GetTexCoords(size_t vertex) const
+	{
+		if (_cookedVertices == nullptr)
+			return vertices[vertex].TexCoords;
+		return glm::vec2(UnpackHalf(_cookedVertices[vertex].TexCoords[0]), UnpackHalf(_cookedVertices[vertex].TexCoords[1]));
+	}
+
+	// index into the vertices, counted over all levels like MeshLod::indexOffset
+	unsigned int GetIndex(size_t index) const
+	{
+		if (_cookedIndices == nullptr)
+			return indices[index];
+		if (allocation.indexType == GL_UNSIGNED_SHORT)
+			return ((const GLushort*)_cookedIndices)[index];
+		return ((const GLuint*)_cookedIndices)[index];
+	}
+
+	/*  Packing, shared with the cooker  */
+	static void CalculateBounds(const std::vector<Vertex> &vertices, glm::vec3 &boundsMin, glm::vec3 &boundsMax)
+	{
+		boundsMin = glm::vec3(0.0f);
+		boundsMax = glm::vec3(0.0f);
+		if (vertices.empty())
+			return;
+
+		boundsMin = vertices[0].Position;
+		boundsMax = vertices[0].Position;
+		for (unsigned int i = 1; i < vertices.size(); i++)
+		{
+			boundsMin = glm::min(boundsMin, vertices[i].Position);
+			boundsMax = glm::max(boundsMax, vertices[i].Position);
+		}
+	}
+
+	static std::vector<PackedVertex> PackVertices(const std::vector<Vertex> &vertices, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+	{
+		std::vector<PackedVertex> packed(vertices.size());
+		for (unsigned int i = 0; i < vertices.size(); i++)
+		{
+			packed[i] = PackedVertex::Pack(vertices[i], boundsMin, boundsMax - boundsMin);
+		}
+		return packed;
+	}
+
+	// indices are stored as 16 bit whenever every vertex can be addressed with them
+	static GLenum IndexTypeFor(size_t vertexCount)
+	{
+		return vertexCount <= 0xffff ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	}
+
+	// binds the textures to consecutive units and points the samplers of the shader at them,
+	// once packed these are the array textures of the slots and the shader picks the layers.
+	void BindTextures(Shader shader) const
+	{
+		if (material >= 0)
+		{
+			for (int slot = 0; slot < MATERIAL_SLOT_COUNT; slot++)
+			{
+				GLStateCache::ActiveTexture(GL_TEXTURE0 + slot);
+				glUniform1i(glGetUniformLocation(shader.getID(), (std::string(MATERIAL_SLOT_NAMES[slot]) + "1").c_str()), slot);
+				GLStateCache::BindTexture(GL_TEXTURE_2D_ARRAY, materialArrays[slot]);
+			}
+			return;
+		}
+
 		unsigned int diffuseNr = 1;
 		unsigned int specularNr = 1;
 		unsigned int normalNr = 1;
 		unsigned int heightNr = 1;
 		for (unsigned int i = 0; i < textures.size(); i++)
 		{
-			glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+			GLStateCache::ActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
 			// retrieve texture number (the N in diffuse_textureN)
 			std::string number;
 			std::string name = textures[i].type;
@@ -80,60 +330,55 @@ public:
 													 // now set the sampler to the correct texture unit
 			glUniform1i(glGetUniformLocation(shader.getID(), (name + number).c_str()), i);
 			// and finally bind the texture
-			glBindTexture(GL_TEXTURE_2D, textures[i].id);
+			GLStateCache::BindTexture(GL_TEXTURE_2D, textures[i].id);
 		}
+	}
+
+	// the index range of a level inside the shared index buffer, lod is clamped to the coarsest level available
+	const MeshLod &GetLod(unsigned int lod) const
+	{
+		return lods[lod < lods.size() ? lod : lods.size() - 1];
+	}
 
-		// draw mesh
-		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
+	// render the mesh on its own, batched drawing goes through the RenderQueue instead
+	void Draw(Shader shader, unsigned int lod = 0)
+	{
+		BindTextures(shader);
+		shader.setMat4("dequantize", dequantize);
 
-		// always good practice to set everything back to defaults once configured.
-		glActiveTexture(GL_TEXTURE0);
+		// draw mesh, bindings are left as they are since the state cache keeps track of them.
+		const MeshLod &level = GetLod(lod);
+		GLStateCache::BindVertexArray(MeshPool::GetVertexArray());
+		GLStateCache::DrawElementsBaseVertex(GL_TRIANGLES, level.indexCount, allocation.indexType,
+			(void*)((allocation.firstIndex + level.indexOffset) * IndexTypeSize(allocation.indexType)), allocation.baseVertex);
 	}
 
 private:
-	/*  Render data  */
-	unsigned int VBO, EBO;
+	/*  Cooked Data  */
+	// keeps the file mapped (or the packed data alive) while the mesh reads from it
+	std::shared_ptr<const void> _owner;
+	const PackedVertex *_cookedVertices;
+	const void *_cookedIndices;
+	size_t _cookedVertexCount;
 
 	/*  Functions    */
-	// initializes all the buffer objects/arrays
+	// packs the vertices and copies them with all levels of indices into the shared mesh buffers
 	void setupMesh()
 	{
-		// create buffers/arrays
-		glGenVertexArrays(1, &VAO);
-		glGenBuffers(1, &VBO);
-		glGenBuffers(1, &EBO);
+		glm::vec3 bounds_size = boundsMax - boundsMin;
+		dequantize = glm::scale(glm::translate(glm::mat4(1.0f), boundsMin), bounds_size);
 
-		glBindVertexArray(VAO);
-		// load data into vertex buffers
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		// A great thing about structs is that their memory layout is sequential for all its items.
-		// The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-		// again translates to 3/2 floats which translates to a byte array.
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+		std::vector<PackedVertex> packed = PackVertices(vertices, boundsMin, boundsMax);
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-		// set the vertex attribute pointers
-		// vertex Positions
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-		// vertex normals
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-		// vertex texture coords
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-		// vertex tangent
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-		// vertex bitangent
-		glEnableVertexAttribArray(4);
-		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-		glBindVertexArray(0);
+		if (IndexTypeFor(vertices.size()) == GL_UNSIGNED_SHORT)
+		{
+			std::vector<GLushort> short_indices(indices.begin(), indices.end());
+			allocation = MeshPool::Allocate(packed.data(), packed.size(), short_indices.data(), short_indices.size(), GL_UNSIGNED_SHORT);
+		}
+		else
+		{
+			allocation = MeshPool::Allocate(packed.data(), packed.size(), indices.data(), indices.size(), GL_UNSIGNED_INT);
+		}
 	}
 };
 #endif
@@ -5,19 +5,27 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+// the loader includes the stb_image declarations, the implementation has to follow them
+#include "TextureCache.h"
 #include "stb_image.cpp"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include "AssimpFileSystem.h"
 
 #include "mesh.h"
+#include "CookedMesh.h"
 #include "shader.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
 
 //#include "Object.h"
 
 #include "Point.h"
 
 #include "Enums.h"
+#include "values.h"
 
 #include <string>
 #include <fstream>
@@ -26,21 +34,38 @@
 #include <map>
 #include <vector>
 
-unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma = false);
+// What Model::Prepare reads for a model without touching GL: the mapped cooked file when it is
+// up to date, otherwise the imported source.
+struct ModelImport {
+	std::string path;
+	std::shared_ptr<MappedFile> cooked;
+	ModelSource source;
+	bool loaded;
+};
 
 class Model
 {
 public:
 	/*  Model Data */
-	std::vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
 	std::vector<Mesh> meshes;
 	std::string directory;
 
 	/*  Functions   */
 	// constructor, expects a filepath to a 3D model.
-	Model(std::string const &path)
+	Model(std::string const &path) : _lod(0)
+	{
+		ModelImport import;
+		Prepare(path, import);
+		_LoadModel(import);
+		_modelMatrix = glm::mat4(1.0f);
+	}
+
+	// creates the buffers of a model prepared before (see ModelLoader), GL thread only. Its textures are
+	// only named, the TexturePacker reads them when the model is packed. A proxy only gets the coarsest level
+	// of every mesh without textures, it stands in for the model while the full one is streamed (see AssetStreamer).
+	explicit Model(const ModelImport &import, bool proxy = false) : _lod(0)
 	{
-		_LoadModel(path);
+		_LoadModel(import, proxy);
 		_modelMatrix = glm::mat4(1.0f);
 	}
 
@@ -50,6 +75,10 @@ public:
 
 	void Draw(Shader shader);
 
+	// picks the level of detail for the following draws from the fraction of the screen height the model covers
+	void SelectLod(float screenSize);
+	unsigned int GetLod() { return _lod; }
+
 	// new
 	void MoveModel(glm::vec3 vec);
 	void MoveModelTo(glm::vec3 vec, glm::vec3 scaleFactor);
@@ -60,6 +89,21 @@ public:
 	glm::vec3 GetInitialMax() { return this->_max; }
 	glm::vec3 GetInitialMin() { return this->_min; }
 
+	// exact bounds of all meshes in model space
+	glm::vec3 GetBoundsMax() { return this->_boundsMax; }
+	glm::vec3 GetBoundsMin() { return this->_boundsMin; }
+
+	// world space box (center & half extents) enclosing the model with its current model matrix
+	void GetWorldBounds(glm::vec3 &center, glm::vec3 &extents);
+
+	// Reads a model file with ASSIMP into simplified & optimized meshes, touches no GL state
+	// so it can run on any thread. false when ASSIMP can not read the file.
+	static bool Import(std::string const &path, ModelSource &source);
+
+	// Maps the cooked file of a model, or imports the model and cooks it for the next run.
+	// Touches no GL state either, false when neither works.
+	static bool Prepare(std::string const &path, ModelImport &import);
+
 private:
 	/*  Model Data  */
 	glm::mat4 _modelMatrix;
@@ -67,14 +111,28 @@ private:
 	glm::vec3 _max;
 	glm::vec3 _min;
 
+	glm::vec3 _boundsMax;
+	glm::vec3 _boundsMin;
+
+	unsigned int _lod;
+
 	/*  Functions   */
-	void _LoadModel(std::string const & path);
+	void _LoadModel(const ModelImport &import, bool proxy = false);
+
+	void _LoadCooked(const std::shared_ptr<MappedFile> &file);
+	void _LoadSource(const ModelSource &source);
+	void _LoadProxy(const ModelImport &import);
 
-	void _ProcessNode(aiNode * node, const aiScene * scene);
+	static Mesh _CreateProxyMesh(const PackedVertex *vertices, const std::vector<unsigned int> &indices, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax);
 
-	Mesh _ProcessMesh(aiMesh * mesh, const aiScene * scene);
+	static void _ProcessNode(aiNode * node, const aiScene * scene, ModelSource &source);
 
-	std::vector<Texture> _LoadMaterialTextures(aiMaterial * mat, aiTextureType type, std::string typeName);
+	static MeshSource _ProcessMesh(aiMesh * mesh, const aiScene * scene, ModelSource &source);
+
+	static std::vector<MeshLod> _GenerateLods(const std::vector<Vertex> &vertices, std::vector<unsigned int> &indices);
+	static void _OptimizeMesh(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, const std::vector<MeshLod> &lods);
+
+	static std::vector<Texture> _MaterialTextures(aiMaterial * mat, aiTextureType type, std::string typeName);
 };
 
 void Model::PrintModel()
@@ -109,36 +167,253 @@ void Model::MoveModelTo(glm::vec3 vec, glm::vec3 scaleFactor)
 	_modelMatrix = glm::scale(glm::translate(glm::mat4(1.0f), vec), scaleFactor);
 }
 
+void Model::GetWorldBounds(glm::vec3 &center, glm::vec3 &extents)
+{
+	glm::vec3 local_center = (_boundsMax + _boundsMin) * 0.5f;
+	glm::vec3 local_extents = (_boundsMax - _boundsMin) * 0.5f;
+
+	// transform the center, and project the extents onto the world axes (Arvo)
+	center = glm::vec3(_modelMatrix * glm::vec4(local_center, 1.0f));
+	for (int i = 0; i < 3; i++)
+	{
+		extents[i] = std::fabs(_modelMatrix[0][i]) * local_extents.x
+			+ std::fabs(_modelMatrix[1][i]) * local_extents.y
+			+ std::fabs(_modelMatrix[2][i]) * local_extents.z;
+	}
+}
+
 // draws the model, and thus all its meshes
 void Model::Draw(Shader shader)
 {
 	for (unsigned int i = 0; i < meshes.size(); i++)
 	{
-		meshes[i].Draw(shader);
+		meshes[i].Draw(shader, _lod);
+	}
+}
+
+void Model::SelectLod(float screenSize)
+{
+	_lod = 0;
+	while (_lod < MAX_MESH_LODS - 1 && screenSize < LOD_SCREEN_SIZES[_lod])
+	{
+		_lod++;
+	}
+}
+
+bool Model::Prepare(std::string const &path, ModelImport &import)
+{
+	import.path = path;
+	import.loaded = false;
+
+	std::string cooked_path = CookedMesh::GetPath(path);
+	import.cooked = CookedMesh::Open(cooked_path, path);
+	if (import.cooked)
+	{
+		import.loaded = true;
+		return true;
+	}
+
+	if (!Import(path, import.source))
+		return false;
+	CookedMesh::Write(cooked_path, path, import.source);
+	import.loaded = true;
+	return true;
+}
+
+// creates the meshes from the cooked file when there is one, otherwise from the imported source.
+void Model::_LoadModel(const ModelImport &import, bool proxy)
+{
+	// retrieve the directory path of the filepath
+	directory = import.path.substr(0, import.path.find_last_of('/'));
+	if (!import.loaded)
+	{
+		_min = _max = _boundsMin = _boundsMax = glm::vec3(0.0f);
+		return;
+	}
+
+	if (proxy)
+	{
+		_LoadProxy(import);
+	}
+	else if (import.cooked)
+	{
+		_LoadCooked(import.cooked);
+		std::cout << "Model: " << import.path << " cooked, " << meshes.size() << " meshes" << std::endl;
+	}
+	else
+	{
+		_LoadSource(import.source);
+	}
+
+	_boundsMin = glm::vec3(0.0f);
+	_boundsMax = glm::vec3(0.0f);
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		_boundsMin = i == 0 ? meshes[i].boundsMin : glm::min(_boundsMin, meshes[i].boundsMin);
+		_boundsMax = i == 0 ? meshes[i].boundsMax : glm::max(_boundsMax, meshes[i].boundsMax);
+	}
+}
+
+// every mesh is uploaded straight out of the mapping, which the meshes keep open for their CPU side readers
+void Model::_LoadCooked(const std::shared_ptr<MappedFile> &file)
+{
+	const CookedMeshHeader &header = CookedMesh::GetHeader(*file);
+	_min = glm::vec3(header.initialMin[0], header.initialMin[1], header.initialMin[2]);
+	_max = glm::vec3(header.initialMax[0], header.initialMax[1], header.initialMax[2]);
+
+	meshes.reserve(header.meshCount);
+	for (uint32_t m = 0; m < header.meshCount; m++)
+	{
+		const CookedMeshEntry &entry = CookedMesh::GetEntry(*file, m);
+
+		std::vector<MeshLod> lods(entry.lodCount);
+		for (uint32_t l = 0; l < entry.lodCount; l++)
+		{
+			lods[l].indexOffset = entry.lodOffsets[l];
+			lods[l].indexCount = entry.lodCounts[l];
+			lods[l].error = entry.lodErrors[l];
+		}
+
+		std::vector<Texture> textures;
+		for (uint32_t t = entry.firstTexture; t < entry.firstTexture + entry.textureCount; t++)
+		{
+			const CookedTextureReference &reference = CookedMesh::GetTexture(*file, t);
+			Texture texture;
+			texture.id = 0;
+			texture.type = CookedMesh::GetString(*file, reference.typeOffset, reference.typeLength);
+			texture.path = CookedMesh::GetString(*file, reference.pathOffset, reference.pathLength);
+			textures.push_back(texture);
+		}
+
+		meshes.push_back(Mesh(file, (const PackedVertex*)(file->GetData() + entry.vertexOffset), entry.vertexCount,
+			file->GetData() + entry.indexOffset, entry.indexCount, entry.indexType, textures, lods,
+			glm::vec3(entry.boundsMin[0], entry.boundsMin[1], entry.boundsMin[2]),
+			glm::vec3(entry.boundsMax[0], entry.boundsMax[1], entry.boundsMax[2])));
 	}
 }
 
-// loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-void Model::_LoadModel(std::string const &path)
+void Model::_LoadSource(const ModelSource &source)
 {
-	// read file via ASSIMP
+	_min = source.initialMin;
+	_max = source.initialMax;
+
+	meshes.reserve(source.meshes.size());
+	for (unsigned int m = 0; m < source.meshes.size(); m++)
+	{
+		const MeshSource &mesh = source.meshes[m];
+		meshes.push_back(Mesh(mesh.vertices, mesh.indices, mesh.textures, mesh.lods));
+	}
+}
+
+// the coarsest level of every mesh, from the cooked file or the source
+void Model::_LoadProxy(const ModelImport &import)
+{
+	if (import.cooked)
+	{
+		const MappedFile &file = *import.cooked;
+		const CookedMeshHeader &header = CookedMesh::GetHeader(file);
+		_min = glm::vec3(header.initialMin[0], header.initialMin[1], header.initialMin[2]);
+		_max = glm::vec3(header.initialMax[0], header.initialMax[1], header.initialMax[2]);
+
+		meshes.reserve(header.meshCount);
+		for (uint32_t m = 0; m < header.meshCount; m++)
+		{
+			const CookedMeshEntry &entry = CookedMesh::GetEntry(file, m);
+			uint32_t offset = entry.lodOffsets[entry.lodCount - 1];
+			std::vector<unsigned int> indices(entry.lodCounts[entry.lodCount - 1]);
+			for (size_t i = 0; i < indices.size(); i++)
+			{
+				if (entry.indexType == GL_UNSIGNED_SHORT)
+					indices[i] = ((const GLushort*)(file.GetData() + entry.indexOffset))[offset + i];
+				else
+					indices[i] = ((const GLuint*)(file.GetData() + entry.indexOffset))[offset + i];
+			}
+			meshes.push_back(_CreateProxyMesh((const PackedVertex*)(file.GetData() + entry.vertexOffset), indices,
+				glm::vec3(entry.boundsMin[0], entry.boundsMin[1], entry.boundsMin[2]),
+				glm::vec3(entry.boundsMax[0], entry.boundsMax[1], entry.boundsMax[2])));
+		}
+		return;
+	}
+
+	_min = import.source.initialMin;
+	_max = import.source.initialMax;
+	meshes.reserve(import.source.meshes.size());
+	for (size_t m = 0; m < import.source.meshes.size(); m++)
+	{
+		const MeshSource &mesh = import.source.meshes[m];
+		glm::vec3 bounds_min, bounds_max;
+		Mesh::CalculateBounds(mesh.vertices, bounds_min, bounds_max);
+		std::vector<PackedVertex> packed = Mesh::PackVertices(mesh.vertices, bounds_min, bounds_max);
+
+		std::vector<unsigned int> indices(mesh.indices);
+		if (!mesh.lods.empty())
+			indices.assign(mesh.indices.begin() + mesh.lods.back().indexOffset,
+				mesh.indices.begin() + mesh.lods.back().indexOffset + mesh.lods.back().indexCount);
+		meshes.push_back(_CreateProxyMesh(packed.data(), indices, bounds_min, bounds_max));
+	}
+}
+
+// the vertices the indices use, in the order they are first used, quantized to the bounds of the full mesh
+Mesh Model::_CreateProxyMesh(const PackedVertex *vertices, const std::vector<unsigned int> &indices, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+{
+	struct ProxyGeometry {
+		std::vector<PackedVertex> vertices;
+		std::vector<GLushort> shortIndices;
+		std::vector<GLuint> indices;
+	};
+	std::shared_ptr<ProxyGeometry> geometry = std::make_shared<ProxyGeometry>();
+
+	std::map<unsigned int, GLuint> remap;
+	geometry->indices.resize(indices.size());
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		auto known = remap.find(indices[i]);
+		if (known == remap.end())
+		{
+			known = remap.insert(std::make_pair(indices[i], (GLuint)geometry->vertices.size())).first;
+			geometry->vertices.push_back(vertices[indices[i]]);
+		}
+		geometry->indices[i] = known->second;
+	}
+
+	GLenum index_type = Mesh::IndexTypeFor(geometry->vertices.size());
+	const void *index_data = geometry->indices.data();
+	if (index_type == GL_UNSIGNED_SHORT)
+	{
+		geometry->shortIndices.assign(geometry->indices.begin(), geometry->indices.end());
+		geometry->indices.clear();
+		index_data = geometry->shortIndices.data();
+	}
+
+	MeshLod level = { 0, (unsigned int)indices.size(), 0.0f };
+	return Mesh(geometry, geometry->vertices.data(), geometry->vertices.size(), index_data, indices.size(), index_type,
+		std::vector<Texture>(), std::vector<MeshLod>(1, level), boundsMin, boundsMax);
+}
+
+bool Model::Import(std::string const &path, ModelSource &source)
+{
+	// read file via ASSIMP, from the asset archive or the loose files
 	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+	importer.SetIOHandler(new AssimpFileSystem());
+	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices);
 	// check for errors
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
 	{
 		std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
-		return;
+		return false;
 	}
-	// retrieve the directory path of the filepath
-	directory = path.substr(0, path.find_last_of('/'));
+
+	source.meshes.clear();
+	source.initialMin = glm::vec3(0.0f);
+	source.initialMax = glm::vec3(0.0f);
 
 	// process ASSIMP's root node recursively
-	_ProcessNode(scene->mRootNode, scene);
+	_ProcessNode(scene->mRootNode, scene, source);
+	return true;
 }
 
 // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-void Model::_ProcessNode(aiNode *node, const aiScene *scene)
+void Model::_ProcessNode(aiNode *node, const aiScene *scene, ModelSource &source)
 {
 	// process each mesh located at the current node
 	for (unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -146,22 +421,26 @@ void Model::_ProcessNode(aiNode *node, const aiScene *scene)
 		// the node object only contains indices to index the actual objects in the scene. 
 		// the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
 		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.push_back(_ProcessMesh(mesh, scene));
+		source.meshes.push_back(_ProcessMesh(mesh, scene, source));
 	}
 	// after we've processed all of the meshes (if any) we then recursively process each of the children nodes
 	for (unsigned int i = 0; i < node->mNumChildren; i++)
 	{
-		_ProcessNode(node->mChildren[i], scene);
+		_ProcessNode(node->mChildren[i], scene, source);
 	}
 
 }
 
-Mesh Model::_ProcessMesh(aiMesh *mesh, const aiScene *scene)
+MeshSource Model::_ProcessMesh(aiMesh *mesh, const aiScene *scene, ModelSource &source)
 {
 	// data to fill
-	std::vector<Vertex> vertices;
-	std::vector<unsigned int> indices;
-	std::vector<Texture> textures;
+	MeshSource result;
+	std::vector<Vertex> &vertices = result.vertices;
+	std::vector<unsigned int> &indices = result.indices;
+	std::vector<Texture> &textures = result.textures;
+	// the collision box GameObject was tuned against, gathered over all meshes exactly as before
+	glm::vec3 &_min = source.initialMin;
+	glm::vec3 &_max = source.initialMax;
 
 	// Walk through each of the mesh's vertices
 	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -222,6 +501,10 @@ Mesh Model::_ProcessMesh(aiMesh *mesh, const aiScene *scene)
 		for (unsigned int j = 0; j < face.mNumIndices; j++)
 			indices.push_back(face.mIndices[j]);
 	}
+	// simplified levels are appended to the index list, they share the vertices above
+	result.lods = _GenerateLods(vertices, indices);
+	_OptimizeMesh(vertices, indices, result.lods);
+
 	// process materials
 	aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 	// we assume a convention for sampler names in the shaders. Each diffuse texture should be named
@@ -232,94 +515,86 @@ Mesh Model::_ProcessMesh(aiMesh *mesh, const aiScene *scene)
 	// normal: texture_normalN
 
 	// 1. diffuse maps
-	std::vector<Texture> diffuseMaps = _LoadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+	std::vector<Texture> diffuseMaps = _MaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
 	textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
 	// 2. specular maps
-	std::vector<Texture> specularMaps = _LoadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+	std::vector<Texture> specularMaps = _MaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
 	textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
 	// 3. normal maps
-	std::vector<Texture> normalMaps = _LoadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
+	std::vector<Texture> normalMaps = _MaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
 	textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
 	// 4. height maps
-	std::vector<Texture> heightMaps = _LoadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
+	std::vector<Texture> heightMaps = _MaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
 	textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
-	// return a mesh object created from the extracted mesh data
-	return Mesh(vertices, indices, textures);
+	// the textures are only named here, the TexturePacker reads them
+	return result;
 }
 
-// checks all material textures of a given type and loads the textures if they're not loaded yet.
-// the required info is returned as a Texture struct.
-std::vector<Texture> Model::_LoadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName)
+// simplifies the full index list into up to MAX_MESH_LODS levels and appends them to indices.
+std::vector<MeshLod> Model::_GenerateLods(const std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
 {
-	std::vector<Texture> textures;
-	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+	std::vector<MeshLod> lods;
+	MeshLod full = { 0, (unsigned int)indices.size(), 0.0f };
+	lods.push_back(full);
+
+	std::vector<unsigned int> previous(indices);
+	for (unsigned int level = 1; level < MAX_MESH_LODS; level++)
 	{
-		aiString str;
-		mat->GetTexture(type, i, &str);
-		// check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-		bool skip = false;
-		for (unsigned int j = 0; j < textures_loaded.size(); j++)
-		{
-			if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-			{
-				textures.push_back(textures_loaded[j]);
-				skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-				break;
-			}
-		}
-		if (!skip)
-		{   // if texture hasn't been loaded already, load it
-			Texture texture;
-			texture.id = TextureFromFile(str.C_Str(), this->directory);
-			texture.type = typeName;
-			texture.path = str.C_Str();
-			textures.push_back(texture);
-			textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-		}
+		size_t target = (size_t)(full.indexCount * LOD_INDEX_RATIOS[level]) / 3 * 3;
+
+		float error = 0.0f;
+		std::vector<unsigned int> simplified = MeshSimplifier::Simplify(vertices, previous, target, LOD_MAX_ERROR, &error);
+
+		// stop once the simplifier can not remove a meaningful amount anymore
+		if (simplified.empty() || simplified.size() > previous.size() * 9 / 10)
+			break;
+
+		MeshLod lod = { (unsigned int)indices.size(), (unsigned int)simplified.size(), error };
+		lods.push_back(lod);
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
+
+		previous.swap(simplified);
 	}
-	return textures;
+	return lods;
 }
 
-
-unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma)
+// reorders every level for the vertex cache, the full level also for overdraw, then the vertices for fetch locality.
+void Model::_OptimizeMesh(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, const std::vector<MeshLod> &lods)
 {
-	std::string filename = std::string(path);
-	//filename = directory + '/' + filename;
+	// a mesh without triangles (points, lines or no faces) has nothing to reorder
+	if (lods.empty() || lods[0].indexCount == 0 || lods[0].indexCount % 3 != 0)
+		return;
 
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
+	float acmr_before = MeshOptimizer::ComputeACMR(indices.data(), lods[0].indexCount, vertices.size());
 
-	int width, height, nrComponents;
-	unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-	if (data)
+	for (unsigned int i = 0; i < lods.size(); i++)
 	{
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
+		MeshOptimizer::OptimizeVertexCache(&indices[lods[i].indexOffset], lods[i].indexCount, vertices.size());
 	}
-	else
+	MeshOptimizer::OptimizeOverdraw(vertices, &indices[lods[0].indexOffset], lods[0].indexCount, MESH_OVERDRAW_THRESHOLD);
+	MeshOptimizer::OptimizeVertexFetch(vertices, indices);
+
+	float acmr_after = MeshOptimizer::ComputeACMR(indices.data(), lods[0].indexCount, vertices.size());
+	std::cout << "Mesh: " << vertices.size() << " vertices, " << lods[0].indexCount / 3 << " triangles, "
+		<< (vertices.size() <= 0xffff ? 16 : 32) << " bit indices | ACMR " << acmr_before << " -> " << acmr_after << std::endl;
+}
+
+// collects type & path of all material textures of a given type, the ids stay 0: the TexturePacker reads the files.
+std::vector<Texture> Model::_MaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName)
+{
+	std::vector<Texture> textures;
+	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
 	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
+		aiString str;
+		mat->GetTexture(type, i, &str);
+		Texture texture;
+		texture.id = 0;
+		texture.type = typeName;
+		texture.path = str.C_Str();
+		textures.push_back(texture);
 	}
-
-	return textureID;
+	return textures;
 }
 
 #endif
@@ -5,6 +5,10 @@
 #include "Include/glad/glad.h"
 //#include <GL/glew.h>
 
+#include "GLStateCache.h"
+#include "GLExtensions.h"
+#include "ProgramBinaryCache.h"
+
 #include <glm/glm.hpp>
 
 #include <string>
@@ -48,6 +52,9 @@ public:
 		glAttachShader(ID, sFragment);
 		if (geometrySource != nullptr)
 			glAttachShader(ID, gShader);
+		// keep the linked binary available for the program binary cache
+		if (GLExtensions::ProgramBinaries)
+			GLExtensions::ProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 		glLinkProgram(ID);
 		checkCompileErrors(ID, "PROGRAM");
 		// delete the shaders as they're linked into our program now and no longer necessery
@@ -57,13 +64,42 @@ public:
 			glDeleteShader(gShader);
 	}
 
+	// creates the program from the binary cached under cacheKey, false when it has to be compiled instead
+	// ------------------------------------------------------------------------
+	bool LoadBinary(const std::string &cacheKey)
+	{
+		this->ID = glCreateProgram();
+		if (ProgramBinaryCache::Load(ID, cacheKey))
+			return true;
+		GLStateCache::DeleteProgram(ID);
+		this->ID = 0;
+		return false;
+	}
+
+	// false when compiling or linking failed, the errors were printed then
+	// ------------------------------------------------------------------------
+	bool isLinked() const
+	{
+		GLint linked = GL_FALSE;
+		if (ID != 0)
+			glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+		return linked == GL_TRUE;
+	}
 	// activate the shader
 	// ------------------------------------------------------------------------
 	Shader &use()
 	{
-		glUseProgram(ID);
+		GLStateCache::UseProgram(ID);
 		return *this;
 	}
+	// attaches the named uniform block to a binding point, programs without the block are left untouched
+	// ------------------------------------------------------------------------
+	void bindUniformBlock(const std::string &name, GLuint binding) const
+	{
+		GLuint index = glGetUniformBlockIndex(ID, name.c_str());
+		if (index != GL_INVALID_INDEX)
+			glUniformBlockBinding(ID, index, binding);
+	}
 	// utility uniform functions
 	// ------------------------------------------------------------------------
 	void setBool(const std::string &name, bool value) const
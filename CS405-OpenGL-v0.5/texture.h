@@ -6,6 +6,8 @@
 
 #include "stb_image.h"
 
+#include "GLStateCache.h"
+
 // Texture2D is able to store and configure a texture in OpenGL.
 // It also hosts utility functions for easy management.
 class Texture3D {
@@ -74,7 +76,7 @@ void Texture3D::Generate(GLuint width, GLuint height, unsigned char* data)
 	this->Width = width;
 	this->Height = height;
 	// Create Texture
-	glBindTexture(GL_TEXTURE_2D, this->ID);
+	GLStateCache::BindTexture(GL_TEXTURE_2D, this->ID);
 	glTexImage2D(GL_TEXTURE_2D, 0, this->Internal_Format, width, height, 0, this->Image_Format, GL_UNSIGNED_BYTE, data);
 	// Set Texture wrap and filter modes
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, this->Wrap_S);
@@ -82,12 +84,12 @@ void Texture3D::Generate(GLuint width, GLuint height, unsigned char* data)
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, this->Filter_Min);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, this->Filter_Max);
 	// Unbind texture
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLStateCache::BindTexture(GL_TEXTURE_2D, 0);
 }
 
 void Texture3D::Bind() const
 {
-	glBindTexture(GL_TEXTURE_2D, this->ID);
+	GLStateCache::BindTexture(GL_TEXTURE_2D, this->ID);
 }
 
 #endif 
@@ -28,6 +28,71 @@ const float SPEED = 5.0f;
 const float SENSITIVITY = 0.1f;
 const float ZOOM = 45.0f;
 
+// Level of detail settings
+const unsigned int MAX_MESH_LODS = 4;
+// fraction of the full index count every level aims for
+const float LOD_INDEX_RATIOS[MAX_MESH_LODS] = { 1.0f, 0.5f, 0.25f, 0.125f };
+// a level is used while the model covers less than this fraction of the screen height
+const float LOD_SCREEN_SIZES[MAX_MESH_LODS - 1] = { 0.25f, 0.12f, 0.05f };
+// collapses moving the surface further than this (relative to the mesh extent) are never made
+const float LOD_MAX_ERROR = 0.02f;
+
+// Mesh import: the overdraw order is kept while its vertex cache miss ratio is at most this factor worse
+const float MESH_OVERDRAW_THRESHOLD = 1.05f;
+
+// Initial size of the shared mesh geometry buffers, in vertices and indices (they grow when needed)
+const size_t MESH_POOL_VERTICES = 256 * 1024;
+const size_t MESH_POOL_INDICES = 1024 * 1024;
+
+// HUD: longest side of a panel texture in the atlas, and how many hunger bar widths are distinguished
+const int HUD_ATLAS_TILE_SIZE = 256;
+const int HUD_HUNGER_STEPS = 200;
+
+// Room for the data of one frame in the stream buffer (three of these are allocated with persistent mapping)
+const size_t STREAM_FRAME_BYTES = 4 * 1024 * 1024;
+
+// Texture uploads per frame stop after this many bytes (at least one image is uploaded every frame)
+const size_t TEXTURE_UPLOAD_BUDGET = 8 * 1024 * 1024;
+
+// Streaming: the full models (geometry & packed textures) kept resident, how many load at once, and how much
+// farther an object the camera did not see last frame counts when choosing what to load next
+const size_t STREAMING_BUDGET = 256 * 1024 * 1024;
+const unsigned int STREAMING_MAX_LOADS = 2;
+const float STREAMING_HIDDEN_DISTANCE_SCALE = 4.0f;
+
+// Hot reloading: watch the Resource directory for changes while the game runs, a changed file is applied once
+// nothing wrote to it for this many seconds
+const bool HOT_RELOAD = true;
+const double HOT_RELOAD_SETTLE_TIME = 0.2;
+
+// Textures no model references anymore stay cached for a model loaded again, up to this many of them
+const size_t TEXTURE_CACHE_UNREFERENCED = 32;
+
+// Texture packing: textures up to this size share atlas pages of the page size, with a gutter of padding
+// texels around each (so the pages only get that many mip levels), rounded up to whole blocks on the last of
+// them. Larger ones become layers of array
+// textures, one array per size. The material table has room for this many entries (mirrored in model_loading.vs).
+const int TEXTURE_ATLAS_MAX_SIZE = 512;
+const int TEXTURE_ATLAS_PAGE_SIZE = 2048;
+const int TEXTURE_ATLAS_PADDING = 8;
+const unsigned int MATERIAL_MAX_COUNT = 128;
+
+// Software occlusion culling: depth buffer size, models covering at least this fraction of the screen height
+// are drawn into it, using this level of detail of their meshes. The simplifier does not keep a coarser level
+// inside the surface, it could stick out and hide what is actually in front of it, so occluders use the full mesh.
+const bool OCCLUSION_CULLING = true;
+const int OCCLUSION_BUFFER_WIDTH = 320;
+const int OCCLUSION_BUFFER_HEIGHT = 180;
+const float OCCLUSION_OCCLUDER_SCREEN_SIZE = 0.2f;
+const unsigned int OCCLUSION_OCCLUDER_LOD = 0;
+
+// Depth only prepass before the shaded opaque pass, toggled at runtime with J (on) and K (off)
+const bool DEPTH_PREPASS = false;
+
+// Uniform block binding points
+const unsigned int UNIFORM_BINDING_CAMERA = 0;
+const unsigned int UNIFORM_BINDING_MATERIALS = 1;
+
 // Window settings
 const unsigned int SCR_WIDTH = 1280;
 const unsigned int SCR_HEIGHT = 720;
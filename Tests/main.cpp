@@ -0,0 +1,645 @@
+// Headless tests of the engine, run on the RecordingRenderDevice so they need neither a window nor a GPU.
+//
+//   Tests
+//
+// Every failed check is printed, the exit code is the number of failures. The recorded costs of a fixed
+// scene, and of the game's own frame loop with and without the depth prepass, have to stay within the
+// baselines below on every GL version the engine has a path for; a change that makes the render path
+// cheaper lowers them, one that makes it more expensive has to explain why.
+
+// like main.cpp the engine comes first, model.h follows its stb_image declarations with the implementation
+#include "../CS405-OpenGL-v0.5/GameEngine.h"
+#include "../CS405-OpenGL-v0.5/RecordingRenderDevice.h"
+#include "../CS405-OpenGL-v0.5/GLExtensions.h"
+#include "../CS405-OpenGL-v0.5/GLStateCache.h"
+#include "../CS405-OpenGL-v0.5/StreamBuffer.h"
+#include "../CS405-OpenGL-v0.5/RenderQueue.h"
+#include "../CS405-OpenGL-v0.5/TexturePacker.h"
+#include "../CS405-OpenGL-v0.5/TextureLoader.h"
+#include "../CS405-OpenGL-v0.5/ProgramBinaryCache.h"
+#include "../CS405-OpenGL-v0.5/shader.h"
+#include "../CS405-OpenGL-v0.5/model.h"
+#include "../CS405-OpenGL-v0.5/OcclusionCuller.h"
+#include "../CS405-OpenGL-v0.5/ThreadPool.h"
+#include "../CS405-OpenGL-v0.5/CookedMesh.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// What one frame of the test scene may cost at most on a context of the given version.
+struct RecordingBaseline {
+	int majorVersion, minorVersion;
+	unsigned int drawCalls;
+	unsigned int stateChanges;
+	size_t uploadBytes;
+};
+
+// 3.3 draws every mesh with its own instanced call and uploads the stream, 4.3 draws all of them with one
+// multi draw indirect and 4.6 also writes the stream through the persistent mapping (which is not counted).
+const RecordingBaseline RECORDING_BASELINES[] = {
+	{ 3, 3, 3, 4, 1632 },
+	{ 4, 3, 1, 5, 1692 },
+	{ 4, 6, 1, 5, 0 },
+};
+
+// What one frame of the game may cost at most, with the depth prepass switched on or off by its key.
+struct EngineBaseline {
+	int majorVersion, minorVersion;
+	bool depthPrepass;
+	unsigned int drawCalls;
+	unsigned int stateChanges;
+	size_t uploadBytes;
+};
+
+// The HUD and the skybox are one call each. 3.3 draws the visible models with a call per batch and the prepass
+// draws them again, 4.3 needs one more multi draw indirect for the prepass and 4.6 maps the stream.
+const EngineBaseline ENGINE_BASELINES[] = {
+	{ 3, 3, false, 4, 24, 344 },
+	{ 3, 3, true, 6, 33, 344 },
+	{ 4, 3, false, 4, 25, 384 },
+	{ 4, 3, true, 5, 35, 424 },
+	{ 4, 6, false, 4, 25, 0 },
+	{ 4, 6, true, 5, 35, 0 },
+};
+
+// frames of the game, enough for every model to stream in, and the seed of its random placement
+const unsigned int ENGINE_FRAMES = 30;
+const unsigned int ENGINE_SEED = 405;
+
+// distinct meshes of the test scene and the copies drawn of each
+const unsigned int TEST_SCENE_MESHES = 3;
+const unsigned int TEST_SCENE_COPIES = 8;
+const unsigned int TEST_SCENE_FRAMES = 10;
+
+static unsigned int failures = 0;
+
+static void Check(bool passed, const std::string &what)
+{
+	if (passed)
+		return;
+	std::cout << "FAILED: " << what << std::endl;
+	failures++;
+}
+
+// a flat grid of size x size quads, one level of detail
+static MeshSource CreateGridMesh(unsigned int size)
+{
+	MeshSource mesh;
+	for (unsigned int y = 0; y <= size; y++)
+	{
+		for (unsigned int x = 0; x <= size; x++)
+		{
+			Vertex vertex = {};
+			vertex.Position = glm::vec3((float)x / size - 0.5f, 0.0f, (float)y / size - 0.5f);
+			vertex.Normal = glm::vec3(0.0f, 1.0f, 0.0f);
+			mesh.vertices.push_back(vertex);
+		}
+	}
+	for (unsigned int y = 0; y < size; y++)
+	{
+		for (unsigned int x = 0; x < size; x++)
+		{
+			unsigned int corner = y * (size + 1) + x;
+			unsigned int quad[6] = { corner, corner + size + 1, corner + 1, corner + 1, corner + size + 1, corner + size + 2 };
+			mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+		}
+	}
+	MeshLod lod = { 0, (unsigned int)mesh.indices.size(), 0.0f };
+	mesh.lods.push_back(lod);
+	return mesh;
+}
+
+static Model *CreateGridModel(unsigned int size)
+{
+	ModelImport import;
+	import.path = "Tests/grid";
+	import.loaded = true;
+	import.source.meshes.push_back(CreateGridMesh(size));
+	import.source.initialMin = glm::vec3(-0.5f, 0.0f, -0.5f);
+	import.source.initialMax = glm::vec3(0.5f, 0.0f, 0.5f);
+	return new Model(import);
+}
+
+// Renders the test scene through the render queue and checks the recorded frames against the baseline.
+static void TestRecordingBaseline(const RecordingBaseline &baseline)
+{
+	std::string version = std::to_string(baseline.majorVersion) + "." + std::to_string(baseline.minorVersion);
+	RecordingRenderDevice device(TEST_SCENE_FRAMES, baseline.majorVersion, baseline.minorVersion);
+	if (!device.Create("Tests", 640, 480))
+	{
+		Check(false, "GL " + version + ": the recording device was created");
+		return;
+	}
+	GLStateCache::Invalidate();
+	GLExtensions::Load(&device);
+
+	// both paths are recorded, the newer context has to take the newer one
+	int version_number = baseline.majorVersion * 10 + baseline.minorVersion;
+	Check(GLExtensions::MultiDrawIndirect == (version_number >= 43), "GL " + version + ": multi draw indirect found as expected");
+	Check(GLExtensions::PersistentMapping == (version_number >= 44), "GL " + version + ": persistent mapping found as expected");
+	Check(GLExtensions::ProgramBinaries == (version_number >= 41), "GL " + version + ": program binaries found as expected");
+
+	StreamBuffer stream;
+	stream.Create(256 * 1024);
+	Check(stream.IsPersistent() == GLExtensions::PersistentMapping, "GL " + version + ": the stream buffer is mapped as expected");
+
+	MeshPool::Init(4096, 16384);
+	RenderQueue queue;
+	queue.Init(&stream);
+
+	Shader shader;
+	shader.Compile("object vertex", "object fragment", nullptr);
+	Check(shader.isLinked(), "GL " + version + ": the object shader linked");
+
+	// the shader binary comes back from the cache as a linked program
+	std::string key = ProgramBinaryCache::MakeKey("object vertex", "object fragment", "");
+	ProgramBinaryCache::Store(shader.getID(), key);
+	Shader cached;
+	Check(cached.LoadBinary(key) == GLExtensions::ProgramBinaries, "GL " + version + ": the cached program binary loaded as expected");
+	if (cached.getID() != 0)
+		GLStateCache::DeleteProgram(cached.getID());
+
+	std::vector<Model*> models;
+	for (unsigned int m = 0; m < TEST_SCENE_MESHES; m++)
+		models.push_back(CreateGridModel(4 + 4 * m));
+	TexturePacker::Pack(models);
+
+	while (!device.ShouldClose())
+	{
+		GLStateCache::BeginFrame();
+		stream.BeginFrame();
+
+		// like the game objects sharing a model, every copy is the same model with its own matrix
+		queue.Begin(glm::vec3(0.0f, 5.0f, 5.0f));
+		for (size_t m = 0; m < models.size(); m++)
+		{
+			for (unsigned int c = 0; c < TEST_SCENE_COPIES; c++)
+			{
+				models[m]->SetModelMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(2.0f * c, 0.0f, -2.0f * m)));
+				queue.Submit(*models[m]);
+			}
+		}
+		queue.Flush(shader);
+
+		stream.EndFrame();
+		device.Present();
+	}
+
+	// the first frames create what later frames reuse, the last one is what every frame costs from then on
+	const RecordingFrameStats &frame = RecordingRenderDevice::GetLastFrame();
+	Check(RecordingRenderDevice::GetErrorCount() == 0, "GL " + version + ": no invalid GL usage");
+	// the device only sees the instances of indirect commands written through a mapping
+	if (!GLExtensions::MultiDrawIndirect || GLExtensions::PersistentMapping)
+	{
+		Check(frame.instances == TEST_SCENE_MESHES * TEST_SCENE_COPIES, "GL " + version + ": every copy drawn once, "
+			+ std::to_string(frame.instances) + " instances");
+	}
+	Check(frame.drawCalls <= baseline.drawCalls, "GL " + version + ": " + std::to_string(frame.drawCalls)
+		+ " draw calls, baseline " + std::to_string(baseline.drawCalls));
+	Check(frame.stateChanges <= baseline.stateChanges, "GL " + version + ": " + std::to_string(frame.stateChanges)
+		+ " state changes, baseline " + std::to_string(baseline.stateChanges));
+	Check(frame.uploadBytes <= baseline.uploadBytes, "GL " + version + ": " + std::to_string(frame.uploadBytes)
+		+ " bytes uploaded, baseline " + std::to_string(baseline.uploadBytes));
+
+	for (size_t i = 0; i < models.size(); i++)
+		delete models[i];
+	queue.Delete();
+	stream.Delete();
+	TexturePacker::Clear();
+	MeshPool::Clear();
+	GLStateCache::DeleteProgram(shader.getID());
+	device.Destroy();
+}
+
+// A wall in front of the camera hides the boxes completely behind it and nothing else.
+static void TestOcclusionCuller()
+{
+	// the occluder meshes live in the mesh pool
+	RecordingRenderDevice device(1);
+	if (!device.Create("Tests", 640, 480))
+	{
+		Check(false, "occlusion: the recording device was created");
+		return;
+	}
+	GLStateCache::Invalidate();
+	GLExtensions::Load(&device);
+	MeshPool::Init(64, 64);
+
+	// a 2 x 2 square at z = 0 facing the camera, its coarse level is only the lower left triangle
+	std::vector<Vertex> vertices(4);
+	for (int i = 0; i < 4; i++)
+	{
+		vertices[i] = Vertex();
+		vertices[i].Position = glm::vec3((i & 1) ? 1.0f : -1.0f, (i >> 1) ? 1.0f : -1.0f, 0.0f);
+	}
+	std::vector<unsigned int> indices = { 0, 1, 2, 1, 3, 2, 0, 1, 2 };
+	std::vector<MeshLod> lods = { { 0, 6, 0.0f }, { 6, 3, 0.5f } };
+	std::vector<Mesh> wall;
+	wall.push_back(Mesh(vertices, indices, std::vector<Texture>(), lods));
+	glm::mat4 wall_matrix = glm::scale(glm::mat4(1.0f), glm::vec3(2.0f));
+
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	ThreadPool pool(2);
+	OcclusionCuller culler;
+	culler.Init(OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT);
+
+	culler.Begin(projection * view);
+	culler.AddOccluder(wall, 0, wall_matrix);
+	culler.Rasterize(pool);
+	size_t full_coverage = (size_t)std::count_if(culler.GetDepth(), culler.GetDepth() + culler.GetWidth() * culler.GetHeight(),
+		[](float depth) { return depth < 1.0f; });
+	Check(full_coverage > 0, "occlusion: the wall was rasterized");
+	Check(!culler.IsVisible(glm::vec3(0.0f, 0.0f, -3.0f), glm::vec3(0.5f)), "occlusion: a box behind the wall is hidden");
+	Check(!culler.IsVisible(glm::vec3(1.2f, 1.2f, -3.0f), glm::vec3(0.3f)), "occlusion: a box behind the upper right of the wall is hidden");
+	Check(culler.IsVisible(glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(0.5f)), "occlusion: a box in front of the wall is visible");
+	Check(culler.IsVisible(glm::vec3(6.0f, 0.0f, -3.0f), glm::vec3(0.5f)), "occlusion: a box beside the wall is visible");
+	Check(culler.IsVisible(glm::vec3(2.2f, 0.0f, -1.0f), glm::vec3(0.5f)), "occlusion: a box reaching past the edge is visible");
+	Check(culler.IsVisible(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.5f)), "occlusion: a box around the camera is visible");
+
+	AABBBatch batch;
+	batch.Add(glm::vec3(0.0f, 0.0f, -3.0f), glm::vec3(0.5f));
+	batch.Add(glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(0.5f));
+	unsigned char visible[2] = { 1, 1 };
+	culler.Cull(batch, visible, pool);
+	Check(visible[0] == 0 && visible[1] == 1, "occlusion: Cull clears only the hidden box");
+
+	// only the triangles of the given level occlude
+	culler.Begin(projection * view);
+	culler.AddOccluder(wall, 1, wall_matrix);
+	culler.Rasterize(pool);
+	size_t coarse_coverage = (size_t)std::count_if(culler.GetDepth(), culler.GetDepth() + culler.GetWidth() * culler.GetHeight(),
+		[](float depth) { return depth < 1.0f; });
+	Check(coarse_coverage > full_coverage / 3 && coarse_coverage < full_coverage * 2 / 3, "occlusion: the coarse level covers half the wall");
+	Check(!culler.IsVisible(glm::vec3(-1.2f, -1.2f, -3.0f), glm::vec3(0.3f)), "occlusion: the coarse level hides what is behind its triangle");
+	Check(culler.IsVisible(glm::vec3(1.2f, 1.2f, -3.0f), glm::vec3(0.3f)), "occlusion: the coarse level hides nothing outside of it");
+
+	// a floor under the camera, cut by the near plane, still occludes with the part in front of it
+	culler.Begin(projection * view);
+	culler.AddOccluder(wall, 0, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.5f, 5.0f))
+		* glm::rotate(glm::mat4(1.0f), glm::radians(-80.0f), glm::vec3(1.0f, 0.0f, 0.0f)) * glm::scale(glm::mat4(1.0f), glm::vec3(3.0f)));
+	culler.Rasterize(pool);
+	Check(std::count_if(culler.GetDepth(), culler.GetDepth() + culler.GetWidth() * culler.GetHeight(), [](float depth) { return depth < 1.0f; }) > 0,
+		"occlusion: a floor through the near plane is clipped, not dropped");
+
+	MeshPool::Clear();
+	device.Destroy();
+}
+
+static void WriteFile(const std::string &path, const std::string &text)
+{
+	std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+	file << text;
+}
+
+// an uncompressed 32 bit TGA of one color
+static void WriteImage(const std::string &path, int width, int height, const unsigned char color[4])
+{
+	std::string image(18, '\0');
+	image[2] = 2;
+	image[12] = (char)(width & 0xff);
+	image[13] = (char)(width >> 8);
+	image[14] = (char)(height & 0xff);
+	image[15] = (char)(height >> 8);
+	image[16] = 32;
+	image[17] = 8;
+	const char bgra[4] = { (char)color[2], (char)color[1], (char)color[0], (char)color[3] };
+	for (int i = 0; i < width * height; i++)
+		image.append(bgra, 4);
+	WriteFile(path, image);
+}
+
+static Model *CreateTexturedModel(const std::string &diffusePath, const std::string &specularPath)
+{
+	ModelImport import;
+	import.path = "Tests/textured";
+	import.loaded = true;
+	import.source.meshes.push_back(CreateGridMesh(1));
+	Texture diffuse = { 0, "texture_diffuse", diffusePath };
+	Texture specular = { 0, "texture_specular", specularPath };
+	import.source.meshes[0].textures.push_back(diffuse);
+	import.source.meshes[0].textures.push_back(specular);
+	return new Model(import);
+}
+
+// Textures are packed from their files, a pack that needs more materials than the table holds changes nothing
+// and a changed file is written over its placement.
+static void TestTexturePacker()
+{
+	RecordingRenderDevice device(1);
+	if (!device.Create("Tests", 640, 480))
+	{
+		Check(false, "texture packer: the recording device was created");
+		return;
+	}
+	GLStateCache::Invalidate();
+	GLExtensions::Load(&device);
+	MeshPool::Init(4096, 16384);
+	CookedAsset::MakeDirectory();
+
+	// every pair of the small images is a material of its own, more than the table holds
+	const int image_count = 12;
+	std::vector<std::string> paths;
+	for (int i = 0; i < image_count; i++)
+	{
+		paths.push_back(DIRECTORY_COOKED + "/pack" + std::to_string(i) + ".tga");
+		const unsigned char color[4] = { (unsigned char)(i * 20), 128, 255, 255 };
+		WriteImage(paths.back(), 8, 8, color);
+	}
+	std::string large_path = DIRECTORY_COOKED + "/pack_large.tga";
+	const unsigned char gray[4] = { 128, 128, 128, 128 };
+	WriteImage(large_path, TEXTURE_ATLAS_MAX_SIZE * 2, 4, gray);
+
+	std::vector<Model*> models;
+	models.push_back(CreateTexturedModel(paths[0], paths[1]));
+	models.push_back(CreateTexturedModel(large_path, paths[1]));
+	Check(TexturePacker::Pack(models), "texture packer: packed");
+	Check(TexturePacker::IsPacked(*models[0]) && TexturePacker::IsPacked(*models[1]), "texture packer: both models packed");
+	Check(TexturePacker::IsPlaced(paths[0]) && TexturePacker::IsPlaced(large_path), "texture packer: the atlas image and the array layer placed");
+
+	std::vector<Model*> pairs;
+	for (int i = 0; i < image_count; i++)
+	{
+		for (int j = 0; j < image_count; j++)
+			pairs.push_back(CreateTexturedModel(paths[i], paths[j]));
+	}
+	Check(!TexturePacker::Pack(pairs), "texture packer: a pack with more materials than the table holds fails");
+	bool unpacked = true;
+	for (size_t i = 0; i < pairs.size(); i++)
+		unpacked = unpacked && !TexturePacker::IsPacked(*pairs[i]);
+	Check(unpacked, "texture packer: the failed pack leaves its models unpacked");
+	Check(TexturePacker::IsPacked(*models[0]) && TexturePacker::IsPlaced(paths[1]) && !TexturePacker::IsPlaced(paths[5]),
+		"texture packer: the failed pack keeps what was packed before and drops what it placed");
+
+	const unsigned char red[4] = { 255, 0, 0, 255 };
+	WriteImage(paths[0], 8, 8, red);
+	Check(TexturePacker::Reload(paths[0]) == 1 && TexturePacker::Reload(paths[5]) == 0, "texture packer: only packed files are read again");
+	device.Present();
+	for (int i = 0; i < 1000 && RecordingRenderDevice::GetLastFrame().uploadBytes == 0; i++)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		TexturePacker::Update();
+		device.Present();
+	}
+	Check(RecordingRenderDevice::GetLastFrame().uploadBytes != 0, "texture packer: the changed file was written");
+	Check(RecordingRenderDevice::GetErrorCount() == 0, "texture packer: no invalid GL usage");
+
+	for (size_t i = 0; i < pairs.size(); i++)
+		delete pairs[i];
+	for (size_t i = 0; i < models.size(); i++)
+		delete models[i];
+	TexturePacker::Clear();
+	MeshPool::Clear();
+	device.Destroy();
+	for (int i = 0; i < image_count; i++)
+		std::remove(paths[i].c_str());
+	std::remove(large_path.c_str());
+}
+
+// A texture requested again before its first image arrived only gets the newest one.
+static void TestTextureLoader()
+{
+	RecordingRenderDevice device(1);
+	if (!device.Create("Tests", 640, 480))
+	{
+		Check(false, "texture loader: the recording device was created");
+		return;
+	}
+	GLStateCache::Invalidate();
+	GLExtensions::Load(&device);
+	TextureLoader::Init();
+	CookedAsset::MakeDirectory();
+
+	std::string old_path = DIRECTORY_COOKED + "/load_old.tga";
+	std::string new_path = DIRECTORY_COOKED + "/load_new.tga";
+	const unsigned char white[4] = { 255, 255, 255, 255 };
+	WriteImage(old_path, 8, 8, white);
+	WriteImage(new_path, 16, 16, white);
+
+	GLuint texture = TextureLoader::Load(old_path);
+	TextureLoader::Reload(texture, new_path);
+	Check(TextureLoader::IsPending(texture), "texture loader: pending until the newest image is uploaded");
+	TextureLoader::Finish();
+	Check(!TextureLoader::IsPending(texture) && TextureLoader::GetPendingCount() == 0, "texture loader: nothing pending after Finish");
+	device.Present();
+	Check(RecordingRenderDevice::GetLastFrame().uploadBytes < 8 * 8 * 4 + 16 * 16 * 4, "texture loader: the older image is not uploaded");
+	Check(RecordingRenderDevice::GetErrorCount() == 0, "texture loader: no invalid GL usage");
+
+	GLStateCache::DeleteTextures(1, &texture);
+	TextureLoader::Clear();
+	device.Destroy();
+	std::remove(old_path.c_str());
+	std::remove(new_path.c_str());
+}
+
+// A cooked model goes stale with its material library and textures, and one indexing past its vertices is rejected.
+static void TestCookedMesh()
+{
+	CookedAsset::MakeDirectory();
+	std::string source_path = DIRECTORY_COOKED + "/test.obj";
+	std::string library_path = DIRECTORY_COOKED + "/test.mtl";
+	std::string texture_path = DIRECTORY_COOKED + "/test.png";
+	std::string cooked_path = CookedMesh::GetPath(source_path);
+	WriteFile(source_path, "mtllib test.mtl\nv 0 0 0\n");
+	WriteFile(library_path, "newmtl grid\n");
+	WriteFile(texture_path, "png");
+
+	ModelSource source;
+	source.meshes.push_back(CreateGridMesh(4));
+	Texture texture = { 0, "texture_diffuse", texture_path };
+	source.meshes[0].textures.push_back(texture);
+	source.initialMin = glm::vec3(-0.5f, 0.0f, -0.5f);
+	source.initialMax = glm::vec3(0.5f, 0.0f, 0.5f);
+	Check(CookedMesh::GetLibraries(source_path) == std::vector<std::string>(1, library_path), "cooked mesh: the material library is found");
+	Check(CookedMesh::Write(cooked_path, source_path, source), "cooked mesh: written");
+	Check(CookedMesh::Open(cooked_path, source_path) != nullptr, "cooked mesh: current after writing");
+
+	WriteFile(library_path, "newmtl grid\nKd 1 0 0\n");
+	Check(CookedMesh::Open(cooked_path, source_path) == nullptr, "cooked mesh: stale after the material library changed");
+	Check(CookedMesh::Restamp(cooked_path, source_path) && CookedMesh::Open(cooked_path, source_path) != nullptr, "cooked mesh: current after a restamp");
+	WriteFile(texture_path, "png changed");
+	Check(CookedMesh::Open(cooked_path, source_path) == nullptr, "cooked mesh: stale after a texture changed");
+	CookedMesh::Restamp(cooked_path, source_path);
+
+	// the last index of the mesh points one past the vertices
+	uint64_t index_offset = 0;
+	uint32_t index_count = 0, vertex_count = 0;
+	{
+		std::shared_ptr<MappedFile> file = CookedMesh::Open(cooked_path, source_path);
+		Check(file != nullptr && CookedMesh::GetEntry(*file, 0).indexType == GL_UNSIGNED_SHORT, "cooked mesh: 16 bit indices");
+		if (file)
+		{
+			index_offset = CookedMesh::GetEntry(*file, 0).indexOffset;
+			index_count = CookedMesh::GetEntry(*file, 0).indexCount;
+			vertex_count = CookedMesh::GetEntry(*file, 0).vertexCount;
+		}
+	}
+	if (index_count != 0)
+	{
+		std::fstream file(cooked_path.c_str(), std::ios::binary | std::ios::in | std::ios::out);
+		GLushort index = (GLushort)vertex_count;
+		file.seekp((std::streamoff)(index_offset + (index_count - 1) * sizeof(GLushort)));
+		file.write((const char*)&index, sizeof(index));
+	}
+	Check(CookedMesh::Open(cooked_path, source_path) == nullptr, "cooked mesh: an index past the vertices is rejected");
+
+	std::remove(cooked_path.c_str());
+	std::remove(source_path.c_str());
+	std::remove(library_path.c_str());
+	std::remove(texture_path.c_str());
+}
+
+// The recording device holding one key down. Every frame waits for the workers, so the models stream in after
+// the same number of frames however fast the machine is.
+class EngineTestDevice : public RecordingRenderDevice {
+public:
+	EngineTestDevice(unsigned int frameCount, int majorVersion, int minorVersion, int key)
+		: RecordingRenderDevice(frameCount, majorVersion, minorVersion), _key(key) { }
+
+	bool IsKeyPressed(int key) { return key == _key; }
+	void Present()
+	{
+		ThreadPool::Shared().Wait();
+		RecordingRenderDevice::Present();
+	}
+
+private:
+	int _key;
+};
+
+// a cooked grid and its textures, the engine maps it without importing the source file
+static std::string WriteCookedModel(const std::string &name, unsigned int size, const std::vector<std::string> &types)
+{
+	std::string source_path = DIRECTORY_COOKED + "/engine_" + name + ".obj";
+	WriteFile(source_path, "v 0 0 0\n");
+
+	ModelSource source;
+	source.meshes.push_back(CreateGridMesh(size));
+	for (size_t t = 0; t < types.size(); t++)
+	{
+		Texture texture = { 0, types[t], DIRECTORY_COOKED + "/engine_" + name + "_" + std::to_string(t) + ".tga" };
+		const unsigned char color[4] = { (unsigned char)(40 * t), 128, (unsigned char)size, 255 };
+		WriteImage(texture.path, 16, 16, color);
+		source.meshes[0].textures.push_back(texture);
+	}
+	source.initialMin = glm::vec3(-0.5f, 0.0f, -0.5f);
+	source.initialMax = glm::vec3(0.5f, 0.0f, 0.5f);
+	CookedMesh::Write(CookedMesh::GetPath(source_path), source_path, source);
+	return source_path;
+}
+
+static void RemoveCookedModel(const std::string &sourcePath, size_t textureCount)
+{
+	std::string name = sourcePath.substr(0, sourcePath.size() - 4);
+	for (size_t t = 0; t < textureCount; t++)
+		std::remove((name + "_" + std::to_string(t) + ".tga").c_str());
+	std::remove(CookedMesh::GetPath(sourcePath).c_str());
+	std::remove(sourcePath.c_str());
+}
+
+// Sets up the game like main does, with cooked grids for its models, and runs its own frame loop: culling, occlusion,
+// streaming, the render queue with or without the depth prepass, the HUD and the skybox. The last frame, with every
+// model streamed in, is checked against the baseline.
+static void TestEngineBaseline(const EngineBaseline &baseline)
+{
+	std::string version = "engine on GL " + std::to_string(baseline.majorVersion) + "." + std::to_string(baseline.minorVersion)
+		+ (baseline.depthPrepass ? " with" : " without") + " depth prepass";
+
+	CookedAsset::MakeDirectory();
+	std::vector<std::string> color(1, "texture_diffuse"), material = color;
+	material.push_back("texture_specular");
+	material.push_back("texture_normal");
+	std::string player = WriteCookedModel("player", 8, material);
+	std::string enemy = WriteCookedModel("enemy", 6, material);
+	std::string coin = WriteCookedModel("coin", 2, color);
+	std::string panels[3] = { WriteCookedModel("lives", 1, color), WriteCookedModel("score", 1, color), WriteCookedModel("hunger", 1, color) };
+	std::vector<std::string> faces;
+	for (int f = 0; f < 6; f++)
+	{
+		faces.push_back(DIRECTORY_COOKED + "/engine_sky_" + std::to_string(f) + ".tga");
+		const unsigned char sky[4] = { 60, 90, (unsigned char)(120 + 20 * f), 255 };
+		WriteImage(faces.back(), 32, 32, sky);
+	}
+
+	// the placement and the values the HUD shows are the same on every run, the camera following the player
+	// looks over it at the scene
+	int lives = TOTAL_LIVES, score = TOTAL_SCORE;
+	float hunger = VAR_HUNGER;
+	Camera view = camera;
+	camera = Camera(glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), 90.0f, -15.0f);
+	std::srand(ENGINE_SEED);
+
+	EngineTestDevice device(ENGINE_FRAMES, baseline.majorVersion, baseline.minorVersion, baseline.depthPrepass ? GLFW_KEY_J : GLFW_KEY_K);
+	GameEngine engine = GameEngine::GetInstance();
+	engine.Init(&device);
+	engine.SetSkybox(faces);
+
+	ResourceManager::LoadShader(FILE_SHADER_VERTEX_SKYBOX.c_str(), FILE_SHADER_FRAGMENT_SKYBOX.c_str(), nullptr, KEY_SHADER_SKYBOX);
+	ResourceManager::LoadShader(FILE_SHADER_VERTEX_STANDARD_OBJECT.c_str(), FILE_SHADER_FRAGMENT_STANDART_OBJECT.c_str(), nullptr, KEY_SHADER_OBJECT);
+	ResourceManager::LoadShader(FILE_SHADER_VERTEX_HUD.c_str(), FILE_SHADER_FRAGMENT_HUD.c_str(), nullptr, KEY_SHADER_HUD);
+	ResourceManager::LoadShader(FILE_SHADER_VERTEX_DEPTH.c_str(), FILE_SHADER_FRAGMENT_DEPTH.c_str(), nullptr, KEY_SHADER_DEPTH);
+	ResourceManager::GetShader(KEY_SHADER_SKYBOX).use().setInt("skybox", 0);
+
+	engine.SetPlayer(player, glm::vec3(0.5f));
+	for (int i = 0; i < 5; i++)
+		engine.AddEnemy(enemy, glm::vec3(0.2f));
+	for (int i = 0; i < 8; i++)
+		engine.AddCoin(coin, glm::vec3(0.3f));
+	engine.SetScreenPanelHP(panels[0], glm::vec3(0.1f, 0.9f, 0.2f));
+	engine.SetScreenPanelScore(panels[1], glm::vec3(0.1f, 0.9f, 0.2f));
+	engine.SetScreenPanelHunger(panels[2], glm::vec3(0.1f, 0.9f, 0.2f));
+	engine.LoadObjects();
+	engine.StartGame();
+
+	RecordingFrameStats frame = RecordingRenderDevice::GetLastFrame();
+	Check(RecordingRenderDevice::GetErrorCount() == 0, version + ": no invalid GL usage");
+	Check(AssetStreamer::GetResidentBytes() > 0, version + ": the models streamed in");
+	Check(frame.drawCalls <= baseline.drawCalls, version + ": " + std::to_string(frame.drawCalls)
+		+ " draw calls, baseline " + std::to_string(baseline.drawCalls));
+	Check(frame.stateChanges <= baseline.stateChanges, version + ": " + std::to_string(frame.stateChanges)
+		+ " state changes, baseline " + std::to_string(baseline.stateChanges));
+	Check(frame.uploadBytes <= baseline.uploadBytes, version + ": " + std::to_string(frame.uploadBytes)
+		+ " bytes uploaded, baseline " + std::to_string(baseline.uploadBytes));
+
+	ResourceManager::Clear();
+	engine.FinishGame();
+	TOTAL_LIVES = lives;
+	TOTAL_SCORE = score;
+	VAR_HUNGER = hunger;
+	camera = view;
+
+	RemoveCookedModel(player, material.size());
+	RemoveCookedModel(enemy, material.size());
+	RemoveCookedModel(coin, color.size());
+	for (int p = 0; p < 3; p++)
+		RemoveCookedModel(panels[p], color.size());
+	for (size_t f = 0; f < faces.size(); f++)
+		std::remove(faces[f].c_str());
+}
+
+int main(int argc, char **argv)
+{
+	for (size_t i = 0; i < sizeof(RECORDING_BASELINES) / sizeof(RECORDING_BASELINES[0]); i++)
+		TestRecordingBaseline(RECORDING_BASELINES[i]);
+	for (size_t i = 0; i < sizeof(ENGINE_BASELINES) / sizeof(ENGINE_BASELINES[0]); i++)
+		TestEngineBaseline(ENGINE_BASELINES[i]);
+	TestOcclusionCuller();
+	TestCookedMesh();
+	TestTexturePacker();
+	TestTextureLoader();
+
+	if (failures == 0)
+		std::cout << "Tests: all passed" << std::endl;
+	else
+		std::cout << "Tests: " << failures << " failed" << std::endl;
+	return (int)failures;
+}